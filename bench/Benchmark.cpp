@@ -0,0 +1,181 @@
+/*********************************************************************
+ *
+ * Benchmark.cpp:  A small harness for timing the primer design kernels.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdlib>
+#include <time.h>
+
+#include "Benchmark.h"
+
+using namespace std;
+
+//The version of the report format, raised whenever a field changes meaning.
+#define BENCHMARK_SCHEMA 1
+
+/*
+ * The malloc family is replaced by one which counts the calls before
+ * handing them to the C library, so that operator new and the C code
+ * of primer3 and samtools are counted alike. The benchmarks run on one
+ * thread.
+ */
+static uint64_t allocationCount = 0;
+static uint64_t allocationBytes = 0;
+
+extern "C" {
+
+void *__libc_malloc(size_t);
+void *__libc_calloc(size_t, size_t);
+void *__libc_realloc(void *, size_t);
+
+void *malloc(size_t size) {
+	allocationCount++;
+	allocationBytes += size;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+	allocationCount++;
+	allocationBytes += count * size;
+	return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+	allocationCount++;
+	allocationBytes += size;
+	return __libc_realloc(ptr, size);
+}
+
+}
+
+volatile double Benchmark::sink = 0;
+
+static uint64_t nowNanos() {
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+uint64_t Benchmark::allocations() {
+	return allocationCount;
+}
+
+uint64_t Benchmark::allocatedBytes() {
+	return allocationBytes;
+}
+
+Benchmark::Benchmark(double minSeconds, int repetitions, const string &filter) :
+	minSeconds(minSeconds), repetitions(repetitions), filter(filter) {
+}
+
+uint64_t Benchmark::timeIterations(BenchmarkCase &benchCase, long iterations) {
+
+	uint64_t start = nowNanos();
+	for(long i = 0; i < iterations; i++) {
+		benchCase.runOnce();
+	}
+	return nowNanos() - start;
+}
+
+bool Benchmark::run(BenchmarkCase &benchCase) {
+
+	if(!filter.empty() && benchCase.getName().find(filter) == string::npos) {
+		return true;
+	}
+
+	if(!benchCase.setUp()) {
+		cerr << "Could not set up the benchmark " << benchCase.getName() << endl;
+		return false;
+	}
+
+	//Warm up the caches and find the number of iterations.
+	uint64_t minNanos = (uint64_t) (minSeconds * 1e9);
+	long iterations = 1;
+	while(timeIterations(benchCase, iterations) < minNanos && iterations < (1L << 40)) {
+		iterations *= 2;
+	}
+
+	vector<double> nsPerOp;
+	uint64_t allocsBefore = allocationCount;
+	uint64_t bytesBefore = allocationBytes;
+	for(int i = 0; i < repetitions; i++) {
+		nsPerOp.push_back((double) timeIterations(benchCase, iterations) / iterations);
+	}
+	double ops = (double) iterations * repetitions;
+
+	sort(nsPerOp.begin(), nsPerOp.end());
+
+	Result result;
+	result.name = benchCase.getName();
+	result.iterations = iterations;
+	result.repetitions = repetitions;
+	result.nsPerOp = nsPerOp[nsPerOp.size() / 2];
+	result.minNsPerOp = nsPerOp.front();
+	result.allocsPerOp = (allocationCount - allocsBefore) / ops;
+	result.bytesPerOp = (allocationBytes - bytesBefore) / ops;
+	result.throughput = benchCase.getUnitsPerOp() * 1e9 / result.nsPerOp;
+	result.unit = benchCase.getUnit() + "/s";
+	results.push_back(result);
+
+	cerr << setw(32) << left << result.name << right << fixed << setprecision(1)
+			<< setw(14) << result.nsPerOp << " ns/op"
+			<< setw(10) << result.allocsPerOp << " allocs/op" << endl;
+
+	return true;
+}
+
+bool Benchmark::writeReport(const string &fileLoc) const {
+
+	ofstream file;
+	if(fileLoc != "-") {
+		file.open(fileLoc.c_str(), ios::out | ios::trunc);
+		if(!file.is_open()) {
+			cerr << "Could not open the benchmark report " << fileLoc << endl;
+			return false;
+		}
+	}
+	ostream &report = fileLoc == "-" ? cout : file;
+
+	//One benchmark per line with the fields always in the same order,
+	//so that two reports can be compared with a line diff.
+	report << fixed << setprecision(3);
+	report << "{\"schema\": " << BENCHMARK_SCHEMA << ", \"benchmarks\": [" << endl;
+	for(vector<Result>::const_iterator iterator=results.begin(); iterator!=results.end(); ++iterator) {
+		report << "  {\"name\": \"" << iterator->name << "\""
+				<< ", \"iterations\": " << iterator->iterations
+				<< ", \"repetitions\": " << iterator->repetitions
+				<< ", \"ns_per_op\": " << iterator->nsPerOp
+				<< ", \"min_ns_per_op\": " << iterator->minNsPerOp
+				<< ", \"allocs_per_op\": " << iterator->allocsPerOp
+				<< ", \"bytes_per_op\": " << iterator->bytesPerOp
+				<< ", \"throughput\": " << iterator->throughput
+				<< ", \"throughput_unit\": \"" << iterator->unit << "\"}"
+				<< (iterator + 1 != results.end() ? "," : "") << endl;
+	}
+	report << "]}" << endl;
+
+	if(fileLoc != "-") {
+		file.close();
+		if(file.fail()) {
+			cerr << "Could not write the benchmark report " << fileLoc << endl;
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,116 @@
+/*********************************************************************
+ *
+ * Benchmark.h:  A small harness for timing the primer design kernels.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * One operation to be measured, such as aligning a pair of oligos.
+ * runOnce() is called many times in a row after setUp(); whatever it
+ * computes should be passed to Benchmark::keep() so that it is not
+ * optimized away.
+ */
+class BenchmarkCase {
+
+public:
+	BenchmarkCase(const std::string &name, const std::string &unit, long unitsPerOp) :
+		name(name), unit(unit), unitsPerOp(unitsPerOp) {}
+	virtual ~BenchmarkCase() {}
+
+	/**
+	 * Prepares the case. Returns false if the case cannot be run, for
+	 * example when its input is missing.
+	 */
+	virtual bool setUp() { return true; }
+
+	virtual void runOnce() = 0;
+
+	const std::string &getName() const { return name; }
+
+	//What the throughput is counted in (bases, bytes) and how many
+	//of those one operation handles.
+	const std::string &getUnit() const { return unit; }
+	long getUnitsPerOp() const { return unitsPerOp; }
+
+protected:
+	std::string name;
+	std::string unit;
+	long unitsPerOp;
+};
+
+/**
+ * Runs benchmark cases and writes their results as JSON.
+ *
+ * The number of iterations of a case is doubled until one run takes
+ * at least the minimum time, then the case is run that many times for
+ * every repetition. The reported time per operation is the median of
+ * the repetitions. Allocations are counted by the malloc family of this
+ * program, so those of primer3 and samtools are included.
+ */
+class Benchmark {
+
+public:
+	Benchmark(double minSeconds, int repetitions, const std::string &filter);
+
+	/**
+	 * Runs the case unless its name does not contain the filter.
+	 * Returns false if the case could not be set up.
+	 */
+	bool run(BenchmarkCase &benchCase);
+
+	/**
+	 * Writes the results to the file, or to the standard output if the
+	 * file is "-". Returns false if the file could not be written.
+	 */
+	bool writeReport(const std::string &fileLoc) const;
+
+	/**
+	 * Keeps a computed value alive.
+	 */
+	static void keep(double value) { sink += value; }
+
+	//The number of allocations and bytes requested since the program started.
+	static uint64_t allocations();
+	static uint64_t allocatedBytes();
+
+protected:
+
+	struct Result {
+		std::string name;
+		long iterations;
+		int repetitions;
+		double nsPerOp;
+		double minNsPerOp;
+		double allocsPerOp;
+		double bytesPerOp;
+		double throughput;
+		std::string unit;
+	};
+
+	double minSeconds;
+	int repetitions;
+	std::string filter;
+	std::vector<Result> results;
+
+	static volatile double sink;
+
+	//Runs the case the given number of times and returns the time taken.
+	static uint64_t timeIterations(BenchmarkCase &benchCase, long iterations);
+};
+
+#endif /* BENCHMARK_H_ */
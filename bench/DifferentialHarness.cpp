@@ -0,0 +1,738 @@
+/*********************************************************************
+ *
+ * DifferentialHarness.cpp:  Designs the same regions with the reference
+ * and the optimized kernels in one process and reports the first place
+ * where the two disagree.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <glob.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "SamtoolsWrapper.h"
+#include "Primer3Wrapper.h"
+#include "SequencesAdapter.h"
+#include "ConfigurationLoader.h"
+#include "Utility.h"
+#include "WorkloadGenerator.h"
+
+using namespace std;
+
+const static string MAIN_CONFIG_FILE = "essentials/medreseq.config";
+
+//The memory of the reference cache of the optimized fetch, when the
+//configuration does not give one.
+#define OPTIMIZED_REFERENCE_CACHE_MB 64
+
+//The prefixes of the output files of the two engines.
+#define REFERENCE_OUTPUT "reference"
+#define OPTIMIZED_OUTPUT "optimized"
+
+/*
+ * The result of one settings file on one region, with the settings it
+ * was designed with, which the oligo sequences and limits come from.
+ */
+struct Design {
+	Primer3Settings *settings;
+	p3retval *retval;
+
+	Design() : settings(NULL), retval(NULL) {}
+	~Design() {
+		if(retval != NULL) {
+			destroy_p3retval(retval);
+		}
+		delete settings;
+	}
+};
+
+/*
+ * Gives access to the primer3 result of a single settings file, which
+ * the wrapper only hands out converted to a PrimerOutput.
+ */
+class DifferentialPrimer3Wrapper : public Primer3Wrapper {
+
+public:
+
+	/**
+	 * Designs primers for the region with the settings file, in the same way
+	 * as Primer3Wrapper::createPrimers(const string &, ...). Returns false if
+	 * primer3 gave no result at all.
+	 */
+	bool design(const string &settingsFile, const SequenceRegionOutput &seqRegOut, Design &design) {
+
+		design.settings = new Primer3Settings(settingsFile, NULL, NULL, PRIMER_THERMO_CONFIG_DEFAULT);
+		fillPrimerParameters(*design.settings);
+
+		design.retval = createPrimers(*design.settings, seqRegOut);
+		return design.retval != NULL;
+	}
+};
+
+/*
+ * The named counters of the oligo and pair statistics that the engines
+ * must agree on. The counts of skipped thermodynamic alignments are left
+ * out, as only the optimized engine skips any.
+ */
+struct OligoCounter {
+	const char *name;
+	int oligo_stats::*field;
+};
+
+static const OligoCounter OLIGO_COUNTERS[] = {
+	{"considered", &oligo_stats::considered}, {"ns", &oligo_stats::ns},
+	{"target", &oligo_stats::target}, {"excluded", &oligo_stats::excluded},
+	{"gc", &oligo_stats::gc}, {"gc_clamp", &oligo_stats::gc_clamp},
+	{"gc_end_high", &oligo_stats::gc_end_high}, {"temp_min", &oligo_stats::temp_min},
+	{"temp_max", &oligo_stats::temp_max}, {"size_min", &oligo_stats::size_min},
+	{"size_max", &oligo_stats::size_max}, {"compl_any", &oligo_stats::compl_any},
+	{"compl_end", &oligo_stats::compl_end}, {"hairpin_th", &oligo_stats::hairpin_th},
+	{"repeat_score", &oligo_stats::repeat_score}, {"poly_x", &oligo_stats::poly_x},
+	{"seq_quality", &oligo_stats::seq_quality}, {"stability", &oligo_stats::stability},
+	{"no_orf", &oligo_stats::no_orf}, {"template_mispriming", &oligo_stats::template_mispriming},
+	{"off_target", &oligo_stats::off_target},
+	{"ok", &oligo_stats::ok}, {"gmasked", &oligo_stats::gmasked},
+	{"not_in_any_left_ok_region", &oligo_stats::not_in_any_left_ok_region},
+	{"not_in_any_right_ok_region", &oligo_stats::not_in_any_right_ok_region}
+};
+
+struct PairCounter {
+	const char *name;
+	int pair_stats::*field;
+};
+
+static const PairCounter PAIR_COUNTERS[] = {
+	{"considered", &pair_stats::considered}, {"product", &pair_stats::product},
+	{"target", &pair_stats::target}, {"temp_diff", &pair_stats::temp_diff},
+	{"compl_any", &pair_stats::compl_any}, {"compl_end", &pair_stats::compl_end},
+	{"internal", &pair_stats::internal}, {"repeat_sim", &pair_stats::repeat_sim},
+	{"high_tm", &pair_stats::high_tm}, {"low_tm", &pair_stats::low_tm},
+	{"template_mispriming", &pair_stats::template_mispriming},
+	{"off_target", &pair_stats::off_target},
+	{"does_not_overlap_a_required_point", &pair_stats::does_not_overlap_a_required_point},
+	{"overlaps_oligo_in_better_pair", &pair_stats::overlaps_oligo_in_better_pair},
+	{"not_in_any_ok_region", &pair_stats::not_in_any_ok_region},
+	{"reversed", &pair_stats::reversed}, {"ok", &pair_stats::ok}
+};
+
+/*
+ * Compares the two engines and prints the first divergence it finds
+ * with the candidates of both engines around it.
+ */
+class EngineComparison {
+
+public:
+
+	EngineComparison(double tolerance, ostream &out) : tolerance(tolerance), out(out) {}
+
+	/**
+	 * Compares the sequences both fetches gave for every region.
+	 */
+	bool compareFetches(const map<string, SequenceRegionOutput> &reference,
+						const map<string, SequenceRegionOutput> &optimized);
+
+	/**
+	 * Compares the designs of one region with one settings file.
+	 */
+	bool compareDesigns(const string &region, const Design &reference, const Design &optimized);
+
+	/**
+	 * Compares the output files written with the two prefixes line by line.
+	 */
+	bool compareOutputFiles(const string &referencePrefix, const string &optimizedPrefix);
+
+protected:
+
+	double tolerance;
+	ostream &out;
+
+	//Where the designs being compared come from, for the report.
+	string region;
+	string settingsFile;
+
+	bool differs(double reference, double optimized) const;
+	bool scoreDiffers(double reference, double optimized, double limit) const;
+	const char *firstOligoDifference(const primer_rec &, const primer_rec &,
+										const args_for_one_oligo_or_primer &, bool) const;
+	const char *firstPairDifference(const primer_pair &, const primer_pair &,
+										const p3_global_settings &) const;
+
+	void printDivergence(const string &what, const string &reference, const string &optimized);
+	void printOligo(const char *engine, const seq_args *, const primer_rec &, oligo_type) const;
+	void printPair(const char *engine, const seq_args *, const primer_pair &) const;
+
+	bool compareStrings(const char *what, const pr_append_str &, const pr_append_str &);
+	bool compareOligoArrays(const char *what, const Design &, const Design &,
+							const oligo_array &, const oligo_array &, const args_for_one_oligo_or_primer &);
+	bool comparePairArrays(const Design &, const Design &);
+};
+
+static string toString(double value) {
+
+	if(value == ALIGN_SCORE_BELOW_LIMIT) {
+		return "below-limit";
+	}
+	ostringstream text;
+	text.precision(10);
+	text << value;
+	return text.str();
+}
+
+static string toString(long value) {
+
+	ostringstream text;
+	text << value;
+	return text.str();
+}
+
+bool EngineComparison::differs(double reference, double optimized) const {
+
+	double scale = max(1.0, max(fabs(reference), fabs(optimized)));
+	return fabs(reference - optimized) > tolerance * scale;
+}
+
+/*
+ * A thermodynamic score the optimized engine did not compute agrees with
+ * the reference one if that one is within the limit.
+ */
+bool EngineComparison::scoreDiffers(double reference, double optimized, double limit) const {
+
+	if(optimized == ALIGN_SCORE_BELOW_LIMIT && reference != ALIGN_SCORE_BELOW_LIMIT) {
+		return limit < 0 || reference > limit;
+	}
+	return differs(reference, optimized);
+}
+
+static double repeatScore(const primer_rec &rec) {
+	return rec.repeat_sim.score != NULL ? rec.repeat_sim.score[rec.repeat_sim.max] : 0;
+}
+
+/*
+ * The name of the first field the oligos differ in, or NULL. The oligos
+ * of the returned pairs have all their scores computed, so those may
+ * not be below-limit.
+ */
+const char *EngineComparison::firstOligoDifference(const primer_rec &reference, const primer_rec &optimized,
+													const args_for_one_oligo_or_primer &args, bool isScored) const {
+
+	if(reference.start != optimized.start) return "start";
+	if(reference.length != optimized.length) return "length";
+	if(differs(reference.temp, optimized.temp)) return "temp";
+	if(differs(reference.gc_content, optimized.gc_content)) return "gc_content";
+	if(differs(reference.quality, optimized.quality)) return "quality";
+	if(differs(reference.end_stability, optimized.end_stability)) return "end_stability";
+	if(isScored ? differs(reference.self_any, optimized.self_any) :
+			scoreDiffers(reference.self_any, optimized.self_any, args.max_self_any_th)) return "self_any";
+	if(isScored ? differs(reference.self_end, optimized.self_end) :
+			scoreDiffers(reference.self_end, optimized.self_end, args.max_self_end_th)) return "self_end";
+	if(isScored ? differs(reference.hairpin_th, optimized.hairpin_th) :
+			scoreDiffers(reference.hairpin_th, optimized.hairpin_th, args.max_hairpin_th)) return "hairpin_th";
+	if(differs(reference.template_mispriming, optimized.template_mispriming)) return "template_mispriming";
+	if(differs(reference.template_mispriming_r, optimized.template_mispriming_r)) return "template_mispriming_r";
+	if(differs(repeatScore(reference), repeatScore(optimized))) return "repeat_sim";
+	if(reference.problems.prob != optimized.problems.prob) return "problems";
+	return NULL;
+}
+
+const char *EngineComparison::firstPairDifference(const primer_pair &reference, const primer_pair &optimized,
+													const p3_global_settings &settings) const {
+
+	if(reference.product_size != optimized.product_size) return "product_size";
+	if(differs(reference.pair_quality, optimized.pair_quality)) return "pair_quality";
+	if(differs(reference.compl_any, optimized.compl_any)) return "compl_any";
+	if(differs(reference.compl_end, optimized.compl_end)) return "compl_end";
+	if(differs(reference.template_mispriming, optimized.template_mispriming)) return "template_mispriming";
+	if(differs(reference.product_tm, optimized.product_tm)) return "product_tm";
+	if(differs(reference.diff_tm, optimized.diff_tm)) return "diff_tm";
+	if(differs(reference.repeat_sim, optimized.repeat_sim)) return "repeat_sim";
+	if(firstOligoDifference(*reference.left, *optimized.left, settings.p_args, true) != NULL) return "left";
+	if(firstOligoDifference(*reference.right, *optimized.right, settings.p_args, true) != NULL) return "right";
+	if((reference.intl == NULL) != (optimized.intl == NULL)) return "intl";
+	if(reference.intl != NULL &&
+			firstOligoDifference(*reference.intl, *optimized.intl, settings.o_args, true) != NULL) return "intl";
+	return NULL;
+}
+
+void EngineComparison::printDivergence(const string &what, const string &reference, const string &optimized) {
+
+	out << "DIVERGENCE in " << what << "\n"
+			<< "  region:    " << region << "\n"
+			<< "  settings:  " << settingsFile << "\n";
+
+	//The candidates are printed by the caller when there are any.
+	if(!reference.empty() || !optimized.empty()) {
+		out << "  reference: " << reference << "\n"
+				<< "  optimized: " << optimized << "\n";
+	}
+}
+
+void EngineComparison::printOligo(const char *engine, const seq_args *sa,
+									const primer_rec &rec, oligo_type type) const {
+
+	string sequence = type == OT_RIGHT ? pr_oligo_rev_c_sequence(sa, &rec) : pr_oligo_sequence(sa, &rec);
+	out << "  " << engine << ": " << sequence
+			<< " start=" << rec.start << " length=" << (int) rec.length
+			<< " tm=" << toString(rec.temp) << " gc=" << toString(rec.gc_content)
+			<< " quality=" << toString(rec.quality) << " end_stability=" << toString(rec.end_stability)
+			<< " self_any=" << toString(rec.self_any) << " self_end=" << toString(rec.self_end)
+			<< " hairpin_th=" << toString(rec.hairpin_th)
+			<< " template_mispriming=" << toString(rec.template_mispriming)
+			<< "/" << toString(rec.template_mispriming_r)
+			<< " repeat_sim=" << toString(repeatScore(rec))
+			<< " problems=\"" << p3_get_ol_problem_string(&rec) << "\"\n";
+}
+
+void EngineComparison::printPair(const char *engine, const seq_args *sa, const primer_pair &pair) const {
+
+	out << "  " << engine << " pair: product_size=" << pair.product_size
+			<< " quality=" << toString(pair.pair_quality)
+			<< " compl_any=" << toString(pair.compl_any) << " compl_end=" << toString(pair.compl_end)
+			<< " template_mispriming=" << toString(pair.template_mispriming)
+			<< " product_tm=" << toString(pair.product_tm) << " diff_tm=" << toString(pair.diff_tm)
+			<< " repeat_sim=" << toString(pair.repeat_sim) << "\n";
+	printOligo("  left", sa, *pair.left, OT_LEFT);
+	printOligo("  right", sa, *pair.right, OT_RIGHT);
+	if(pair.intl != NULL) {
+		printOligo("  intl", sa, *pair.intl, OT_INTL);
+	}
+}
+
+bool EngineComparison::compareFetches(const map<string, SequenceRegionOutput> &reference,
+										const map<string, SequenceRegionOutput> &optimized) {
+
+	settingsFile = "-";
+
+	map<string, SequenceRegionOutput>::const_iterator optIterator = optimized.begin();
+	for(map<string, SequenceRegionOutput>::const_iterator refIterator=reference.begin();
+			refIterator!=reference.end(); ++refIterator, ++optIterator) {
+
+		region = refIterator->first;
+		if(optIterator == optimized.end() || optIterator->first != refIterator->first) {
+			printDivergence("the fetched regions", refIterator->first,
+					optIterator == optimized.end() ? "(none)" : optIterator->first);
+			return false;
+		}
+
+		const SequenceRegionOutput &ref = refIterator->second;
+		const SequenceRegionOutput &opt = optIterator->second;
+		if(ref.getPrevSequence() != opt.getPrevSequence()) {
+			printDivergence("the fetched sequence before the target", ref.getPrevSequence(), opt.getPrevSequence());
+			return false;
+		}
+		if(ref.getTargetSequence() != opt.getTargetSequence()) {
+			printDivergence("the fetched target", ref.getTargetSequence(), opt.getTargetSequence());
+			return false;
+		}
+		if(ref.getNextSequence() != opt.getNextSequence()) {
+			printDivergence("the fetched sequence after the target", ref.getNextSequence(), opt.getNextSequence());
+			return false;
+		}
+	}
+
+	if(optIterator != optimized.end()) {
+		region = optIterator->first;
+		printDivergence("the fetched regions", "(none)", optIterator->first);
+		return false;
+	}
+
+	return true;
+}
+
+bool EngineComparison::compareStrings(const char *what, const pr_append_str &reference,
+										const pr_append_str &optimized) {
+
+	string ref = reference.data != NULL ? reference.data : "";
+	string opt = optimized.data != NULL ? optimized.data : "";
+	if(ref != opt) {
+		printDivergence(what, ref, opt);
+		return false;
+	}
+	return true;
+}
+
+bool EngineComparison::compareOligoArrays(const char *what, const Design &reference, const Design &optimized,
+											const oligo_array &ref, const oligo_array &opt,
+											const args_for_one_oligo_or_primer &args) {
+
+	for(size_t i = 0; i < sizeof(OLIGO_COUNTERS) / sizeof(OLIGO_COUNTERS[0]); i++) {
+		int refCount = ref.expl.*OLIGO_COUNTERS[i].field;
+		int optCount = opt.expl.*OLIGO_COUNTERS[i].field;
+		if(refCount != optCount) {
+			printDivergence(string(what) + " statistics, " + OLIGO_COUNTERS[i].name,
+					toString((long) refCount), toString((long) optCount));
+			return false;
+		}
+	}
+
+	if(ref.num_elem != opt.num_elem) {
+		printDivergence(string(what) + " candidates", toString((long) ref.num_elem), toString((long) opt.num_elem));
+		return false;
+	}
+
+	for(int i = 0; i < ref.num_elem; i++) {
+		const char *field = firstOligoDifference(ref.oligo[i], opt.oligo[i], args, false);
+		if(field != NULL) {
+			ostringstream where;
+			where << what << " candidate " << i << ", " << field;
+			printDivergence(where.str(), "", "");
+			printOligo("reference", reference.settings->sequenceSetting, ref.oligo[i], ref.type);
+			printOligo("optimized", optimized.settings->sequenceSetting, opt.oligo[i], opt.type);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool EngineComparison::comparePairArrays(const Design &reference, const Design &optimized) {
+
+	const pair_array_t &ref = reference.retval->best_pairs;
+	const pair_array_t &opt = optimized.retval->best_pairs;
+
+	for(size_t i = 0; i < sizeof(PAIR_COUNTERS) / sizeof(PAIR_COUNTERS[0]); i++) {
+		int refCount = ref.expl.*PAIR_COUNTERS[i].field;
+		int optCount = opt.expl.*PAIR_COUNTERS[i].field;
+		if(refCount != optCount) {
+			printDivergence(string("pair statistics, ") + PAIR_COUNTERS[i].name,
+					toString((long) refCount), toString((long) optCount));
+			return false;
+		}
+	}
+
+	if(ref.num_pairs != opt.num_pairs) {
+		printDivergence("pairs", toString((long) ref.num_pairs), toString((long) opt.num_pairs));
+		return false;
+	}
+
+	for(int i = 0; i < ref.num_pairs; i++) {
+		const char *field = firstPairDifference(ref.pairs[i], opt.pairs[i], *reference.settings->globalSetting);
+		if(field != NULL) {
+			ostringstream where;
+			where << "pair " << i << ", " << field;
+			printDivergence(where.str(), "", "");
+			printPair("reference", reference.settings->sequenceSetting, ref.pairs[i]);
+			printPair("optimized", optimized.settings->sequenceSetting, opt.pairs[i]);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool EngineComparison::compareDesigns(const string &region, const Design &reference, const Design &optimized) {
+
+	this->region = region;
+	this->settingsFile = reference.settings->settingsFile;
+
+	if((reference.retval == NULL) != (optimized.retval == NULL)) {
+		printDivergence("the primer3 result", reference.retval == NULL ? "(none)" : "a result",
+				optimized.retval == NULL ? "(none)" : "a result");
+		return false;
+	}
+	if(reference.retval == NULL) {
+		return true;
+	}
+
+	const p3retval &ref = *reference.retval;
+	const p3retval &opt = *optimized.retval;
+	const p3_global_settings &settings = *reference.settings->globalSetting;
+
+	return compareStrings("the global error", ref.glob_err, opt.glob_err) &&
+			compareStrings("the sequence error", ref.per_sequence_err, opt.per_sequence_err) &&
+			compareStrings("the warnings", ref.warnings, opt.warnings) &&
+			compareOligoArrays("left", reference, optimized, ref.fwd, opt.fwd, settings.p_args) &&
+			compareOligoArrays("right", reference, optimized, ref.rev, opt.rev, settings.p_args) &&
+			compareOligoArrays("internal", reference, optimized, ref.intl, opt.intl, settings.o_args) &&
+			comparePairArrays(reference, optimized);
+}
+
+static vector<string> globFiles(const string &pattern) {
+
+	vector<string> files;
+	glob_t matches;
+	if(glob(pattern.c_str(), 0, NULL, &matches) == 0) {
+		for(size_t i = 0; i < matches.gl_pathc; i++) {
+			files.push_back(matches.gl_pathv[i]);
+		}
+	}
+	globfree(&matches);
+	return files;
+}
+
+bool EngineComparison::compareOutputFiles(const string &referencePrefix, const string &optimizedPrefix) {
+
+	region = "-";
+	settingsFile = "-";
+
+	vector<string> referenceFiles = globFiles(referencePrefix + ".*");
+	vector<string> optimizedFiles = globFiles(optimizedPrefix + ".*");
+	vector<string> more = globFiles(referencePrefix + "-*");
+	referenceFiles.insert(referenceFiles.end(), more.begin(), more.end());
+	more = globFiles(optimizedPrefix + "-*");
+	optimizedFiles.insert(optimizedFiles.end(), more.begin(), more.end());
+
+	if(referenceFiles.size() != optimizedFiles.size()) {
+		printDivergence("the output files", toString((long) referenceFiles.size()) + " files",
+				toString((long) optimizedFiles.size()) + " files");
+		return false;
+	}
+
+	for(vector<string>::const_iterator file=referenceFiles.begin(); file!=referenceFiles.end(); ++file) {
+
+		string suffix = file->substr(referencePrefix.length());
+		ifstream ref(file->c_str());
+		ifstream opt((optimizedPrefix + suffix).c_str());
+		if(!opt.is_open()) {
+			printDivergence("the output files", *file, "(no " + optimizedPrefix + suffix + ")");
+			return false;
+		}
+
+		string refLine, optLine;
+		for(int lineNo = 1; ; lineNo++) {
+			bool hasRef = (bool) getline(ref, refLine);
+			bool hasOpt = (bool) getline(opt, optLine);
+			if(!hasRef && !hasOpt) {
+				break;
+			}
+			if(hasRef != hasOpt || refLine != optLine) {
+				region = file->substr(file->rfind('/') + 1) + ":" + toString((long) lineNo);
+				printDivergence("the output file line", hasRef ? refLine : "(end of file)",
+						hasOpt ? optLine : "(end of file)");
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static void removeDirectory(const string &dirLoc) {
+
+	DIR *dir = opendir(dirLoc.c_str());
+	if(dir == NULL) {
+		return;
+	}
+	struct dirent *entry;
+	while((entry = readdir(dir)) != NULL) {
+		if(strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..")) {
+			unlink((dirLoc + "/" + entry->d_name).c_str());
+		}
+	}
+	closedir(dir);
+	rmdir(dirLoc.c_str());
+}
+
+/*
+ * Fetches the regions of the input, or reads the sequences of a sequence
+ * input, with the given fasta wrapper.
+ */
+static map<string, SequenceRegionOutput> readInput(SamtoolsWrapper &samtoolsWrapper,
+													const string &input, bool isRegionInput) {
+
+	map<string, SequenceRegionOutput> sequencesMap;
+
+	if(!isRegionInput) {
+		SequencesAdapter sequenceAdapter;
+		if(Utility::fileExists(input)) {
+			sequencesMap = sequenceAdapter.retrieveSequencesFromFile(input);
+		}
+		else {
+			sequencesMap.insert(pair<string, SequenceRegionOutput>
+								("UNKNOWN", sequenceAdapter.retrieveSequenceObj("UNKNOWN", input)));
+		}
+	}
+	else if(Utility::fileExists(input)) {
+		sequencesMap = samtoolsWrapper.retrieveSequencesForRegions(input);
+	}
+	else {
+		sequencesMap.insert(pair<string, SequenceRegionOutput>
+							(input, samtoolsWrapper.retrieveSequenceForRegion(input)));
+	}
+
+	return sequencesMap;
+}
+
+int main(int argc, char *argv[]) {
+
+	string usage = "Usage: MedReseqDiff [options] (-f fasta -r region-input | -s sequence-input | --workload preset)\n"
+			"Designs every region with the reference and the optimized kernels and reports the first divergence.\n"
+			"Run from the MedReseq root directory, as MedReseq reads essentials/medreseq.config.\n"
+			"\t-f, --fasta\tThe fasta file of the regions.\n"
+			"\t-r, --region\tA region, regions file, vcf file or bed file.\n"
+			"\t-s, --sequence\tA sequence or sequences file, instead of -f and -r.\n"
+			"\t--workload\tA preset of MedReseqWorkload (small, medium or large), instead of the above.\n"
+			"\t--tolerance\tThe relative difference tolerated between scores (default 1e-6).\n"
+			"\t--work-dir\tAn existing directory the workload and outputs are kept in\n"
+			"\t\t\t(default a temporary directory which is removed unless they diverge).\n";
+
+	string fastaFile;
+	string input;
+	bool isRegionInput = true;
+	string workload;
+	double tolerance = 1e-6;
+	string workDir;
+
+	for(int i = 1; i < argc; i++) {
+		if(i + 1 == argc) {
+			cerr << usage;
+			return EXIT_FAILURE;
+		}
+		if(!strcmp(argv[i], "-f") || !strcmp(argv[i], "--fasta")) {
+			fastaFile = argv[++i];
+		}
+		else if(!strcmp(argv[i], "-r") || !strcmp(argv[i], "--region")) {
+			input = argv[++i];
+			isRegionInput = true;
+		}
+		else if(!strcmp(argv[i], "-s") || !strcmp(argv[i], "--sequence")) {
+			input = argv[++i];
+			isRegionInput = false;
+		}
+		else if(!strcmp(argv[i], "--workload")) {
+			workload = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--tolerance")) {
+			tolerance = atof(argv[++i]);
+		}
+		else if(!strcmp(argv[i], "--work-dir")) {
+			workDir = argv[++i];
+		}
+		else {
+			cerr << usage;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(workload.empty() == input.empty() || (isRegionInput && workload.empty() && fastaFile.empty())) {
+		cerr << usage;
+		return EXIT_FAILURE;
+	}
+
+	ConfigurationHolder configHolder = ConfigurationLoader::obtainConfigurationSettings(MAIN_CONFIG_FILE);
+	ConfigurationLoader::applyConfigurationSetting(configHolder);
+	if(configHolder.isError()) {
+		cerr << configHolder.getErrorMsg() << endl;
+	}
+	vector<string> settingsFiles = configHolder.getSettingsFiles();
+
+	bool isTempDir = workDir.empty();
+	if(isTempDir) {
+		char tempDir[] = "/tmp/medreseq-diff-XXXXXX";
+		if(mkdtemp(tempDir) == NULL) {
+			cerr << "Could not create a temporary directory" << endl;
+			return EXIT_FAILURE;
+		}
+		workDir = tempDir;
+	}
+
+	if(!workload.empty()) {
+		WorkloadSpec spec;
+		if(!WorkloadSpec::preset(workload, spec)) {
+			cerr << "Unknown workload " << workload << endl;
+			return EXIT_FAILURE;
+		}
+		string prefix = workDir + "/" + workload;
+		cerr << "Generating the " << workload << " workload" << endl;
+		WorkloadGenerator generator(spec);
+		if(!generator.generate(prefix)) {
+			return EXIT_FAILURE;
+		}
+		fastaFile = prefix + WorkloadGenerator::FASTA_EXTENSION;
+		input = prefix + WorkloadGenerator::REGIONS_EXTENSION;
+	}
+
+	//The reference fetch reads the fasta a character at a time with
+	//faidx_fetch_seq(); the optimized one reads the packed reference
+	//through the cache.
+	SamtoolsWrapper referenceFetch, optimizedFetch;
+	if(!fastaFile.empty()) {
+		SamtoolsWrapper::USE_REFERENCE_READS = true;
+		int referenceCacheMb = SamtoolsWrapper::REFERENCE_CACHE_MB;
+		SamtoolsWrapper::REFERENCE_CACHE_MB = 0;
+		bool isLoaded = referenceFetch.loadFastaFile(fastaFile);
+
+		SamtoolsWrapper::USE_REFERENCE_READS = false;
+		SamtoolsWrapper::REFERENCE_CACHE_MB = referenceCacheMb > 0 ? referenceCacheMb : OPTIMIZED_REFERENCE_CACHE_MB;
+		if(!isLoaded || !optimizedFetch.loadFastaFile(fastaFile)) {
+			cerr << "Error in loading the fasta index file " << fastaFile << endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	EngineComparison comparison(tolerance, cout);
+	bool retVal = true;
+
+	map<string, SequenceRegionOutput> referenceMap = readInput(referenceFetch, input, isRegionInput);
+	map<string, SequenceRegionOutput> optimizedMap = readInput(optimizedFetch, input, isRegionInput);
+	retVal = comparison.compareFetches(referenceMap, optimizedMap);
+
+	//Every settings file is tried on every region, not only until one
+	//succeeds, so that the later tiers are compared as well.
+	//Each engine keeps the settings it read in its own wrapper, so that the
+	//reference one reads them the plain way.
+	DifferentialPrimer3Wrapper referenceWrapper, optimizedWrapper;
+	int designs = 0;
+	for(map<string, SequenceRegionOutput>::const_iterator iterator=referenceMap.begin();
+			retVal && iterator!=referenceMap.end(); ++iterator) {
+
+		for(vector<string>::const_iterator settingsFile=settingsFiles.begin();
+				retVal && settingsFile!=settingsFiles.end(); ++settingsFile) {
+
+			Design reference, optimized;
+
+			Primer3Wrapper::setReferenceKernels(true);
+			referenceWrapper.design(*settingsFile, iterator->second, reference);
+
+			Primer3Wrapper::setReferenceKernels(false);
+			optimizedWrapper.design(*settingsFile, iterator->second, optimized);
+
+			retVal = comparison.compareDesigns(iterator->first, reference, optimized);
+			designs++;
+		}
+	}
+
+	//And the files written for the whole input, as MedReseq writes them.
+	if(retVal) {
+		string referencePrefix = workDir + "/" + REFERENCE_OUTPUT;
+		string optimizedPrefix = workDir + "/" + OPTIMIZED_OUTPUT;
+
+		Primer3Wrapper::setReferenceKernels(true);
+		referenceWrapper.createPrimers(settingsFiles, referenceMap, referencePrefix);
+
+		Primer3Wrapper::setReferenceKernels(false);
+		optimizedWrapper.createPrimers(settingsFiles, optimizedMap, optimizedPrefix);
+
+		retVal = comparison.compareOutputFiles(referencePrefix, optimizedPrefix);
+	}
+
+	if(retVal) {
+		cout << "No divergence in " << referenceMap.size() << " regions, " << designs << " designs" << endl;
+	}
+
+	//The outputs of a divergence are kept for a look.
+	if(isTempDir && retVal) {
+		removeDirectory(workDir);
+	}
+	else if(isTempDir) {
+		cerr << "The inputs and outputs are kept in " << workDir << endl;
+	}
+
+	return retVal ? EXIT_SUCCESS : EXIT_FAILURE;
+}
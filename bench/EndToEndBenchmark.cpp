@@ -0,0 +1,555 @@
+/*********************************************************************
+ *
+ * EndToEndBenchmark.cpp:  Runs MedReseq over synthetic workloads and
+ * records its wall time, peak memory, throughput and success per tier,
+ * optionally against a baseline run.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <glob.h>
+#include <dirent.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "WorkloadGenerator.h"
+
+using namespace std;
+
+//The version of the report format, raised whenever a field changes meaning.
+#define BENCHMARK_SCHEMA 1
+
+//The suffix and extension of the terse output files, one per tier.
+#define PRIMERS_FILE_SUFFIX ".primers"
+
+/*
+ * What one run of MedReseq over one input of a workload gave.
+ */
+struct RunResult {
+	string name;
+	int regions;
+	int exitStatus;
+	double wallSeconds;
+	double userSeconds;
+	double systemSeconds;
+	long peakRssKb;
+	double regionsPerSecond;
+
+	//The number of regions written to each terse file, by tier name.
+	map<string, int> tiers;
+};
+
+static double nowSeconds() {
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static vector<string> split(const string &text, char delimiter) {
+
+	vector<string> parts;
+	istringstream stream(text);
+	string part;
+	while(getline(stream, part, delimiter)) {
+		if(!part.empty()) {
+			parts.push_back(part);
+		}
+	}
+	return parts;
+}
+
+static int countLines(const string &fileLoc) {
+
+	ifstream file(fileLoc.c_str());
+	string line;
+	int count = 0;
+	while(getline(file, line)) {
+		count++;
+	}
+	return count;
+}
+
+/*
+ * Counts the regions in the terse files of a run. Every region has a
+ * forward line, named ...F, whether it has primers or an error.
+ */
+static void countTiers(const string &outputPrefix, map<string, int> &tiers) {
+
+	string pattern = outputPrefix + "-*" + PRIMERS_FILE_SUFFIX;
+	glob_t files;
+	if(glob(pattern.c_str(), 0, NULL, &files) != 0) {
+		return;
+	}
+
+	for(size_t i = 0; i < files.gl_pathc; i++) {
+		string fileLoc = files.gl_pathv[i];
+		string tier = fileLoc.substr(outputPrefix.length() + 1,
+				fileLoc.length() - outputPrefix.length() - 1 - strlen(PRIMERS_FILE_SUFFIX));
+
+		ifstream file(fileLoc.c_str());
+		string line;
+		int count = 0;
+		while(getline(file, line)) {
+			size_t separator = line.find(", ");
+			if(separator != string::npos && separator > 0 && line[separator - 1] == 'F') {
+				count++;
+			}
+		}
+		tiers[tier] = count;
+	}
+
+	globfree(&files);
+}
+
+/*
+ * Runs MedReseq with its output sent to the log file and measures it.
+ */
+static bool runMedReseq(const string &medreseq, const vector<string> &args,
+						const string &logFile, RunResult &result) {
+
+	double start = nowSeconds();
+
+	pid_t pid = fork();
+	if(pid < 0) {
+		cerr << "Could not start " << medreseq << endl;
+		return false;
+	}
+	if(pid == 0) {
+		int fd = open(logFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(fd >= 0) {
+			dup2(fd, STDOUT_FILENO);
+			dup2(fd, STDERR_FILENO);
+			close(fd);
+		}
+
+		vector<char *> argv;
+		argv.push_back((char *) medreseq.c_str());
+		for(vector<string>::const_iterator iterator=args.begin(); iterator!=args.end(); ++iterator) {
+			argv.push_back((char *) iterator->c_str());
+		}
+		argv.push_back(NULL);
+
+		execv(medreseq.c_str(), &argv[0]);
+		_exit(127);
+	}
+
+	int status;
+	struct rusage usage;
+	if(wait4(pid, &status, 0, &usage) < 0) {
+		cerr << "Could not wait for " << medreseq << endl;
+		return false;
+	}
+
+	result.wallSeconds = nowSeconds() - start;
+	result.userSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6;
+	result.systemSeconds = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+	result.peakRssKb = usage.ru_maxrss;
+	result.exitStatus = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+	result.regionsPerSecond = result.wallSeconds > 0 ? result.regions / result.wallSeconds : 0;
+
+	return true;
+}
+
+/*
+ * Generates the workload in a child process. The peak RSS of a child
+ * includes what it inherited from this process before its exec, so the
+ * reference is never held here.
+ */
+static bool generateWorkload(const WorkloadSpec &spec, const string &prefix) {
+
+	pid_t pid = fork();
+	if(pid < 0) {
+		cerr << "Could not start the workload generator" << endl;
+		return false;
+	}
+	if(pid == 0) {
+		WorkloadGenerator generator(spec);
+		_exit(generator.generate(prefix) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	int status;
+	return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+static void writeResult(ostream &report, const RunResult &result) {
+
+	report << "  {\"name\": \"" << result.name << "\""
+			<< ", \"regions\": " << result.regions
+			<< ", \"exit_status\": " << result.exitStatus
+			<< ", \"wall_seconds\": " << result.wallSeconds
+			<< ", \"user_seconds\": " << result.userSeconds
+			<< ", \"system_seconds\": " << result.systemSeconds
+			<< ", \"peak_rss_kb\": " << result.peakRssKb
+			<< ", \"regions_per_second\": " << result.regionsPerSecond
+			<< ", \"tiers\": {";
+	for(map<string, int>::const_iterator iterator=result.tiers.begin(); iterator!=result.tiers.end(); ++iterator) {
+		report << (iterator == result.tiers.begin() ? "" : ", ") << "\"" << iterator->first << "\": " << iterator->second;
+	}
+	report << "}}";
+}
+
+static bool writeReport(const string &fileLoc, const string &medreseq, const vector<RunResult> &results) {
+
+	ofstream file;
+	if(fileLoc != "-") {
+		file.open(fileLoc.c_str(), ios::out | ios::trunc);
+		if(!file.is_open()) {
+			cerr << "Could not open the benchmark report " << fileLoc << endl;
+			return false;
+		}
+	}
+	ostream &report = fileLoc == "-" ? cout : file;
+
+	//One run per line with the fields always in the same order, which
+	//is also what readBaseline() relies on.
+	report << fixed << setprecision(3);
+	report << "{\"schema\": " << BENCHMARK_SCHEMA << ", \"medreseq\": \"" << medreseq << "\", \"runs\": [" << endl;
+	for(vector<RunResult>::const_iterator iterator=results.begin(); iterator!=results.end(); ++iterator) {
+		writeResult(report, *iterator);
+		report << (iterator + 1 != results.end() ? "," : "") << endl;
+	}
+	report << "]}" << endl;
+
+	if(fileLoc != "-") {
+		file.close();
+		if(file.fail()) {
+			cerr << "Could not write the benchmark report " << fileLoc << endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static double numberField(const string &line, const string &key) {
+
+	size_t position = line.find("\"" + key + "\": ");
+	if(position == string::npos) {
+		return 0;
+	}
+	return atof(line.c_str() + position + key.length() + 4);
+}
+
+/*
+ * Reads the runs of a report written by writeReport().
+ */
+static bool readBaseline(const string &fileLoc, map<string, RunResult> &baseline) {
+
+	ifstream file(fileLoc.c_str());
+	if(!file.is_open()) {
+		cerr << "Could not open the baseline " << fileLoc << endl;
+		return false;
+	}
+
+	string line;
+	while(getline(file, line)) {
+		size_t nameStart = line.find("{\"name\": \"");
+		if(nameStart == string::npos) {
+			continue;
+		}
+		nameStart += 10;
+
+		RunResult result;
+		result.name = line.substr(nameStart, line.find('"', nameStart) - nameStart);
+		result.regions = (int) numberField(line, "regions");
+		result.exitStatus = (int) numberField(line, "exit_status");
+		result.wallSeconds = numberField(line, "wall_seconds");
+		result.userSeconds = numberField(line, "user_seconds");
+		result.systemSeconds = numberField(line, "system_seconds");
+		result.peakRssKb = (long) numberField(line, "peak_rss_kb");
+		result.regionsPerSecond = numberField(line, "regions_per_second");
+
+		size_t tiersStart = line.find("\"tiers\": {");
+		if(tiersStart != string::npos) {
+			tiersStart += 10;
+			string tiers = line.substr(tiersStart, line.find('}', tiersStart) - tiersStart);
+			vector<string> entries = split(tiers, ',');
+			for(vector<string>::const_iterator iterator=entries.begin(); iterator!=entries.end(); ++iterator) {
+				size_t open = iterator->find('"');
+				size_t close = iterator->find('"', open + 1);
+				if(open != string::npos && close != string::npos) {
+					result.tiers[iterator->substr(open + 1, close - open - 1)] = atoi(iterator->c_str() + close + 2);
+				}
+			}
+		}
+
+		baseline[result.name] = result;
+	}
+
+	return true;
+}
+
+static string percentChange(double before, double after) {
+
+	ostringstream change;
+	change << showpos << fixed << setprecision(1) << (before > 0 ? (after - before) * 100 / before : 0.0) << "%";
+	return change.str();
+}
+
+/*
+ * Prints every run next to its baseline. A run regresses if its
+ * throughput drops or its peak memory grows by more than the tolerance,
+ * or if the regions land in different tiers. Returns false if any does.
+ */
+static bool compareWithBaseline(const vector<RunResult> &results, const map<string, RunResult> &baseline,
+								double tolerance) {
+
+	bool retVal = true;
+
+	cerr << endl << left << setw(20) << "run" << right
+			<< setw(14) << "regions/s" << setw(10) << "change"
+			<< setw(14) << "peak RSS kB" << setw(10) << "change" << "  status" << endl;
+
+	for(vector<RunResult>::const_iterator iterator=results.begin(); iterator!=results.end(); ++iterator) {
+		map<string, RunResult>::const_iterator base = baseline.find(iterator->name);
+		cerr << left << setw(20) << iterator->name << right << fixed << setprecision(2)
+				<< setw(14) << iterator->regionsPerSecond;
+		if(base == baseline.end()) {
+			cerr << setw(10) << "" << setw(14) << iterator->peakRssKb << setw(10) << "" << "  no baseline" << endl;
+			continue;
+		}
+
+		string status;
+		if(iterator->regionsPerSecond < base->second.regionsPerSecond * (1 - tolerance / 100)) {
+			status += " slower";
+		}
+		if(iterator->peakRssKb > base->second.peakRssKb * (1 + tolerance / 100)) {
+			status += " more-memory";
+		}
+		if(iterator->tiers != base->second.tiers || iterator->exitStatus != base->second.exitStatus) {
+			status += " tiers-changed";
+		}
+		retVal = retVal && status.empty();
+
+		cerr << setw(10) << percentChange(base->second.regionsPerSecond, iterator->regionsPerSecond)
+				<< setw(14) << iterator->peakRssKb
+				<< setw(10) << percentChange(base->second.peakRssKb, iterator->peakRssKb)
+				<< " " << (status.empty() ? " ok" : status) << endl;
+	}
+
+	return retVal;
+}
+
+static void removeDirectory(const string &dirLoc) {
+
+	DIR *dir = opendir(dirLoc.c_str());
+	if(dir == NULL) {
+		return;
+	}
+	struct dirent *entry;
+	while((entry = readdir(dir)) != NULL) {
+		if(strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..")) {
+			unlink((dirLoc + "/" + entry->d_name).c_str());
+		}
+	}
+	closedir(dir);
+	rmdir(dirLoc.c_str());
+}
+
+int main(int argc, char *argv[]) {
+
+	string usage = "Usage: MedReseqEndToEnd [options]\n"
+			"Run from the MedReseq root directory, as MedReseq reads essentials/medreseq.config.\n"
+			"\t--medreseq\tThe MedReseq executable (default ./MedReseq).\n"
+			"\t--workloads\tComma separated presets of MedReseqWorkload (default small,medium,large).\n"
+			"\t--inputs\tComma separated inputs to run: regions, vcf, bed, sequence\n"
+			"\t\t\t(default all for small, regions for the others).\n"
+			"\t--out\tThe file the JSON report is written to, - for the standard output (default).\n"
+			"\t--baseline\tA report of an earlier run to compare with.\n"
+			"\t--tolerance\tThe change in percent tolerated against the baseline (default 10).\n"
+			"\t--work-dir\tAn existing directory the workloads and outputs are kept in\n"
+			"\t\t\t(default a temporary directory which is removed).\n";
+
+	string medreseq = "./MedReseq";
+	string workloadsArg = "small,medium,large";
+	string inputsArg;
+	string outFile = "-";
+	string baselineFile;
+	double tolerance = 10;
+	string workDir;
+
+	for(int i = 1; i < argc; i++) {
+		if(i + 1 == argc) {
+			cerr << usage;
+			return EXIT_FAILURE;
+		}
+		if(!strcmp(argv[i], "--medreseq")) {
+			medreseq = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--workloads")) {
+			workloadsArg = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--inputs")) {
+			inputsArg = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--out")) {
+			outFile = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--baseline")) {
+			baselineFile = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--tolerance")) {
+			tolerance = atof(argv[++i]);
+		}
+		else if(!strcmp(argv[i], "--work-dir")) {
+			workDir = argv[++i];
+		}
+		else {
+			cerr << usage;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(access(medreseq.c_str(), X_OK) != 0) {
+		cerr << "Cannot run " << medreseq << endl;
+		return EXIT_FAILURE;
+	}
+
+	map<string, RunResult> baseline;
+	if(!baselineFile.empty() && !readBaseline(baselineFile, baseline)) {
+		return EXIT_FAILURE;
+	}
+
+	bool isTempDir = workDir.empty();
+	if(isTempDir) {
+		char tempDir[] = "/tmp/medreseq-benchmark-XXXXXX";
+		if(mkdtemp(tempDir) == NULL) {
+			cerr << "Could not create a temporary directory" << endl;
+			return EXIT_FAILURE;
+		}
+		workDir = tempDir;
+	}
+
+	bool retVal = true;
+	vector<RunResult> results;
+
+	vector<string> workloads = split(workloadsArg, ',');
+	for(vector<string>::const_iterator workload=workloads.begin(); workload!=workloads.end(); ++workload) {
+
+		WorkloadSpec spec;
+		if(!WorkloadSpec::preset(*workload, spec)) {
+			cerr << "Unknown workload " << *workload << endl;
+			retVal = false;
+			continue;
+		}
+
+		string prefix = workDir + "/" + *workload;
+		cerr << "Generating the " << *workload << " workload" << endl;
+		if(!generateWorkload(spec, prefix)) {
+			retVal = false;
+			continue;
+		}
+		int regions = countLines(prefix + WorkloadGenerator::REGIONS_EXTENSION);
+
+		//MedReseq packs a reference the first time it loads it; a run over
+		//one region does that, so that every measured run finds it packed.
+		string firstRegion;
+		ifstream regionsFile((prefix + WorkloadGenerator::REGIONS_EXTENSION).c_str());
+		getline(regionsFile, firstRegion);
+
+		vector<string> warmUpArgs;
+		warmUpArgs.push_back("-f");
+		warmUpArgs.push_back(prefix + WorkloadGenerator::FASTA_EXTENSION);
+		warmUpArgs.push_back("-r");
+		warmUpArgs.push_back(firstRegion);
+		warmUpArgs.push_back("-o");
+		warmUpArgs.push_back(prefix + "-warmup");
+
+		RunResult warmUp;
+		warmUp.regions = 1;
+		if(firstRegion.empty() || !runMedReseq(medreseq, warmUpArgs, prefix + "-warmup.log", warmUp) ||
+				warmUp.exitStatus != 0) {
+			cerr << "Could not run MedReseq on the " << *workload << " workload" << endl;
+			retVal = false;
+			continue;
+		}
+
+		vector<string> inputs = split(!inputsArg.empty() ? inputsArg :
+				(*workload == "small" ? "regions,vcf,bed,sequence" : "regions"), ',');
+		for(vector<string>::const_iterator input=inputs.begin(); input!=inputs.end(); ++input) {
+
+			vector<string> args;
+			args.push_back("-f");
+			args.push_back(prefix + WorkloadGenerator::FASTA_EXTENSION);
+			if(*input == "regions") {
+				args.push_back("-r");
+				args.push_back(prefix + WorkloadGenerator::REGIONS_EXTENSION);
+			}
+			else if(*input == "vcf") {
+				args.push_back("-r");
+				args.push_back(prefix + WorkloadGenerator::VCF_EXTENSION);
+			}
+			else if(*input == "bed") {
+				args.push_back("-r");
+				args.push_back(prefix + WorkloadGenerator::BED_EXTENSION);
+			}
+			else if(*input == "sequence") {
+				args.push_back("-s");
+				args.push_back(prefix + WorkloadGenerator::SEQUENCES_EXTENSION);
+			}
+			else {
+				cerr << "Unknown input " << *input << endl;
+				retVal = false;
+				continue;
+			}
+
+			string outputPrefix = prefix + "-" + *input;
+			args.push_back("-o");
+			args.push_back(outputPrefix);
+
+			RunResult result;
+			result.name = *workload + "/" + *input;
+			result.regions = regions;
+
+			cerr << "Running " << result.name << " (" << regions << " regions)" << endl;
+			if(!runMedReseq(medreseq, args, outputPrefix + ".log", result)) {
+				retVal = false;
+				continue;
+			}
+			countTiers(outputPrefix, result.tiers);
+
+			if(result.exitStatus != 0) {
+				cerr << result.name << " exited with status " << result.exitStatus
+						<< ", see " << outputPrefix << ".log" << endl;
+				retVal = false;
+			}
+			results.push_back(result);
+		}
+	}
+
+	retVal = writeReport(outFile, medreseq, results) && retVal;
+
+	if(!baselineFile.empty()) {
+		retVal = compareWithBaseline(results, baseline, tolerance) && retVal;
+	}
+
+	//The outputs and logs of a failed run are kept for a look.
+	if(isTempDir && retVal) {
+		removeDirectory(workDir);
+	}
+	else if(isTempDir) {
+		cerr << "The workloads and outputs are kept in " << workDir << endl;
+	}
+
+	return retVal ? EXIT_SUCCESS : EXIT_FAILURE;
+}
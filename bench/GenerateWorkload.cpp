@@ -0,0 +1,120 @@
+/*********************************************************************
+ *
+ * GenerateWorkload.cpp:  Writes a synthetic reference with matching
+ * regions, VCF, BED and sequence files.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+#include "WorkloadGenerator.h"
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+
+	string usage = "Usage: MedReseqWorkload [options] -o prefix\n"
+			"Writes prefix.fa (indexed), prefix.regions, prefix.vcf, prefix.bed and prefix.sequences\n"
+			"\t-o, --output\tThe prefix of the files written.\n"
+			"\t--preset\tsmall, medium or large; the options below change the preset.\n"
+			"\t--contigs\tThe number of contigs.\n"
+			"\t--contig-length\tThe length of every contig.\n"
+			"\t--gc\tThe GC fraction of the unique sequence (0-1).\n"
+			"\t--repeats\tThe fraction of the reference in soft masked repeats (0-1).\n"
+			"\t--n-runs\tThe number of runs of N per contig.\n"
+			"\t--n-run-length\tThe length of a run of N.\n"
+			"\t--regions\tThe number of targets.\n"
+			"\t--min-target\tThe shortest target.\n"
+			"\t--max-target\tThe longest target.\n"
+			"\t--clustering\tThe chance that a target lies near the one before it (0-1).\n"
+			"\t--cluster-span\tThe largest gap between clustered targets.\n"
+			"\t--seed\tThe seed of the generator.\n";
+
+	WorkloadSpec spec;
+	string prefix;
+
+	for(int i = 1; i < argc; i++) {
+		if(i + 1 == argc) {
+			cerr << usage;
+			return EXIT_FAILURE;
+		}
+		if(!strcmp(argv[i], "-o") || !strcmp(argv[i], "--output")) {
+			prefix = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--preset")) {
+			//The preset replaces the whole specification, so it comes first.
+			if(!WorkloadSpec::preset(argv[++i], spec)) {
+				cerr << "Unknown preset " << argv[i] << endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if(!strcmp(argv[i], "--contigs")) {
+			spec.contigs = atoi(argv[++i]);
+		}
+		else if(!strcmp(argv[i], "--contig-length")) {
+			spec.contigLength = atol(argv[++i]);
+		}
+		else if(!strcmp(argv[i], "--gc")) {
+			spec.gcContent = atof(argv[++i]);
+		}
+		else if(!strcmp(argv[i], "--repeats")) {
+			spec.repeatFraction = atof(argv[++i]);
+		}
+		else if(!strcmp(argv[i], "--n-runs")) {
+			spec.nRunsPerContig = atoi(argv[++i]);
+		}
+		else if(!strcmp(argv[i], "--n-run-length")) {
+			spec.nRunLength = atoi(argv[++i]);
+		}
+		else if(!strcmp(argv[i], "--regions")) {
+			spec.regions = atoi(argv[++i]);
+		}
+		else if(!strcmp(argv[i], "--min-target")) {
+			spec.minTargetLength = atoi(argv[++i]);
+		}
+		else if(!strcmp(argv[i], "--max-target")) {
+			spec.maxTargetLength = atoi(argv[++i]);
+		}
+		else if(!strcmp(argv[i], "--clustering")) {
+			spec.clustering = atof(argv[++i]);
+		}
+		else if(!strcmp(argv[i], "--cluster-span")) {
+			spec.clusterSpan = atoi(argv[++i]);
+		}
+		else if(!strcmp(argv[i], "--seed")) {
+			spec.seed = strtoull(argv[++i], NULL, 10);
+		}
+		else {
+			cerr << usage;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(prefix.empty() || spec.contigs < 1 || spec.contigLength < 1 ||
+			spec.gcContent < 0 || spec.gcContent > 1 ||
+			spec.repeatFraction < 0 || spec.repeatFraction >= 1 ||
+			spec.nRunsPerContig < 0 || spec.nRunLength < 0 || spec.nRunLength > spec.contigLength ||
+			spec.regions < 0 || spec.minTargetLength < 1 || spec.maxTargetLength < spec.minTargetLength ||
+			spec.clustering < 0 || spec.clustering > 1 || spec.clusterSpan < 0) {
+		cerr << usage;
+		return EXIT_FAILURE;
+	}
+
+	WorkloadGenerator generator(spec);
+	if(!generator.generate(prefix)) {
+		return EXIT_FAILURE;
+	}
+
+	cout << "The workload is: " << prefix << endl;
+	return EXIT_SUCCESS;
+}
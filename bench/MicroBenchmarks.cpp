@@ -0,0 +1,400 @@
+/*********************************************************************
+ *
+ * MicroBenchmarks.cpp:  Microbenchmarks of the kernels the primer
+ * design spends its time in: thermodynamic and dynamic programming
+ * alignments, melting temperatures, reference fetches and the loading
+ * of mispriming libraries.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "Benchmark.h"
+#include "thal.h"
+#include "dpal.h"
+#include "oligotm.h"
+#include "libprimer3.h"
+#include "faidx.h"
+
+using namespace std;
+
+//The default location of the thermodynamic parameters and the mispriming library.
+#define THERMO_CONFIG_LOCATION "essentials/primer3_config/"
+#define MISPRIMING_LIBRARY_LOCATION "essentials/humrep_and_simple.txt"
+
+//The length of the synthetic contig fetched from.
+#define REFERENCE_LENGTH 4000000
+
+//The salt and oligo concentrations primer3 uses by default.
+#define DNA_CONC 50.0
+#define SALT_CONC 50.0
+#define DIVALENT_CONC 0.0
+#define DNTP_CONC 0.0
+
+//The longest sequence seqtm() uses the nearest neighbor model for,
+//MAX_PRIMER_LENGTH of libprimer3.c.
+#define NN_MAX_LENGTH 36
+
+/*
+ * A fixed pseudo random sequence of bases, so that every run and every
+ * build measures the same input.
+ */
+static string randomBases(unsigned int seed, int length) {
+
+	static const char bases[] = "ACGT";
+	string sequence(length, 'N');
+	for(int i = 0; i < length; i++) {
+		seed = seed * 1103515245 + 12345;
+		sequence[i] = bases[(seed >> 16) & 3];
+	}
+	return sequence;
+}
+
+/*
+ * thal() of two oligos, or of one oligo with itself for hairpins.
+ */
+class ThalCase : public BenchmarkCase {
+
+public:
+	ThalCase(const string &name, thal_alignment_type type, int length) :
+		BenchmarkCase(name, "bases", length), type(type) {
+		oligo1 = randomBases(length, length);
+		oligo2 = type == thal_hairpin ? oligo1 : randomBases(length + 1000, length);
+	}
+
+	bool setUp() {
+		set_thal_default_args(&args);
+		args.type = type;
+		args.dimer = type == thal_hairpin ? 0 : 1;
+		return true;
+	}
+
+	void runOnce() {
+		thal_results results;
+		thal((const unsigned char *) oligo1.c_str(), (const unsigned char *) oligo2.c_str(), &args, &results);
+		Benchmark::keep(results.temp);
+	}
+
+private:
+	thal_alignment_type type;
+	thal_args args;
+	string oligo1, oligo2;
+};
+
+/*
+ * dpal() of a primer against a sequence, as in the mispriming checks.
+ */
+class DpalCase : public BenchmarkCase {
+
+public:
+	DpalCase(const string &name, int flag, int primerLength, int targetLength) :
+		BenchmarkCase(name, "bases", targetLength), flag(flag) {
+		primer = randomBases(primerLength, primerLength);
+		target = randomBases(targetLength + 2000, targetLength);
+	}
+
+	bool setUp() {
+		set_dpal_args(&args);
+		args.flag = flag;
+		return true;
+	}
+
+	void runOnce() {
+		dpal_results results;
+		dpal((const unsigned char *) primer.c_str(), (const unsigned char *) target.c_str(), &args, &results);
+		Benchmark::keep(results.score);
+	}
+
+private:
+	int flag;
+	dpal_args args;
+	string primer, target;
+};
+
+/*
+ * The melting temperature functions of oligotm.
+ */
+class TmCase : public BenchmarkCase {
+
+public:
+	enum Function { OLIGOTM, SEQTM, LONG_SEQ_TM };
+
+	TmCase(const string &name, Function function, int length) :
+		BenchmarkCase(name, "bases", length), function(function) {
+		sequence = randomBases(length + 3000, length);
+	}
+
+	void runOnce() {
+		double tm;
+		switch(function) {
+		case OLIGOTM:
+			tm = oligotm(sequence.c_str(), DNA_CONC, SALT_CONC, DIVALENT_CONC, DNTP_CONC,
+					santalucia_auto, santalucia);
+			break;
+		case SEQTM:
+			tm = seqtm(sequence.c_str(), DNA_CONC, SALT_CONC, DIVALENT_CONC, DNTP_CONC,
+					NN_MAX_LENGTH, santalucia_auto, santalucia);
+			break;
+		default:
+			tm = long_seq_tm(sequence.c_str(), 0, sequence.length(), SALT_CONC, DIVALENT_CONC, DNTP_CONC);
+			break;
+		}
+		Benchmark::keep(tm);
+	}
+
+private:
+	Function function;
+	string sequence;
+};
+
+/*
+ * fai_fetch() of spans at pseudo random places of an indexed FASTA file.
+ */
+class FetchCase : public BenchmarkCase {
+
+public:
+	FetchCase(const string &name, faidx_t *fai, int span) :
+		BenchmarkCase(name, "bases", span), fai(fai), span(span), seed(span) {}
+
+	bool setUp() { return fai != NULL; }
+
+	void runOnce() {
+		seed = seed * 1103515245 + 12345;
+		int start = 1 + (seed >> 4) % (REFERENCE_LENGTH - span);
+
+		char region[64];
+		snprintf(region, sizeof(region), "bench:%d-%d", start, start + span - 1);
+
+		int len;
+		char *sequence = fai_fetch(fai, region, &len);
+		Benchmark::keep(len);
+		free(sequence);
+	}
+
+private:
+	faidx_t *fai;
+	int span;
+	unsigned int seed;
+};
+
+/*
+ * read_and_create_seq_lib() of a mispriming library, parsed or mapped
+ * from its snapshot.
+ */
+class SeqLibCase : public BenchmarkCase {
+
+public:
+	SeqLibCase(const string &name, const string &fileLoc, bool useSnapshots) :
+		BenchmarkCase(name, "bytes", 0), fileLoc(fileLoc), useSnapshots(useSnapshots) {}
+
+	bool setUp() {
+		ifstream file(fileLoc.c_str(), ios::in | ios::ate);
+		if(!file.is_open()) {
+			return false;
+		}
+		unitsPerOp = file.tellg();
+
+		//Leave a snapshot behind for the runs to map.
+		seq_lib_use_snapshots(useSnapshots);
+		runOnce();
+		return true;
+	}
+
+	void runOnce() {
+		seq_lib *lib = read_and_create_seq_lib(fileLoc.c_str(), "benchmark");
+		Benchmark::keep(seq_lib_num_seq(lib));
+		destroy_seq_lib(lib);
+	}
+
+private:
+	string fileLoc;
+	bool useSnapshots;
+};
+
+/*
+ * Writes a synthetic contig to the FASTA file and indexes it.
+ */
+static bool createReference(const string &fileLoc) {
+
+	ofstream fasta(fileLoc.c_str(), ios::out | ios::trunc);
+	if(!fasta.is_open()) {
+		return false;
+	}
+
+	string sequence = randomBases(REFERENCE_LENGTH, REFERENCE_LENGTH);
+	fasta << ">bench" << endl;
+	for(int i = 0; i < REFERENCE_LENGTH; i += 60) {
+		fasta << sequence.substr(i, 60) << endl;
+	}
+	fasta.close();
+
+	return !fasta.fail() && fai_build(fileLoc.c_str()) == 0;
+}
+
+static bool copyFile(const string &fromLoc, const string &toLoc) {
+
+	ifstream from(fromLoc.c_str(), ios::in | ios::binary);
+	ofstream to(toLoc.c_str(), ios::out | ios::trunc | ios::binary);
+	if(!from.is_open() || !to.is_open()) {
+		return false;
+	}
+	to << from.rdbuf();
+	to.close();
+
+	return !to.fail();
+}
+
+int main(int argc, char *argv[]) {
+
+	string usage = "Usage: MedReseqBench [options]\n"
+			"\t--out\tThe file the JSON report is written to, - for the standard output (default).\n"
+			"\t--filter\tRun only the benchmarks whose name contains this text.\n"
+			"\t--min-time\tThe minimum time in seconds of one repetition (default 0.2).\n"
+			"\t--repetitions\tThe number of repetitions of every benchmark (default 5).\n"
+			"\t--thermo\tThe directory of the thermodynamic parameters.\n"
+			"\t--library\tThe mispriming library to load.\n";
+
+	string outFile = "-";
+	string filter;
+	double minSeconds = 0.2;
+	int repetitions = 5;
+	string thermoPath = THERMO_CONFIG_LOCATION;
+	string libraryFile = MISPRIMING_LIBRARY_LOCATION;
+
+	for(int i = 1; i < argc; i++) {
+		string option = argv[i];
+		if(option == "-h" || option == "--help") {
+			cout << usage;
+			return 0;
+		}
+		if(i + 1 == argc) {
+			cerr << usage;
+			return 1;
+		}
+		if(option == "--out") {
+			outFile = argv[++i];
+		}
+		else if(option == "--filter") {
+			filter = argv[++i];
+		}
+		else if(option == "--min-time") {
+			minSeconds = atof(argv[++i]);
+		}
+		else if(option == "--repetitions") {
+			repetitions = atoi(argv[++i]);
+		}
+		else if(option == "--thermo") {
+			thermoPath = argv[++i];
+		}
+		else if(option == "--library") {
+			libraryFile = argv[++i];
+		}
+		else {
+			cerr << usage;
+			return 1;
+		}
+	}
+
+	if(minSeconds <= 0 || repetitions < 1) {
+		cerr << usage;
+		return 1;
+	}
+
+	thal_results thalRes;
+	if(thal_load_default_parameters(&thalRes) != 0 &&
+			get_thermodynamic_values(thermoPath.c_str(), &thalRes) != 0) {
+		cerr << thalRes.msg << endl;
+		return 1;
+	}
+
+	//The generated inputs live in a directory of their own which is removed at the end.
+	char tempDir[] = "/tmp/medreseq-bench-XXXXXX";
+	if(mkdtemp(tempDir) == NULL) {
+		cerr << "Could not create a temporary directory" << endl;
+		return 1;
+	}
+	string referenceFile = string(tempDir) + "/reference.fa";
+	string libraryCopy = string(tempDir) + "/library.fa";
+
+	faidx_t *fai = NULL;
+	if(createReference(referenceFile)) {
+		fai = fai_load(referenceFile.c_str());
+	}
+	if(!copyFile(libraryFile, libraryCopy)) {
+		cerr << "Could not copy the mispriming library " << libraryFile << endl;
+	}
+
+	vector<BenchmarkCase *> cases;
+
+	const int oligoLengths[] = {18, 24, 30, 36};
+	for(int i = 0; i < 4; i++) {
+		ostringstream length;
+		length << oligoLengths[i];
+		cases.push_back(new ThalCase("thal/any/" + length.str(), thal_any, oligoLengths[i]));
+		cases.push_back(new ThalCase("thal/end1/" + length.str(), thal_end1, oligoLengths[i]));
+		cases.push_back(new ThalCase("thal/hairpin/" + length.str(), thal_hairpin, oligoLengths[i]));
+	}
+
+	const int targetLengths[] = {20, 300, 1000};
+	for(int i = 0; i < 3; i++) {
+		ostringstream length;
+		length << "20x" << targetLengths[i];
+		cases.push_back(new DpalCase("dpal/local/" + length.str(), DPAL_LOCAL, 20, targetLengths[i]));
+		cases.push_back(new DpalCase("dpal/local_end/" + length.str(), DPAL_LOCAL_END, 20, targetLengths[i]));
+	}
+
+	for(int i = 0; i < 4; i++) {
+		ostringstream length;
+		length << oligoLengths[i];
+		cases.push_back(new TmCase("oligotm/" + length.str(), TmCase::OLIGOTM, oligoLengths[i]));
+	}
+	cases.push_back(new TmCase("seqtm/20", TmCase::SEQTM, 20));
+	cases.push_back(new TmCase("seqtm/300", TmCase::SEQTM, 300));
+	cases.push_back(new TmCase("long_seq_tm/300", TmCase::LONG_SEQ_TM, 300));
+	cases.push_back(new TmCase("long_seq_tm/3000", TmCase::LONG_SEQ_TM, 3000));
+
+	const int spans[] = {100, 1000, 10000, 100000};
+	for(int i = 0; i < 4; i++) {
+		ostringstream span;
+		span << spans[i];
+		cases.push_back(new FetchCase("fai_fetch/" + span.str(), fai, spans[i]));
+	}
+
+	cases.push_back(new SeqLibCase("seq_lib/parse", libraryCopy, false));
+	cases.push_back(new SeqLibCase("seq_lib/snapshot", libraryCopy, true));
+
+	Benchmark benchmark(minSeconds, repetitions, filter);
+	bool retVal = true;
+	for(vector<BenchmarkCase *>::iterator iterator=cases.begin(); iterator!=cases.end(); ++iterator) {
+		retVal = benchmark.run(**iterator) && retVal;
+		delete *iterator;
+	}
+	retVal = benchmark.writeReport(outFile) && retVal;
+
+	if(fai != NULL) {
+		fai_destroy(fai);
+	}
+	destroy_thal_structures();
+
+	unlink(referenceFile.c_str());
+	unlink((referenceFile + ".fai").c_str());
+	unlink(libraryCopy.c_str());
+	unlink((libraryCopy + ".p3sl").c_str());
+	rmdir(tempDir);
+
+	return retVal ? 0 : 1;
+}
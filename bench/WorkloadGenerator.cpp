@@ -0,0 +1,365 @@
+/*********************************************************************
+ *
+ * WorkloadGenerator.cpp:  Synthetic references and inputs for
+ * end to end benchmarks.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cctype>
+
+#include "WorkloadGenerator.h"
+#include "faidx.h"
+
+using namespace std;
+
+//The length of the lines of the FASTA file.
+#define FASTA_LINE_LENGTH 60
+
+//The interspersed repeat elements every copy is taken from, and how
+//much a copy diverges from its element.
+#define REPEAT_ELEMENTS 8
+#define REPEAT_ELEMENT_LENGTH 300
+#define REPEAT_DIVERGENCE 0.1
+
+//The mean length of a repeat copy, used to space them out.
+#define REPEAT_MEAN_LENGTH 170
+
+//Targets keep this far from the ends of a contig, so that the sequence
+//around them can be fetched.
+#define TARGET_MARGIN 1000
+
+//The flanks of a target in the sequences file.
+#define SEQUENCE_FLANK_LENGTH 250
+
+//The attempts to place a target before giving up on clustering it.
+#define TARGET_ATTEMPTS 100
+
+const std::string WorkloadGenerator::FASTA_EXTENSION = ".fa";
+const std::string WorkloadGenerator::REGIONS_EXTENSION = ".regions";
+const std::string WorkloadGenerator::VCF_EXTENSION = ".vcf";
+const std::string WorkloadGenerator::BED_EXTENSION = ".bed";
+const std::string WorkloadGenerator::SEQUENCES_EXTENSION = ".sequences";
+
+WorkloadSpec::WorkloadSpec() :
+	contigs(2), contigLength(1000000), gcContent(0.41), repeatFraction(0.45),
+	nRunsPerContig(2), nRunLength(10000),
+	regions(25), minTargetLength(20), maxTargetLength(150), clustering(0.6), clusterSpan(5000),
+	seed(1) {
+}
+
+bool WorkloadSpec::preset(const string &name, WorkloadSpec &spec) {
+
+	spec = WorkloadSpec();
+
+	if(name == "small") {
+		spec.contigs = 2;
+		spec.contigLength = 1000000;
+		spec.regions = 25;
+	}
+	else if(name == "medium") {
+		spec.contigs = 4;
+		spec.contigLength = 2000000;
+		spec.regions = 150;
+	}
+	else if(name == "large") {
+		spec.contigs = 8;
+		spec.contigLength = 4000000;
+		spec.regions = 600;
+	}
+	else {
+		return false;
+	}
+
+	return true;
+}
+
+WorkloadGenerator::WorkloadGenerator(const WorkloadSpec &spec) :
+	spec(spec), state(spec.seed) {
+}
+
+/*
+ * splitmix64, so that the files do not depend on the C library.
+ */
+uint64_t WorkloadGenerator::nextRandom() {
+
+	uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+double WorkloadGenerator::nextDouble() {
+	return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+long WorkloadGenerator::nextLong(long bound) {
+	return bound > 0 ? (long) (nextRandom() % (uint64_t) bound) : 0;
+}
+
+string WorkloadGenerator::contigName(int contig) const {
+
+	ostringstream name;
+	name << "chr" << (contig + 1);
+	return name.str();
+}
+
+char WorkloadGenerator::randomBase() {
+
+	double u = nextDouble();
+	if(u < spec.gcContent) {
+		return u < spec.gcContent / 2 ? 'G' : 'C';
+	}
+	return u < spec.gcContent + (1 - spec.gcContent) / 2 ? 'A' : 'T';
+}
+
+void WorkloadGenerator::generateContigs() {
+
+	vector<string> elements;
+	for(int i = 0; i < REPEAT_ELEMENTS; i++) {
+		string element;
+		for(int j = 0; j < REPEAT_ELEMENT_LENGTH; j++) {
+			element += tolower(randomBase());
+		}
+		elements.push_back(element);
+	}
+
+	//The unique stretches are spaced so that repeats cover the requested fraction.
+	double meanUniqueLength = spec.repeatFraction > 0 ?
+			REPEAT_MEAN_LENGTH * (1 - spec.repeatFraction) / spec.repeatFraction : spec.contigLength;
+
+	contigs.clear();
+	for(int c = 0; c < spec.contigs; c++) {
+		string contig;
+		contig.reserve(spec.contigLength + 2 * REPEAT_ELEMENT_LENGTH);
+
+		while((long) contig.length() < spec.contigLength) {
+			long uniqueLength = (long) (-meanUniqueLength * log(1 - nextDouble()));
+			for(long i = 0; i < uniqueLength; i++) {
+				contig += randomBase();
+			}
+			if(spec.repeatFraction <= 0) {
+				continue;
+			}
+
+			if(nextDouble() < 0.3) {
+				//A microsatellite of a 1 to 6 base unit.
+				string unit;
+				for(long i = 1 + nextLong(6); i > 0; i--) {
+					unit += tolower(randomBase());
+				}
+				for(long length = 20 + nextLong(180); length > 0; length -= unit.length()) {
+					contig += unit;
+				}
+			}
+			else {
+				//A diverged, possibly truncated copy of an interspersed element.
+				const string &element = elements[nextLong(REPEAT_ELEMENTS)];
+				long length = 100 + nextLong(REPEAT_ELEMENT_LENGTH - 100 + 1);
+				for(long i = REPEAT_ELEMENT_LENGTH - length; i < REPEAT_ELEMENT_LENGTH; i++) {
+					contig += nextDouble() < REPEAT_DIVERGENCE ? tolower(randomBase()) : element[i];
+				}
+			}
+		}
+		contig.resize(spec.contigLength);
+
+		for(int n = 0; n < spec.nRunsPerContig; n++) {
+			long start = nextLong(spec.contigLength - spec.nRunLength);
+			for(long i = start; i < start + spec.nRunLength && i < spec.contigLength; i++) {
+				contig[i] = 'N';
+			}
+		}
+
+		contigs.push_back(contig);
+	}
+}
+
+bool WorkloadGenerator::overlapsN(int contig, long start, long end) const {
+
+	const string &sequence = contigs[contig];
+	for(long i = start - 1; i < end; i++) {
+		if(sequence[i] == 'N') {
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorkloadGenerator::generateTargets() {
+
+	targets.clear();
+
+	long usable = spec.contigLength - 2 * TARGET_MARGIN - spec.maxTargetLength;
+	if(usable <= 0) {
+		return;
+	}
+
+	for(int i = 0; i < spec.regions; i++) {
+		Target target;
+		long length = spec.minTargetLength + nextLong(spec.maxTargetLength - spec.minTargetLength + 1);
+
+		bool placed = false;
+		for(int attempt = 0; attempt < TARGET_ATTEMPTS && !placed; attempt++) {
+			if(!targets.empty() && nextDouble() < spec.clustering) {
+				const Target &previous = targets.back();
+				target.contig = previous.contig;
+				target.start = previous.end + 1 + nextLong(spec.clusterSpan);
+			}
+			else {
+				target.contig = nextLong(spec.contigs);
+				target.start = TARGET_MARGIN + 1 + nextLong(usable);
+			}
+			target.end = target.start + length - 1;
+
+			placed = target.end + TARGET_MARGIN <= spec.contigLength &&
+					!overlapsN(target.contig, target.start, target.end);
+		}
+
+		if(placed) {
+			targets.push_back(target);
+		}
+	}
+
+	sort(targets.begin(), targets.end());
+}
+
+bool WorkloadGenerator::writeFasta(const string &fileLoc) const {
+
+	ofstream fasta(fileLoc.c_str(), ios::out | ios::trunc);
+	if(!fasta.is_open()) {
+		return false;
+	}
+
+	for(size_t c = 0; c < contigs.size(); c++) {
+		fasta << ">" << contigName(c) << "\n";
+		for(size_t i = 0; i < contigs[c].length(); i += FASTA_LINE_LENGTH) {
+			fasta.write(contigs[c].data() + i, min((size_t) FASTA_LINE_LENGTH, contigs[c].length() - i));
+			fasta << "\n";
+		}
+	}
+	fasta.close();
+
+	return !fasta.fail() && fai_build(fileLoc.c_str()) == 0;
+}
+
+bool WorkloadGenerator::writeRegions(const string &fileLoc) const {
+
+	ofstream regions(fileLoc.c_str(), ios::out | ios::trunc);
+	if(!regions.is_open()) {
+		return false;
+	}
+
+	for(vector<Target>::const_iterator iterator=targets.begin(); iterator!=targets.end(); ++iterator) {
+		regions << contigName(iterator->contig) << ":" << iterator->start << "-" << iterator->end << "\n";
+	}
+	regions.close();
+
+	return !regions.fail();
+}
+
+bool WorkloadGenerator::writeVCF(const string &fileLoc) const {
+
+	ofstream vcf(fileLoc.c_str(), ios::out | ios::trunc);
+	if(!vcf.is_open()) {
+		return false;
+	}
+
+	vcf << "##fileformat=VCFv4.1\n";
+	for(size_t c = 0; c < contigs.size(); c++) {
+		vcf << "##contig=<ID=" << contigName(c) << ",length=" << contigs[c].length() << ">\n";
+	}
+	vcf << "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\n";
+
+	//A deletion at every fifth target and substitutions elsewhere.
+	static const string bases = "ACGT";
+	int index = 0;
+	for(vector<Target>::const_iterator iterator=targets.begin(); iterator!=targets.end(); ++iterator, ++index) {
+		const string &contig = contigs[iterator->contig];
+		string ref, alt;
+		if(index % 5 == 4) {
+			for(long i = iterator->start - 1; i < iterator->start + 2; i++) {
+				ref += toupper(contig[i]);
+			}
+			alt = ref.substr(0, 1);
+		}
+		else {
+			ref = string(1, toupper(contig[iterator->start - 1]));
+			alt = string(1, bases[(bases.find(ref[0]) + 1 + index % 3) % 4]);
+		}
+		vcf << contigName(iterator->contig) << "\t" << iterator->start << "\t.\t" << ref << "\t" << alt
+				<< "\t50\tPASS\t.\n";
+	}
+	vcf.close();
+
+	return !vcf.fail();
+}
+
+bool WorkloadGenerator::writeBED(const string &fileLoc) const {
+
+	ofstream bed(fileLoc.c_str(), ios::out | ios::trunc);
+	if(!bed.is_open()) {
+		return false;
+	}
+
+	int index = 0;
+	for(vector<Target>::const_iterator iterator=targets.begin(); iterator!=targets.end(); ++iterator, ++index) {
+		bed << contigName(iterator->contig) << "\t" << (iterator->start - 1) << "\t" << iterator->end
+				<< "\ttarget" << (index + 1) << "\n";
+	}
+	bed.close();
+
+	return !bed.fail();
+}
+
+bool WorkloadGenerator::writeSequences(const string &fileLoc) const {
+
+	ofstream sequences(fileLoc.c_str(), ios::out | ios::trunc);
+	if(!sequences.is_open()) {
+		return false;
+	}
+
+	int index = 0;
+	for(vector<Target>::const_iterator iterator=targets.begin(); iterator!=targets.end(); ++iterator, ++index) {
+		const string &contig = contigs[iterator->contig];
+		long targetStart = iterator->start - 1;
+		long targetLength = iterator->end - iterator->start + 1;
+
+		sequences << ">target" << (index + 1) << "_" << contigName(iterator->contig) << "_" << iterator->start << "\n"
+				<< contig.substr(targetStart - SEQUENCE_FLANK_LENGTH, SEQUENCE_FLANK_LENGTH)
+				<< "[" << contig.substr(targetStart, targetLength) << "]"
+				<< contig.substr(targetStart + targetLength, SEQUENCE_FLANK_LENGTH) << "\n";
+	}
+	sequences.close();
+
+	return !sequences.fail();
+}
+
+bool WorkloadGenerator::generate(const string &prefix) {
+
+	state = spec.seed;
+	generateContigs();
+	generateTargets();
+
+	if(!writeFasta(prefix + FASTA_EXTENSION) ||
+			!writeRegions(prefix + REGIONS_EXTENSION) ||
+			!writeVCF(prefix + VCF_EXTENSION) ||
+			!writeBED(prefix + BED_EXTENSION) ||
+			!writeSequences(prefix + SEQUENCES_EXTENSION)) {
+		cerr << "Could not write the workload " << prefix << endl;
+		return false;
+	}
+
+	return true;
+}
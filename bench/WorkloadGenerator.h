@@ -0,0 +1,124 @@
+/*********************************************************************
+ *
+ * WorkloadGenerator.h:  Synthetic references and inputs for
+ * end to end benchmarks.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#ifndef WORKLOADGENERATOR_H_
+#define WORKLOADGENERATOR_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * The shape of a synthetic workload: the reference and the targets
+ * on it. The same specification and seed always give the same files.
+ */
+struct WorkloadSpec {
+
+	WorkloadSpec();
+
+	//The reference: contigs chr1..chrN of the given length.
+	int contigs;
+	long contigLength;
+
+	//The fraction of G and C in the unique sequence.
+	double gcContent;
+
+	//The fraction of the reference covered by soft masked (lower case)
+	//repeats: copies of a few interspersed elements and microsatellites.
+	double repeatFraction;
+
+	//Runs of N, as gaps in an assembly.
+	int nRunsPerContig;
+	int nRunLength;
+
+	//The targets, their length range, and the chance that a target is
+	//placed within clusterSpan bases of the one before it, like the exons
+	//of a gene panel.
+	int regions;
+	int minTargetLength;
+	int maxTargetLength;
+	double clustering;
+	int clusterSpan;
+
+	uint64_t seed;
+
+	/**
+	 * Fills the specification with the preset of the name: small, medium
+	 * or large. Returns false if there is no such preset.
+	 */
+	static bool preset(const std::string &name, WorkloadSpec &spec);
+};
+
+/**
+ * Writes a workload to files sharing a prefix:
+ *   prefix.fa          the reference, with its .fai index
+ *   prefix.regions     the targets as chrName:startIndex-endIndex
+ *   prefix.vcf         one variant at the start of every target
+ *   prefix.bed         the targets as BED intervals
+ *   prefix.sequences   the targets with their flanks as prev[target]next
+ */
+class WorkloadGenerator {
+
+public:
+
+	const static std::string FASTA_EXTENSION;
+	const static std::string REGIONS_EXTENSION;
+	const static std::string VCF_EXTENSION;
+	const static std::string BED_EXTENSION;
+	const static std::string SEQUENCES_EXTENSION;
+
+	WorkloadGenerator(const WorkloadSpec &spec);
+
+	/**
+	 * Generates the reference and the targets and writes every file.
+	 * Returns false if a file could not be written.
+	 */
+	bool generate(const std::string &prefix);
+
+protected:
+
+	struct Target {
+		int contig;
+		long start;    //1 based, inclusive
+		long end;      //1 based, inclusive
+		bool operator<(const Target &other) const {
+			return contig != other.contig ? contig < other.contig : start < other.start;
+		}
+	};
+
+	WorkloadSpec spec;
+	uint64_t state;
+
+	std::vector<std::string> contigs;
+	std::vector<Target> targets;
+
+	uint64_t nextRandom();
+	double nextDouble();
+	long nextLong(long bound);
+
+	std::string contigName(int contig) const;
+	char randomBase();
+	void generateContigs();
+	void generateTargets();
+	bool overlapsN(int contig, long start, long end) const;
+
+	bool writeFasta(const std::string &fileLoc) const;
+	bool writeRegions(const std::string &fileLoc) const;
+	bool writeVCF(const std::string &fileLoc) const;
+	bool writeBED(const std::string &fileLoc) const;
+	bool writeSequences(const std::string &fileLoc) const;
+};
+
+#endif /* WORKLOADGENERATOR_H_ */
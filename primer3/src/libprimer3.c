@@ -45,6 +45,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <float.h>
 #include <string.h>
 #include <ctype.h> /* toupper */
+#include <time.h>
 
 #ifdef __GNUC__
 #include <ext/hash_map>
@@ -128,6 +129,22 @@ typedef struct thal_arg_holder {
 
 static jmp_buf _jmp_buf;
 
+/* See p3_get_align_stats(). */
+static p3_align_stats _align_stats = {0, 0, 0.0, 0.0};
+static int _align_timing = 0;
+
+/* See p3_set_phase_hook(). */
+static p3_phase_hook _phase_hook = NULL;
+#define P3_PHASE(name, begin) \
+  do { if (_phase_hook) _phase_hook((name), (begin)); } while (0)
+
+/* See p3_set_reference_kernels(). */
+static int _reference_kernels = 0;
+
+/* See p3_set_specificity_hooks(). */
+static p3_oligo_specificity_hook _oligo_specificity_hook = NULL;
+static p3_pair_specificity_hook _pair_specificity_hook = NULL;
+
 /* Function declarations. */
 
 static void  pr_set_default_global_args_1(p3_global_settings *);
@@ -192,8 +209,25 @@ static void   add_pair(const primer_pair *, pair_array_t *);
 
 static double align(const char *, const char*, const dpal_args *a);
 
+static double align_clock(void);
+
 static double align_thermod(const char *, const char *, const thal_args *a);
 
+static double align_thermod_bounded(const char *, const char *,
+                                    const thal_args *a, double limit,
+                                    thal_bound_stats *, int bounded);
+
+static int    pair_compl_end_thermod_below_limit(const p3_global_settings *,
+                                                 const thal_arg_holder *,
+                                                 const char *s1, const char *s2,
+                                                 const char *s1_rev,
+                                                 const char *s2_rev);
+
+static void   fill_bounded_thermod_scores(primer_pair *,
+                                          const seq_args *,
+                                          const thal_arg_holder *,
+                                          const thal_arg_holder *);
+
 static int    characterize_pair(p3retval *p,
                                 const p3_global_settings *,
                                 const seq_args *,
@@ -362,13 +396,15 @@ static void   oligo_compl_thermod(primer_rec *,
                           oligo_stats *,
                           const thal_arg_holder *,
                           const char *oligo_seq,
-                          const char *revc_oligo_seq
+                          const char *revc_oligo_seq,
+                          int bounded
                           );
 static void   oligo_hairpin(primer_rec *,
                             const args_for_one_oligo_or_primer *po_args,
                             oligo_stats *,
                             const thal_arg_holder *,
-                            const char *oligo_seq
+                            const char *oligo_seq,
+                            int bounded
                             );
 
 static void   oligo_compute_sequence_and_reverse(primer_rec *,
@@ -439,6 +475,7 @@ static void op_set_overlaps_masked_sequence(primer_rec *);
 static void op_set_too_long(primer_rec *);
 static void op_set_too_short(primer_rec *);
 static void op_set_does_not_amplify_orf(primer_rec *);
+static void op_set_off_target(primer_rec *);
 /* End functions to set problems in oligos */
 
 /* Global static variables. */
@@ -994,6 +1031,41 @@ destroy_dpal_thal_arg_holder() {
      destroy_thal_arg_holder(thal_oligo_arg_to_use);
 }
 
+void
+p3_set_align_timing(int on) {
+  _align_timing = on;
+}
+
+void
+p3_get_align_stats(p3_align_stats *stats) {
+  *stats = _align_stats;
+}
+
+void
+p3_set_phase_hook(p3_phase_hook hook) {
+  _phase_hook = hook;
+}
+
+void
+p3_set_reference_kernels(int on) {
+  _reference_kernels = on;
+  thal_set_reference_kernels(on);
+}
+
+void
+p3_set_specificity_hooks(p3_oligo_specificity_hook oligo_hook,
+                         p3_pair_specificity_hook pair_hook) {
+  _oligo_specificity_hook = oligo_hook;
+  _pair_specificity_hook = pair_hook;
+}
+
+static double
+align_clock(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
 const oligo_array *
 p3_get_rv_fwd(const p3retval *r) {
   return &r->fwd;
@@ -1163,6 +1235,7 @@ choose_primers(const p3_global_settings *pa,
       destroy_thal_arg_holder(thal_oligo_arg_to_use);
       thal_oligo_arg_to_use = create_thal_arg_holder(&pa->o_args);
    } 
+  P3_PHASE("oligo_lists", 1);
   if (pa->primer_task == pick_primer_list) {
     make_complete_primer_lists(retval, pa, sa,
                                dpal_arg_to_use,thal_arg_to_use,thal_oligo_arg_to_use);
@@ -1177,6 +1250,7 @@ choose_primers(const p3_global_settings *pa,
     if (make_detection_primer_lists(retval, pa, sa,
                                     dpal_arg_to_use,thal_arg_to_use) != 0) {
       /* There was an error */
+      P3_PHASE("oligo_lists", 0);
       return retval;
     }
     /* Populate the internal oligo lists */
@@ -1184,11 +1258,14 @@ choose_primers(const p3_global_settings *pa,
       if (make_internal_oligo_list(retval, pa, sa,
                                    dpal_arg_to_use,thal_oligo_arg_to_use) != 0) {
         /* There was an error*/
+        P3_PHASE("oligo_lists", 0);
         return retval;
       }
     }
   }
+  P3_PHASE("oligo_lists", 0);
 
+  P3_PHASE("sort", 1);
   if (pa->pick_right_primer &&
       (pa->primer_task != pick_sequencing_primers))
     sort_primer_array(&retval->rev);
@@ -1204,11 +1281,14 @@ choose_primers(const p3_global_settings *pa,
      for a given primer pair. */
   if (retval->output_type == primer_list && pa->pick_internal_oligo == 1)
     sort_primer_array(&retval->intl);
+  P3_PHASE("sort", 0);
 
   /* Select primer pairs if needed */
   if (retval->output_type == primer_pairs) {
+    P3_PHASE("pair_search", 1);
     choose_pair_or_triple(retval, pa, sa, dpal_arg_to_use, thal_arg_to_use,
        thal_oligo_arg_to_use, &retval->best_pairs);
+    P3_PHASE("pair_search", 0);
   }
 
   if (pa->dump) {
@@ -1614,6 +1694,10 @@ choose_pair_or_triple(p3retval *retval,
       if (trace_me)
         fprintf(stderr, "ADD pair i=%d, j=%d\n", the_best_i, the_best_j);
 
+      if (pa->thermodynamic_alignment == 1) {
+        fill_bounded_thermod_scores(&the_best_pair, sa, thal_arg_to_use,
+                                    thal_oligo_arg_to_use);
+      }
       add_pair(&the_best_pair, best_pairs);
 
       /* Mark the pair as already selected */
@@ -1713,14 +1797,14 @@ choose_internal_oligo(p3retval *retval,
         p3_reverse_complement(oligo_seq, revc_oligo_seq);
           
         oligo_compl_thermod(h, &pa->o_args, &retval->intl.expl,
-                            thal_oligo_arg_to_use, oligo_seq, oligo_seq);
+                            thal_oligo_arg_to_use, oligo_seq, oligo_seq, 1);
         if (!OK_OR_MUST_USE(h)) continue;
       }
       if(h->hairpin_th == ALIGN_SCORE_UNDEF && pa->thermodynamic_alignment==1) {
 	_pr_substr(sa->trimmed_seq, h->start, h->length, oligo_seq);
 	oligo_hairpin(h, &pa->o_args,
                       &retval->intl.expl, thal_oligo_arg_to_use,
-                      oligo_seq);
+                      oligo_seq, 1);
         if (!OK_OR_MUST_USE(h)) continue;
       }
        
@@ -3237,7 +3321,7 @@ calc_and_check_oligo_features(const p3_global_settings *pa,
      {
         oligo_compl_thermod(h, po_args,
                             stats, thal_arg_to_use,
-                            oligo_seq, oligo_seq);
+                            oligo_seq, oligo_seq, 0);
                             /* input_oligo_seq, input_oligo_seq);*/
                             /* oligo_seq, revc_oligo_seq); */
         if ((!(p3_ol_is_uninitialized(h))) && !must_use) {
@@ -3261,7 +3345,7 @@ calc_and_check_oligo_features(const p3_global_settings *pa,
       oligo_hairpin(h, po_args,
                     stats, thal_arg_to_use,
                     /* input_oligo_seq);*/
-                    oligo_seq);
+                    oligo_seq, 0);
       if ((!(p3_ol_is_uninitialized(h))) && !must_use) {
          PR_ASSERT(!p3_ol_is_ok(h));
          return;
@@ -3368,6 +3452,15 @@ calc_and_check_oligo_features(const p3_global_settings *pa,
     }
   }
 
+  /* Binding sites elsewhere in the genome, when the caller has set
+     an oligo specificity hook. */
+  if ((OT_LEFT == l || OT_RIGHT == l) && _oligo_specificity_hook
+      && !_oligo_specificity_hook(oligo_seq)) {
+    op_set_off_target(h);
+    stats->off_target++;
+    if (!must_use) return;
+  }
+
   /* FIX ME FIXME Steve, is this really needed? */
   op_set_completely_written(h);
 
@@ -3966,7 +4059,7 @@ characterize_pair(p3retval *retval,
    if (retval->fwd.oligo[m].self_any == ALIGN_SCORE_UNDEF 
        && pa->thermodynamic_alignment==1) {
       oligo_compl_thermod(&retval->fwd.oligo[m], &pa->p_args,
-                          &retval->fwd.expl, thal_arg_to_use, s1, s1); /* ! s1, s1_rev */
+                          &retval->fwd.expl, thal_arg_to_use, s1, s1, 1); /* ! s1, s1_rev */
       
       if (!OK_OR_MUST_USE(&retval->fwd.oligo[m])) {
          pair_expl->considered--;
@@ -3976,7 +4069,7 @@ characterize_pair(p3retval *retval,
    if (retval->fwd.oligo[m].hairpin_th == ALIGN_SCORE_UNDEF 
        && pa->thermodynamic_alignment==1) {
       oligo_hairpin(&retval->fwd.oligo[m], &pa->p_args,
-                          &retval->fwd.expl, thal_arg_to_use, s1);
+                          &retval->fwd.expl, thal_arg_to_use, s1, 1);
       if (!OK_OR_MUST_USE(&retval->fwd.oligo[m])) {
          pair_expl->considered--;
          if (!must_use) return PAIR_FAILED;
@@ -3997,7 +4090,7 @@ characterize_pair(p3retval *retval,
    /* Thermodynamic approach */
    if (retval->rev.oligo[n].self_any == ALIGN_SCORE_UNDEF && pa->thermodynamic_alignment==1) {
       oligo_compl_thermod(&retval->rev.oligo[n], &pa->p_args,
-                          &retval->rev.expl, thal_arg_to_use, s2_rev, s2_rev); /* s2_rev, s2 */
+                          &retval->rev.expl, thal_arg_to_use, s2_rev, s2_rev, 1); /* s2_rev, s2 */
       
       if (!OK_OR_MUST_USE(&retval->rev.oligo[n])) {
          pair_expl->considered--;
@@ -4006,7 +4099,7 @@ characterize_pair(p3retval *retval,
    }
    if (retval->rev.oligo[n].hairpin_th == ALIGN_SCORE_UNDEF && pa->thermodynamic_alignment==1) {
       oligo_hairpin(&retval->rev.oligo[n], &pa->p_args,
-                    &retval->rev.expl, thal_arg_to_use, s2_rev);
+                    &retval->rev.expl, thal_arg_to_use, s2_rev, 1);
       if (!OK_OR_MUST_USE(&retval->rev.oligo[n])) {
          pair_expl->considered--;
          if (!must_use) return PAIR_FAILED;
@@ -4059,6 +4152,20 @@ characterize_pair(p3retval *retval,
   /* ============================================================= */
 
 
+  /* ============================================================= */
+  /* Other products of the pair in the genome, when the caller has
+     set a pair specificity hook; s2_rev is the right primer 5'->3',
+     whose first base on the forward strand is length - 1 before its
+     start. */
+  if (_pair_specificity_hook
+      && !_pair_specificity_hook(s1, sa->incl_s + ppair->left->start,
+                                 s2_rev, sa->incl_s + ppair->right->start
+                                 - ppair->right->length + 1)) {
+    if (update_stats) { pair_expl->off_target++; }
+    if (!must_use) return PAIR_FAILED;
+  }
+
+
   /* ============================================================= */
   /*
    * Similarity between s1 and s2 is equivalent to complementarity between
@@ -4078,23 +4185,40 @@ characterize_pair(p3retval *retval,
       }
    } else {
       /* thermodynamical approach */
-      ppair->compl_any = align_thermod(s1, s2_rev, thal_arg_to_use->any);
+      ppair->compl_any = align_thermod_bounded(s1, s2_rev, thal_arg_to_use->any,
+                                               pa->pair_compl_any_th,
+                                               update_stats ? &pair_expl->compl_any_th_bound : NULL,
+                                               !pa->pr_pair_weights.compl_any_th);
       if (ppair->compl_any > pa->pair_compl_any_th) {
          if (update_stats) {
             pair_expl->compl_any++; 
          }
          if (!must_use) return PAIR_FAILED;
       }
-      ppair->compl_end = align_thermod(s1, s2_rev, thal_arg_to_use->end1);
-      compl_end        = align_thermod(s1, s2_rev, thal_arg_to_use->end2); /* Triinu Please check */
-      if (ppair->compl_end < compl_end) {
-         ppair->compl_end = compl_end;
+      /* The four end alignments (the two below and the two after
+         pair_repeat_sim()) are skipped together. */
+      if (update_stats) {
+         pair_expl->compl_end_th_bound.requested++;
       }
-      if (ppair->compl_end > pa->pair_compl_end_th) {
+      if (!pa->pr_pair_weights.compl_end_th
+          && pair_compl_end_thermod_below_limit(pa, thal_arg_to_use,
+                                                s1, s2, s1_rev, s2_rev)) {
          if (update_stats) {
-            pair_expl->compl_end++; 
+            pair_expl->compl_end_th_bound.skipped++;
+         }
+         ppair->compl_end = ALIGN_SCORE_BELOW_LIMIT;
+      } else {
+         ppair->compl_end = align_thermod(s1, s2_rev, thal_arg_to_use->end1);
+         compl_end        = align_thermod(s1, s2_rev, thal_arg_to_use->end2); /* Triinu Please check */
+         if (ppair->compl_end < compl_end) {
+            ppair->compl_end = compl_end;
+         }
+         if (ppair->compl_end > pa->pair_compl_end_th) {
+            if (update_stats) {
+               pair_expl->compl_end++; 
+            }
+            if (!must_use) return PAIR_FAILED;
          }
-         if (!must_use) return PAIR_FAILED;
       }
    }
    
@@ -4117,7 +4241,8 @@ characterize_pair(p3retval *retval,
     if (!must_use) return PAIR_FAILED;
   }
    /* thermodynamic approach */
-   if (pa->thermodynamic_alignment==1 && ((compl_end = align_thermod(s2, s1_rev, thal_arg_to_use->end1))
+   if (pa->thermodynamic_alignment==1 && ppair->compl_end != ALIGN_SCORE_BELOW_LIMIT
+       && ((compl_end = align_thermod(s2, s1_rev, thal_arg_to_use->end1))
        > ppair->compl_end || (compl_end = align_thermod(s2, s1_rev, thal_arg_to_use->end2)) > ppair->compl_end)) {
       if (compl_end > pa->p_args.max_self_end_th) {
          if (update_stats) {
@@ -4361,7 +4486,13 @@ align(const char *s1,
       return strlen(s2);
     }
   }
-  dpal((const unsigned char *) s1, (const unsigned char *) s2, a, &r);
+  _align_stats.dpal_calls++;
+  if (_align_timing) {
+    double start = align_clock();
+    dpal((const unsigned char *) s1, (const unsigned char *) s2, a, &r);
+    _align_stats.dpal_seconds += align_clock() - start;
+  } else
+    dpal((const unsigned char *) s1, (const unsigned char *) s2, a, &r);
   PR_ASSERT(r.score <= SHRT_MAX);
   if (r.score == DPAL_ERROR_SCORE) {
     /* There was an error. */
@@ -4386,7 +4517,13 @@ align_thermod(const char *s1,
 {  
   int thal_trace=0;
    thal_results r;
-   thal((const unsigned char *) s1, (const unsigned char *) s2, a, &r);
+   _align_stats.thal_calls++;
+   if (_align_timing) {
+     double start = align_clock();
+     thal((const unsigned char *) s1, (const unsigned char *) s2, a, &r);
+     _align_stats.thal_seconds += align_clock() - start;
+   } else
+     thal((const unsigned char *) s1, (const unsigned char *) s2, a, &r);
    if (thal_trace) {
      fprintf(stdout, 
 	     "thal, thal_args, type=%d maxLoop=%d mv=%f dv=%f "
@@ -4417,6 +4554,117 @@ align_thermod(const char *s1,
    return ((r.temp < 0.0) ? 0.0 : (double) (r.temp));
 }
 
+/* Like align_thermod(), but if 'bounded' is non-0 and
+   thal_may_exceed() shows that the score is not above 'limit', return
+   ALIGN_SCORE_BELOW_LIMIT without doing the alignment. Use only where
+   the caller needs the pass/fail decision, and the exact score is
+   filled in by fill_bounded_thermod_scores() if the oligo or pair is
+   returned. */
+static double
+align_thermod_bounded(const char *s1,
+                      const char *s2,
+                      const thal_args *a,
+                      double limit,
+                      thal_bound_stats *stats,
+                      int bounded)
+{
+  if (stats) stats->requested++;
+  if (bounded && !_reference_kernels && limit >= 0.0
+      && !thal_may_exceed((const unsigned char *) s1,
+                          (const unsigned char *) s2, a, limit)) {
+    if (stats) stats->skipped++;
+    return ALIGN_SCORE_BELOW_LIMIT;
+  }
+  return align_thermod(s1, s2, a);
+}
+
+/* Return 1 if none of the four end alignments that characterize_pair()
+   does for a pair can fail, that is if all of them are shown to be
+   below their limits by thal_may_exceed(). */
+static int
+pair_compl_end_thermod_below_limit(const p3_global_settings *pa,
+                                   const thal_arg_holder *thal_arg_to_use,
+                                   const char *s1, const char *s2,
+                                   const char *s1_rev, const char *s2_rev)
+{
+  if (_reference_kernels
+      || pa->pair_compl_end_th < 0.0 || pa->p_args.max_self_end_th < 0.0)
+    return 0;
+  return !thal_may_exceed((const unsigned char *) s1, (const unsigned char *) s2_rev,
+                          thal_arg_to_use->end1, pa->pair_compl_end_th)
+    && !thal_may_exceed((const unsigned char *) s1, (const unsigned char *) s2_rev,
+                        thal_arg_to_use->end2, pa->pair_compl_end_th)
+    && !thal_may_exceed((const unsigned char *) s2, (const unsigned char *) s1_rev,
+                        thal_arg_to_use->end1, pa->p_args.max_self_end_th)
+    && !thal_may_exceed((const unsigned char *) s2, (const unsigned char *) s1_rev,
+                        thal_arg_to_use->end2, pa->p_args.max_self_end_th);
+}
+
+/* Replace the ALIGN_SCORE_BELOW_LIMIT scores of the pair and of its
+   oligos by the scores that align_thermod() gives, in the same way as
+   characterize_pair(), oligo_compl_thermod() and oligo_hairpin()
+   compute them. */
+static void
+fill_bounded_thermod_scores(primer_pair *pair,
+                            const seq_args *sa,
+                            const thal_arg_holder *thal_arg_to_use,
+                            const thal_arg_holder *thal_oligo_arg_to_use)
+{
+  char s1[MAX_PRIMER_LENGTH+1], s2[MAX_PRIMER_LENGTH+1],
+    s1_rev[MAX_PRIMER_LENGTH+1], s2_rev[MAX_PRIMER_LENGTH+1];
+  double compl_end;
+  primer_rec *h;
+
+  _pr_substr(sa->trimmed_seq, pair->left->start, pair->left->length, s1);
+  _pr_substr(sa->trimmed_seq,
+             pair->right->start - pair->right->length + 1,
+             pair->right->length, s2);
+  p3_reverse_complement(s1, s1_rev);
+  p3_reverse_complement(s2, s2_rev);
+
+  h = pair->left;
+  if (h->self_any == ALIGN_SCORE_BELOW_LIMIT)
+    h->self_any = align_thermod(s1, s1, thal_arg_to_use->any);
+  if (h->self_end == ALIGN_SCORE_BELOW_LIMIT)
+    h->self_end = align_thermod(s1, s1, thal_arg_to_use->end1);
+  if (h->hairpin_th == ALIGN_SCORE_BELOW_LIMIT)
+    h->hairpin_th = align_thermod(s1, s1, thal_arg_to_use->hairpin_th);
+
+  h = pair->right;
+  if (h->self_any == ALIGN_SCORE_BELOW_LIMIT)
+    h->self_any = align_thermod(s2_rev, s2_rev, thal_arg_to_use->any);
+  if (h->self_end == ALIGN_SCORE_BELOW_LIMIT)
+    h->self_end = align_thermod(s2_rev, s2_rev, thal_arg_to_use->end1);
+  if (h->hairpin_th == ALIGN_SCORE_BELOW_LIMIT)
+    h->hairpin_th = align_thermod(s2_rev, s2_rev, thal_arg_to_use->hairpin_th);
+
+  h = pair->intl;
+  if (h != NULL) {
+    char oligo_seq[MAX_PRIMER_LENGTH+1];
+    _pr_substr(sa->trimmed_seq, h->start, h->length, oligo_seq);
+    if (h->self_any == ALIGN_SCORE_BELOW_LIMIT)
+      h->self_any = align_thermod(oligo_seq, oligo_seq, thal_oligo_arg_to_use->any);
+    if (h->self_end == ALIGN_SCORE_BELOW_LIMIT)
+      h->self_end = align_thermod(oligo_seq, oligo_seq, thal_oligo_arg_to_use->end1);
+    if (h->hairpin_th == ALIGN_SCORE_BELOW_LIMIT)
+      h->hairpin_th = align_thermod(oligo_seq, oligo_seq, thal_oligo_arg_to_use->hairpin_th);
+  }
+
+  if (pair->compl_any == ALIGN_SCORE_BELOW_LIMIT)
+    pair->compl_any = align_thermod(s1, s2_rev, thal_arg_to_use->any);
+  if (pair->compl_end == ALIGN_SCORE_BELOW_LIMIT) {
+    pair->compl_end = align_thermod(s1, s2_rev, thal_arg_to_use->end1);
+    compl_end       = align_thermod(s1, s2_rev, thal_arg_to_use->end2);
+    if (pair->compl_end < compl_end) {
+      pair->compl_end = compl_end;
+    }
+    if ((compl_end = align_thermod(s2, s1_rev, thal_arg_to_use->end1)) > pair->compl_end
+        || (compl_end = align_thermod(s2, s1_rev, thal_arg_to_use->end2)) > pair->compl_end) {
+      pair->compl_end = compl_end;
+    }
+  }
+}
+
 /* Return the sequence of oligo in
    a ****static***** buffer.  The
    sequence returned is changed at the
@@ -4489,18 +4737,25 @@ oligo_compl_thermod(primer_rec *h,
                     oligo_stats *ostats,
                     const thal_arg_holder *thal_arg_to_use,
                     const char *oligo_seq,
-                    const char *revc_oligo_seq)
+                    const char *revc_oligo_seq,
+                    int bounded)
 {
    
    PR_ASSERT(h != NULL);
-   h->self_any = align_thermod(oligo_seq, revc_oligo_seq, thal_arg_to_use->any);
+   h->self_any = align_thermod_bounded(oligo_seq, revc_oligo_seq, thal_arg_to_use->any,
+                                       po_args->max_self_any_th,
+                                       &ostats->compl_any_th_bound,
+                                       bounded && !po_args->weights.compl_any_th);
    if(h->self_any > po_args->max_self_any_th) { 
       op_set_high_self_any(h);
       ostats->compl_any++;
       ostats->ok--;
       if (!h->must_use) return;
    }  
-   h->self_end = align_thermod(oligo_seq, revc_oligo_seq, thal_arg_to_use->end1);  
+   h->self_end = align_thermod_bounded(oligo_seq, revc_oligo_seq, thal_arg_to_use->end1,
+                                       po_args->max_self_end_th,
+                                       &ostats->compl_end_th_bound,
+                                       bounded && !po_args->weights.compl_end_th);
    if(h->self_end > po_args->max_self_end_th){  
       op_set_high_self_end(h);
       ostats->compl_end++;
@@ -4514,10 +4769,14 @@ oligo_hairpin(primer_rec *h,
               const args_for_one_oligo_or_primer *po_args,
               oligo_stats *ostats,
               const thal_arg_holder *thal_arg_to_use,
-              const char *oligo_seq)
+              const char *oligo_seq,
+              int bounded)
 {
    PR_ASSERT(h != NULL);
-   h->hairpin_th = align_thermod(oligo_seq, oligo_seq, thal_arg_to_use->hairpin_th);
+   h->hairpin_th = align_thermod_bounded(oligo_seq, oligo_seq, thal_arg_to_use->hairpin_th,
+                                         po_args->max_hairpin_th,
+                                         &ostats->hairpin_th_bound,
+                                         bounded && !po_args->weights.hairpin_th);
    if(h->hairpin_th > po_args->max_hairpin_th) {
       op_set_high_hairpin_th(h);
       ostats->hairpin_th++;
@@ -5286,6 +5545,8 @@ p3_pair_explain_string(const pair_stats *pair_expl)
                   pair_expl->not_in_any_ok_region);
   IF_SP_AND_CHECK(", left primer to right of right primer %d",
 		  pair_expl->reversed);
+  IF_SP_AND_CHECK(", second product in the genome %d",
+                  pair_expl->off_target)
 
   SP_AND_CHECK(", ok %d", pair_expl->ok)
 
@@ -5325,6 +5586,7 @@ p3_oligo_explain_string(const oligo_stats *stat)
   IF_SP_AND_CHECK(", high template mispriming score %d",
                   stat->template_mispriming)
   IF_SP_AND_CHECK(", lowercase masking of 3' end %d",stat->gmasked)
+  IF_SP_AND_CHECK(", too many sites in the genome %d", stat->off_target)
   IF_SP_AND_CHECK(", not in any ok left region %d", 
                   stat->not_in_any_left_ok_region)
   IF_SP_AND_CHECK(", not in any ok right region %d", 
@@ -7958,6 +8220,7 @@ initialize_op(primer_rec *oligo) {
 #define OP_DOES_NOT_AMPLIFY_ORF                (1UL << 27)
 #define OP_TOO_MANY_GC_AT_END                  (1UL << 28) /* 3prime problem*/
 #define OP_HIGH_HAIRPIN                        (1UL << 29) /* 3prime problem*/
+#define OP_OFF_TARGET                          (1UL << 30)
 
 /* Space for more Errors */
 
@@ -8067,6 +8330,8 @@ p3_get_ol_problem_string(const primer_rec *oligo) {
                " Too short;")
     ADD_OP_STR(OP_DOES_NOT_AMPLIFY_ORF,
                " Would not amplify an open reading frame;")
+    ADD_OP_STR(OP_OFF_TARGET,
+               " Too many binding sites in the genome;")
   }
   return output;
 }
@@ -8123,6 +8388,12 @@ op_set_does_not_amplify_orf(primer_rec *oligo) {
   oligo->problems.prob |= OP_PARTIALLY_WRITTEN;
 }
 
+static void
+op_set_off_target(primer_rec *oligo) {
+  oligo->problems.prob |= OP_OFF_TARGET;
+  oligo->problems.prob |= OP_PARTIALLY_WRITTEN;
+}
+
 static void
 op_set_completely_written(primer_rec *oligo) {
   oligo->problems.prob |= OP_COMPLETELY_WRITTEN;
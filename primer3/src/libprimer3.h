@@ -53,6 +53,12 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 /* ALIGN_SCORE_UNDEF is used only libprimer3 and clients, not in dpal */
 #define ALIGN_SCORE_UNDEF            -DBL_MAX
+
+/* ALIGN_SCORE_BELOW_LIMIT marks a thermodynamic score that was not
+   calculated because thal_may_exceed() showed that it is below the
+   limit.  It is replaced by the calculated score before the oligo or
+   pair is stored in best_pairs. */
+#define ALIGN_SCORE_BELOW_LIMIT      (-DBL_MAX / 2)
      
 /* These next 5 are exposed for format_output.c -- probabaly should be reviewed. */
 #define PR_INFINITE_POSITION_PENALTY -1.0
@@ -635,6 +641,14 @@ interval_array_t2_count(const interval_array_t2 *array);
 const int *
 interval_array_t2_get_pair(const interval_array_t2 *array, int i);
 
+/* Number of thermodynamic alignments requested for one kind of check,
+   and how many of them were skipped because thal_may_exceed() showed
+   that the check passes. */
+typedef struct thal_bound_stats {
+  int requested;
+  int skipped;
+} thal_bound_stats;
+
 typedef struct oligo_stats {
   int considered;          /* Total number of tested oligos of given type   */
   int ns;                  /* Number of oligos rejected because of Ns       */
@@ -658,6 +672,8 @@ typedef struct oligo_stats {
   int no_orf;              /* Would not amplify any of the specified ORF
                              (valid for left primers only).                 */
   int template_mispriming; /* Template mispriming score too high.           */
+  int off_target;          /* Too many binding sites in the genome (see
+                              p3_set_specificity_hooks()).                  */
   int ok;                  /* Number of acceptable oligos.                  */
   int gmasked;             /* Added by T. Koressaar, number of gmasked
 			      oligos */
@@ -667,6 +683,9 @@ typedef struct oligo_stats {
   int not_in_any_right_ok_region;/* Oligo not included in any of the
                                     right regions given in
                                     PRIMER_PAIR_OK_REGION_LIST. */
+  thal_bound_stats compl_any_th_bound; /* Self any checks.              */
+  thal_bound_stats compl_end_th_bound; /* Self end checks.              */
+  thal_bound_stats hairpin_th_bound;   /* Hairpin checks.               */
 } oligo_stats;
 
 typedef struct pair_stats {
@@ -681,6 +700,8 @@ typedef struct pair_stats {
   int high_tm;             /* Product Tm too high.                          */
   int low_tm;              /* Product Tm too low.                           */
   int template_mispriming; /* Sum of template mispriming scores too high.   */
+  int off_target;          /* A second product from the genome (see
+                              p3_set_specificity_hooks()).                  */
 
   /* Neither oligo in the pairs overlaps one of the "required sites".       */
   int does_not_overlap_a_required_point;
@@ -698,6 +719,9 @@ typedef struct pair_stats {
 
   int ok;                  /* Number that were ok.                          */
 
+  thal_bound_stats compl_any_th_bound; /* Pair any complementarity checks. */
+  thal_bound_stats compl_end_th_bound; /* Pair end complementarity checks. */
+
 } pair_stats;
 
 typedef struct pair_array_t {
@@ -832,6 +856,58 @@ typedef struct p3retval {
 void destroy_p3retval(p3retval *);
 
 void destroy_dpal_thal_arg_holder();
+
+/* The number of dpal and thal alignments run by choose_primers() and
+   the other entry points, accumulated over all calls since the program
+   started.  The time spent in them is only measured while
+   p3_set_align_timing() is on, and is 0 otherwise. */
+typedef struct p3_align_stats {
+  long   dpal_calls;
+  long   thal_calls;
+  double dpal_seconds;
+  double thal_seconds;
+} p3_align_stats;
+
+/* If on is non-zero, time every alignment.  Off by default, because
+   reading the clock around each alignment is not free. */
+void p3_set_align_timing(int on);
+
+void p3_get_align_stats(p3_align_stats *stats);
+
+/* A function called when choose_primers() enters (begin is non-zero) and
+   leaves (begin is 0) one of its phases: "oligo_lists", where candidate
+   oligos are enumerated and each is filtered as it is generated,
+   "sort", and "pair_search".  A phase left through the ENOMEM longjmp
+   is not reported as left. */
+typedef void (*p3_phase_hook)(const char *phase, int begin);
+
+/* Set the phase hook, or NULL (the default) for none. */
+void p3_set_phase_hook(p3_phase_hook hook);
+
+/* If on is non-zero, choose_primers() uses the reference version of
+   each kernel that has a faster one: the row by row thal() dimer fill
+   and its loop function (see thal_set_reference_kernels()), and every
+   thermodynamic alignment done in full instead of skipped when
+   thal_may_exceed() rules it out.  The primers chosen are the same
+   either way; this is for checking that they are.  Off by default. */
+void p3_set_reference_kernels(int on);
+
+/* Genome-wide specificity checks supplied by the caller, for instance
+   from an index of the whole reference.  The oligo hook is given a left
+   or right primer 5'->3' and returns 0 if the primer binds too many
+   sites, in which case it is dropped before any pair is formed.  The
+   pair hook is given the left and the right primer, both 5'->3', each
+   with the 0-based position in the template of the first base it covers
+   on the forward strand, and returns 0 if the pair would amplify a
+   product besides the intended one between those two positions.  Both
+   are NULL (no check) by default. */
+typedef int (*p3_oligo_specificity_hook)(const char *oligo);
+typedef int (*p3_pair_specificity_hook)(const char *left, int left_start,
+                                        const char *right, int right_start);
+
+/* Set the specificity hooks, or NULL for none. */
+void p3_set_specificity_hooks(p3_oligo_specificity_hook oligo_hook,
+                              p3_pair_specificity_hook pair_hook);
        
 /* get elements of p3retval */
 const pair_array_t *p3_get_rv_best_pairs(const p3retval *r);
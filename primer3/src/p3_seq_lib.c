@@ -38,6 +38,16 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <ctype.h>       /* toupper() ... */
 #include <string.h>      /* memset(), ... */
 #include <setjmp.h>      /* longjmp(), ... */
+#include <stdint.h>      /* uint64_t, ... */
+#include <sys/types.h>
+#include <sys/stat.h>    /* stat(), ... */
+#if defined(_WIN32) || defined(WIN32) || defined (__WIN32__) || defined(__CYGWIN__) || defined(__MINGW32__)
+#define P3SL_NO_SNAPSHOTS
+#else
+#include <fcntl.h>       /* open(), ... */
+#include <unistd.h>      /* close(), getpid(), ... */
+#include <sys/mman.h>    /* mmap(), ... */
+#endif
 #include "libprimer3.h"  /* Must include libprimer3.h, which
 			    includes p3_seq_lib.h */
 
@@ -60,6 +70,12 @@ static jmp_buf _jmp_buf;
 static double parse_seq_name(char *s);
 static char   upcase_and_check_char(char *s);
 static void   reverse_complement_seq_lib(seq_lib  *lib);
+static seq_lib *read_seq_lib_snapshot(const char *filename,
+				      const struct stat *src);
+static void   write_seq_lib_snapshot(const seq_lib *lib,
+				     const struct stat *src);
+
+static int use_snapshots = 0;
 
 static int
 add_seq_to_seq_lib(seq_lib *sl,
@@ -180,7 +196,14 @@ read_and_create_seq_lib(const char * filename, const char *errfrag) {
     size_t seq_storage_size;
     size_t seq_len;
 
-    seq_lib *lib = create_empty_seq_lib();
+    seq_lib *lib;
+    struct stat src;
+    int have_src = use_snapshots && stat(filename, &src) == 0;
+
+    if (have_src && (lib = read_seq_lib_snapshot(filename, &src)) != NULL)
+      return lib;
+
+    lib = create_empty_seq_lib();
     if (NULL == lib) return NULL; /* ENOMEM */
 
     if (setjmp(_jmp_buf) != 0)
@@ -284,6 +307,7 @@ read_and_create_seq_lib(const char * filename, const char *errfrag) {
     if (file) fclose(file);
     free(seq);
     free(seq_id_plus);
+    if (have_src) write_seq_lib_snapshot(lib, &src);
     return lib;
 
  ERROR:
@@ -297,6 +321,12 @@ read_and_create_seq_lib(const char * filename, const char *errfrag) {
 }
 
 
+/* Strings of a library loaded from a snapshot point into the mapping. */
+#define IN_SNAPSHOT(lib, p) ((lib)->snapshot != NULL                         \
+                             && (char *) (p) >= (char *) (lib)->snapshot     \
+                             && (char *) (p) < (char *) (lib)->snapshot       \
+                                               + (lib)->snapshot_size)
+
 /* 
  * Free exogenous storage associated with a seq_lib (but not the seq_lib
  * itself).  Silently ignore NULL p.  Set *p to 0 bytes.
@@ -310,14 +340,17 @@ destroy_seq_lib(seq_lib *p)
   free(p->repeat_file);
   if (NULL != p->seqs) { 
     for(i = 0; i < p->seq_num; i++)
-      if (NULL != p->seqs[i]) free(p->seqs[i]);
+      if (NULL != p->seqs[i] && !IN_SNAPSHOT(p, p->seqs[i])) free(p->seqs[i]);
     free(p->seqs);
   }
   if (NULL != p->names) {
     for(i = 0; i < p->seq_num; i++)
-      if (NULL != p->names[i]) free(p->names[i]);
+      if (NULL != p->names[i] && !IN_SNAPSHOT(p, p->names[i])) free(p->names[i]);
     free(p->names);
   }
+#ifndef P3SL_NO_SNAPSHOTS
+  if (NULL != p->snapshot) munmap(p->snapshot, p->snapshot_size);
+#endif
   free(p->weight);
   free(p->error.data);
   free(p->warning.data);
@@ -436,6 +469,244 @@ upcase_and_check_char(char *s)
     return m;
 }
 
+/* ============================================================ */
+/* Binary snapshots of parsed libraries                         */
+/* ============================================================ */
+
+/*
+ * A snapshot holds a parsed seq_lib (forward and reverse-complement
+ * entries, as built by read_and_create_seq_lib()) in one block that is
+ * mapped back in with a single mmap().  It is written next to the
+ * source as <file>.p3sl in host byte order and is only used while the
+ * source still matches: same size, and same mtime or same content
+ * hash.  Layout, all offsets from the start of the file:
+ *
+ *   struct p3sl_header
+ *   double   weight[seq_num]
+ *   uint64_t name_off[seq_num]
+ *   uint64_t seq_off[seq_num]
+ *   char     warning[warning_len]
+ *   NUL-terminated names and sequences
+ */
+#define P3SL_MAGIC "P3SLIB1"
+#define P3SL_SUFFIX ".p3sl"
+
+struct p3sl_header {
+  char     magic[8];
+  uint64_t src_size;
+  int64_t  src_mtime;
+  uint64_t src_hash;     /* FNV-1a of the source file */
+  uint64_t seq_num;      /* forward plus reverse-complement entries */
+  uint64_t warning_len;  /* including the NUL, 0 if no warning */
+  uint64_t total_size;
+};
+
+void
+seq_lib_use_snapshots(int on)
+{
+  use_snapshots = on;
+}
+
+static char *
+snapshot_name(const char *filename)
+{
+  char *r = (char *) malloc(strlen(filename) + sizeof(P3SL_SUFFIX));
+  if (NULL == r) return NULL;
+  strcpy(r, filename);
+  strcat(r, P3SL_SUFFIX);
+  return r;
+}
+
+/* FNV-1a over the whole file; returns 0 if the file cannot be read. */
+static uint64_t
+hash_file(const char *filename)
+{
+  unsigned char buf[1 << 16];
+  uint64_t h = 14695981039346656037ULL;
+  size_t n, i;
+  FILE *f = fopen(filename, "rb");
+  if (NULL == f) return 0;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    for (i = 0; i < n; i++) {
+      h ^= buf[i];
+      h *= 1099511628211ULL;
+    }
+  fclose(f);
+  return h;
+}
+
+#ifdef P3SL_NO_SNAPSHOTS
+
+static seq_lib *
+read_seq_lib_snapshot(const char *filename, const struct stat *src)
+{
+  return NULL;
+}
+
+static void
+write_seq_lib_snapshot(const seq_lib *lib, const struct stat *src)
+{
+}
+
+#else
+
+/*
+ * Map the snapshot of filename if it is current.  Returns NULL if
+ * there is none, it is stale or damaged, or memory ran out; the caller
+ * then parses the source as usual.
+ */
+static seq_lib *
+read_seq_lib_snapshot(const char *filename, const struct stat *src)
+{
+  char *name = snapshot_name(filename);
+  const struct p3sl_header *h;
+  const double *weight;
+  const uint64_t *name_off, *seq_off;
+  const char *warning;
+  struct stat st;
+  void *map = MAP_FAILED;
+  seq_lib *lib = NULL;
+  uint64_t n, i, strings;
+  int fd;
+
+  if (NULL == name) return NULL;
+  fd = open(name, O_RDONLY);
+  free(name);
+  if (fd < 0) return NULL;
+  if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(*h))
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (MAP_FAILED == map) return NULL;
+
+  h = (const struct p3sl_header *) map;
+  n = h->seq_num;
+  strings = sizeof(*h) + n * (sizeof(double) + 2 * sizeof(uint64_t));
+  if (memcmp(h->magic, P3SL_MAGIC, sizeof(h->magic))
+      || h->total_size != (uint64_t) st.st_size
+      || n == 0 || n % 2
+      || n > (h->total_size - sizeof(*h)) / (sizeof(double) + 2 * sizeof(uint64_t))
+      || h->warning_len > h->total_size - strings
+      || h->src_size != (uint64_t) src->st_size)
+    goto FAIL;
+  if (h->src_mtime != (int64_t) src->st_mtime
+      && h->src_hash != hash_file(filename))
+    goto FAIL;
+
+  weight = (const double *) (h + 1);
+  name_off = (const uint64_t *) (weight + n);
+  seq_off = name_off + n;
+  warning = (const char *) (seq_off + n);
+  for (i = 0; i < n; i++)
+    if (name_off[i] < strings || name_off[i] >= h->total_size
+	|| seq_off[i] < strings || seq_off[i] >= h->total_size)
+      goto FAIL;
+  /* The last string must end inside the block. */
+  if (((const char *) map)[h->total_size - 1] != '\0')
+    goto FAIL;
+
+  lib = (seq_lib *) calloc(1, sizeof(*lib));
+  if (NULL == lib) goto FAIL;
+  lib->snapshot = map;
+  lib->snapshot_size = st.st_size;
+  lib->seq_num = lib->storage_size = (int) n;
+  lib->repeat_file    = (char *) malloc(strlen(filename) + 1);
+  lib->names          = (char **) malloc(n * sizeof(*lib->names));
+  lib->seqs           = (char **) malloc(n * sizeof(*lib->seqs));
+  lib->rev_compl_seqs = (char **) malloc(n * sizeof(*lib->rev_compl_seqs));
+  lib->weight         = (double *) malloc(n * sizeof(*lib->weight));
+  if (!lib->repeat_file || !lib->names || !lib->seqs
+      || !lib->rev_compl_seqs || !lib->weight)
+    goto FAIL;
+  if (h->warning_len > 0
+      && pr_append_new_chunk_external(&lib->warning, warning))
+    goto FAIL;
+
+  strcpy(lib->repeat_file, filename);
+  memcpy(lib->weight, weight, n * sizeof(*lib->weight));
+  for (i = 0; i < n; i++) {
+    lib->names[i] = (char *) map + name_off[i];
+    lib->seqs[i] = (char *) map + seq_off[i];
+  }
+  /* Entry i and entry i + n/2 are reverse complements of each other,
+     see reverse_complement_seq_lib(). */
+  for (i = 0; i < n; i++)
+    lib->rev_compl_seqs[i] = lib->seqs[(i + n / 2) % n];
+  return lib;
+
+ FAIL:
+  if (NULL != lib) {
+    lib->seq_num = 0;
+    destroy_seq_lib(lib);  /* also unmaps */
+  } else
+    munmap(map, st.st_size);
+  return NULL;
+}
+
+/*
+ * Write the snapshot of a freshly parsed lib.  Failures (for example
+ * a read-only library directory) are silently ignored; the library is
+ * then simply parsed again next time.
+ */
+static void
+write_seq_lib_snapshot(const seq_lib *lib, const struct stat *src)
+{
+  struct p3sl_header h;
+  const char *warning = seq_lib_warning_data(lib);
+  char *name = NULL, *tmp = NULL;
+  uint64_t *off = NULL;
+  uint64_t n = lib->seq_num, i, pos;
+  FILE *f = NULL;
+  int ok = 0;
+
+  if (n == 0 || NULL == lib->rev_compl_seqs || !pr_is_empty(&lib->error))
+    return;
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, P3SL_MAGIC, sizeof(h.magic));
+  h.src_size = src->st_size;
+  h.src_mtime = src->st_mtime;
+  h.src_hash = hash_file(lib->repeat_file);
+  h.seq_num = n;
+  h.warning_len = warning ? strlen(warning) + 1 : 0;
+
+  off = (uint64_t *) malloc(2 * n * sizeof(*off));
+  name = snapshot_name(lib->repeat_file);
+  if (NULL == off || NULL == name) goto DONE;
+  tmp = (char *) malloc(strlen(name) + 32);
+  if (NULL == tmp) goto DONE;
+  sprintf(tmp, "%s.%ld", name, (long) getpid());
+
+  pos = sizeof(h) + n * (sizeof(double) + 2 * sizeof(uint64_t)) + h.warning_len;
+  for (i = 0; i < n; i++) {
+    off[i] = pos;
+    pos += strlen(lib->names[i]) + 1;
+    off[n + i] = pos;
+    pos += strlen(lib->seqs[i]) + 1;
+  }
+  h.total_size = pos;
+
+  if (NULL == (f = fopen(tmp, "wb"))) goto DONE;
+  ok = fwrite(&h, sizeof(h), 1, f) == 1
+    && fwrite(lib->weight, sizeof(double), n, f) == n
+    && fwrite(off, sizeof(*off), 2 * n, f) == 2 * n
+    && (h.warning_len == 0 || fwrite(warning, 1, h.warning_len, f) == h.warning_len);
+  for (i = 0; ok && i < n; i++)
+    ok = fwrite(lib->names[i], 1, strlen(lib->names[i]) + 1, f)
+           == strlen(lib->names[i]) + 1
+      && fwrite(lib->seqs[i], 1, strlen(lib->seqs[i]) + 1, f)
+           == strlen(lib->seqs[i]) + 1;
+  if (fclose(f) != 0) ok = 0;
+  /* Readers only ever see a complete snapshot. */
+  if (!ok || rename(tmp, name) != 0) remove(tmp);
+
+ DONE:
+  free(off);
+  free(name);
+  free(tmp);
+}
+
+#endif
+
 #undef INIT_LIB_SIZE
 #undef PR_MAX_LIBRARY_WT
 
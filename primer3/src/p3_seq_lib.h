@@ -59,6 +59,11 @@ typedef struct seq_lib {
 
   /* The size of storage allocated for names, sequences, and weights */
   int storage_size;  
+
+  /* The mapped snapshot the names and sequences point into, if the
+     library was loaded from one (see seq_lib_use_snapshots()). */
+  void  *snapshot;
+  size_t snapshot_size;
 } seq_lib;
 
 /* ======================================================= */
@@ -76,6 +81,15 @@ read_and_create_seq_lib(const char *filename, const char* errfrag);
 void
 destroy_seq_lib(seq_lib *lib);
 
+/*
+ * If on is non-zero, read_and_create_seq_lib() keeps a binary snapshot
+ * of every library it parses next to the source file (<file>.p3sl)
+ * and later maps that snapshot instead of parsing the file again, as
+ * long as the file is unchanged.  Off by default.
+ */
+void
+seq_lib_use_snapshots(int on);
+
 /* number of sequences in a seq_lib* */
 int
 seq_lib_num_seq(const seq_lib* lib);
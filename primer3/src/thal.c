@@ -200,26 +200,47 @@ static void initMatrix2(); /* initiates thermodynamic parameter tables of entrop
 
 static void fillMatrix(int maxLoop, thal_results* o); /* calc-s thermod values into dynamic progr table (dimer) */
 
+static void fillMatrixReference(int maxLoop, thal_results* o); /* the same as fillMatrix, row by row */
+
 static void fillMatrix2(int maxLoop, thal_results* o); /* calc-s thermod values into dynamic progr table (monomer) */
 
 static void maxTM(int i, int j); /* finds max Tm while filling the dyn progr table using stacking S and stacking H (dimer) */
 
 static void maxTM2(int i, int j); /* finds max Tm while filling the dyn progr table using stacking S and stacking H (monomer) */
 
+/* The loop functions below are used both when filling the dynamic
+   programming tables (traceback 0) and in the traceback (1 or 2).  They
+   are templates on the traceback value, so that the fill loops get a
+   copy without the traceback branches and with the table lookups
+   inlined.  They are not templates on the alignment type: the type
+   only decides where thal() takes the end of the alignment after the
+   fill, and the dimer and hairpin fills are separate functions. */
+
+/* dS and dH of a dimer structure ending with a bulge or internal loop
+   closed by the pairs (i, j) and (ii, jj); returns 1 for a 1x1 loop */
+static inline int bulge_internal_SH(int i, int j, int ii, int jj, double* S, double* H);
+
 /* calculates bulges and internal loops for dimer structures */
-static void calc_bulge_internal(int ii, int jj, int i, int j, double* EntropyEnthalpy, int traceback, int maxLoop);
+template <int traceback>
+static void calc_bulge_internal(int ii, int jj, int i, int j, double* EntropyEnthalpy, int maxLoop);
+
+/* the same, with the traceback value checked at run time */
+static void calc_bulge_internal_reference(int ii, int jj, int i, int j, double* EntropyEnthalpy, int traceback, int maxLoop);
 
 /* calculates bulges and internal loops for monomer structures */
-static void calc_bulge_internal2(int ii, int jj, int i, int j, double* EntropyEnthalpy, int traceback, int maxLoop);
+template <int traceback>
+static void calc_bulge_internal2(int ii, int jj, int i, int j, double* EntropyEnthalpy, int maxLoop);
 
 /* carries out Bulge and Internal loop and stack calculations to hairpin */
-static void CBI(int i, int j, double* EntropyEnthalpy, int traceback, int maxLoop);
+template <int traceback>
+static void CBI(int i, int j, double* EntropyEnthalpy, int maxLoop);
 
 /* finds monomer structure that has maximum Tm */
-static void calc_hairpin(int i, int j, double* EntropyEnthalpy, int traceback);
+template <int traceback>
+static void calc_hairpin(int i, int j, double* EntropyEnthalpy);
 
-static double Ss(int i, int j, int k); /* returns stack entropy */
-static double Hs(int i, int j, int k); /* returns stack enthalpy */
+static inline double Ss(int i, int j, int k); /* returns stack entropy */
+static inline double Hs(int i, int j, int k); /* returns stack enthalpy */
 
 /* calculate terminal entropy S and terminal enthalpy H starting reading from 5'end (Left hand/3' end - Right end) */
 static void LSH(int i, int j, double* EntropyEnthalpy);
@@ -238,11 +259,33 @@ static void traceback(int i, int j, double RT, int* ps1, int* ps2, int maxLoop,
 /* traceback for hairpins */
 static void tracebacku(int*, int, thal_results*);
 
-/* prints ascii output of dimer structure */
-static void drawDimer(int*, int*, double, double, double, int, double, thal_results *);
+/* melting temperature of the traced dimer; the salt correction depends on the number of base pairs */
+static double calcDimerTm(const int*, const int*, double, double);
+
+/* melting temperature of the traced hairpin */
+static double calcHairpinTm(const int*, double, double);
+
+/* dG = H - T*S of a thermodynamic term; _INFINITY if the term is not defined */
+static double termG(double H, double S, double T);
+
+/* lower bounds of dG of the terminal penalties left and right of bp i-j (dimer) */
+static double boundLSH(const unsigned char*, const unsigned char*, int, int, double);
+static double boundRSH(const unsigned char*, const unsigned char*, int, int, double);
+
+/* lower bound of dG of any bulge or internal loop that is not a single-base bulge or a 1x1 loop;
+   boundLongLoop() keeps the value for the last T, scanLongLoop() computes it from the tables */
+static double boundLongLoop(double T);
+static double scanLongLoop(double T);
 
-/* prints ascii output of hairpin structure */
-static void drawHairpin(int*, double, double, int, double, thal_results *);
+/* lower bounds of dG used by thal_may_exceed() for dimer and monomer structures */
+static double boundDimer(const unsigned char*, int, const unsigned char*, int, double, int);
+static double boundHairpin(const unsigned char*, const unsigned char*, int, double);
+
+/* prints and/or returns ascii output of dimer structure */
+static void drawDimer(int*, int*, double, double, double, int, double, thal_mode, thal_results *);
+
+/* prints and/or returns ascii output of hairpin structure */
+static void drawHairpin(int*, double, double, int, double, thal_mode, thal_results *);
 
 static int equal(double a, double b);
 
@@ -313,6 +356,14 @@ static struct triloop* triloopEnthalpies = NULL; /* ther penalties for given tri
 static struct tetraloop* tetraloopEntropies = NULL; /* ther penalties for given tetraloop seq-s */
 static struct tetraloop* tetraloopEnthalpies = NULL; /* ther penalties for given tetraloop seq-s */
 static jmp_buf _jmp_buf;
+static int reference_kernels = 0; /* see thal_set_reference_kernels() */
+/* buffers of fillMatrix(), kept between calls and grown as needed;
+   fill_diags and fill_cells are the numbers of elements they hold */
+static int *fill_diag = NULL, *fill_first = NULL, *fill_before = NULL, *fill_listJ = NULL;
+static double *fill_listH = NULL, *fill_listS = NULL, *fill_listTH = NULL, *fill_listTS = NULL;
+static int fill_diags = 0, fill_cells = 0;
+static double long_loop_T = -1.0; /* T of long_loop_G; negative after the tables change */
+static double long_loop_G;
 
 /* Read the thermodynamic values (parameters) from the parameter files
    in the directory specified by 'path'.  Return 0 on success and -1
@@ -326,6 +377,7 @@ get_thermodynamic_values(const char* path, thal_results *o)
      return -1;
   }
 
+  long_loop_T = -1.0;
   parampath = (char*) safe_malloc((strlen(path) + 1) * sizeof(char), o);
   strcpy(parampath, path);
 
@@ -355,6 +407,155 @@ destroy_thal_structures()
   free(triloopEnthalpies);
   free(tetraloopEntropies);
   free(tetraloopEnthalpies);
+  parampath = NULL;
+  long_loop_T = -1.0;
+  free(fill_diag);
+  free(fill_first);
+  free(fill_before);
+  free(fill_listJ);
+  free(fill_listH);
+  free(fill_listS);
+  free(fill_listTH);
+  free(fill_listTS);
+  fill_diag = fill_first = fill_before = fill_listJ = NULL;
+  fill_listH = fill_listS = fill_listTH = fill_listTS = NULL;
+  fill_diags = fill_cells = 0;
+  triloopEntropies = triloopEnthalpies = NULL;
+  tetraloopEntropies = tetraloopEnthalpies = NULL;
+}
+
+/* Built-in copy of the parameter set in primer3_config/, generated at
+   build time by thal_params (see thal_write_parameter_tables()). */
+#ifndef THAL_NO_DEFAULT_PARAMETERS
+#include "thal_default_params.h"
+#endif
+
+int
+thal_load_default_parameters(thal_results *o)
+{
+#ifdef THAL_NO_DEFAULT_PARAMETERS
+  strcpy(o->msg, "No built-in thermodynamic parameters");
+  return -1;
+#else
+  if (setjmp(_jmp_buf) != 0) {
+     return -1;
+  }
+
+  long_loop_T = -1.0;
+  memcpy(stackEntropies, def_stackEntropies, sizeof(stackEntropies));
+  memcpy(stackEnthalpies, def_stackEnthalpies, sizeof(stackEnthalpies));
+  memcpy(stackint2Entropies, def_stackint2Entropies, sizeof(stackint2Entropies));
+  memcpy(stackint2Enthalpies, def_stackint2Enthalpies, sizeof(stackint2Enthalpies));
+  memcpy(dangleEntropies3, def_dangleEntropies3, sizeof(dangleEntropies3));
+  memcpy(dangleEnthalpies3, def_dangleEnthalpies3, sizeof(dangleEnthalpies3));
+  memcpy(dangleEntropies5, def_dangleEntropies5, sizeof(dangleEntropies5));
+  memcpy(dangleEnthalpies5, def_dangleEnthalpies5, sizeof(dangleEnthalpies5));
+  memcpy(hairpinLoopEntropies, def_hairpinLoopEntropies, sizeof(hairpinLoopEntropies));
+  memcpy(interiorLoopEntropies, def_interiorLoopEntropies, sizeof(interiorLoopEntropies));
+  memcpy(bulgeLoopEntropies, def_bulgeLoopEntropies, sizeof(bulgeLoopEntropies));
+  memcpy(hairpinLoopEnthalpies, def_hairpinLoopEnthalpies, sizeof(hairpinLoopEnthalpies));
+  memcpy(interiorLoopEnthalpies, def_interiorLoopEnthalpies, sizeof(interiorLoopEnthalpies));
+  memcpy(bulgeLoopEnthalpies, def_bulgeLoopEnthalpies, sizeof(bulgeLoopEnthalpies));
+  memcpy(tstackEntropies, def_tstackEntropies, sizeof(tstackEntropies));
+  memcpy(tstackEnthalpies, def_tstackEnthalpies, sizeof(tstackEnthalpies));
+  memcpy(tstack2Entropies, def_tstack2Entropies, sizeof(tstack2Entropies));
+  memcpy(tstack2Enthalpies, def_tstack2Enthalpies, sizeof(tstack2Enthalpies));
+
+  /* The loop tables stay on the heap so that destroy_thal_structures()
+     works the same whichever way they were loaded. */
+  numTriloops = def_numTriloops;
+  numTetraloops = def_numTetraloops;
+  triloopEntropies = (struct triloop*) safe_malloc(sizeof(def_triloopEntropies), o);
+  triloopEnthalpies = (struct triloop*) safe_malloc(sizeof(def_triloopEnthalpies), o);
+  tetraloopEntropies = (struct tetraloop*) safe_malloc(sizeof(def_tetraloopEntropies), o);
+  tetraloopEnthalpies = (struct tetraloop*) safe_malloc(sizeof(def_tetraloopEnthalpies), o);
+  memcpy(triloopEntropies, def_triloopEntropies, sizeof(def_triloopEntropies));
+  memcpy(triloopEnthalpies, def_triloopEnthalpies, sizeof(def_triloopEnthalpies));
+  memcpy(tetraloopEntropies, def_tetraloopEntropies, sizeof(def_tetraloopEntropies));
+  memcpy(tetraloopEnthalpies, def_tetraloopEnthalpies, sizeof(def_tetraloopEnthalpies));
+
+  tableStartATS(AT_S, atpS);
+  tableStartATH(AT_H, atpH);
+
+  return 0;
+#endif
+}
+
+static void
+write_table(FILE *f, const char *name, const double *v, size_t n, const char *dims)
+{
+  size_t i;
+  fprintf(f, "static const double %s%s = {", name, dims);
+  for (i = 0; i < n; i++) {
+    if (i % 5 == 0) fprintf(f, "\n ");
+    if (isinf(v[i]))
+      fprintf(f, " %sHUGE_VAL,", v[i] < 0 ? "-" : "");
+    else
+      fprintf(f, " %.17g,", v[i]);
+  }
+  fprintf(f, "};\n\n");
+}
+
+static void
+write_triloops(FILE *f, const char *name, const struct triloop *t, int num)
+{
+  int i;
+  fprintf(f, "static const struct triloop %s[%d] = {\n", name, num > 0 ? num : 1);
+  for (i = 0; i < num; i++)
+    fprintf(f, "  {{%d, %d, %d, %d, %d}, %.17g},\n", t[i].loop[0], t[i].loop[1],
+	    t[i].loop[2], t[i].loop[3], t[i].loop[4], t[i].value);
+  if (num == 0) fprintf(f, "  {{0}, 0},\n");
+  fprintf(f, "};\n\n");
+}
+
+static void
+write_tetraloops(FILE *f, const char *name, const struct tetraloop *t, int num)
+{
+  int i;
+  fprintf(f, "static const struct tetraloop %s[%d] = {\n", name, num > 0 ? num : 1);
+  for (i = 0; i < num; i++)
+    fprintf(f, "  {{%d, %d, %d, %d, %d, %d}, %.17g},\n", t[i].loop[0], t[i].loop[1],
+	    t[i].loop[2], t[i].loop[3], t[i].loop[4], t[i].loop[5], t[i].value);
+  if (num == 0) fprintf(f, "  {{0}, 0},\n");
+  fprintf(f, "};\n\n");
+}
+
+#define WRITE_TABLE(f, t, dims) \
+  write_table(f, "def_" #t, (const double*) t, sizeof(t) / sizeof(double), dims)
+
+int
+thal_write_parameter_tables(const char *file)
+{
+  FILE *f;
+  if (!(f = fopen(file, "w")))
+    return -1;
+  fprintf(f, "/* Generated by thal_params from %s; do not edit. */\n\n",
+	  parampath ? parampath : "?");
+  WRITE_TABLE(f, stackEntropies, "[5][5][5][5]");
+  WRITE_TABLE(f, stackEnthalpies, "[5][5][5][5]");
+  WRITE_TABLE(f, stackint2Entropies, "[5][5][5][5]");
+  WRITE_TABLE(f, stackint2Enthalpies, "[5][5][5][5]");
+  WRITE_TABLE(f, dangleEntropies3, "[5][5][5]");
+  WRITE_TABLE(f, dangleEnthalpies3, "[5][5][5]");
+  WRITE_TABLE(f, dangleEntropies5, "[5][5][5]");
+  WRITE_TABLE(f, dangleEnthalpies5, "[5][5][5]");
+  WRITE_TABLE(f, hairpinLoopEntropies, "[30]");
+  WRITE_TABLE(f, interiorLoopEntropies, "[30]");
+  WRITE_TABLE(f, bulgeLoopEntropies, "[30]");
+  WRITE_TABLE(f, hairpinLoopEnthalpies, "[30]");
+  WRITE_TABLE(f, interiorLoopEnthalpies, "[30]");
+  WRITE_TABLE(f, bulgeLoopEnthalpies, "[30]");
+  WRITE_TABLE(f, tstackEntropies, "[5][5][5][5]");
+  WRITE_TABLE(f, tstackEnthalpies, "[5][5][5][5]");
+  WRITE_TABLE(f, tstack2Entropies, "[5][5][5][5]");
+  WRITE_TABLE(f, tstack2Enthalpies, "[5][5][5][5]");
+  fprintf(f, "static const int def_numTriloops = %d;\n", numTriloops);
+  fprintf(f, "static const int def_numTetraloops = %d;\n\n", numTetraloops);
+  write_triloops(f, "def_triloopEntropies", triloopEntropies, numTriloops);
+  write_triloops(f, "def_triloopEnthalpies", triloopEnthalpies, numTriloops);
+  write_tetraloops(f, "def_tetraloopEntropies", tetraloopEntropies, numTetraloops);
+  write_tetraloops(f, "def_tetraloopEnthalpies", tetraloopEnthalpies, numTetraloops);
+  return fclose(f) == 0 ? 0 : -1;
 }
 
 /* central method: execute all sub-methods for calculating secondary
@@ -380,6 +581,7 @@ thal(const unsigned char *oligo_f,
    oligo1 = oligo2 = NULL;
    strcpy(o->msg, "");
    o->temp = THAL_ERROR_SCORE;
+   o->sec_struct = NULL;
    errno = 0; 
 
    if (setjmp(_jmp_buf) != 0) {
@@ -415,12 +617,12 @@ thal(const unsigned char *oligo_f,
 	       "Illegal type");
    o->align_end_1 = -1;
    o->align_end_2 = -1;
-   if ('\0' == oligo_f) {
+   if ('\0' == *oligo_f) {
       strcpy(o->msg, "Empty first sequence");
       o->temp = 0.0;
       return;
    }
-   if ('\0' == oligo_r) {
+   if ('\0' == *oligo_r) {
       strcpy(o->msg, "Empty second sequence");
       o->temp = 0.0;
       return;
@@ -515,7 +717,10 @@ thal(const unsigned char *oligo_f,
       if(isFinite(mh)) {
 	 tracebacku(bp, a->maxLoop, o);
 	 /* traceback for unimolecular structure */
-	 drawHairpin(bp, mh, ms, a->temponly,a->temp, o); /* if temponly=1 then return after printing basic therm data */
+	 if(a->temponly == 0 || a->mode == THL_STRUCT || !isFinite(ms))
+	   drawHairpin(bp, mh, ms, a->temponly,a->temp, a->mode, o);
+	 else
+	   o->temp = calcHairpinTm(bp, mh, ms); /* score only; no ascii structure is built */
       } else if(a->temponly==0) {
 	 fputs("No secondary structure could be calculated\n",stderr);
       }
@@ -536,7 +741,10 @@ thal(const unsigned char *oligo_f,
       enthalpyDPT = safe_recalloc(enthalpyDPT, len1, len2, o); /* dyn. programming table for dS and dH */
       entropyDPT = safe_recalloc(entropyDPT, len1, len2, o); /* enthalpyDPT is 3D array represented as 1D array */
       initMatrix();
-      fillMatrix(a->maxLoop, o);
+      if (reference_kernels)
+	 fillMatrixReference(a->maxLoop, o);
+      else
+	 fillMatrix(a->maxLoop, o);
       SHleft = -_INFINITY;
       SH = (double*) safe_malloc(2 * sizeof(double), o);
       /* calculate terminal basepairs */
@@ -593,8 +801,17 @@ thal(const unsigned char *oligo_f,
       for (j = 0; j < len2; ++j)
 	ps2[j] = 0;
       if(isFinite(EnthalpyDPT(bestI, bestJ))){
-	 traceback(bestI, bestJ, RC, ps1, ps2, a->maxLoop, o);
-	 drawDimer(ps1, ps2, SHleft, dH, dS, a->temponly,a->temp, o);
+	 if(a->temponly == 0 || a->mode == THL_STRUCT) {
+	    traceback(bestI, bestJ, RC, ps1, ps2, a->maxLoop, o);
+	    drawDimer(ps1, ps2, SHleft, dH, dS, a->temponly,a->temp, a->mode, o);
+	 } else if(!isFinite(SHleft)) {
+	    /* no structure; the traceback is not needed for the score */
+	    o->temp = 0.0;
+	    strcpy(o->msg, "No predicted sec struc for given seq");
+	 } else {
+	    traceback(bestI, bestJ, RC, ps1, ps2, a->maxLoop, o);
+	    o->temp = calcDimerTm(ps1, ps2, dH, dS);
+	 }
 	 o->align_end_1=bestI;
 	 o->align_end_2=bestJ;
       } else  {
@@ -615,6 +832,85 @@ thal(const unsigned char *oligo_f,
 }
 /*** END thal() ***/
 
+/* The bound: a structure with Tm above tm_limit has dG < 0 at T = tm_limit,
+   where dG includes the salt correction and the oligo concentration term
+   of the Tm formula. dG of a structure is a sum of terms (stacks, loops,
+   terminal penalties), so a lower bound of dG follows from lower bounds of
+   the terms on a chain of base pairs. Stacks, single-base bulges and 1x1
+   loops are taken exactly; longer loops get the smallest loop penalty of
+   the tables. The loop size limit and the choices thal() makes between
+   alternatives are ignored, which only lowers the bound.
+   The bound is a fill of an l1 x l2 table too, but with a constant
+   number of terms per cell, where thal() scans up to MAX_LOOP^2 loop
+   sizes per cell and then traces the structure back.
+   G is in cal/mol. In exact arithmetic G > 0 would do; the 1 cal/mol
+   of margin covers the rounding of thal(), which adds the same terms
+   in another order and tests Tm = H / S rather than the sign of dG.
+   That rounding is below 1e-6 cal/mol for oligos of THAL_MAX_ALIGN
+   bases, and the margin only makes the test align a pair whose bound
+   is within 1 cal/mol of the limit, a Tm difference of a few
+   thousandths of a degree. */
+int
+thal_may_exceed(const unsigned char *oligo_f,
+		const unsigned char *oligo_r,
+		const thal_args *a,
+		double tm_limit)
+{
+   unsigned char s1[THAL_MAX_ALIGN + 2], s2[THAL_MAX_ALIGN + 2];
+   const unsigned char *o1, *o2;
+   int l1, l2, i, rev;
+   double T, sc, rc, G;
+
+   if (NULL == oligo_f || NULL == oligo_r || NULL == a) return 1;
+   if (a->type != thal_any && a->type != thal_end1
+       && a->type != thal_end2 && a->type != thal_hairpin) return 1;
+   l1 = length_unsig_char(oligo_f);
+   l2 = length_unsig_char(oligo_r);
+   if (l1 <= 0 || l2 <= 0 || l1 > THAL_MAX_ALIGN || l2 > THAL_MAX_ALIGN) return 1;
+   T = tm_limit + ABSOLUTE_ZERO;
+   if (!(T > 0.0)) return 1;
+   /* the bound relies on the salt correction lowering the entropy */
+   sc = saltCorrectS(a->mv, a->dv, a->dntp);
+   if (!(sc <= 0.0)) return 1;
+
+   /* same order and direction of the sequences as in thal() */
+   o1 = oligo_f;
+   o2 = oligo_r;
+   rev = (a->type != thal_hairpin);
+   if (a->type == thal_end2) {
+      o1 = oligo_r;
+      o2 = oligo_f;
+      i = l1; l1 = l2; l2 = i;
+   }
+   for (i = 1; i <= l1; ++i) s1[i] = str2int(toupper(o1[i - 1]));
+   for (i = 1; i <= l2; ++i) s2[i] = str2int(toupper(rev ? o2[l2 - i] : o2[i - 1]));
+   s1[0] = s1[l1 + 1] = s2[0] = s2[l2 + 1] = 4;
+
+   if (a->type == thal_hairpin) {
+      if (l1 != l2) return 1;
+      /* Tm = H / (S + (N-1)*sc), N >= 0 base pairs */
+      G = boundHairpin(s1, s2, l1, T) + T * sc;
+   } else {
+      if (symmetry_thermo(oligo_f) && symmetry_thermo(oligo_r)) {
+	 rc = R * log(a->dna_conc/1000000000.0);
+      } else {
+	 rc = R * log(a->dna_conc/4000000000.0);
+      }
+      if (!(rc <= 0.0)) return 1;
+      /* Tm = (H + 200) / (S - 5.7 + (N-1)*sc + rc) */
+      G = boundDimer(s1, l1, s2, l2, T, a->type != thal_any)
+	+ termG(200, -5.7, T) - T * rc + T * sc;
+   }
+   /* margin for rounding in the sums of thal() */
+   return (G > 1.0) ? 0 : 1;
+}
+
+void
+thal_set_reference_kernels(int on)
+{
+   reference_kernels = on;
+}
+
 /* Set default args */
 void 
 set_thal_default_args(thal_args *a)
@@ -1273,8 +1569,152 @@ initMatrix2()
 
 }
 
+/* The dimer table is filled by anti-diagonals. Cell (i, j) depends
+   only on cells (ii, jj) with ii < i and jj < j, which lie on earlier
+   anti-diagonals, so this gives the same table as filling it by rows.
+   When an anti-diagonal is done, its cells with a finite value are
+   listed, so that the bulge and internal loop scan of later cells only
+   visits the inner pairs it does not skip. The fill is scalar: most
+   cells of an anti-diagonal cannot pair, and vector lanes over them
+   cost more than the list walk saves. The hairpin table (fillMatrix2())
+   is still filled by rows. */
 static void 
 fillMatrix(int maxLoop, thal_results *o)
+{
+   int d, i, j, ii, jj, k, kk, c, c1, lo, hi, ilo, ihi, loopSize1, loopSize2;
+   double S, H, T1, T2;
+   double cellH, cellS;
+   /* For anti-diagonal k, the finite cells in order of j are at diag[k],
+      diag[k] + 1, ...: listJ is their j, listH and listS their values
+      and listTH, listTS the terminal mismatch after the pair, as in
+      internal loops. Cells of anti-diagonal k with j < jj come before
+      before[first[k] + jj]. */
+   int *diag, *first, *before, *listJ;
+   double *listH, *listS, *listTH, *listTS;
+   double SH[2];
+   /* the buffers only grow, so after the first calls there is no
+      allocation here; a failed realloc leaves them as they were */
+   if (len1 + len2 + 1 > fill_diags) {
+      fill_diag = (int*) safe_realloc(fill_diag, (len1 + len2 + 1) * sizeof(int), o);
+      fill_first = (int*) safe_realloc(fill_first, (len1 + len2 + 1) * sizeof(int), o);
+      fill_diags = len1 + len2 + 1;
+   }
+   if (len1 * len2 + len1 + len2 > fill_cells) {
+      c = len1 * len2 + len1 + len2;
+      fill_before = (int*) safe_realloc(fill_before, c * sizeof(int), o);
+      fill_listJ = (int*) safe_realloc(fill_listJ, c * sizeof(int), o);
+      fill_listH = (double*) safe_realloc(fill_listH, c * sizeof(double), o);
+      fill_listS = (double*) safe_realloc(fill_listS, c * sizeof(double), o);
+      fill_listTH = (double*) safe_realloc(fill_listTH, c * sizeof(double), o);
+      fill_listTS = (double*) safe_realloc(fill_listTS, c * sizeof(double), o);
+      fill_cells = c;
+   }
+   diag = fill_diag;
+   first = fill_first;
+   before = fill_before;
+   listJ = fill_listJ;
+   listH = fill_listH;
+   listS = fill_listS;
+   listTH = fill_listTH;
+   listTS = fill_listTS;
+   for (k = 2, c = 0, c1 = 0; k <= len1 + len2; ++k) {
+      lo = (k - len1 > 1) ? k - len1 : 1; /* first j on the anti-diagonal */
+      hi = (k - 1 < len2) ? k - 1 : len2;
+      diag[k] = c;
+      first[k] = c1 - lo;
+      c += hi - lo + 1;
+      c1 += hi - lo + 2;
+   }
+   for (k = 2; k <= len1 + len2; ++k) {
+      ilo = (k - len2 > 1) ? k - len2 : 1;
+      ihi = (k - 1 < len1) ? k - 1 : len1;
+      for (i = ihi; i >= ilo; --i) {
+	 j = k - i;
+	 if(isFinite(EnthalpyDPT(i, j))) { /* if finite */
+	    SH[0] = -1.0;
+	    SH[1] = _INFINITY;
+	    LSH(i,j,SH);
+	    if(isFinite(SH[1])) {
+	       EntropyDPT(i,j) = SH[0];
+	       EnthalpyDPT(i,j) = SH[1];
+	    }
+	    if (i > 1 && j > 1) {
+	       maxTM(i, j); /* stack: sets EntropyDPT(i, j) and EnthalpyDPT(i, j) */
+	       /* This is calc_bulge_internal<0>() with the Tm of (i, j)
+		  computed only when (i, j) changes. */
+	       T2 = (EnthalpyDPT(i, j) + dplx_init_H) / (EntropyDPT(i, j) + dplx_init_S + RC);
+	       cellH = tstackEnthalpies[numSeq2[j]][numSeq2[j-1]][numSeq1[i]][numSeq1[i-1]];
+	       cellS = tstackEntropies[numSeq2[j]][numSeq2[j-1]][numSeq1[i]][numSeq1[i-1]];
+	       for(d = 3; d <= maxLoop + 2 && k - d >= 2; d++) { /* max=30, length over 30 is not allowed */
+		  /* inner pairs (ii, jj) with ii + jj = kk, ii < i and jj < j */
+		  kk = k - d;
+		  lo = (kk - i + 1 > 1) ? kk - i + 1 : 1;
+		  hi = (j - 1 < kk - 1) ? j - 1 : kk - 1;
+		  if (hi > len2) hi = len2;
+		  if (lo > hi) continue;
+		  for (c = before[first[kk] + lo]; c < before[first[kk] + hi + 1]; ++c) {
+		     jj = listJ[diag[kk] + c];
+		     ii = kk - jj;
+		     loopSize1 = i - ii - 1;
+		     loopSize2 = j - jj - 1;
+		     if (loopSize1 > 0 && loopSize2 > 0 && loopSize1 + loopSize2 > 2) {
+			H = interiorLoopEnthalpies[loopSize1 + loopSize2 - 1] + listTH[diag[kk] + c] +
+			  cellH + (ILAH * abs(loopSize1 - loopSize2));
+			H += listH[diag[kk] + c];
+			S = interiorLoopEntropies[loopSize1 + loopSize2 - 1] + listTS[diag[kk] + c] +
+			  cellS + (ILAS * abs(loopSize1 - loopSize2));
+			S += listS[diag[kk] + c];
+			if(!isFinite(H)) {
+			   H = _INFINITY;
+			   S = -1.0;
+			}
+			T1 = (H + dplx_init_H) / ((S + dplx_init_S) + RC);
+			if (!(T1 > T2)) continue;
+		     } else if (bulge_internal_SH(ii, jj, i, j, &S, &H)) {
+			T1 = (H + dplx_init_H) / ((S + dplx_init_S) + RC);
+			if (!(DBL_EQ(T1,T2) == 2 && T1 > T2)) continue;
+		     } else {
+			T1 = (H + dplx_init_H) / ((S + dplx_init_S) + RC);
+			if (!(T1 > T2)) continue;
+		     }
+		     if(S < MinEntropyCutoff) {
+			/* to not give dH any value if dS is unreasonable */
+			S = MinEntropy;
+			H = 0.0;
+		     }
+		     if(isFinite(H)) {
+			EnthalpyDPT(i, j) = H;
+			EntropyDPT(i, j) = S;
+			T2 = (EnthalpyDPT(i, j) + dplx_init_H) / (EntropyDPT(i, j) + dplx_init_S + RC);
+		     }
+		  }
+	       }
+	    } /* if */
+	 }
+      }
+      /* list the finite cells of the anti-diagonal */
+      for (i = ihi, c = 0; i >= ilo; --i) {
+	 j = k - i;
+	 before[first[k] + j] = c;
+	 if (isFinite(EnthalpyDPT(i, j))) {
+	    listJ[diag[k] + c] = j;
+	    listH[diag[k] + c] = EnthalpyDPT(i, j);
+	    listS[diag[k] + c] = EntropyDPT(i, j);
+	    listTH[diag[k] + c] = tstackEnthalpies[numSeq1[i]][numSeq1[i+1]][numSeq2[j]][numSeq2[j+1]];
+	    listTS[diag[k] + c] = tstackEntropies[numSeq1[i]][numSeq1[i+1]][numSeq2[j]][numSeq2[j+1]];
+	    ++c;
+	 }
+      }
+      before[first[k] + k - ilo + 1] = c;
+   }
+}
+
+/* The dimer table filled row by row, cell by cell, with the loop
+   function as primer3 had it before fillMatrix() filled it by
+   anti-diagonals. Kept as the reference the faster fill is validated
+   against. */
+static void
+fillMatrixReference(int maxLoop, thal_results *o)
 {
    int d, i, j, ii, jj;
    double* SH;
@@ -1302,7 +1742,7 @@ fillMatrix(int maxLoop, thal_results *o)
 		     if (isFinite(EnthalpyDPT(ii, jj))) {
 			SH[0] = -1.0;
 			SH[1] = _INFINITY;
-			calc_bulge_internal(ii, jj, i, j, SH,0,maxLoop);
+			calc_bulge_internal_reference(ii, jj, i, j, SH, 0, maxLoop);
 			if(SH[0] < MinEntropyCutoff) {
 			   /* to not give dH any value if dS is unreasonable */
 			   SH[0] = MinEntropy;
@@ -1334,10 +1774,10 @@ fillMatrix2(int maxLoop, thal_results* o)
 	   SH[0] = -1.0;
 	   SH[1] = _INFINITY;
 	   maxTM2(i,j); /* calculate stack */
-	   CBI(i, j, SH, 0,maxLoop); /* calculate Bulge and Internal loop and stack */
+	   CBI<0>(i, j, SH, maxLoop); /* calculate Bulge and Internal loop and stack */
 	   SH[0] = -1.0;
 	   SH[1] = _INFINITY;
-	   calc_hairpin(i, j, SH, 0);
+	   calc_hairpin<0>(i, j, SH);
 	   if(isFinite(SH[1])) {
 	      if(SH[0] < MinEntropyCutoff){ /* to not give dH any value if dS is unreasonable */
 		 SH[0] = MinEntropy;
@@ -1632,7 +2072,7 @@ RSH(int i, int j, double* EntropyEnthalpy)
    return;
 }
 
-static double 
+static inline double 
 Ss(int i, int j, int k)
 {
    if(k==2) {
@@ -1652,7 +2092,7 @@ Ss(int i, int j, int k)
 }
 
 
-static double 
+static inline double 
 Hs(int i, int j, int k)
 {
    if(k==2) {
@@ -1675,8 +2115,9 @@ Hs(int i, int j, int k)
    }
 }
 
+template <int traceback>
 static void 
-CBI(int i, int j, double* EntropyEnthalpy, int traceback, int maxLoop)
+CBI(int i, int j, double* EntropyEnthalpy, int maxLoop)
 {
    int d, ii, jj;
    for (d = j - i - 3; d >= MIN_HRPN_LOOP + 1 && d >= j - i - 2 - maxLoop; --d)
@@ -1687,7 +2128,7 @@ CBI(int i, int j, double* EntropyEnthalpy, int traceback, int maxLoop)
 	   EntropyEnthalpy[1] = _INFINITY;
 	}
 	if (isFinite(EnthalpyDPT(ii, jj))) {
-	   calc_bulge_internal2(i, j, ii, jj, EntropyEnthalpy, traceback,maxLoop);
+	   calc_bulge_internal2<traceback>(i, j, ii, jj, EntropyEnthalpy, maxLoop);
 	   if(isFinite(EntropyEnthalpy[1])) {
 	      if(EntropyEnthalpy[0] < MinEntropyCutoff) {
 		 EntropyEnthalpy[0] = MinEntropy;
@@ -1703,8 +2144,9 @@ CBI(int i, int j, double* EntropyEnthalpy, int traceback, int maxLoop)
    return;
 }
 
+template <int traceback>
 static void 
-calc_hairpin(int i, int j, double* EntropyEnthalpy, int traceback)
+calc_hairpin(int i, int j, double* EntropyEnthalpy)
 {
    int loopSize = j - i - 1;
    double T1, T2;
@@ -1771,30 +2213,119 @@ calc_hairpin(int i, int j, double* EntropyEnthalpy, int traceback)
 }
 
 
+static inline int
+bulge_internal_SH(int i, int j, int ii, int jj, double* S_, double* H_)
+{
+   int loopSize1, loopSize2, loopSize;
+   double S,H;
+   S = MinEntropy;
+   H = 0;
+   loopSize1 = ii - i - 1;
+   loopSize2 = jj - j - 1;
+#ifdef DEBUG
+   if (ii <= i){
+      fputs("Error in calc_bulge_internal(): ii is not greater than i\n", stderr);
+   }
+   if (jj <= j)
+     fputs("Error in calc_bulge_internal(): jj is not greater than j\n", stderr);
+#endif
+
+#ifdef DEBUG
+   if (loopSize1 == 0 && loopSize2 == 0) {
+      fputs("Error: calc_bulge_internal() called with nonsense\n", stderr);
+   }
+#endif
+   loopSize = loopSize1 + loopSize2 -1;
+   if((loopSize1 == 0 && loopSize2 > 0) || (loopSize2 == 0 && loopSize1 > 0)) { /* only bulges have to be considered */
+      if(loopSize2 == 1 || loopSize1 == 1) { /* bulge loop of size one is treated differently
+					      the intervening nn-pair must be added */
+
+	 if((loopSize2 == 1 && loopSize1 == 0) || (loopSize2 == 0 && loopSize1 == 1)) {
+	    H = bulgeLoopEnthalpies[loopSize] +
+	      stackEnthalpies[numSeq1[i]][numSeq1[ii]][numSeq2[j]][numSeq2[jj]];
+	    S = bulgeLoopEntropies[loopSize] +
+	      stackEntropies[numSeq1[i]][numSeq1[ii]][numSeq2[j]][numSeq2[jj]];
+	 }
+	 H += EnthalpyDPT(i, j);
+	 S += EntropyDPT(i, j);
+      } else { /* we have _not_ implemented Jacobson-Stockaymayer equation; the maximum bulgeloop size is 30 */
+
+	 H = bulgeLoopEnthalpies[loopSize] + atPenaltyH(numSeq1[i], numSeq2[j]) + atPenaltyH(numSeq1[ii], numSeq2[jj]);
+	 H += EnthalpyDPT(i, j);
+
+	 S = bulgeLoopEntropies[loopSize] + atPenaltyS(numSeq1[i], numSeq2[j]) + atPenaltyS(numSeq1[ii], numSeq2[jj]);
+	 S += EntropyDPT(i, j);
+      }
+   } else if (loopSize1 == 1 && loopSize2 == 1) {
+      S = stackint2Entropies[numSeq1[i]][numSeq1[i+1]][numSeq2[j]][numSeq2[j+1]] +
+	stackint2Entropies[numSeq2[jj]][numSeq2[jj-1]][numSeq1[ii]][numSeq1[ii-1]];
+      S += EntropyDPT(i, j);
+
+      H = stackint2Enthalpies[numSeq1[i]][numSeq1[i+1]][numSeq2[j]][numSeq2[j+1]] +
+	stackint2Enthalpies[numSeq2[jj]][numSeq2[jj-1]][numSeq1[ii]][numSeq1[ii-1]];
+      H += EnthalpyDPT(i, j);
+   } else { /* only internal loops */
+      H = interiorLoopEnthalpies[loopSize] + tstackEnthalpies[numSeq1[i]][numSeq1[i+1]][numSeq2[j]][numSeq2[j+1]] +
+	tstackEnthalpies[numSeq2[jj]][numSeq2[jj-1]][numSeq1[ii]][numSeq1[ii-1]]
+	+ (ILAH * abs(loopSize1 - loopSize2));
+      H += EnthalpyDPT(i, j);
+
+      S = interiorLoopEntropies[loopSize] + tstackEntropies[numSeq1[i]][numSeq1[i+1]][numSeq2[j]][numSeq2[j+1]] +
+	tstackEntropies[numSeq2[jj]][numSeq2[jj-1]][numSeq1[ii]][numSeq1[ii-1]] + (ILAS * abs(loopSize1 - loopSize2));
+      S += EntropyDPT(i, j);
+   }
+   if(!isFinite(H)) {
+      H = _INFINITY;
+      S = -1.0;
+   }
+   *S_ = S;
+   *H_ = H;
+   return (loopSize1 == 1 && loopSize2 == 1);
+}
+
+template <int traceback>
+static void 
+calc_bulge_internal(int i, int j, int ii, int jj, double* EntropyEnthalpy, int maxLoop)
+{
+   double T1, T2;
+   double S,H;
+   int is1x1;
+#ifdef DEBUG
+   if (ii - i - 1 + jj - j - 1 > maxLoop) {
+      fputs("Error: calc_bulge_internal() called with loopSize1 + loopSize2 > maxLoop\n", stderr);
+      return;
+   }
+#endif
+   is1x1 = bulge_internal_SH(i, j, ii, jj, &S, &H);
+   T1 = (H + dplx_init_H) / ((S + dplx_init_S) + RC);
+   T2 = (EnthalpyDPT(ii, jj) + dplx_init_H) / ((EntropyDPT(ii, jj)) + dplx_init_S + RC);
+   if (is1x1) {
+      if((DBL_EQ(T1,T2) == 2) || traceback==1) {
+	 if((T1 > T2) || (traceback && T1 >= T2)) {
+	    EntropyEnthalpy[0] = S;
+	    EntropyEnthalpy[1] = H;
+	 }
+      }
+   } else if((T1 > T2) || ((traceback && T1 >= T2) || (traceback==1))) {
+      EntropyEnthalpy[0] = S;
+      EntropyEnthalpy[1] = H;
+   }
+   return;
+}
+
+/* calc_bulge_internal() as primer3 had it before it was split and made a
+   template, kept for the reference kernels (see thal_set_reference_kernels()) */
 static void 
-calc_bulge_internal(int i, int j, int ii, int jj, double* EntropyEnthalpy, int traceback, int maxLoop)
+calc_bulge_internal_reference(int i, int j, int ii, int jj, double* EntropyEnthalpy, int traceback, int maxLoop)
 {
    int loopSize1, loopSize2, loopSize;
    double T1, T2;
    double S,H;
-   int N, N_loop;
    T1 = T2 = -_INFINITY;
    S = MinEntropy;
    H = 0;
    loopSize1 = ii - i - 1;
    loopSize2 = jj - j - 1;
-   if(ii < jj) {
-      N = ((2 * i)/2);
-      N_loop = N;
-      if(loopSize1 > 2) N_loop -= (loopSize1 - 2);
-      if(loopSize2 > 2) N_loop -= (loopSize2 - 2);
-   } else {
-      N = ((2 * j)/2);
-      N_loop = 2 * jj;
-      if(loopSize1 > 2) N_loop -= (loopSize1 - 2);
-      if(loopSize2 > 2) N_loop -= (loopSize2 - 2);
-      N_loop = (N_loop/2) - 1;
-   }
 #ifdef DEBUG
    if (ii <= i){
       fputs("Error in calc_bulge_internal(): ii is not greater than i\n", stderr);
@@ -1905,8 +2436,9 @@ calc_bulge_internal(int i, int j, int ii, int jj, double* EntropyEnthalpy, int t
    return;
 }
 
+template <int traceback>
 static void 
-calc_bulge_internal2(int i, int j, int ii, int jj, double* EntropyEnthalpy, int traceback, int maxLoop)
+calc_bulge_internal2(int i, int j, int ii, int jj, double* EntropyEnthalpy, int maxLoop)
 {
    int loopSize1, loopSize2, loopSize;
    double T1, T2;
@@ -2493,10 +3025,10 @@ tracebacku(int* bp, int maxLoop,thal_results* o) /* traceback for unimolecular s
 	 bp[j - 1] = i;
 	 SH1[0] = -1.0;
 	 SH1[1] = _INFINITY;
-	 calc_hairpin(i, j, SH1, 1); /* 1 means that we use this method in traceback */
+	 calc_hairpin<1>(i, j, SH1); /* 1 means that we use this method in traceback */
 	 SH2[0] = -1.0;
 	 SH2[1] = _INFINITY;
-	 CBI(i,j,SH2,2,maxLoop);
+	 CBI<2>(i,j,SH2,maxLoop);
 	 if (equal(EntropyDPT(i, j), Ss(i, j, 2) + EntropyDPT(i + 1, j - 1)) &&
 	     equal(EnthalpyDPT(i, j), Hs(i, j, 2) + EnthalpyDPT(i + 1, j - 1))) {
 	    push(&stack, i + 1, j - 1, 0, o);
@@ -2509,7 +3041,7 @@ tracebacku(int* bp, int maxLoop,thal_results* o) /* traceback for unimolecular s
 		 jj = d + ii;
 		 EntropyEnthalpy[0] = -1.0;
 		 EntropyEnthalpy[1] = _INFINITY;
-		 calc_bulge_internal2(i, j, ii, jj,EntropyEnthalpy,1,maxLoop);
+		 calc_bulge_internal2<1>(i, j, ii, jj,EntropyEnthalpy,maxLoop);
 		 if (equal(EntropyDPT(i, j), EntropyEnthalpy[0] + EntropyDPT(ii, jj)) &&
 		     equal(EnthalpyDPT(i, j), EntropyEnthalpy[1] + EnthalpyDPT(ii, jj))) {
 		    push(&stack, ii, jj, 0, o);
@@ -2561,7 +3093,10 @@ traceback(int i, int j, double RT, int* ps1, int* ps2, int maxLoop, thal_results
 	 for (; !done && ii > 0 && jj < j; --ii, ++jj) {
 	    SH[0] = -1.0;
 	    SH[1] = _INFINITY;
-	    calc_bulge_internal(ii, jj, i, j, SH,1,maxLoop);
+	    if (reference_kernels)
+	       calc_bulge_internal_reference(ii, jj, i, j, SH, 1, maxLoop);
+	    else
+	       calc_bulge_internal<1>(ii, jj, i, j, SH,maxLoop);
 	    if (equal(EntropyDPT(i, j), SH[0]) && equal(EnthalpyDPT(i, j), SH[1])) {
 	       i = ii;
 	       j = jj;
@@ -2576,8 +3111,34 @@ traceback(int i, int j, double RT, int* ps1, int* ps2, int maxLoop, thal_results
    free(SH);
 }
 
+static double 
+calcDimerTm(const int* ps1, const int* ps2, double H, double S)
+{
+   int i, N;
+   N=0;
+   for(i=0;i<len1;i++){
+      if(ps1[i]>0) ++N;
+   }
+   for(i=0;i<len2;i++) {
+      if(ps2[i]>0) ++N;
+   }
+   N = (N/2) -1;
+   return ((H) / (S + (N * saltCorrection) + RC)) - ABSOLUTE_ZERO;
+}
+
+static double 
+calcHairpinTm(const int* bp, double mh, double ms)
+{
+   int i, N;
+   N = 0;
+   for (i = 1; i < len1; ++i) {
+      if(bp[i-1] > 0) N++;
+   }
+   return (mh / (ms + (((N/2)-1) * saltCorrection))) - ABSOLUTE_ZERO;
+}
+
 static void 
-drawDimer(int* ps1, int* ps2, double temp, double H, double S, int temponly, double t37, thal_results *o)
+drawDimer(int* ps1, int* ps2, double temp, double H, double S, int temponly, double t37, thal_mode mode, thal_results *o)
 {
    int i, j, k, numSS1, numSS2, N;
    char* duplex[4];
@@ -2599,18 +3160,17 @@ drawDimer(int* ps1, int* ps2, double temp, double H, double S, int temponly, dou
 	 if(ps2[i]>0) ++N;
       }
       N = (N/2) -1;
-      t = ((H) / (S + (N * saltCorrection) + RC)) - ABSOLUTE_ZERO;
+      t = calcDimerTm(ps1, ps2, H, S);
+      o->temp = (double) t;
       if(temponly==0) {
 	 G = (H) - (t37 * (S + (N * saltCorrection)));
 	 S = S + (N * saltCorrection);
-	 o->temp = (double) t;
 	 /* maybe user does not need as precise as that */
 	 /* printf("Thermodynamical values:\t%d\tdS = %g\tdH = %g\tdG = %g\tt = %g\tN = %d, SaltC=%f, RC=%f\n",
 		len1, (double) S, (double) H, (double) G, (double) t, (int) N, saltCorrection, RC); */
 	 printf("Calculated thermodynamical parameters for dimer:\tdS = %g\tdH = %g\tdG = %g\tt = %g\n",
 		(double) S, (double) H, (double) G, (double) t);
-      } else {
-	 o->temp = (double) t;
+      } else if(mode != THL_STRUCT) {
 	 return;
       }
    }
@@ -2684,14 +3244,21 @@ drawDimer(int* ps1, int* ps2, double temp, double H, double S, int temponly, dou
 	   strcatc(duplex[3], '-');
 	}
    }
-   printf("SEQ\t");
-   printf("%s\n", duplex[0]);
-   printf("SEQ\t");
-   printf("%s\n", duplex[1]);
-   printf("STR\t");
-   printf("%s\n", duplex[2]);
-   printf("STR\t");
-   printf("%s\n", duplex[3]);
+   if(temponly==0) {
+      printf("SEQ\t");
+      printf("%s\n", duplex[0]);
+      printf("SEQ\t");
+      printf("%s\n", duplex[1]);
+      printf("STR\t");
+      printf("%s\n", duplex[2]);
+      printf("STR\t");
+      printf("%s\n", duplex[3]);
+   }
+   if(mode == THL_STRUCT) {
+      o->sec_struct = (char*) safe_malloc(4 * (len1 + len2 + 6) + 1, o);
+      sprintf(o->sec_struct, "SEQ\t%s\nSEQ\t%s\nSTR\t%s\nSTR\t%s\n",
+	      duplex[0], duplex[1], duplex[2], duplex[3]);
+   }
 
    free(duplex[0]);
    free(duplex[1]);
@@ -2702,7 +3269,7 @@ drawDimer(int* ps1, int* ps2, double temp, double H, double S, int temponly, dou
 }
 
 static void 
-drawHairpin(int* bp, double mh, double ms, int temponly, double temp, thal_results *o)
+drawHairpin(int* bp, double mh, double ms, int temponly, double temp, thal_mode mode, thal_results *o)
 {
    /* Plain text */
    int i, N;
@@ -2719,24 +3286,17 @@ drawHairpin(int* bp, double mh, double ms, int temponly, double temp, thal_resul
 	 strcpy(o->msg, "No predicted sec struc for given seq\n");
       }
    } else {
-      if(temponly == 0) {
-	 for (i = 1; i < len1; ++i) {
-	    if(bp[i-1] > 0) N++;
-	 }
-      } else {
-	 for (i = 1; i < len1; ++i) {
-	    if(bp[i-1] > 0) N++;
-	 }
+      for (i = 1; i < len1; ++i) {
+	 if(bp[i-1] > 0) N++;
       }
-      t = (mh / (ms + (((N/2)-1) * saltCorrection))) - ABSOLUTE_ZERO;
+      t = calcHairpinTm(bp, mh, ms);
+      o->temp = (double) t;
       if(temponly == 0) {
 	 mg = mh - (temp * (ms + (((N/2)-1) * saltCorrection)));
 	 ms = ms + (((N/2)-1) * saltCorrection);
-	 o->temp = (double) t;
 	 printf("Calculated thermodynamical parameters for dimer:\t%d\tdS = %g\tdH = %g\tdG = %g\tt = %g\n",
 		len1, (double) ms, (double) mh, (double) mg, (double) t);
-      } else {
-	 o->temp = (double) t;
+      } else if(mode != THL_STRUCT) {
 	 return;
       }
    }
@@ -2755,14 +3315,243 @@ drawHairpin(int* bp, double mh, double ms, int temponly, double temp, thal_resul
 	 }
       }
    }
-   printf("SEQ\t");
-   for(i = 0; i < len1; ++i) printf("%c",asciiRow[i]);
-   printf("\nSTR\t%s\n", oligo1);
+   if(temponly == 0) {
+      printf("SEQ\t");
+      for(i = 0; i < len1; ++i) printf("%c",asciiRow[i]);
+      printf("\nSTR\t%s\n", oligo1);
+   }
+   if(mode == THL_STRUCT) {
+      o->sec_struct = (char*) safe_malloc(2 * len1 + 12, o);
+      sprintf(o->sec_struct, "SEQ\t%.*s\nSTR\t%s\n", len1, asciiRow, oligo1);
+   }
    free(asciiRow);
    return;
 }
 
 
+static double
+termG(double H, double S, double T)
+{
+   if (!isFinite(H) || !isFinite(S)) return _INFINITY;
+   return H - T * S;
+}
+
+static double
+boundLSH(const unsigned char *s1, const unsigned char *s2, int i, int j, double T)
+{
+   double G, min = 0.0;
+   G = termG(tstack2Enthalpies[s2[j]][s2[j-1]][s1[i]][s1[i-1]],
+	     tstack2Entropies[s2[j]][s2[j-1]][s1[i]][s1[i-1]], T);
+   if (G < min) min = G;
+   G = termG(dangleEnthalpies3[s2[j]][s2[j-1]][s1[i]], dangleEntropies3[s2[j]][s2[j-1]][s1[i]], T);
+   if (G < min) min = G;
+   G += termG(dangleEnthalpies5[s2[j]][s1[i]][s1[i-1]], dangleEntropies5[s2[j]][s1[i]][s1[i-1]], T);
+   if (G < min) min = G;
+   G = termG(dangleEnthalpies5[s2[j]][s1[i]][s1[i-1]], dangleEntropies5[s2[j]][s1[i]][s1[i-1]], T);
+   if (G < min) min = G;
+   return min + termG(atPenaltyH(s1[i], s2[j]), atPenaltyS(s1[i], s2[j]), T);
+}
+
+static double
+boundRSH(const unsigned char *s1, const unsigned char *s2, int i, int j, double T)
+{
+   double G, min = 0.0;
+   G = termG(tstack2Enthalpies[s1[i]][s1[i+1]][s2[j]][s2[j+1]],
+	     tstack2Entropies[s1[i]][s1[i+1]][s2[j]][s2[j+1]], T);
+   if (G < min) min = G;
+   G = termG(dangleEnthalpies3[s1[i]][s1[i+1]][s2[j]], dangleEntropies3[s1[i]][s1[i+1]][s2[j]], T);
+   if (G < min) min = G;
+   G += termG(dangleEnthalpies5[s1[i]][s2[j]][s2[j+1]], dangleEntropies5[s1[i]][s2[j]][s2[j+1]], T);
+   if (G < min) min = G;
+   G = termG(dangleEnthalpies5[s1[i]][s2[j]][s2[j+1]], dangleEntropies5[s1[i]][s2[j]][s2[j+1]], T);
+   if (G < min) min = G;
+   return min + termG(atPenaltyH(s1[i], s2[j]), atPenaltyS(s1[i], s2[j]), T);
+}
+
+/* thal_may_exceed() is called over and over with the same limit */
+static double
+boundLongLoop(double T)
+{
+   if (T != long_loop_T) {
+      long_loop_G = scanLongLoop(T);
+      long_loop_T = T;
+   }
+   return long_loop_G;
+}
+
+static double
+scanLongLoop(double T)
+{
+   int a, b, c, d, k;
+   double G, bulge, interior, ts, at;
+   bulge = interior = ts = _INFINITY;
+   for (k = 1; k < 30; ++k) { /* bulges of 2 and more */
+      G = termG(bulgeLoopEnthalpies[k], bulgeLoopEntropies[k], T);
+      if (G < bulge) bulge = G;
+   }
+   for (k = 2; k < 30; ++k) { /* internal loops other than 1x1 */
+      G = termG(interiorLoopEnthalpies[k], interiorLoopEntropies[k], T);
+      if (G < interior) interior = G;
+   }
+   for (a = 0; a < 5; ++a)
+     for (b = 0; b < 5; ++b)
+       for (c = 0; c < 5; ++c)
+	 for (d = 0; d < 5; ++d) {
+	    G = termG(tstackEnthalpies[a][b][c][d], tstackEntropies[a][b][c][d], T);
+	    if (G < ts) ts = G;
+	 }
+   at = termG(AT_H, AT_S, T);
+   if (at > 0.0) at = 0.0;
+   G = termG(ILAH, ILAS, T) * (MAX_LOOP - 1);
+   if (G > 0.0) G = 0.0;
+   bulge += 2 * at;
+   interior += 2 * ts + G;
+   return (bulge < interior) ? bulge : interior;
+}
+
+static double
+boundDimer(const unsigned char *s1, int l1, const unsigned char *s2, int l2, double T, int endOnly)
+{
+   double best[THAL_MAX_ALIGN + 2][THAL_MAX_ALIGN + 2];
+   double pm[THAL_MAX_ALIGN + 2][THAL_MAX_ALIGN + 2]; /* min of best over ii <= i, jj <= j */
+   double loop, bulge1, G, min;
+   int i, j;
+
+   loop = boundLongLoop(T);
+   bulge1 = termG(bulgeLoopEnthalpies[0], bulgeLoopEntropies[0], T);
+   for (i = 0; i <= l1; ++i) pm[i][0] = _INFINITY;
+   for (j = 0; j <= l2; ++j) pm[0][j] = _INFINITY;
+   min = _INFINITY;
+   for (i = 1; i <= l1; ++i) {
+      for (j = 1; j <= l2; ++j) {
+	 best[i][j] = _INFINITY;
+	 if (bpIndx(s1[i], s2[j])) {
+	    best[i][j] = boundLSH(s1, s2, i, j, T);
+	    if (i > 1 && j > 1) {
+	       G = best[i-1][j-1] + termG(stackEnthalpies[s1[i-1]][s1[i]][s2[j-1]][s2[j]],
+					  stackEntropies[s1[i-1]][s1[i]][s2[j-1]][s2[j]], T);
+	       if (G < best[i][j]) best[i][j] = G;
+	       G = pm[i-1][j-1] + loop;
+	       if (G < best[i][j]) best[i][j] = G;
+	    }
+	    if (i > 2 && j > 1) {
+	       G = best[i-2][j-1] + bulge1 + termG(stackEnthalpies[s1[i-2]][s1[i]][s2[j-1]][s2[j]],
+						   stackEntropies[s1[i-2]][s1[i]][s2[j-1]][s2[j]], T);
+	       if (G < best[i][j]) best[i][j] = G;
+	    }
+	    if (i > 1 && j > 2) {
+	       G = best[i-1][j-2] + bulge1 + termG(stackEnthalpies[s1[i-1]][s1[i]][s2[j-2]][s2[j]],
+						   stackEntropies[s1[i-1]][s1[i]][s2[j-2]][s2[j]], T);
+	       if (G < best[i][j]) best[i][j] = G;
+	    }
+	    if (i > 2 && j > 2) {
+	       G = best[i-2][j-2]
+		 + termG(stackint2Enthalpies[s1[i-2]][s1[i-1]][s2[j-2]][s2[j-1]],
+			 stackint2Entropies[s1[i-2]][s1[i-1]][s2[j-2]][s2[j-1]], T)
+		 + termG(stackint2Enthalpies[s2[j]][s2[j-1]][s1[i]][s1[i-1]],
+			 stackint2Entropies[s2[j]][s2[j-1]][s1[i]][s1[i-1]], T);
+	       if (G < best[i][j]) best[i][j] = G;
+	    }
+	    if (!endOnly || i == l1) {
+	       G = best[i][j] + boundRSH(s1, s2, i, j, T);
+	       if (G < min) min = G;
+	    }
+	 }
+	 pm[i][j] = best[i][j];
+	 if (pm[i-1][j] < pm[i][j]) pm[i][j] = pm[i-1][j];
+	 if (pm[i][j-1] < pm[i][j]) pm[i][j] = pm[i][j-1];
+      }
+   }
+   return min;
+}
+
+static double
+boundHairpin(const unsigned char *s1, const unsigned char *s2, int len, double T)
+{
+   double best[THAL_MAX_ALIGN + 2][THAL_MAX_ALIGN + 2];
+   double q[THAL_MAX_ALIGN + 2][THAL_MAX_ALIGN + 2]; /* min of best over ii >= i, jj <= j */
+   double ext[THAL_MAX_ALIGN + 2]; /* min over non-empty sets of stems within 1..j */
+   double loop, bulge1, G, min;
+   int i, j, size;
+   struct triloop* loop3;
+   struct tetraloop* loop4;
+
+   loop = boundLongLoop(T);
+   bulge1 = termG(bulgeLoopEnthalpies[0], bulgeLoopEntropies[0], T);
+   for (i = 0; i <= len + 1; ++i) q[i][0] = _INFINITY;
+   for (j = 0; j <= len; ++j) q[len + 1][j] = _INFINITY;
+   for (j = 1; j <= len; ++j) {
+      for (i = len; i >= 1; --i) {
+	 best[i][j] = _INFINITY;
+	 if (j - i >= MIN_HRPN_LOOP + 1 && bpIndx(s1[i], s1[j])) {
+	    /* hairpin loop closed by i-j */
+	    size = j - i - 1;
+	    G = termG(hairpinLoopEnthalpies[(size < 30 ? size : 30) - 1],
+		      hairpinLoopEntropies[(size < 30 ? size : 30) - 1], T);
+	    if (size > 3)
+	      G += termG(tstack2Enthalpies[s1[i]][s1[i+1]][s1[j]][s1[j-1]],
+			 tstack2Entropies[s1[i]][s1[i+1]][s1[j]][s1[j-1]], T);
+	    else
+	      G += termG(atPenaltyH(s1[i], s1[j]), atPenaltyS(s1[i], s1[j]), T);
+	    if (size == 3 && numTriloops) {
+	       if ((loop3 = (struct triloop*) bsearch(s1 + i, triloopEnthalpies, numTriloops, sizeof(struct triloop), comp3loop)))
+		 G += loop3->value;
+	       if ((loop3 = (struct triloop*) bsearch(s1 + i, triloopEntropies, numTriloops, sizeof(struct triloop), comp3loop)))
+		 G -= T * loop3->value;
+	    } else if (size == 4 && numTetraloops) {
+	       if ((loop4 = (struct tetraloop*) bsearch(s1 + i, tetraloopEnthalpies, numTetraloops, sizeof(struct tetraloop), comp4loop)))
+		 G += loop4->value;
+	       if ((loop4 = (struct tetraloop*) bsearch(s1 + i, tetraloopEntropies, numTetraloops, sizeof(struct tetraloop), comp4loop)))
+		 G -= T * loop4->value;
+	    }
+	    if (isFinite(G)) best[i][j] = G;
+	    /* stack, single-base bulges and 1x1 loop on bp ii-jj inside i-j */
+	    G = best[i+1][j-1] + termG(stackEnthalpies[s1[i]][s1[i+1]][s2[j]][s2[j-1]],
+				       stackEntropies[s1[i]][s1[i+1]][s2[j]][s2[j-1]], T);
+	    if (G < best[i][j]) best[i][j] = G;
+	    G = best[i+2][j-1] + bulge1 + termG(stackEnthalpies[s1[i]][s1[i+2]][s2[j]][s2[j-1]],
+						stackEntropies[s1[i]][s1[i+2]][s2[j]][s2[j-1]], T);
+	    if (G < best[i][j]) best[i][j] = G;
+	    G = best[i+1][j-2] + bulge1 + termG(stackEnthalpies[s1[i]][s1[i+1]][s2[j]][s2[j-2]],
+						stackEntropies[s1[i]][s1[i+1]][s2[j]][s2[j-2]], T);
+	    if (G < best[i][j]) best[i][j] = G;
+	    G = best[i+2][j-2]
+	      + termG(stackint2Enthalpies[s1[i]][s1[i+1]][s2[j]][s2[j-1]],
+		      stackint2Entropies[s1[i]][s1[i+1]][s2[j]][s2[j-1]], T)
+	      + termG(stackint2Enthalpies[s2[j-2]][s2[j-1]][s1[i+2]][s1[i+1]],
+		      stackint2Entropies[s2[j-2]][s2[j-1]][s1[i+2]][s1[i+1]], T);
+	    if (G < best[i][j]) best[i][j] = G;
+	    G = q[i+1][j-1] + loop;
+	    if (G < best[i][j]) best[i][j] = G;
+	 }
+	 q[i][j] = best[i][j];
+	 if (q[i+1][j] < q[i][j]) q[i][j] = q[i+1][j];
+	 if (q[i][j-1] < q[i][j]) q[i][j] = q[i][j-1];
+      }
+   }
+
+   /* stems in the exterior loop, closed by bp i-j */
+   ext[0] = _INFINITY;
+   for (j = 1; j <= len; ++j) {
+      ext[j] = ext[j-1];
+      for (i = 1; i < j; ++i) {
+	 if (!isFinite(best[i][j])) continue;
+	 min = 0.0;
+	 G = termG(dangleEnthalpies5[s1[j]][s1[i]][s1[i-1]], dangleEntropies5[s1[j]][s1[i]][s1[i-1]], T);
+	 if (G < min) min = G;
+	 G = termG(dangleEnthalpies3[s1[j]][s1[j+1]][s1[i]], dangleEntropies3[s1[j]][s1[j+1]][s1[i]], T);
+	 if (G < min) min = G;
+	 G = termG(tstack2Enthalpies[s1[j]][s1[j+1]][s1[i]][s1[i-1]],
+		   tstack2Entropies[s1[j]][s1[j+1]][s1[i]][s1[i-1]], T);
+	 if (G < min) min = G;
+	 G = best[i][j] + min + termG(atPenaltyH(s1[i], s1[j]), atPenaltyS(s1[i], s1[j]), T);
+	 if (ext[i-1] < 0.0) G += ext[i-1];
+	 if (G < ext[j]) ext[j] = G;
+      }
+   }
+   return ext[len];
+}
+
 static int 
 equal(double a, double b)
 {
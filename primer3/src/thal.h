@@ -89,6 +89,15 @@ typedef enum thal_alignment_type {
   thal_hairpin = 4,
 } thal_alignment_type;
 
+/* What thal() computes besides the melting temperature. In THL_FAST
+   mode only the temperature (and the alignment ends) are returned and
+   no ascii structure is built; THL_STRUCT additionally returns the
+   structure in thal_results.sec_struct. */
+typedef enum thal_mode {
+  THL_FAST = 0,
+  THL_STRUCT = 1,
+} thal_mode;
+
 /* Structure for passing arguments to THermodynamic ALignment calculation */
 typedef struct {
    int debug; /* if non zero, print debugging info to stderr */
@@ -105,6 +114,7 @@ typedef struct {
    double temp; /* temperature from which hairpin structures will be calculated */
    int temponly; /* if non zero, print only temperature to stderr */
    int dimer; /* if non zero, dimer structure is calculated */
+   thal_mode mode; /* THL_FAST (default) or THL_STRUCT */
 } thal_args;
 
 /* Structure for receiving results from the thermodynamic alignment calculation */
@@ -113,6 +123,8 @@ typedef struct {
    double temp;
    int align_end_1;
    int align_end_2;
+   char *sec_struct; /* ascii structure in THL_STRUCT mode, NULL
+                        otherwise; must be freed by the caller */
 } thal_results;
 
 /*** END OF TYPEDEFS ***/
@@ -134,6 +146,18 @@ void set_thal_oligo_default_args(thal_args *a);
 #endif
 int  get_thermodynamic_values(const char* path, thal_results *o);
 
+/* Load the parameter set shipped in primer3_config/ from tables
+   compiled into thal.c, without reading any files.  Return 0 on
+   success and -1 on error (or if thal.c was built with
+   THAL_NO_DEFAULT_PARAMETERS).  Free with destroy_thal_structures()
+   as after get_thermodynamic_values(). */
+int  thal_load_default_parameters(thal_results *o);
+
+/* Write the currently loaded thermodynamic values to 'file' as the C
+   tables used by thal_load_default_parameters().  Return 0 on success
+   and -1 on error. */
+int  thal_write_parameter_tables(const char *file);
+
 void destroy_thal_structures();
 
 /* Central method for finding the best alignment.  On error, o->temp
@@ -147,4 +171,22 @@ void thal(const unsigned char *oligo1,
 	  const thal_args* a, 
 	  thal_results* o);
 
+/* If on is non-zero, thal() fills the dimer table with the plain row
+   by row fill primer3 used before the anti-diagonal one, and fills and
+   traces it back with the loop function as it was before it was made
+   a template. Both give the same results; the plain versions are kept
+   as a reference to validate the faster ones against. Off by default. */
+void thal_set_reference_kernels(int on);
+
+/* Cheap test to run before thal(). Returns 0 if no structure that
+   thal() can find for the same arguments has a melting temperature
+   above tm_limit, and 1 if the full alignment is needed to decide.
+   The test is conservative: it sums lower bounds of dG at tm_limit
+   over stacks, loops and terminal penalties along any chain of base
+   pairs. It answers 1 for arguments thal() would reject. */
+int thal_may_exceed(const unsigned char *oligo1,
+		    const unsigned char *oligo2,
+		    const thal_args* a,
+		    double tm_limit);
+
 #endif
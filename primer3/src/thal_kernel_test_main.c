@@ -0,0 +1,252 @@
+/*
+ Copyright (c) 1996,1997,1998,1999,2000,2001,2004,2006,2007,2008,2009
+ Whitehead Institute for Biomedical Research, Steve Rozen
+ (http://purl.com/STEVEROZEN/), and Helen Skaletsky
+ All rights reserved.
+ 
+       This file is part of primer3 software suite.
+   
+       This software suite is is free software;
+       you can redistribute it and/or modify it under the terms
+       of the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version.
+   
+       This software is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+   
+       You should have received a copy of the GNU General Public License
+       along with this software (file gpl-2.0.txt in the source
+       distribution); if not, write to the Free Software
+       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON A THEORY 
+ OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Randomized checks of the fast paths in thal.c against the plain
+   computation they replace.  Usage: thal_kernel_test [ <cases> ].
+   Prints one line per check and exits with a non-zero status if any
+   of them fails.  The random sequences are the same from run to run. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "thal.h"
+
+#define DEFAULT_CASES 4000
+#define MIN_LEN 15
+#define MAX_LEN 40
+
+static const char bases[] = "ACGT";
+
+static double
+uniform(double lo, double hi)
+{
+  return lo + (hi - lo) * (rand() / (RAND_MAX + 1.0));
+}
+
+static void
+random_seq(char *s, int len)
+{
+  int i;
+  for (i = 0; i < len; i++) s[i] = bases[rand() % 4];
+  s[len] = '\0';
+}
+
+/* Reverse complement of s in r with up to 'mutations' random bases
+   changed, so that s and r form a strong duplex. */
+static void
+mutated_rev_comp(const char *s, char *r, int mutations)
+{
+  int i, len = (int) strlen(s);
+  for (i = 0; i < len; i++) {
+    switch (s[len - 1 - i]) {
+    case 'A': r[i] = 'T'; break;
+    case 'C': r[i] = 'G'; break;
+    case 'G': r[i] = 'C'; break;
+    default:  r[i] = 'A'; break;
+    }
+  }
+  r[len] = '\0';
+  for (i = 0; i < mutations; i++) r[rand() % len] = bases[rand() % 4];
+}
+
+/* A random oligo pair: unrelated, or the second one a mutated reverse
+   complement of part of the first.  For hairpins s2 is s1 with a
+   mutated stem in it. */
+static void
+random_case(char *s1, char *s2, thal_alignment_type type)
+{
+  int len = MIN_LEN + rand() % (MAX_LEN - MIN_LEN + 1);
+  int stem, loop, start;
+  char stem_seq[MAX_LEN + 1], stem_rc[MAX_LEN + 1];
+
+  random_seq(s1, len);
+  if (type == thal_hairpin) {
+    if (rand() % 2) {
+      stem = 4 + rand() % 8;
+      loop = 3 + rand() % 6;
+      if (2 * stem + loop <= len) {
+        start = rand() % (len - 2 * stem - loop + 1);
+        memcpy(stem_seq, s1 + start, stem);
+        stem_seq[stem] = '\0';
+        mutated_rev_comp(stem_seq, stem_rc, rand() % 3);
+        memcpy(s1 + start + stem + loop, stem_rc, stem);
+      }
+    }
+    strcpy(s2, s1);
+  } else if (rand() % 2) {
+    random_seq(s2, MIN_LEN + rand() % (MAX_LEN - MIN_LEN + 1));
+  } else {
+    stem = 6 + rand() % (len - 5);
+    start = rand() % (len - stem + 1);
+    memcpy(stem_seq, s1 + start, stem);
+    stem_seq[stem] = '\0';
+    mutated_rev_comp(stem_seq, s2, rand() % 4);
+  }
+}
+
+static void
+random_args(thal_args *a, thal_alignment_type type)
+{
+  set_thal_oligo_default_args(a);
+  a->type = type;
+  a->mv = uniform(10.0, 100.0);
+  a->dv = (rand() % 2) ? uniform(0.0, 4.0) : 0.0;
+  a->dntp = (rand() % 2) ? uniform(0.0, 1.0) : 0.0;
+  a->dna_conc = uniform(25.0, 250.0);
+  a->dimer = (type != thal_hairpin);
+}
+
+static int
+report(const char *check, int ok)
+{
+  printf("%s...%s\n", check, ok ? "[OK]" : "[FAILED]");
+  return ok;
+}
+
+/* thal_may_exceed() must never answer 0 for a limit that the melting
+   temperature thal() finds is above.  Limits just below the Tm are
+   the ones a loose bound fails on; limits above it show how often the
+   bound saves the alignment. */
+static int
+check_bound(int cases)
+{
+  static const thal_alignment_type types[]
+    = { thal_any, thal_end1, thal_end2, thal_hairpin };
+  static const double below[] = { 5.0, 0.5, 0.01, 0.001 };
+  char s1[MAX_LEN + 1], s2[MAX_LEN + 1];
+  thal_args a;
+  thal_results o;
+  double limit;
+  int n, k, errors = 0, above = 0, skipped = 0;
+
+  for (n = 0; n < cases; n++) {
+    random_case(s1, s2, types[n % 4]);
+    random_args(&a, types[n % 4]);
+    thal((const unsigned char *) s1, (const unsigned char *) s2, &a, &o);
+    if (o.temp == THAL_ERROR_SCORE) {
+      fprintf(stderr, "thal() failed for %s %s: %s\n", s1, s2, o.msg);
+      errors++;
+      continue;
+    }
+    for (k = 0; k < 4; k++) {
+      limit = o.temp - below[k];
+      if (limit >= 0.0
+          && !thal_may_exceed((const unsigned char *) s1,
+                              (const unsigned char *) s2, &a, limit)) {
+        fprintf(stderr, "type %d, %s %s: Tm %f skipped at limit %f\n",
+                (int) a.type, s1, s2, o.temp, limit);
+        errors++;
+      }
+    }
+    limit = o.temp + uniform(0.0, 60.0);
+    above++;
+    if (!thal_may_exceed((const unsigned char *) s1,
+                         (const unsigned char *) s2, &a, limit))
+      skipped++;
+  }
+  printf("Bound skipped %d of %d alignments with the Tm below the limit\n",
+         skipped, above);
+  return report("Bound never skips an alignment above the limit",
+                errors == 0 && skipped > 0);
+}
+
+/* The dimer table filled by anti-diagonals and traced back with the
+   loop function template must give the same Tm, ends and structure as
+   the row by row fill and plain loop function of
+   thal_set_reference_kernels(), to the last bit.  Sequences up to THAL_MAX_ALIGN bases are used so
+   that the fill buffers kept between calls grow and are reused. */
+static int
+check_fill(int cases)
+{
+  static const thal_alignment_type types[] = { thal_any, thal_end1, thal_end2 };
+  char s1[THAL_MAX_ALIGN + 1], s2[THAL_MAX_ALIGN + 1];
+  thal_args a;
+  thal_results fast, ref;
+  int n, errors = 0, len;
+
+  for (n = 0; n < cases; n++) {
+    if (n % 4 == 3) {
+      len = 1 + rand() % THAL_MAX_ALIGN;
+      random_seq(s1, len);
+      random_seq(s2, 1 + rand() % THAL_MAX_ALIGN);
+    } else {
+      random_case(s1, s2, thal_any);
+    }
+    random_args(&a, types[n % 3]);
+    a.mode = THL_STRUCT;
+    thal_set_reference_kernels(0);
+    thal((const unsigned char *) s1, (const unsigned char *) s2, &a, &fast);
+    thal_set_reference_kernels(1);
+    thal((const unsigned char *) s1, (const unsigned char *) s2, &a, &ref);
+    if (memcmp(&fast.temp, &ref.temp, sizeof(double))
+        || fast.align_end_1 != ref.align_end_1
+        || fast.align_end_2 != ref.align_end_2
+        || (fast.sec_struct == NULL) != (ref.sec_struct == NULL)
+        || (fast.sec_struct && strcmp(fast.sec_struct, ref.sec_struct))) {
+      fprintf(stderr, "type %d, %s %s: Tm %.17g, reference %.17g\n",
+              (int) a.type, s1, s2, fast.temp, ref.temp);
+      errors++;
+    }
+    free(fast.sec_struct);
+    free(ref.sec_struct);
+  }
+  thal_set_reference_kernels(0);
+  return report("Dimer fill and traceback equal the reference kernels", errors == 0);
+}
+
+int main(int argc, char** argv)
+{
+  thal_results o;
+  int cases = DEFAULT_CASES, ok = 1;
+
+  if (argc > 2 || (argc == 2 && (cases = atoi(argv[1])) <= 0)) {
+    fprintf(stderr, "Usage: %s [ <cases> ]\n", argv[0]);
+    exit(-1);
+  }
+  if (thal_load_default_parameters(&o)) {
+    fprintf(stderr, "%s\n", o.msg);
+    exit(-1);
+  }
+  srand(1);
+
+  ok = check_bound(cases) && ok;
+  ok = check_fill(cases) && ok;
+
+  destroy_thal_structures();
+  return ok ? 0 : -1;
+}
@@ -0,0 +1,65 @@
+/*
+ Copyright (c) 1996,1997,1998,1999,2000,2001,2004,2006,2007,2008,2009
+ Whitehead Institute for Biomedical Research, Steve Rozen
+ (http://purl.com/STEVEROZEN/), and Helen Skaletsky
+ All rights reserved.
+ 
+       This file is part of primer3 software suite.
+   
+       This software suite is is free software;
+       you can redistribute it and/or modify it under the terms
+       of the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version.
+   
+       This software is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+   
+       You should have received a copy of the GNU General Public License
+       along with this software (file gpl-2.0.txt in the source
+       distribution); if not, write to the Free Software
+       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON A THEORY 
+ OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Build helper: read the thermodynamic parameter files in the given
+   directory and write them out as the C tables that thal.c compiles
+   in as its built-in parameter set (thal_default_params.h). */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "thal.h"
+
+int main(int argc, char** argv)
+{
+  thal_results o;
+
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <parameter directory> <output header>\n", argv[0]);
+    exit(-1);
+  }
+  if (get_thermodynamic_values(argv[1], &o)) {
+    fprintf(stderr, "%s\n", o.msg);
+    exit(-1);
+  }
+  if (thal_write_parameter_tables(argv[2])) {
+    fprintf(stderr, "Unable to write %s\n", argv[2]);
+    exit(-1);
+  }
+  destroy_thal_structures();
+  return 0;
+}
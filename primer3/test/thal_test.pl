@@ -172,6 +172,12 @@ sub main() {
             "-r", "thal_long_input", 'thal_long_temp_output',
             "thal_long_temp_output.tmp");
 
+    # 2400 random alignments of all four types, with and without -r;
+    # the output is that of thal() before its loop kernels became templates
+    runtest('Random alignments + loop kernels',
+            "", "thal_kernel_input", 'thal_kernel_output',
+            "thal_kernel_output.tmp");
+
 
     # ================================================== 
     # If we were running under valgrind to look for memory-related
@@ -8,6 +8,7 @@
 #define drand48() ((double)rand() / RAND_MAX)
 #endif
 
+#include "bedidx.h"
 #include "ksort.h"
 KSORT_INIT_GENERIC(uint64_t)
 
@@ -70,10 +71,10 @@ int bed_overlap_core(const bed_reglist_t *p, int beg, int end)
 {
 	int i, min_off;
 	if (p->n == 0) return 0;
-	min_off = (beg>>LIDX_SHIFT >= p->n)? p->idx[p->n-1] : p->idx[beg>>LIDX_SHIFT];
+	min_off = (beg>>LIDX_SHIFT >= p->m)? p->idx[p->m-1] : p->idx[beg>>LIDX_SHIFT];
 	if (min_off < 0) { // TODO: this block can be improved, but speed should not matter too much here
 		int n = beg>>LIDX_SHIFT;
-		if (n > p->n) n = p->n;
+		if (n > p->m) n = p->m;
 		for (i = n - 1; i >= 0; --i)
 			if (p->idx[i] >= 0) break;
 		min_off = i >= 0? p->idx[i] : 0;
@@ -96,6 +97,74 @@ int bed_overlap(const void *_h, const char *chr, int beg, int end)
 	return bed_overlap_core(&kh_val(h, k), beg, end);
 }
 
+void bed_unify(void *_h, int merge)
+{
+	reghash_t *h = (reghash_t*)_h;
+	khint_t k;
+	int i, j;
+	for (k = 0; k < kh_end(h); ++k) {
+		if (kh_exist(h, k)) {
+			bed_reglist_t *p = &kh_val(h, k);
+			if (p->n == 0) continue;
+			for (i = 1, j = 0; i < p->n; ++i) { // the list is sorted by start, then end
+				if (merge && (int)(p->a[i]>>32) <= (int32_t)p->a[j]) {
+					if ((uint32_t)p->a[i] > (uint32_t)p->a[j])
+						p->a[j] = (p->a[j]>>32<<32) | (uint32_t)p->a[i];
+				} else if (p->a[i] != p->a[j]) p->a[++j] = p->a[i];
+			}
+			p->n = j + 1;
+			free(p->idx);
+			p->idx = bed_index_core(p->n, p->a, &p->m);
+		}
+	}
+}
+
+int bed_n_intervals(const void *_h)
+{
+	const reghash_t *h = (const reghash_t*)_h;
+	khint_t k;
+	int n = 0;
+	for (k = 0; k < kh_end(h); ++k)
+		if (kh_exist(h, k)) n += kh_val(h, k).n;
+	return n;
+}
+
+const uint64_t *bed_intervals(const void *_h, const char *chr, int *n)
+{
+	const reghash_t *h = (const reghash_t*)_h;
+	khint_t k;
+	*n = 0;
+	if (!h) return 0;
+	k = kh_get(reg, h, chr);
+	if (k == kh_end(h) || kh_val(h, k).n == 0) return 0;
+	*n = kh_val(h, k).n;
+	return kh_val(h, k).a;
+}
+
+void *bed_init(void)
+{
+	return kh_init(reg);
+}
+
+void bed_insert(void *_h, const char *chr, int beg, int end)
+{
+	reghash_t *h = (reghash_t*)_h;
+	bed_reglist_t *p;
+	khint_t k = kh_get(reg, h, chr);
+	if (k == kh_end(h)) { // absent from the hash table
+		int ret;
+		char *s = strdup(chr);
+		k = kh_put(reg, h, s, &ret);
+		memset(&kh_val(h, k), 0, sizeof(bed_reglist_t));
+	}
+	p = &kh_val(h, k);
+	if (p->n == p->m) {
+		p->m = p->m? p->m<<1 : 4;
+		p->a = realloc(p->a, p->m * 8);
+	}
+	p->a[p->n++] = (uint64_t)beg<<32 | end;
+}
+
 void *bed_read(const char *fn)
 {
 	reghash_t *h = kh_init(reg);
@@ -0,0 +1,78 @@
+#ifndef BEDIDX_H
+#define BEDIDX_H
+
+#include <stdint.h>
+
+/*!
+  @header
+
+  Read BED and position list files into per-sequence lists of sorted,
+  indexed intervals. Intervals are zero-based and half open; each is
+  stored as (uint64_t)beg<<32 | end.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/*!
+	  @abstract   Read and index a BED or position list file.
+	  @param  fn  File name, possibly gzipped; "-" for stdin
+	  @return     Opaque interval index; null on failure
+	 */
+	void *bed_read(const char *fn);
+
+	/*!
+	  @abstract   An empty index to be filled with bed_insert().
+	 */
+	void *bed_init(void);
+
+	/*!
+	  @abstract   Add the interval chr:[beg,end). Call bed_index() once all
+	  intervals are added and before querying.
+	 */
+	void bed_insert(void *h, const char *chr, int beg, int end);
+
+	/*!
+	  @abstract   Sort and index the intervals of every sequence.
+	 */
+	void bed_index(void *h);
+
+	/*!
+	  @abstract   Free an index returned by bed_read() or bed_init().
+	 */
+	void bed_destroy(void *h);
+
+	/*!
+	  @abstract   Test if chr:[beg,end) overlaps an interval.
+	  @return     1 if it does; 0 otherwise
+	 */
+	int bed_overlap(const void *h, const char *chr, int beg, int end);
+
+	/*!
+	  @abstract     Remove duplicate intervals and reindex.
+	  @param  h     Index returned by bed_read()
+	  @param  merge If non-zero, also merge overlapping and book-ended
+	                intervals into one
+	 */
+	void bed_unify(void *h, int merge);
+
+	/*!
+	  @abstract   The number of intervals over all sequences.
+	 */
+	int bed_n_intervals(const void *h);
+
+	/*!
+	  @abstract   The sorted intervals of one sequence.
+	  @param  chr Sequence name
+	  @param  n   Set to the number of intervals
+	  @return     Intervals as (uint64_t)beg<<32 | end, sorted by start
+	              then end; null if the sequence has none
+	 */
+	const uint64_t *bed_intervals(const void *h, const char *chr, int *n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -33,6 +33,7 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <pthread.h>
 #include "bgzf.h"
 
 #include "khash.h"
@@ -147,6 +148,8 @@ static BGZF *bgzf_read_init()
     fp->compressed_block = malloc(MAX_BLOCK_SIZE);
 	fp->cache_size = 0;
 	fp->cache = kh_init(cache);
+	fp->cache_lock = malloc(sizeof(pthread_mutex_t));
+	pthread_mutex_init((pthread_mutex_t*)fp->cache_lock, 0);
 	return fp;
 }
 
@@ -362,40 +365,51 @@ deflate_block(BGZF* fp, int block_length)
     return compressed_length;
 }
 
+// Inflate a compressed block into out; -1 if inflateInit2 fails, -2 if inflate does
 static
 int
-inflate_block(BGZF* fp, int block_length)
+inflate_buffer(void* compressed, int block_length, void* out, int out_size)
 {
-    // Inflate the block in fp->compressed_block into fp->uncompressed_block
-
     z_stream zs;
 	int status;
     zs.zalloc = NULL;
     zs.zfree = NULL;
-    zs.next_in = fp->compressed_block + 18;
+    zs.next_in = (Bytef*)compressed + 18;
     zs.avail_in = block_length - 16;
-    zs.next_out = fp->uncompressed_block;
-    zs.avail_out = fp->uncompressed_block_size;
+    zs.next_out = out;
+    zs.avail_out = out_size;
 
     status = inflateInit2(&zs, GZIP_WINDOW_BITS);
     if (status != Z_OK) {
-        report_error(fp, "inflate init failed");
         return -1;
     }
     status = inflate(&zs, Z_FINISH);
     if (status != Z_STREAM_END) {
         inflateEnd(&zs);
-        report_error(fp, "inflate failed");
-        return -1;
+        return -2;
     }
     status = inflateEnd(&zs);
     if (status != Z_OK) {
-        report_error(fp, "inflate failed");
-        return -1;
+        return -2;
     }
     return zs.total_out;
 }
 
+static
+int
+inflate_block(BGZF* fp, int block_length)
+{
+    // Inflate the block in fp->compressed_block into fp->uncompressed_block
+
+    int count = inflate_buffer(fp->compressed_block, block_length,
+                               fp->uncompressed_block, fp->uncompressed_block_size);
+    if (count < 0) {
+        report_error(fp, count == -1? "inflate init failed" : "inflate failed");
+        return -1;
+    }
+    return count;
+}
+
 static
 int
 check_header(const bgzf_byte_t* header)
@@ -418,6 +432,8 @@ static void free_cache(BGZF *fp)
 	for (k = kh_begin(h); k < kh_end(h); ++k)
 		if (kh_exist(h, k)) free(kh_val(h, k).block);
 	kh_destroy(cache, h);
+	pthread_mutex_destroy((pthread_mutex_t*)fp->cache_lock);
+	free(fp->cache_lock);
 }
 
 static int load_block_from_cache(BGZF *fp, int64_t block_address)
@@ -440,13 +456,18 @@ static int load_block_from_cache(BGZF *fp, int64_t block_address)
 	return p->size;
 }
 
-static void cache_block(BGZF *fp, int size)
+/* Put a decompressed block of MAX_BLOCK_SIZE bytes in the cache, which
+ * then owns it; it is freed if the cache is off or has the block already. */
+static void cache_insert(BGZF *fp, int64_t block_address, int length, int64_t end_offset, void *block)
 {
 	int ret;
 	khint_t k;
 	cache_t *p;
 	khash_t(cache) *h = (khash_t(cache)*)fp->cache;
-	if (MAX_BLOCK_SIZE >= fp->cache_size) return;
+	if (MAX_BLOCK_SIZE >= fp->cache_size) {
+		free(block);
+		return;
+	}
 	if ((kh_size(h) + 1) * MAX_BLOCK_SIZE > fp->cache_size) {
 		/* A better way would be to remove the oldest block in the
 		 * cache, but here we remove a random one for simplicity. This
@@ -458,13 +479,24 @@ static void cache_block(BGZF *fp, int size)
 			kh_del(cache, h, k);
 		}
 	}
-	k = kh_put(cache, h, fp->block_address, &ret);
-	if (ret == 0) return; // if this happens, a bug!
+	k = kh_put(cache, h, block_address, &ret);
+	if (ret == 0) { // only bgzf_read_block_at() can get here, from another thread
+		free(block);
+		return;
+	}
 	p = &kh_val(h, k);
-	p->size = fp->block_length;
-	p->end_offset = fp->block_address + size;
-	p->block = malloc(MAX_BLOCK_SIZE);
-	memcpy(kh_val(h, k).block, fp->uncompressed_block, MAX_BLOCK_SIZE);
+	p->size = length;
+	p->end_offset = end_offset;
+	p->block = block;
+}
+
+static void cache_block(BGZF *fp, int size)
+{
+	void *block;
+	if (MAX_BLOCK_SIZE >= fp->cache_size) return;
+	block = malloc(MAX_BLOCK_SIZE);
+	memcpy(block, fp->uncompressed_block, MAX_BLOCK_SIZE);
+	cache_insert(fp, fp->block_address, fp->block_length, fp->block_address + size, block);
 }
 
 int
@@ -520,6 +552,71 @@ bgzf_read_block(BGZF* fp)
     return 0;
 }
 
+static int pread_all(int fd, void *buf, int n, int64_t offset)
+{
+	int got = 0;
+	while (got < n) {
+		ssize_t ret = pread(fd, (char*)buf + got, n - got, offset + got);
+		if (ret <= 0) break;
+		got += ret;
+	}
+	return got;
+}
+
+// copy up to length bytes from offset 'from' of a decompressed block
+static int copy_from_block(const void *block, int size, int from, void *data, int length)
+{
+	int n = size - from < length? size - from : length;
+	if (n <= 0) return 0;
+	memcpy(data, (const uint8_t*)block + from, n);
+	return n;
+}
+
+int
+bgzf_read_block_at(BGZF* fp, int64_t block_address, int from, void* data, int length)
+{
+	bgzf_byte_t header[BLOCK_HEADER_LENGTH];
+	void *compressed, *block;
+	khint_t k;
+	khash_t(cache) *h = (khash_t(cache)*)fp->cache;
+	int fd, block_length, count = -1;
+
+	if (fp->open_mode != 'r' || from < 0 || length < 0) return -1;
+	pthread_mutex_lock((pthread_mutex_t*)fp->cache_lock);
+	k = kh_get(cache, h, block_address);
+	if (k != kh_end(h)) count = copy_from_block(kh_val(h, k).block, kh_val(h, k).size, from, data, length);
+	pthread_mutex_unlock((pthread_mutex_t*)fp->cache_lock);
+	if (count >= 0) return count;
+
+	// not cached: read and inflate without holding the lock
+#ifdef _USE_KNETFILE
+	fd = fp->x.fpr->type == KNF_TYPE_LOCAL? knet_fileno(fp->x.fpr) : -1;
+#else
+	fd = fileno(fp->file);
+#endif
+	if (fd < 0 || pread_all(fd, header, BLOCK_HEADER_LENGTH, block_address) != BLOCK_HEADER_LENGTH
+		|| !check_header(header)) return -1;
+	block_length = unpackInt16((uint8_t*)&header[16]) + 1;
+	compressed = malloc(MAX_BLOCK_SIZE);
+	block = malloc(MAX_BLOCK_SIZE);
+	if (compressed && block && block_length > BLOCK_HEADER_LENGTH) {
+		memcpy(compressed, header, BLOCK_HEADER_LENGTH);
+		if (pread_all(fd, (bgzf_byte_t*)compressed + BLOCK_HEADER_LENGTH, block_length - BLOCK_HEADER_LENGTH,
+					  block_address + BLOCK_HEADER_LENGTH) == block_length - BLOCK_HEADER_LENGTH)
+			count = inflate_buffer(compressed, block_length, block, MAX_BLOCK_SIZE);
+	}
+	free(compressed);
+	if (count < 0) {
+		free(block);
+		return -1;
+	}
+	length = copy_from_block(block, count, from, data, length);
+	pthread_mutex_lock((pthread_mutex_t*)fp->cache_lock);
+	cache_insert(fp, block_address, count, block_address + block_length, block);
+	pthread_mutex_unlock((pthread_mutex_t*)fp->cache_lock);
+	return length;
+}
+
 int
 bgzf_read(BGZF* fp, void* data, int length)
 {
@@ -55,6 +55,7 @@ typedef struct {
 	int cache_size;
     const char* error;
 	void *cache; // a pointer to a hash table
+	void *cache_lock; // a pthread mutex guarding the cache in bgzf_read_block_at()
 } BGZF;
 
 #ifdef __cplusplus
@@ -126,6 +127,19 @@ void bgzf_set_cache_size(BGZF *fp, int cache_size);
 
 int bgzf_check_EOF(BGZF *fp);
 int bgzf_read_block(BGZF* fp);
+
+/*
+ * Copy up to length bytes, from offset 'from' of the uncompressed block
+ * that starts at the compressed offset block_address, to data. The block
+ * is taken from the cache or read with pread() and put in the cache, like
+ * bgzf_read_block() does, but the file position and current block of fp
+ * are neither used nor moved. Several threads may call this at once on a
+ * handle opened for reading from a local file, as long as nothing else
+ * uses the handle meanwhile.
+ * Returns the number of bytes copied, or -1 on error.
+ */
+int bgzf_read_block_at(BGZF* fp, int64_t block_address, int from, void* data, int length);
+
 int bgzf_flush(BGZF* fp);
 int bgzf_flush_try(BGZF *fp, int size);
 int bgzf_check_bgzf(const char *fn);
@@ -3,15 +3,22 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "faidx.h"
 #include "khash.h"
+#include "bgzf.h"
 
 typedef struct {
 	int32_t line_len, line_blen;
 	int64_t len;
 	uint64_t offset;
 } faidx1_t;
-KHASH_MAP_INIT_STR(s, faidx1_t)
+KHASH_MAP_INIT_STR(s, int)
 
 #ifndef _NO_RAZF
 #include "razf.h"
@@ -34,34 +41,79 @@ extern int fseeko(FILE *stream, off_t offset, int whence);
 #include "knetfile.h"
 #endif
 
+// BGZF blocks kept decompressed while fetching; one region batch touches a few blocks per target
+#define FAI_BGZF_CACHE_SIZE (16 * 1024 * 1024)
+
+/* Fetches read with pread() and keep no file position, so that any
+ * number of threads can fetch from one faidx_t. BGZF blocks are read
+ * with bgzf_read_block_at(), which does the same and locks the block
+ * cache of the handle itself. Only the stream readers (the RAZF reader
+ * of compressed .rz or remote files, and the reference reads of
+ * fai_set_reference_reads()) are guarded by this lock. */
+typedef struct {
+	pthread_mutex_t lock;
+} fai_io_t;
+
 struct __faidx_t {
-	RAZF *rz;
+	RAZF *rz; // for inputs that cannot be read with pread(), and the reference reads of plain ones
+	int fd; // plain FASTA, read with pread(); -1 if not used
+	BGZF *bgzf; // BGZF FASTA, read with bgzf_read_block_at()
+	int n_gzi; // number of blocks in the .gzi index, the first one at (0, 0)
+	uint64_t *gzi; // compressed and uncompressed offset of each block start
+	fai_io_t *io;
+	int reference; // faidx_fetch_seq() reads a character at a time from the stream readers
 	int n, m;
 	char **name;
-	khash_t(s) *hash;
+	faidx1_t *seq; // indexed by the contig id, in .fai order
+	khash_t(s) *hash; // name -> contig id
 };
 
 #ifndef kroundup32
 #define kroundup32(x) (--(x), (x)|=(x)>>1, (x)|=(x)>>2, (x)|=(x)>>4, (x)|=(x)>>8, (x)|=(x)>>16, ++(x))
 #endif
 
-static inline void fai_insert_index(faidx_t *idx, const char *name, int len, int line_len, int line_blen, uint64_t offset)
+static inline void fai_insert_index(faidx_t *idx, const char *name, int64_t len, int line_len, int line_blen, uint64_t offset)
 {
 	khint_t k;
 	int ret;
-	faidx1_t t;
+	faidx1_t *t;
 	if (idx->n == idx->m) {
 		idx->m = idx->m? idx->m<<1 : 16;
 		idx->name = (char**)realloc(idx->name, sizeof(void*) * idx->m);
+		idx->seq = (faidx1_t*)realloc(idx->seq, sizeof(faidx1_t) * idx->m);
 	}
 	idx->name[idx->n] = strdup(name);
 	k = kh_put(s, idx->hash, idx->name[idx->n], &ret);
-	t.len = len; t.line_len = line_len; t.line_blen = line_blen; t.offset = offset;
-	kh_value(idx->hash, k) = t;
+	kh_value(idx->hash, k) = idx->n;
+	t = &idx->seq[idx->n];
+	t->len = len; t->line_len = line_len; t->line_blen = line_blen; t->offset = offset;
 	++idx->n;
 }
 
-faidx_t *fai_build_core(RAZF *rz)
+// sequential input for building the index; offsets in the .fai are uncompressed ones
+typedef struct {
+	RAZF *rz;
+	BGZF *bgzf;
+	int64_t upos;
+} fai_in_t;
+
+static inline int fai_in_getc(fai_in_t *in, char *c)
+{
+	if (in->bgzf) {
+		int ret = bgzf_read(in->bgzf, c, 1);
+		if (ret <= 0) return 0;
+		++in->upos;
+		return ret;
+	}
+	return razf_read(in->rz, c, 1);
+}
+
+static inline int64_t fai_in_tell(fai_in_t *in)
+{
+	return in->bgzf? in->upos : razf_tell(in->rz);
+}
+
+static faidx_t *fai_build_core_in(fai_in_t *in)
 {
 	char c, *name;
 	int l_name, m_name, ret;
@@ -72,13 +124,14 @@ faidx_t *fai_build_core(RAZF *rz)
 	int64_t len;
 
 	idx = (faidx_t*)calloc(1, sizeof(faidx_t));
+	idx->fd = -1;
 	idx->hash = kh_init(s);
 	name = 0; l_name = m_name = 0;
 	len = line_len = line_blen = -1; state = 0; l1 = l2 = -1; offset = 0;
-	while (razf_read(rz, &c, 1)) {
+	while (fai_in_getc(in, &c)) {
 		if (c == '\n') { // an empty line
 			if (state == 1) {
-				offset = razf_tell(rz);
+				offset = fai_in_tell(in);
 				continue;
 			} else if ((state == 0 && len < 0) || state == 2) continue;
 		}
@@ -86,7 +139,7 @@ faidx_t *fai_build_core(RAZF *rz)
 			if (len >= 0)
 				fai_insert_index(idx, name, len, line_len, line_blen, offset);
 			l_name = 0;
-			while ((ret = razf_read(rz, &c, 1)) != 0 && !isspace(c)) {
+			while ((ret = fai_in_getc(in, &c)) != 0 && !isspace(c)) {
 				if (m_name < l_name + 2) {
 					m_name = l_name + 2;
 					kroundup32(m_name);
@@ -100,9 +153,9 @@ faidx_t *fai_build_core(RAZF *rz)
 				free(name); fai_destroy(idx);
 				return 0;
 			}
-			if (c != '\n') while (razf_read(rz, &c, 1) && c != '\n');
+			if (c != '\n') while (fai_in_getc(in, &c) && c != '\n');
 			state = 1; len = 0;
-			offset = razf_tell(rz);
+			offset = fai_in_tell(in);
 		} else {
 			if (state == 3) {
 				fprintf(stderr, "[fai_build_core] inlined empty line is not allowed in sequence '%s'.\n", name);
@@ -114,7 +167,117 @@ faidx_t *fai_build_core(RAZF *rz)
 			do {
 				++l1;
 				if (isgraph(c)) ++l2;
-			} while ((ret = razf_read(rz, &c, 1)) && c != '\n');
+			} while ((ret = fai_in_getc(in, &c)) && c != '\n');
+			if (state == 3 && l2) {
+				fprintf(stderr, "[fai_build_core] different line length in sequence '%s'.\n", name);
+				free(name); fai_destroy(idx);
+				return 0;
+			}
+			++l1; len += l2;
+			if (state == 1) line_len = l1, line_blen = l2, state = 0;
+			else if (state == 0) {
+				if (l1 != line_len || l2 != line_blen) state = 2;
+			}
+		}
+	}
+	fai_insert_index(idx, name, len, line_len, line_blen, offset);
+	free(name);
+	return idx;
+}
+
+faidx_t *fai_build_core(RAZF *rz)
+{
+	fai_in_t in;
+	in.rz = rz; in.bgzf = 0; in.upos = 0;
+	return fai_build_core_in(&in);
+}
+
+/* Plain FASTA files are indexed from a memory mapping. The file is cut
+ * at record starts ("\n>") into chunks that are indexed by separate
+ * threads with the same rules as fai_build_core(), and the chunk
+ * indices are merged in file order. */
+#define FAI_BUILD_MAX_THREADS 16
+#ifndef FAI_BUILD_MIN_CHUNK
+#define FAI_BUILD_MIN_CHUNK (8 * 1024 * 1024)
+#endif
+#define FAI_BUILD_PROGRESS_SIZE (256 * 1024 * 1024) // report progress for files at least this big
+
+typedef struct {
+	const char *beg, *end; // the chunk
+	const char *file; // the start of the mapping; offsets are relative to it
+	faidx_t *idx; // the result, null on error
+} fai_chunk_t;
+
+// the number of printable, non-space characters, as isgraph() in the C locale
+static inline int fai_count_graph(const char *p, int n)
+{
+	int i, l = 0;
+	for (i = 0; i < n; ++i) // plain loop so that it can be vectorized
+		l += (unsigned char)(p[i] - 33) < 94;
+	return l;
+}
+
+static faidx_t *fai_build_core_mem(const char *p, const char *end, const char *file)
+{
+	char c, *name;
+	const char *q;
+	int l_name, m_name;
+	int line_len, line_blen, state;
+	int l1, l2;
+	faidx_t *idx;
+	uint64_t offset;
+	int64_t len;
+
+	idx = (faidx_t*)calloc(1, sizeof(faidx_t));
+	idx->fd = -1;
+	idx->hash = kh_init(s);
+	name = 0; l_name = m_name = 0;
+	len = line_len = line_blen = -1; state = 0; l1 = l2 = -1; offset = 0;
+	while (p < end) {
+		c = *p++;
+		if (c == '\n') { // an empty line
+			if (state == 1) {
+				offset = p - file;
+				continue;
+			} else if ((state == 0 && len < 0) || state == 2) continue;
+		}
+		if (c == '>') { // fasta header
+			if (len >= 0)
+				fai_insert_index(idx, name, len, line_len, line_blen, offset);
+			for (q = p; q < end && !isspace(*q); ++q);
+			l_name = q - p;
+			if (m_name < l_name + 2) {
+				m_name = l_name + 2;
+				kroundup32(m_name);
+				name = (char*)realloc(name, m_name);
+			}
+			memcpy(name, p, l_name);
+			name[l_name] = '\0';
+			p = q;
+			if (p == end) {
+				fprintf(stderr, "[fai_build_core] the last entry has no sequence\n");
+				free(name); fai_destroy(idx);
+				return 0;
+			}
+			if ((c = *p++) != '\n') {
+				q = (const char*)memchr(p, '\n', end - p);
+				p = q? q + 1 : end;
+			}
+			state = 1; len = 0;
+			offset = p - file;
+		} else {
+			if (state == 3) {
+				fprintf(stderr, "[fai_build_core] inlined empty line is not allowed in sequence '%s'.\n", name);
+				free(name); fai_destroy(idx);
+				return 0;
+			}
+			if (state == 2) state = 3;
+			// c and the rest of its line, up to and including the newline
+			q = (const char*)memchr(p, '\n', end - p);
+			if (q == 0) q = end;
+			l1 = 1 + (q - p);
+			l2 = (isgraph(c) != 0) + fai_count_graph(p, q - p);
+			p = q < end? q + 1 : end;
 			if (state == 3 && l2) {
 				fprintf(stderr, "[fai_build_core] different line length in sequence '%s'.\n", name);
 				free(name); fai_destroy(idx);
@@ -132,18 +295,97 @@ faidx_t *fai_build_core(RAZF *rz)
 	return idx;
 }
 
+static void *fai_build_chunk(void *data)
+{
+	fai_chunk_t *chunk = (fai_chunk_t*)data;
+	chunk->idx = fai_build_core_mem(chunk->beg, chunk->end, chunk->file);
+	return 0;
+}
+
+/* The first record start at or after p: a '>' opening a line. A '>'
+ * right after an empty line is skipped, as fai_build_core() reads the
+ * empty line and the next one as a single line there. */
+static const char *fai_next_record(const char *file, const char *p, const char *end)
+{
+	if (p < file + 2) p = file + 2;
+	while (p < end && (p = (const char*)memchr(p, '>', end - p)) != 0) {
+		if (p[-1] == '\n' && p[-2] != '\n') return p;
+		++p;
+	}
+	return end;
+}
+
+// index a plain FASTA file through a memory mapping; returns null if it could not be mapped or indexed
+static faidx_t *fai_build_mmap(const char *fn, int *mapped)
+{
+	fai_chunk_t chunk[FAI_BUILD_MAX_THREADS];
+	pthread_t tid[FAI_BUILD_MAX_THREADS];
+	int started[FAI_BUILD_MAX_THREADS];
+	int fd, i, j, n_chunks, failed = 0;
+	long n_cpus;
+	struct stat st;
+	const char *file;
+	faidx_t *fai = 0;
+
+	*mapped = 0;
+	if ((fd = open(fn, O_RDONLY)) < 0) return 0;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) { close(fd); return 0; }
+	file = (const char*)mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (file == MAP_FAILED) return 0;
+	*mapped = 1;
+	madvise((void*)file, st.st_size, MADV_SEQUENTIAL);
+
+	n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	n_chunks = n_cpus < 1? 1 : n_cpus > FAI_BUILD_MAX_THREADS? FAI_BUILD_MAX_THREADS : (int)n_cpus;
+	if ((int64_t)n_chunks * FAI_BUILD_MIN_CHUNK > st.st_size)
+		n_chunks = st.st_size / FAI_BUILD_MIN_CHUNK > 0? st.st_size / FAI_BUILD_MIN_CHUNK : 1;
+
+	// cut at the first record start after each even split point, dropping empty chunks
+	for (i = j = 0; i < n_chunks; ++i) {
+		chunk[j].file = file;
+		chunk[j].beg = j? chunk[j-1].end : file;
+		chunk[j].end = i < n_chunks - 1? fai_next_record(file, file + st.st_size / n_chunks * (i + 1), file + st.st_size) : file + st.st_size;
+		if (chunk[j].end > chunk[j].beg) ++j;
+	}
+	n_chunks = j;
+
+	for (i = 1; i < n_chunks; ++i)
+		started[i] = pthread_create(&tid[i], 0, fai_build_chunk, &chunk[i]) == 0;
+	fai_build_chunk(&chunk[0]);
+	for (i = 0; i < n_chunks; ++i) {
+		if (i > 0) {
+			if (started[i]) pthread_join(tid[i], 0);
+			else fai_build_chunk(&chunk[i]);
+		}
+		if (chunk[i].idx == 0) failed = 1;
+		if (st.st_size >= FAI_BUILD_PROGRESS_SIZE)
+			fprintf(stderr, "[fai_build] %d%% of %s indexed\n", (int)(100.0 * (chunk[i].end - file) / st.st_size), fn);
+	}
+	munmap((void*)file, st.st_size);
+
+	if (!failed) {
+		fai = chunk[0].idx; chunk[0].idx = 0;
+		for (i = 1; i < n_chunks; ++i)
+			for (j = 0; j < chunk[i].idx->n; ++j) {
+				faidx1_t *x = &chunk[i].idx->seq[j];
+				fai_insert_index(fai, chunk[i].idx->name[j], x->len, x->line_len, x->line_blen, x->offset);
+			}
+	}
+	for (i = 0; i < n_chunks; ++i)
+		if (chunk[i].idx) fai_destroy(chunk[i].idx);
+	return fai;
+}
+
 void fai_save(const faidx_t *fai, FILE *fp)
 {
-	khint_t k;
 	int i;
 	for (i = 0; i < fai->n; ++i) {
-		faidx1_t x;
-		k = kh_get(s, fai->hash, fai->name[i]);
-		x = kh_value(fai->hash, k);
+		faidx1_t x = fai->seq[i];
 #ifdef _WIN32
-		fprintf(fp, "%s\t%d\t%ld\t%d\t%d\n", fai->name[i], (int)x.len, (long)x.offset, (int)x.line_blen, (int)x.line_len);
+		fprintf(fp, "%s\t%ld\t%ld\t%d\t%d\n", fai->name[i], (long)x.len, (long)x.offset, (int)x.line_blen, (int)x.line_len);
 #else
-		fprintf(fp, "%s\t%d\t%lld\t%d\t%d\n", fai->name[i], (int)x.len, (long long)x.offset, (int)x.line_blen, (int)x.line_len);
+		fprintf(fp, "%s\t%lld\t%lld\t%d\t%d\n", fai->name[i], (long long)x.len, (long long)x.offset, (int)x.line_blen, (int)x.line_len);
 #endif
 	}
 }
@@ -152,23 +394,20 @@ faidx_t *fai_read(FILE *fp)
 {
 	faidx_t *fai;
 	char *buf, *p;
-	int len, line_len, line_blen;
-#ifdef _WIN32
-	long offset;
-#else
-	long long offset;
-#endif
+	int line_len, line_blen;
+	int64_t len, offset;
 	fai = (faidx_t*)calloc(1, sizeof(faidx_t));
+	fai->fd = -1;
 	fai->hash = kh_init(s);
 	buf = (char*)calloc(0x10000, 1);
 	while (!feof(fp) && fgets(buf, 0x10000, fp)) {
 		for (p = buf; *p && isgraph(*p); ++p);
 		*p = 0; ++p;
-#ifdef _WIN32
-		sscanf(p, "%d%ld%d%d", &len, &offset, &line_blen, &line_len);
-#else
-		sscanf(p, "%d%lld%d%d", &len, &offset, &line_blen, &line_len);
-#endif
+		// the four columns are plain decimal integers; strtol() is much cheaper than sscanf()
+		len = strtoll(p, &p, 10);
+		offset = strtoll(p, &p, 10);
+		line_blen = strtol(p, &p, 10);
+		line_len = strtol(p, &p, 10);
 		fai_insert_index(fai, buf, len, line_len, line_blen, offset);
 	}
 	free(buf);
@@ -180,11 +419,80 @@ void fai_destroy(faidx_t *fai)
 	int i;
 	for (i = 0; i < fai->n; ++i) free(fai->name[i]);
 	free(fai->name);
+	free(fai->seq);
+	free(fai->gzi);
 	kh_destroy(s, fai->hash);
 	if (fai->rz) razf_close(fai->rz);
+	if (fai->fd >= 0) close(fai->fd);
+	if (fai->bgzf) bgzf_close(fai->bgzf);
+	if (fai->io) {
+		pthread_mutex_destroy(&fai->io->lock);
+		free(fai->io);
+	}
 	free(fai);
 }
 
+/* The .gzi index, as written by bgzip -i: the number of blocks after the
+ * first, then for each of them the compressed and uncompressed offset of
+ * its start, all as little-endian 64-bit integers. */
+static int fai_gzi_build(const char *fn)
+{
+	BGZF *fp;
+	FILE *out;
+	char *str;
+	uint64_t n = 0, m = 0, *offs = 0, uoff = 0;
+	int ret = 0;
+
+	if ((fp = bgzf_open(fn, "r")) == 0) return -1;
+	for (;;) {
+		if (bgzf_read_block(fp) != 0) { ret = -1; break; }
+		if (fp->block_length == 0) break;
+		if (n == m) {
+			m = m? m<<1 : 1024;
+			offs = (uint64_t*)realloc(offs, m * 2 * sizeof(uint64_t));
+		}
+		offs[2*n] = fp->block_address; offs[2*n+1] = uoff;
+		uoff += fp->block_length;
+		++n;
+	}
+	bgzf_close(fp);
+	str = (char*)calloc(strlen(fn) + 5, 1);
+	sprintf(str, "%s.gzi", fn);
+	if (ret == 0 && (out = fopen(str, "wb")) != 0) {
+		uint64_t n_rest = n? n - 1 : 0; // the first block at (0, 0) is implied
+		if (fwrite(&n_rest, sizeof(n_rest), 1, out) != 1
+			|| (n_rest && fwrite(offs + 2, 2 * sizeof(uint64_t), n_rest, out) != n_rest)) ret = -1;
+		if (fclose(out) != 0) ret = -1;
+	} else ret = -1;
+	free(str); free(offs);
+	return ret;
+}
+
+static int fai_gzi_load(faidx_t *fai, const char *fn)
+{
+	FILE *fp;
+	char *str;
+	uint64_t n;
+	str = (char*)calloc(strlen(fn) + 5, 1);
+	sprintf(str, "%s.gzi", fn);
+	fp = fopen(str, "rb");
+	if (fp == 0) {
+		fprintf(stderr, "[fai_load] build BGZF index.\n");
+		fai_gzi_build(fn);
+		fp = fopen(str, "rb");
+	}
+	free(str);
+	if (fp == 0) return -1;
+	if (fread(&n, sizeof(n), 1, fp) != 1 || n > INT32_MAX - 1) { fclose(fp); return -1; }
+	fai->gzi = (uint64_t*)calloc(2 * (n + 1), sizeof(uint64_t));
+	if (fai->gzi == 0 || fread(fai->gzi + 2, 2 * sizeof(uint64_t), n, fp) != n) {
+		fclose(fp); return -1;
+	}
+	fclose(fp);
+	fai->n_gzi = n + 1;
+	return 0;
+}
+
 int fai_build(const char *fn)
 {
 	char *str;
@@ -193,14 +501,42 @@ int fai_build(const char *fn)
 	faidx_t *fai;
 	str = (char*)calloc(strlen(fn) + 5, 1);
 	sprintf(str, "%s.fai", fn);
-	rz = razf_open(fn, "r");
-	if (rz == 0) {
-		fprintf(stderr, "[fai_build] fail to open the FASTA file %s\n",fn);
+	if (bgzf_check_bgzf(fn) == 1) {
+		fai_in_t in;
+		in.rz = 0; in.upos = 0;
+		in.bgzf = bgzf_open(fn, "r");
+		if (in.bgzf == 0 || fai_gzi_build(fn) != 0) {
+			fprintf(stderr, "[fai_build] fail to index the BGZF file %s\n",fn);
+			if (in.bgzf) bgzf_close(in.bgzf);
+			free(str);
+			return -1;
+		}
+		fai = fai_build_core_in(&in);
+		bgzf_close(in.bgzf);
+	} else {
+		int mapped = 0;
+		rz = razf_open(fn, "r");
+		if (rz == 0) {
+			fprintf(stderr, "[fai_build] fail to open the FASTA file %s\n",fn);
+			free(str);
+			return -1;
+		}
+		if (rz->file_type == FILE_TYPE_PLAIN) {
+			fai = fai_build_mmap(fn, &mapped);
+			if (mapped) { // indexed, or failed with a message
+				razf_close(rz);
+				rz = 0;
+			}
+		}
+		if (rz) {
+			fai = fai_build_core(rz);
+			razf_close(rz);
+		}
+	}
+	if (fai == 0) {
 		free(str);
 		return -1;
 	}
-	fai = fai_build_core(rz);
-	razf_close(rz);
 	fp = fopen(str, "wb");
 	if (fp == 0) {
 		fprintf(stderr, "[fai_build] fail to write FASTA index %s\n",str);
@@ -291,18 +627,142 @@ faidx_t *fai_load(const char *fn)
 	fai = fai_read(fp);
 	fclose(fp);
 
-	fai->rz = razf_open(fn, "rb");
 	free(str);
+	fai->io = (fai_io_t*)calloc(1, sizeof(fai_io_t));
+	pthread_mutex_init(&fai->io->lock, 0);
+	if (bgzf_check_bgzf(fn) == 1) {
+		fai->bgzf = bgzf_open(fn, "r");
+		if (fai->bgzf == 0 || fai_gzi_load(fai, fn) != 0) {
+			fprintf(stderr, "[fai_load] fail to open BGZF FASTA file or its .gzi index.\n");
+			fai_destroy(fai);
+			return 0;
+		}
+		bgzf_set_cache_size(fai->bgzf, FAI_BGZF_CACHE_SIZE);
+		return fai;
+	}
+	fai->rz = razf_open(fn, "rb");
 	if (fai->rz == 0) {
 		fprintf(stderr, "[fai_load] fail to open FASTA file.\n");
 		return 0;
 	}
+	if (fai->rz->file_type == FILE_TYPE_PLAIN)
+		fai->fd = open(fn, O_RDONLY);
 	return fai;
 }
 
+static int fai_pread(int fd, void *buf, int n, uint64_t offset)
+{
+	int got = 0;
+	while (got < n) {
+		ssize_t ret = pread(fd, (char*)buf + got, n - got, offset + got);
+		if (ret <= 0) break;
+		got += ret;
+	}
+	return got;
+}
+
+// the last BGZF block starting at or before an uncompressed file offset
+static int fai_gzi_block(const faidx_t *fai, uint64_t offset)
+{
+	int lo = 0, hi = fai->n_gzi - 1, mid;
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if (fai->gzi[2*mid+1] <= offset) lo = mid;
+		else hi = mid - 1;
+	}
+	return lo;
+}
+
+// read n bytes starting at an uncompressed file offset; safe to call from several threads
+static int fai_read_at(const faidx_t *fai, uint64_t offset, char *buf, int n)
+{
+	if (fai->bgzf) {
+		int lo = fai_gzi_block(fai, offset), got = 0, ret;
+		uint64_t from;
+		from = offset - fai->gzi[2*lo+1];
+		for (; got < n && lo < fai->n_gzi; ++lo, from = 0) {
+			ret = bgzf_read_block_at(fai->bgzf, fai->gzi[2*lo], (int)from, buf + got, n - got);
+			if (ret <= 0) break;
+			got += ret;
+		}
+		return got;
+	}
+	if (fai->fd >= 0) return fai_pread(fai->fd, buf, n, offset);
+	{
+		int ret;
+		pthread_mutex_lock(&fai->io->lock);
+		razf_seek(fai->rz, offset, SEEK_SET);
+		ret = razf_read(fai->rz, buf, n);
+		pthread_mutex_unlock(&fai->io->lock);
+		return ret;
+	}
+}
+
+// the bases in [beg, end) of a sequence, read with one seek and one read
+static int fai_retrieve(const faidx_t *fai, const faidx1_t *val, int beg, int end, char *buf)
+{
+	uint64_t off_beg, off_end;
+	int l, n, i;
+	char *raw;
+
+	if (beg < 0) beg = 0;
+	if (beg >= val->len) beg = val->len;
+	if (end >= val->len) end = val->len;
+	if (beg > end) beg = end;
+	if (beg == end) {
+		buf[0] = '\0';
+		return 0;
+	}
+	// the span includes the line breaks
+	off_beg = val->offset + beg / val->line_blen * val->line_len + beg % val->line_blen;
+	off_end = val->offset + (end - 1) / val->line_blen * val->line_len + (end - 1) % val->line_blen + 1;
+	n = (int)(off_end - off_beg);
+	raw = (char*)malloc(n);
+	if (raw == 0) {
+		buf[0] = '\0';
+		return -1;
+	}
+	n = fai_read_at(fai, off_beg, raw, n);
+	for (i = l = 0; i < n && l < end - beg; ++i)
+		if (isgraph(raw[i])) buf[l++] = raw[i];
+	free(raw);
+	buf[l] = '\0';
+	return l;
+}
+
+// the bases in [beg, end) of a sequence, read a character at a time from
+// the stream readers as samtools did before fai_read_at()
+static int fai_retrieve_stream(const faidx_t *fai, const faidx1_t *val, int beg, int end, char *buf)
+{
+	uint64_t offset;
+	int l = 0;
+	char c;
+
+	offset = val->offset + beg / val->line_blen * val->line_len + beg % val->line_blen;
+	pthread_mutex_lock(&fai->io->lock);
+	if (fai->bgzf) {
+		int block = fai_gzi_block(fai, offset);
+		bgzf_seek(fai->bgzf, (int64_t)(fai->gzi[2*block] << 16 | (offset - fai->gzi[2*block+1])), SEEK_SET);
+		while (l < end - beg && bgzf_read(fai->bgzf, &c, 1) == 1)
+			if (isgraph(c)) buf[l++] = c;
+	} else {
+		razf_seek(fai->rz, offset, SEEK_SET);
+		while (l < end - beg && razf_read(fai->rz, &c, 1) == 1)
+			if (isgraph(c)) buf[l++] = c;
+	}
+	pthread_mutex_unlock(&fai->io->lock);
+	buf[l] = '\0';
+	return l;
+}
+
+void fai_set_reference_reads(faidx_t *fai, int on)
+{
+	fai->reference = on;
+}
+
 char *fai_fetch(const faidx_t *fai, const char *str, int *len)
 {
-	char *s, c;
+	char *s;
 	int i, l, k, name_end;
 	khiter_t iter;
 	faidx1_t val;
@@ -337,7 +797,11 @@ char *fai_fetch(const faidx_t *fai, const char *str, int *len)
 			} else s[name_end] = ':', name_end = l;
 		}
 	} else iter = kh_get(s, h, str);
-	val = kh_value(h, iter);
+	if (iter == kh_end(h)) {
+		*len = 0;
+		free(s); return 0;
+	}
+	val = fai->seq[kh_value(h, iter)];
 	// parse the interval
 	if (name_end < l) {
 		for (i = k = name_end + 1; i < l; ++i)
@@ -354,16 +818,36 @@ char *fai_fetch(const faidx_t *fai, const char *str, int *len)
 	free(s);
 
 	// now retrieve the sequence
-	l = 0;
 	s = (char*)malloc(end - beg + 2);
-	razf_seek(fai->rz, val.offset + beg / val.line_blen * val.line_len + beg % val.line_blen, SEEK_SET);
-	while (razf_read(fai->rz, &c, 1) == 1 && l < end - beg && !fai->rz->z_err)
-		if (isgraph(c)) s[l++] = c;
-	s[l] = '\0';
-	*len = l;
+	l = fai_retrieve(fai, &val, beg, end, s);
+	*len = l < 0? 0 : l;
 	return s;
 }
 
+int faidx_name2id(const faidx_t *fai, const char *name)
+{
+	khiter_t iter = kh_get(s, fai->hash, name);
+	return iter == kh_end(fai->hash)? -1 : kh_value(fai->hash, iter);
+}
+
+const char *faidx_iseq(const faidx_t *fai, int id)
+{
+	return id >= 0 && id < fai->n? fai->name[id] : 0;
+}
+
+int faidx_seq_len(const faidx_t *fai, int id)
+{
+	// a sequence too long for the int coordinates of the fetch functions has no usable length
+	if (id < 0 || id >= fai->n || fai->seq[id].len > INT_MAX) return -1;
+	return (int)fai->seq[id].len;
+}
+
+int faidx_fetch_id(const faidx_t *fai, int id, int beg, int end, char *buf)
+{
+	if (id < 0 || id >= fai->n) return -1;
+	return fai_retrieve(fai, &fai->seq[id], beg, end, buf);
+}
+
 int faidx_main(int argc, char *argv[])
 {
 	if (argc == 1) {
@@ -401,7 +885,6 @@ int faidx_fetch_nseq(const faidx_t *fai)
 char *faidx_fetch_seq(const faidx_t *fai, char *c_name, int p_beg_i, int p_end_i, int *len)
 {
 	int l;
-	char c;
     khiter_t iter;
     faidx1_t val;
 	char *seq=NULL;
@@ -409,7 +892,7 @@ char *faidx_fetch_seq(const faidx_t *fai, char *c_name, int p_beg_i, int p_end_i
     // Adjust position
     iter = kh_get(s, fai->hash, c_name);
     if(iter == kh_end(fai->hash)) return 0;
-    val = kh_value(fai->hash, iter);
+    val = fai->seq[kh_value(fai->hash, iter)];
 	if(p_end_i < p_beg_i) p_beg_i = p_end_i;
     if(p_beg_i < 0) p_beg_i = 0;
     else if(val.len <= p_beg_i) p_beg_i = val.len - 1;
@@ -417,13 +900,10 @@ char *faidx_fetch_seq(const faidx_t *fai, char *c_name, int p_beg_i, int p_end_i
     else if(val.len <= p_end_i) p_end_i = val.len - 1;
 
     // Now retrieve the sequence 
-	l = 0;
 	seq = (char*)malloc(p_end_i - p_beg_i + 2);
-	razf_seek(fai->rz, val.offset + p_beg_i / val.line_blen * val.line_len + p_beg_i % val.line_blen, SEEK_SET);
-	while (razf_read(fai->rz, &c, 1) == 1 && l < p_end_i - p_beg_i + 1)
-		if (isgraph(c)) seq[l++] = c;
-	seq[l] = '\0';
-	*len = l;
+	l = fai->reference? fai_retrieve_stream(fai, &val, p_beg_i, p_end_i + 1, seq)
+		: fai_retrieve(fai, &val, p_beg_i, p_end_i + 1, seq);
+	*len = l < 0? 0 : l;
 	return seq;
 }
 
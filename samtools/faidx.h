@@ -33,6 +33,11 @@
 
   Index FASTA files and extract subsequence.
 
+  Once loaded, a faidx_t may be shared by several threads: the fetch
+  functions take a const faidx_t and read plain and BGZF files with
+  pread(), so they neither move a shared file position nor need to be
+  serialized by the caller.
+
   @copyright The Wellcome Trust Sanger Institute.
  */
 
@@ -75,6 +80,18 @@ extern "C" {
 	 */
 	char *fai_fetch(const faidx_t *fai, const char *reg, int *len);
 
+	/*!
+	  @abstract    Make faidx_fetch_seq() read the plain way samtools did.
+	  @param  fai  Pointer to the faidx_t struct
+	  @param  on   Non-zero for the plain reads, zero (the default) for the fast ones
+
+	  @discussion With the plain reads faidx_fetch_seq() seeks the file
+	  and reads it a character at a time, one fetch at a time. The
+	  sequences are the same; this is for checking the fast reads
+	  against.
+	 */
+	void fai_set_reference_reads(faidx_t *fai, int on);
+
 	/*!
 	  @abstract	   Fetch the number of sequences. 
 	  @param  fai  Pointer to the faidx_t struct
@@ -96,6 +113,40 @@ extern "C" {
 	 */
 	char *faidx_fetch_seq(const faidx_t *fai, char *c_name, int p_beg_i, int p_end_i, int *len);
 
+	/*!
+	  @abstract    Look up the contig id of a sequence name.
+	  @param  fai  Pointer to the faidx_t struct
+	  @param  name Sequence name
+	  @return      Id in [0, faidx_fetch_nseq()), in .fai order; -1 if unknown
+	 */
+	int faidx_name2id(const faidx_t *fai, const char *name);
+
+	/*!
+	  @abstract    Name of the sequence with the given contig id; null if out of range.
+	 */
+	const char *faidx_iseq(const faidx_t *fai, int id);
+
+	/*!
+	  @abstract    Length of the sequence with the given contig id; -1 if out of range,
+	               or if the sequence is longer than INT_MAX and so cannot be fetched.
+	 */
+	int faidx_seq_len(const faidx_t *fai, int id);
+
+	/*!
+	  @abstract    Fetch a region by contig id and integer coordinates.
+	  @param  fai  Pointer to the faidx_t struct
+	  @param  id   Contig id from faidx_name2id()
+	  @param  beg  Beginning position (zero-based, inclusive)
+	  @param  end  End position (zero-based, exclusive)
+	  @param  buf  Buffer of at least end - beg + 1 bytes for the sequence
+	  @return      Number of bases written to buf (NUL-terminated); -1 on failure
+
+	  @discussion Coordinates are clipped to the sequence like fai_fetch()
+	  does. Unlike fai_fetch() no region string is parsed and nothing is
+	  allocated for the caller.
+	 */
+	int faidx_fetch_id(const faidx_t *fai, int id, int beg, int end, char *buf);
+
 #ifdef __cplusplus
 }
 #endif
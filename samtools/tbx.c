@@ -0,0 +1,613 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "tbx.h"
+#include "khash.h"
+#include "ksort.h"
+#include "bam_endian.h"
+
+/*!
+  @header
+
+  A tabix compatible index for bgzip compressed VCF files. It is built
+  and queried like the BAM index in bam_index.c: each record is put in
+  the smallest UCSC bin containing it and a linear index keeps, for
+  every 16kb window, the file offset of the first record overlapping
+  it. A query collects the chunks of all bins that may overlap the
+  interval, drops those that end before the linear index offset of the
+  interval start and reads just these parts of the file.
+
+  The index is saved in the tabix format with the VCF preset, so that
+  files indexed by tabix can be used and vice versa.
+ */
+
+#define TBX_LIDX_SHIFT    14
+#define TBX_MAX_BIN       37450 // =(8^6-1)/7+1
+
+#define TBX_PRESET_VCF    2
+
+typedef struct {
+	uint64_t u, v;
+} pair64_t;
+
+#define pair64_lt(a,b) ((a).u < (b).u)
+KSORT_INIT(tbx_off, pair64_t, pair64_lt)
+
+typedef struct {
+	uint32_t m, n;
+	pair64_t *list;
+} tbx_binlist_t;
+
+typedef struct {
+	int32_t n, m;
+	uint64_t *offset;
+} tbx_lidx_t;
+
+KHASH_MAP_INIT_INT(tbx_i, tbx_binlist_t)
+KHASH_MAP_INIT_STR(tbx_s, int)
+
+struct __tbx_t {
+	int32_t n, m;
+	char **name;
+	khash_t(tbx_s) *hash; // name -> sequence id
+	khash_t(tbx_i) **index;
+	tbx_lidx_t *index2;
+};
+
+struct __tbx_iter_t {
+	int tid, beg, end, n_off, i, finished;
+	char *name; // of sequence tid
+	int l_name;
+	uint64_t curr_off;
+	pair64_t *off;
+};
+
+// the sequence, start and end of a VCF record
+typedef struct {
+	int beg, end;
+	char *ss, *se; // the sequence name, not NUL-terminated
+} tbx_intv_t;
+
+static inline int reg2bin(uint32_t beg, uint32_t end)
+{
+	--end;
+	if (beg>>14 == end>>14) return 4681 + (beg>>14);
+	if (beg>>17 == end>>17) return  585 + (beg>>17);
+	if (beg>>20 == end>>20) return   73 + (beg>>20);
+	if (beg>>23 == end>>23) return    9 + (beg>>23);
+	if (beg>>26 == end>>26) return    1 + (beg>>26);
+	return 0;
+}
+
+static inline int reg2bins(uint32_t beg, uint32_t end, uint16_t list[TBX_MAX_BIN])
+{
+	int i = 0, k;
+	if (beg >= end) return 0;
+	if (end >= 1u<<29) end = 1u<<29;
+	--end;
+	list[i++] = 0;
+	for (k =    1 + (beg>>26); k <=    1 + (end>>26); ++k) list[i++] = k;
+	for (k =    9 + (beg>>23); k <=    9 + (end>>23); ++k) list[i++] = k;
+	for (k =   73 + (beg>>20); k <=   73 + (end>>20); ++k) list[i++] = k;
+	for (k =  585 + (beg>>17); k <=  585 + (end>>17); ++k) list[i++] = k;
+	for (k = 4681 + (beg>>14); k <= 4681 + (end>>14); ++k) list[i++] = k;
+	return i;
+}
+
+int tbx_getline(BGZF *fp, kstring_t *str)
+{
+	int found = 0;
+	str->l = 0;
+	while (!found) {
+		char *p, *q;
+		int n;
+		if (fp->block_offset >= fp->block_length) {
+			if (bgzf_read_block(fp) != 0) return -2;
+			if (fp->block_length == 0) break; // end-of-file
+		}
+		p = (char*)fp->uncompressed_block + fp->block_offset;
+		n = fp->block_length - fp->block_offset;
+		if ((q = (char*)memchr(p, '\n', n)) != 0) n = q - p, found = 1;
+		kputsn(p, n, str);
+		fp->block_offset += n + found;
+		if (fp->block_offset == fp->block_length) { // as bgzf_getc() does at the end of a block
+#ifdef _USE_KNETFILE
+			fp->block_address = knet_tell(fp->x.fpr);
+#else
+			fp->block_address = ftello(fp->file);
+#endif
+			fp->block_offset = 0;
+			fp->block_length = 0;
+		}
+	}
+	if (!found && str->l == 0) return -1;
+	if (str->l > 0 && str->s[str->l-1] == '\r') str->s[--str->l] = 0;
+	return str->l;
+}
+
+// parse CHROM, POS, REF and INFO/END of a VCF record; returns -1 if malformed
+static int get_intv(const kstring_t *str, tbx_intv_t *intv)
+{
+	char *p = str->s, *q, *end = str->s + str->l;
+	int col;
+	intv->ss = intv->se = 0; intv->beg = intv->end = -1;
+	for (col = 1; p < end && col <= 8; ++col) {
+		for (q = p; q < end && *q != '\t'; ++q);
+		if (col == 1) intv->ss = p, intv->se = q;
+		else if (col == 2) {
+			intv->beg = atoi(p) - 1;
+			intv->end = intv->beg + 1;
+		} else if (col == 4) {
+			if (q - p > 1) intv->end = intv->beg + (q - p);
+		} else if (col == 8) { // INFO: END= for symbolic alleles
+			char *s = p;
+			while (s < q) {
+				if (strncmp(s, "END=", 4) == 0 && (s == p || s[-1] == ';')) {
+					int e = atoi(s + 4);
+					if (e > intv->beg) intv->end = e;
+					break;
+				}
+				while (s < q && *s != ';') ++s;
+				if (s < q) ++s;
+			}
+		}
+		p = q + 1;
+	}
+	if (intv->ss == 0 || intv->se == intv->ss || intv->beg < 0) return -1;
+	return 0;
+}
+
+static int get_tid(tbx_t *idx, const char *ss, int l)
+{
+	khint_t k;
+	int ret;
+	char *name = (char*)malloc(l + 1);
+	memcpy(name, ss, l); name[l] = 0;
+	k = kh_get(tbx_s, idx->hash, name);
+	if (k != kh_end(idx->hash)) {
+		free(name);
+		return kh_value(idx->hash, k);
+	}
+	if (idx->n == idx->m) {
+		idx->m = idx->m? idx->m<<1 : 16;
+		idx->name = (char**)realloc(idx->name, sizeof(char*) * idx->m);
+		idx->index = (khash_t(tbx_i)**)realloc(idx->index, sizeof(void*) * idx->m);
+		idx->index2 = (tbx_lidx_t*)realloc(idx->index2, sizeof(tbx_lidx_t) * idx->m);
+	}
+	idx->name[idx->n] = name;
+	idx->index[idx->n] = kh_init(tbx_i);
+	memset(&idx->index2[idx->n], 0, sizeof(tbx_lidx_t));
+	k = kh_put(tbx_s, idx->hash, name, &ret);
+	kh_value(idx->hash, k) = idx->n;
+	return idx->n++;
+}
+
+static inline void insert_offset(khash_t(tbx_i) *h, int bin, uint64_t beg, uint64_t end)
+{
+	khint_t k;
+	tbx_binlist_t *l;
+	int ret;
+	k = kh_put(tbx_i, h, bin, &ret);
+	l = &kh_value(h, k);
+	if (ret) { // not present
+		l->m = 1; l->n = 0;
+		l->list = (pair64_t*)calloc(l->m, 16);
+	}
+	if (l->n == l->m) {
+		l->m <<= 1;
+		l->list = (pair64_t*)realloc(l->list, l->m * 16);
+	}
+	l->list[l->n].u = beg; l->list[l->n++].v = end;
+}
+
+static inline void insert_offset2(tbx_lidx_t *index2, int _beg, int _end, uint64_t offset)
+{
+	int i, beg, end;
+	beg = _beg >> TBX_LIDX_SHIFT;
+	end = (_end - 1) >> TBX_LIDX_SHIFT;
+	if (index2->m < end + 1) {
+		int old_m = index2->m;
+		index2->m = end + 1;
+		kroundup32(index2->m);
+		index2->offset = (uint64_t*)realloc(index2->offset, index2->m * 8);
+		memset(index2->offset + old_m, 0, 8 * (index2->m - old_m));
+	}
+	for (i = beg; i <= end; ++i)
+		if (index2->offset[i] == 0) index2->offset[i] = offset;
+	if (index2->n < end + 1) index2->n = end + 1;
+}
+
+static void merge_chunks(tbx_t *idx)
+{
+	khash_t(tbx_i) *index;
+	int i, l, m;
+	khint_t k;
+	for (i = 0; i < idx->n; ++i) {
+		index = idx->index[i];
+		for (k = kh_begin(index); k != kh_end(index); ++k) {
+			tbx_binlist_t *p;
+			if (!kh_exist(index, k)) continue;
+			p = &kh_value(index, k);
+			m = 0;
+			for (l = 1; l < p->n; ++l) {
+				if (p->list[m].v>>16 == p->list[l].u>>16) p->list[m].v = p->list[l].v;
+				else p->list[++m] = p->list[l];
+			}
+			p->n = m + 1;
+		}
+	}
+}
+
+static void fill_missing(tbx_t *idx)
+{
+	int i, j;
+	for (i = 0; i < idx->n; ++i) {
+		tbx_lidx_t *idx2 = &idx->index2[i];
+		for (j = 1; j < idx2->n; ++j)
+			if (idx2->offset[j] == 0)
+				idx2->offset[j] = idx2->offset[j-1];
+	}
+}
+
+static tbx_t *tbx_index_core(BGZF *fp)
+{
+	int ret, tid;
+	tbx_t *idx;
+	uint32_t last_bin, save_bin;
+	int32_t last_coor, last_tid, save_tid;
+	uint64_t save_off, last_off;
+	kstring_t str = {0, 0, 0};
+	tbx_intv_t intv;
+
+	idx = (tbx_t*)calloc(1, sizeof(tbx_t));
+	idx->hash = kh_init(tbx_s);
+
+	save_bin = last_bin = 0xffffffffu; save_tid = last_tid = -1;
+	save_off = last_off = bgzf_tell(fp); last_coor = -1;
+	while ((ret = tbx_getline(fp, &str)) >= 0) {
+		if (str.l == 0 || str.s[0] == '#') { // meta lines
+			last_off = bgzf_tell(fp);
+			continue;
+		}
+		if (get_intv(&str, &intv) != 0) {
+			fprintf(stderr, "[tbx_index_core] the following line cannot be parsed and is skipped: %s\n", str.s);
+			last_off = bgzf_tell(fp);
+			continue;
+		}
+		tid = get_tid(idx, intv.ss, intv.se - intv.ss);
+		if (last_tid != tid) { // change of chromosomes
+			if (last_tid >= 0 && tid < last_tid) {
+				fprintf(stderr, "[tbx_index_core] the file is not sorted: sequence %s appears again after %s\n",
+						idx->name[tid], idx->name[last_tid]);
+				free(str.s); tbx_index_destroy(idx);
+				return 0;
+			}
+			last_tid = tid;
+			last_bin = 0xffffffffu;
+		} else if (last_coor > intv.beg) {
+			fprintf(stderr, "[tbx_index_core] the file is not sorted: %d > %d in sequence %s\n",
+					last_coor + 1, intv.beg + 1, idx->name[tid]);
+			free(str.s); tbx_index_destroy(idx);
+			return 0;
+		}
+		insert_offset2(&idx->index2[tid], intv.beg, intv.end, last_off);
+		if ((uint32_t)reg2bin(intv.beg, intv.end) != last_bin) { // then write the binning index
+			if (save_bin != 0xffffffffu) // save_bin==0xffffffffu only happens to the first record
+				insert_offset(idx->index[save_tid], save_bin, save_off, last_off);
+			save_off = last_off;
+			save_bin = last_bin = reg2bin(intv.beg, intv.end);
+			save_tid = tid;
+		}
+		last_off = bgzf_tell(fp);
+		last_coor = intv.beg;
+	}
+	if (save_tid >= 0)
+		insert_offset(idx->index[save_tid], save_bin, save_off, bgzf_tell(fp));
+	merge_chunks(idx);
+	fill_missing(idx);
+	free(str.s);
+	if (ret < -1) {
+		fprintf(stderr, "[tbx_index_core] fail to read the file.\n");
+		tbx_index_destroy(idx);
+		return 0;
+	}
+	return idx;
+}
+
+void tbx_index_destroy(tbx_t *idx)
+{
+	khint_t k;
+	int i;
+	if (idx == 0) return;
+	for (i = 0; i < idx->n; ++i) {
+		khash_t(tbx_i) *index = idx->index[i];
+		for (k = kh_begin(index); k != kh_end(index); ++k)
+			if (kh_exist(index, k)) free(kh_value(index, k).list);
+		kh_destroy(tbx_i, index);
+		free(idx->index2[i].offset);
+		free(idx->name[i]);
+	}
+	kh_destroy(tbx_s, idx->hash);
+	free(idx->name); free(idx->index); free(idx->index2);
+	free(idx);
+}
+
+static inline void write32(BGZF *fp, int32_t x)
+{
+	if (bam_is_big_endian()) bam_swap_endian_4p(&x);
+	bgzf_write(fp, &x, 4);
+}
+
+static inline void write64(BGZF *fp, uint64_t x)
+{
+	if (bam_is_big_endian()) bam_swap_endian_8p(&x);
+	bgzf_write(fp, &x, 8);
+}
+
+static void tbx_index_save(const tbx_t *idx, BGZF *fp)
+{
+	int32_t i, j, l_nm;
+	khint_t k;
+	bgzf_write(fp, "TBI\1", 4);
+	write32(fp, idx->n);
+	// the VCF preset: format, sequence/begin/end columns, meta character and lines to skip
+	write32(fp, TBX_PRESET_VCF); write32(fp, 1); write32(fp, 2); write32(fp, 0);
+	write32(fp, '#'); write32(fp, 0);
+	for (i = l_nm = 0; i < idx->n; ++i) l_nm += strlen(idx->name[i]) + 1;
+	write32(fp, l_nm);
+	for (i = 0; i < idx->n; ++i) bgzf_write(fp, idx->name[i], strlen(idx->name[i]) + 1);
+	for (i = 0; i < idx->n; ++i) {
+		khash_t(tbx_i) *index = idx->index[i];
+		tbx_lidx_t *index2 = idx->index2 + i;
+		// write binning index
+		write32(fp, kh_size(index));
+		for (k = kh_begin(index); k != kh_end(index); ++k) {
+			if (kh_exist(index, k)) {
+				tbx_binlist_t *p = &kh_value(index, k);
+				write32(fp, kh_key(index, k));
+				write32(fp, p->n);
+				for (j = 0; j < (int32_t)p->n; ++j) {
+					write64(fp, p->list[j].u);
+					write64(fp, p->list[j].v);
+				}
+			}
+		}
+		// write linear index
+		write32(fp, index2->n);
+		for (j = 0; j < index2->n; ++j) write64(fp, index2->offset[j]);
+	}
+}
+
+int tbx_index_build(const char *fn)
+{
+	char *fnidx;
+	BGZF *fp;
+	tbx_t *idx;
+	if ((fp = bgzf_open(fn, "r")) == 0) {
+		fprintf(stderr, "[tbx_index_build] fail to open the VCF file %s\n", fn);
+		return -1;
+	}
+	idx = tbx_index_core(fp);
+	bgzf_close(fp);
+	if (idx == 0) return -1;
+	fnidx = (char*)calloc(strlen(fn) + 5, 1);
+	strcpy(fnidx, fn); strcat(fnidx, ".tbi");
+	if ((fp = bgzf_open(fnidx, "w")) == 0) {
+		fprintf(stderr, "[tbx_index_build] fail to create the index %s\n", fnidx);
+		free(fnidx); tbx_index_destroy(idx);
+		return -1;
+	}
+	tbx_index_save(idx, fp);
+	bgzf_close(fp);
+	free(fnidx);
+	tbx_index_destroy(idx);
+	return 0;
+}
+
+static inline int read32(BGZF *fp, int32_t *x)
+{
+	if (bgzf_read(fp, x, 4) != 4) return -1;
+	if (bam_is_big_endian()) bam_swap_endian_4p(x);
+	return 0;
+}
+
+static inline int read64(BGZF *fp, uint64_t *x)
+{
+	if (bgzf_read(fp, x, 8) != 8) return -1;
+	if (bam_is_big_endian()) bam_swap_endian_8p(x);
+	return 0;
+}
+
+static tbx_t *tbx_index_load_core(BGZF *fp)
+{
+	char magic[4], *names, *p;
+	int32_t i, j, n, conf[6], l_nm, n_bin, bin, n_chunk;
+	tbx_t *idx;
+	if (bgzf_read(fp, magic, 4) != 4 || strncmp(magic, "TBI\1", 4)) {
+		fprintf(stderr, "[tbx_index_load] wrong magic number.\n");
+		return 0;
+	}
+	if (read32(fp, &n) || n < 0) return 0;
+	for (i = 0; i < 6; ++i)
+		if (read32(fp, &conf[i])) return 0;
+	if ((conf[0] & 0xffff) != TBX_PRESET_VCF) {
+		fprintf(stderr, "[tbx_index_load] the index is not for a VCF file.\n");
+		return 0;
+	}
+	if (read32(fp, &l_nm) || l_nm < 0) return 0;
+	names = (char*)malloc(l_nm + 1);
+	if (bgzf_read(fp, names, l_nm) != l_nm) { free(names); return 0; }
+	names[l_nm] = 0;
+
+	idx = (tbx_t*)calloc(1, sizeof(tbx_t));
+	idx->hash = kh_init(tbx_s);
+	for (p = names, i = 0; i < n && p < names + l_nm; ++i, p += strlen(p) + 1)
+		get_tid(idx, p, strlen(p));
+	free(names);
+	if (idx->n != n) goto fail;
+	for (i = 0; i < n; ++i) {
+		khash_t(tbx_i) *index = idx->index[i];
+		tbx_lidx_t *index2 = idx->index2 + i;
+		// load binning index
+		if (read32(fp, &n_bin)) goto fail;
+		for (j = 0; j < n_bin; ++j) {
+			tbx_binlist_t *l;
+			khint_t k;
+			int ret, c;
+			if (read32(fp, &bin) || read32(fp, &n_chunk) || n_chunk < 0) goto fail;
+			k = kh_put(tbx_i, index, bin, &ret);
+			l = &kh_value(index, k);
+			if (!ret) free(l->list);
+			l->n = l->m = n_chunk;
+			l->list = (pair64_t*)malloc((n_chunk? n_chunk : 1) * 16);
+			for (c = 0; c < n_chunk; ++c)
+				if (read64(fp, &l->list[c].u) || read64(fp, &l->list[c].v)) goto fail;
+		}
+		// load linear index
+		if (read32(fp, &index2->n) || index2->n < 0) goto fail;
+		index2->m = index2->n;
+		index2->offset = (uint64_t*)calloc(index2->m? index2->m : 1, 8);
+		for (j = 0; j < index2->n; ++j)
+			if (read64(fp, &index2->offset[j])) goto fail;
+	}
+	return idx;
+
+fail:
+	fprintf(stderr, "[tbx_index_load] the index is truncated.\n");
+	tbx_index_destroy(idx);
+	return 0;
+}
+
+tbx_t *tbx_index_load(const char *fn)
+{
+	char *fnidx;
+	BGZF *fp;
+	tbx_t *idx;
+	fnidx = (char*)calloc(strlen(fn) + 5, 1);
+	strcpy(fnidx, fn); strcat(fnidx, ".tbi");
+	fp = bgzf_open(fnidx, "r");
+	free(fnidx);
+	if (fp == 0) return 0;
+	idx = tbx_index_load_core(fp);
+	bgzf_close(fp);
+	return idx;
+}
+
+int tbx_n_seqs(const tbx_t *idx)
+{
+	return idx->n;
+}
+
+const char *tbx_seq_name(const tbx_t *idx, int tid)
+{
+	return tid >= 0 && tid < idx->n? idx->name[tid] : 0;
+}
+
+int tbx_name2id(const tbx_t *idx, const char *name)
+{
+	khint_t k = kh_get(tbx_s, idx->hash, name);
+	return k == kh_end(idx->hash)? -1 : kh_value(idx->hash, k);
+}
+
+tbx_iter_t tbx_iter_query(const tbx_t *idx, int tid, int beg, int end)
+{
+	uint16_t *bins;
+	int i, n_bins, n_off, l;
+	pair64_t *off;
+	khint_t k;
+	khash_t(tbx_i) *index;
+	uint64_t min_off;
+	tbx_iter_t iter;
+
+	if (beg < 0) beg = 0;
+	iter = (tbx_iter_t)calloc(1, sizeof(struct __tbx_iter_t));
+	iter->tid = tid, iter->beg = beg, iter->end = end; iter->i = -1;
+	if (tid < 0 || tid >= idx->n || end <= beg) return iter;
+	iter->name = strdup(idx->name[tid]);
+	iter->l_name = strlen(iter->name);
+
+	bins = (uint16_t*)calloc(TBX_MAX_BIN, 2);
+	n_bins = reg2bins(beg, end, bins);
+	index = idx->index[tid];
+	if (idx->index2[tid].n > 0) {
+		min_off = (beg>>TBX_LIDX_SHIFT >= idx->index2[tid].n)? idx->index2[tid].offset[idx->index2[tid].n-1]
+			: idx->index2[tid].offset[beg>>TBX_LIDX_SHIFT];
+		if (min_off == 0) { // for index files built by tabix prior to 0.1.4
+			int n = beg>>TBX_LIDX_SHIFT;
+			if (n > idx->index2[tid].n) n = idx->index2[tid].n;
+			for (i = n - 1; i >= 0; --i)
+				if (idx->index2[tid].offset[i] != 0) break;
+			if (i >= 0) min_off = idx->index2[tid].offset[i];
+		}
+	} else min_off = 0;
+	for (i = n_off = 0; i < n_bins; ++i)
+		if ((k = kh_get(tbx_i, index, bins[i])) != kh_end(index))
+			n_off += kh_value(index, k).n;
+	if (n_off == 0) {
+		free(bins); return iter;
+	}
+	off = (pair64_t*)calloc(n_off, 16);
+	for (i = n_off = 0; i < n_bins; ++i) {
+		if ((k = kh_get(tbx_i, index, bins[i])) != kh_end(index)) {
+			int j;
+			tbx_binlist_t *p = &kh_value(index, k);
+			for (j = 0; j < (int)p->n; ++j)
+				if (p->list[j].v > min_off) off[n_off++] = p->list[j];
+		}
+	}
+	free(bins);
+	if (n_off == 0) {
+		free(off); return iter;
+	}
+	ks_introsort(tbx_off, n_off, off);
+	// resolve completely contained adjacent blocks
+	for (i = 1, l = 0; i < n_off; ++i)
+		if (off[l].v < off[i].v)
+			off[++l] = off[i];
+	n_off = l + 1;
+	// resolve overlaps between adjacent blocks; this may happen due to the merge in indexing
+	for (i = 1; i < n_off; ++i)
+		if (off[i-1].v >= off[i].u) off[i-1].v = off[i].u;
+	// merge adjacent blocks
+	for (i = 1, l = 0; i < n_off; ++i) {
+		if (off[l].v>>16 == off[i].u>>16) off[l].v = off[i].v;
+		else off[++l] = off[i];
+	}
+	n_off = l + 1;
+	iter->n_off = n_off; iter->off = off;
+	return iter;
+}
+
+void tbx_iter_destroy(tbx_iter_t iter)
+{
+	if (iter) { free(iter->off); free(iter->name); free(iter); }
+}
+
+int tbx_iter_read(BGZF *fp, tbx_iter_t iter, kstring_t *str)
+{
+	int ret;
+	tbx_intv_t intv;
+	if (iter == 0 || iter->finished || iter->off == 0) return -1;
+	for (;;) {
+		if (iter->curr_off == 0 || iter->curr_off >= iter->off[iter->i].v) { // then jump to the next chunk
+			if (iter->i == iter->n_off - 1) { ret = -1; break; } // no more chunks
+			if (iter->i >= 0) assert(iter->curr_off == iter->off[iter->i].v); // otherwise bug
+			if (iter->i < 0 || iter->off[iter->i].v != iter->off[iter->i+1].u) { // not adjacent chunks; then seek
+				bgzf_seek(fp, iter->off[iter->i+1].u, SEEK_SET);
+				iter->curr_off = bgzf_tell(fp);
+			}
+			++iter->i;
+		}
+		if ((ret = tbx_getline(fp, str)) >= 0) {
+			iter->curr_off = bgzf_tell(fp);
+			if (str->l == 0 || str->s[0] == '#' || get_intv(str, &intv) != 0) continue;
+			if (intv.se - intv.ss != iter->l_name || strncmp(intv.ss, iter->name, iter->l_name) != 0
+					|| intv.beg >= iter->end) { ret = -1; break; } // no need to proceed
+			if (intv.end > iter->beg) return str->l;
+		} else break; // end of file or error
+	}
+	iter->finished = 1;
+	return ret;
+}
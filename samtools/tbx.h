@@ -0,0 +1,84 @@
+#ifndef TBX_H
+#define TBX_H
+
+#include <stdint.h>
+#include "bgzf.h"
+#include "kstring.h"
+
+/*!
+  @header
+
+  Random access to bgzip compressed, position sorted VCF files through
+  a tabix compatible index ("fn.tbi"). The index uses the same UCSC
+  binning index and linear index as BAM (see bam_index.c); a record
+  spans [POS-1, POS-1+length(REF)), or up to END= in the INFO column.
+ */
+
+typedef struct __tbx_t tbx_t;
+
+struct __tbx_iter_t;
+typedef struct __tbx_iter_t *tbx_iter_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/*!
+	  @abstract   Build the index "fn.tbi" for a bgzip compressed VCF.
+	  @param  fn  File name of the VCF
+	  @return     0 on success; -1 on failure (e.g. an unsorted file)
+	 */
+	int tbx_index_build(const char *fn);
+
+	/*!
+	  @abstract   Load the index "fn.tbi".
+	  @return     The index; null if it cannot be read
+	 */
+	tbx_t *tbx_index_load(const char *fn);
+
+	void tbx_index_destroy(tbx_t *idx);
+
+	/*!
+	  @abstract   The number of sequences in the index, in file order.
+	 */
+	int tbx_n_seqs(const tbx_t *idx);
+
+	/*!
+	  @abstract   The name of the i-th sequence.
+	 */
+	const char *tbx_seq_name(const tbx_t *idx, int tid);
+
+	/*!
+	  @abstract   The id of a sequence name; -1 if it has no records.
+	 */
+	int tbx_name2id(const tbx_t *idx, const char *name);
+
+	/*!
+	  @abstract   Find the file chunks that may hold records overlapping
+	  the zero-based half open interval [beg, end) of sequence tid.
+	  @return     An iterator for tbx_iter_read(); free with tbx_iter_destroy()
+	 */
+	tbx_iter_t tbx_iter_query(const tbx_t *idx, int tid, int beg, int end);
+
+	/*!
+	  @abstract   Read the next record overlapping the queried interval.
+	  @param  fp  The VCF, opened with bgzf_open()
+	  @param line Set to the record, without the newline
+	  @return     The length of the record; -1 when there are no more
+	 */
+	int tbx_iter_read(BGZF *fp, tbx_iter_t iter, kstring_t *line);
+
+	void tbx_iter_destroy(tbx_iter_t iter);
+
+	/*!
+	  @abstract   Read the next line of a BGZF file.
+	  @param line Set to the line, without the newline
+	  @return     The length of the line; -1 at the end of the file; -2 on error
+	 */
+	int tbx_getline(BGZF *fp, kstring_t *line);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
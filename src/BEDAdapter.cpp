@@ -0,0 +1,106 @@
+/*********************************************************************
+ *
+ * BEDAdapter.cpp:  The adapter for BED target inputs.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <iostream>
+
+#include "BEDAdapter.h"
+#include "bedidx.h"
+
+using namespace std;
+
+//Initialize the static members
+bool BEDAdapter::MERGE_OVERLAPPING_TARGETS = false;
+const std::string BEDAdapter::BED_FILE_EXTENTION = ".bed";
+const std::string BEDAdapter::BED_GZ_FILE_EXTENTION = ".bed.gz";
+
+BEDAdapter::BEDAdapter() : bedIndex(NULL) {
+
+}
+
+BEDAdapter::~BEDAdapter() {
+
+	if(bedIndex != NULL) {
+		bed_destroy(bedIndex);
+	}
+}
+
+bool BEDAdapter::isBEDFile(string fileLoc) {
+
+	const string &ext = BED_FILE_EXTENTION;
+	const string &gzExt = BED_GZ_FILE_EXTENTION;
+
+	return (fileLoc.length() > ext.length() &&
+				fileLoc.compare(fileLoc.length() - ext.length(), ext.length(), ext) == 0) ||
+			(fileLoc.length() > gzExt.length() &&
+				fileLoc.compare(fileLoc.length() - gzExt.length(), gzExt.length(), gzExt) == 0);
+}
+
+bool BEDAdapter::load(string bedFileLoc, bool mergeOverlapping) {
+
+	if(bedIndex != NULL) {
+		bed_destroy(bedIndex);
+	}
+
+	bedIndex = bed_read(bedFileLoc.c_str());
+	if(bedIndex == NULL) {
+		cerr << "Could not read the bed-file " << bedFileLoc << endl;
+		return false;
+	}
+
+	bed_unify(bedIndex, mergeOverlapping);
+
+	return true;
+}
+
+void BEDAdapter::loadRegions(vector<SequenceRegionInput> &regions, bool mergeOverlapping) {
+
+	if(bedIndex != NULL) {
+		bed_destroy(bedIndex);
+	}
+
+	bedIndex = bed_init();
+	for(vector<SequenceRegionInput>::iterator iterator=regions.begin();
+				iterator!=regions.end(); ++iterator) {
+		long beg = iterator->getStartIndex() > 0 ? iterator->getStartIndex() - 1 : 0;
+		if(iterator->getEndIndex() > beg) {
+			bed_insert(bedIndex, iterator->getRegionName().c_str(), beg, iterator->getEndIndex());
+		}
+	}
+	bed_index(bedIndex);
+
+	bed_unify(bedIndex, mergeOverlapping);
+}
+
+bool BEDAdapter::overlaps(string contigName, long beg, long end) const {
+	return bedIndex != NULL && bed_overlap(bedIndex, contigName.c_str(), beg, end);
+}
+
+int BEDAdapter::getTargetCount() const {
+	return bedIndex != NULL ? bed_n_intervals(bedIndex) : 0;
+}
+
+int BEDAdapter::extractRegions(string contigName, int contigId, vector<SequenceRegionInput> &regions) const {
+
+	int n = 0;
+	const uint64_t *intervals = bed_intervals(bedIndex, contigName.c_str(), &n);
+
+	for(int i = 0; i < n; i++) {
+		//BED intervals are zero-based and half open.
+		SequenceRegionInput region(contigName, (long) (intervals[i] >> 32) + 1, (long) (uint32_t) intervals[i]);
+		region.setContigId(contigId);
+		regions.push_back(region);
+	}
+
+	return n;
+}
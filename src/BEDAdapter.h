@@ -0,0 +1,93 @@
+/*********************************************************************
+ *
+ * BEDAdapter.h:  The adapter for BED target inputs.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#ifndef BEDADAPTER_H_
+#define BEDADAPTER_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "SequenceRegions.h"
+
+/**
+ * This class reads the targets of a BED (or position list) file into the
+ * sorted interval index of samtools, so that the targets can be walked in
+ * reference order without being turned into region strings first.
+ * Duplicate intervals are always dropped; overlapping and book-ended
+ * intervals may be merged.
+ */
+class BEDAdapter {
+
+public:
+
+	//Merge overlapping and book-ended primer targets into one.
+	static bool MERGE_OVERLAPPING_TARGETS;
+
+protected:
+
+	//The extensions which identify a BED file, optionally gzipped.
+	const static std::string BED_FILE_EXTENTION;
+	const static std::string BED_GZ_FILE_EXTENTION;
+
+	//The interval index returned by bed_read.
+	void *bedIndex;
+
+public:
+
+	BEDAdapter();
+	~BEDAdapter();
+
+	/*
+	 * This static method tells if a given file is BED file or not based on
+	 * the extension of the file.
+	 */
+	bool static isBEDFile(std::string);
+
+	/**
+	 * Reads and indexes the targets of the BED file, merging overlapping
+	 * targets if asked to. Returns false if the file could not be read.
+	 */
+	bool load(std::string bedFileLoc, bool mergeOverlapping);
+
+	/**
+	 * Indexes the given regions (one-based, inclusive) instead of a file.
+	 */
+	void loadRegions(std::vector<SequenceRegionInput> &regions, bool mergeOverlapping);
+
+	/**
+	 * Indicates if the zero-based half open interval [beg, end) of a contig
+	 * overlaps one of the targets.
+	 */
+	bool overlaps(std::string contigName, long beg, long end) const;
+
+	/**
+	 * The number of targets that are left after de-duplication and merging.
+	 */
+	int getTargetCount() const;
+
+	/**
+	 * Appends the targets on a contig, sorted by start, as one-based inclusive
+	 * region inputs carrying the given contig id.
+	 * Returns the number of targets appended.
+	 */
+	int extractRegions(std::string contigName, int contigId, std::vector<SequenceRegionInput> &regions) const;
+
+private:
+	//The adapter owns the index and is not copied.
+	BEDAdapter(const BEDAdapter &);
+	BEDAdapter &operator=(const BEDAdapter &);
+};
+
+#endif /* BEDADAPTER_H_ */
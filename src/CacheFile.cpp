@@ -0,0 +1,100 @@
+/*********************************************************************
+ *
+ * CacheFile.cpp:  What the on-disk caches kept next to the reference
+ * fasta have in common.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "CacheFile.h"
+
+using namespace std;
+
+bool CacheFile::stamp(Stamp &stamp, const char *magic, const string &fastaFileLoc) {
+
+	struct stat fastaStat;
+	if(stat(fastaFileLoc.c_str(), &fastaStat) != 0) {
+		return false;
+	}
+
+	memset(&stamp, 0, sizeof(stamp));
+	memcpy(stamp.magic, magic, sizeof(stamp.magic));
+	stamp.fastaSize = fastaStat.st_size;
+	stamp.fastaMtime = fastaStat.st_mtime;
+	return true;
+}
+
+const char *CacheFile::map(const string &cacheFileLoc, const char *magic,
+							const string &fastaFileLoc, size_t minSize, size_t &mappingSize) {
+
+	Stamp expected;
+	if(!stamp(expected, magic, fastaFileLoc)) {
+		return NULL;
+	}
+
+	int fd = ::open(cacheFileLoc.c_str(), O_RDONLY);
+	if(fd < 0) {
+		return NULL;
+	}
+
+	struct stat cacheStat;
+	void *data = MAP_FAILED;
+	if(fstat(fd, &cacheStat) == 0 && (size_t) cacheStat.st_size >= max(minSize, sizeof(Stamp))) {
+		data = mmap(NULL, cacheStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	::close(fd);
+	if(data == MAP_FAILED) {
+		return NULL;
+	}
+
+	//A cache of another format, or of the fasta before it changed, is not used.
+	const Stamp *found = (const Stamp *) data;
+	if(memcmp(found->magic, expected.magic, sizeof(expected.magic)) != 0 ||
+			found->fastaSize != expected.fastaSize || found->fastaMtime != expected.fastaMtime) {
+		munmap(data, cacheStat.st_size);
+		return NULL;
+	}
+
+	mappingSize = cacheStat.st_size;
+	return (const char *) data;
+}
+
+void CacheFile::unmap(const char *mapping, size_t mappingSize) {
+
+	if(mapping != NULL) {
+		munmap((void *) mapping, mappingSize);
+	}
+}
+
+string CacheFile::tempFileLoc(const string &cacheFileLoc) {
+
+	stringstream tempName("");
+	tempName << cacheFileLoc << "." << getpid();
+	return tempName.str();
+}
+
+bool CacheFile::commit(const string &tempFileLoc, const string &cacheFileLoc, bool isWritten) {
+
+	if(!isWritten || rename(tempFileLoc.c_str(), cacheFileLoc.c_str()) != 0) {
+		remove(tempFileLoc.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,93 @@
+/*********************************************************************
+ *
+ * CacheFile.h:  What the on-disk caches kept next to the reference
+ * fasta have in common.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#ifndef CACHEFILE_H_
+#define CACHEFILE_H_
+
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * The base coding and the file handling shared by the caches built from
+ * the reference fasta (the packed reference and the specificity index).
+ * A cache file starts with a Stamp, which names its format and the size
+ * and modification time of the fasta it was built from; it is mapped
+ * read-only and only used while the stamp matches. A cache is written to
+ * a temporary file which is renamed into place once it is complete, so
+ * readers only ever see a whole cache.
+ */
+class CacheFile {
+
+public:
+
+	/**
+	 * The start of every cache file, in host byte order.
+	 */
+	struct Stamp {
+		char magic[8];
+		uint64_t fastaSize;
+		int64_t fastaMtime;
+	};
+
+	/**
+	 * The 2-bit code of a base, A=0 C=1 G=2 T=3 in either case, or -1 for
+	 * any other character.
+	 */
+	static inline int baseCode(char base) {
+
+		switch(base) {
+		case 'A': case 'a': return 0;
+		case 'C': case 'c': return 1;
+		case 'G': case 'g': return 2;
+		case 'T': case 't': return 3;
+		default: return -1;
+		}
+	}
+
+	/**
+	 * Fills the stamp of a cache of the given format for the fasta.
+	 * Returns false if the fasta cannot be read.
+	 */
+	static bool stamp(Stamp &stamp, const char *magic, const std::string &fastaFileLoc);
+
+	/**
+	 * Maps a cache file read-only if it is at least minSize bytes and its
+	 * stamp is that of the given format and fasta; the rest of it is for the
+	 * caller to check. Returns the mapping, and its size in mappingSize, or
+	 * NULL.
+	 */
+	static const char *map(const std::string &cacheFileLoc, const char *magic,
+							const std::string &fastaFileLoc, size_t minSize, size_t &mappingSize);
+
+	/**
+	 * Unmaps what map() returned.
+	 */
+	static void unmap(const char *mapping, size_t mappingSize);
+
+	/**
+	 * The temporary file a cache is written to before it is put in place.
+	 */
+	static std::string tempFileLoc(const std::string &cacheFileLoc);
+
+	/**
+	 * Puts a written temporary file in place of the cache if the write
+	 * went well, and removes it otherwise. Returns true if the cache is in
+	 * place.
+	 */
+	static bool commit(const std::string &tempFileLoc, const std::string &cacheFileLoc, bool isWritten);
+};
+
+#endif /* CACHEFILE_H_ */
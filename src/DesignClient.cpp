@@ -0,0 +1,160 @@
+/*********************************************************************
+ *
+ * DesignClient.cpp:  Sends regions, VCF lines or sequences to a
+ * MedReseq server and prints the primers it designs.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+using namespace std;
+
+const static string MEDRESEQ_CLIENT_USAGE_STR = "Usage: ./MedReseqClient -S socket-file [input ...]\n"
+								"Sends the inputs to a server started with ./MedReseq --serve socket-file and prints\n"
+								"the tier and the primers of every input.\n"
+								"\t-S, --socket\tthe socket-file of the server\n"
+								"\tinput\ta region, VCF line or sequence, or a file of them one per line;\n"
+								"\t\tthe standard input is read when none is given\n";
+
+static bool writeFully(int fd, const string &text) {
+
+	const char *data = text.data();
+	size_t left = text.length();
+	while(left > 0) {
+		ssize_t written = write(fd, data, left);
+		if(written < 0 && errno == EINTR) {
+			continue;
+		}
+		if(written <= 0) {
+			return false;
+		}
+		data += written;
+		left -= written;
+	}
+	return true;
+}
+
+//Adds the lines of the stream to the request, leaving out empty lines,
+//which would end the request early.
+static void addLines(istream &input, string &request) {
+
+	string line;
+	while(getline(input, line)) {
+		if(!line.empty() && line != "\r") {
+			request += line;
+			request += '\n';
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+
+	string socketLoc;
+	string request;
+	bool hasInput = false;
+
+	for(int i = 1; i < argc; i++) {
+		if(!strcmp(argv[i], "-S") || !strcmp(argv[i], "--socket")) {
+			if(i + 1 == argc) {
+				cerr << MEDRESEQ_CLIENT_USAGE_STR;
+				return EXIT_FAILURE;
+			}
+			socketLoc = argv[++i];
+		}
+		else if(!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+			cout << MEDRESEQ_CLIENT_USAGE_STR;
+			return EXIT_SUCCESS;
+		}
+		else {
+			//An input is a file of lines if there is such a file.
+			struct stat fileStat;
+			if(stat(argv[i], &fileStat) == 0 && S_ISREG(fileStat.st_mode)) {
+				ifstream inputFile(argv[i]);
+				addLines(inputFile, request);
+			}
+			else {
+				request += argv[i];
+				request += '\n';
+			}
+			hasInput = true;
+		}
+	}
+
+	if(socketLoc.empty()) {
+		cerr << MEDRESEQ_CLIENT_USAGE_STR;
+		return EXIT_FAILURE;
+	}
+	if(!hasInput) {
+		addLines(cin, request);
+	}
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(socketLoc.length() >= sizeof(address.sun_path)) {
+		cerr << "The socket path is too long: " << socketLoc << endl;
+		return EXIT_FAILURE;
+	}
+	strcpy(address.sun_path, socketLoc.c_str());
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0 || connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+		cerr << "Could not connect to the server at " << socketLoc << ": " << strerror(errno) << endl;
+		return EXIT_FAILURE;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+
+	//One request, ended by an empty line; the server answers once it has
+	//read all of it.
+	request += '\n';
+	if(!writeFully(fd, request)) {
+		cerr << "Could not send the request: " << strerror(errno) << endl;
+		close(fd);
+		return EXIT_FAILURE;
+	}
+	shutdown(fd, SHUT_WR);
+
+	//The response is ended by an empty line, which is not printed.
+	string response;
+	char buffer[65536];
+	ssize_t count;
+	while((count = read(fd, buffer, sizeof(buffer))) != 0) {
+		if(count < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		response.append(buffer, count);
+	}
+	close(fd);
+
+	if(response.length() < 1 || response.compare(response.length() - 1, 1, "\n") != 0 ||
+			(response.length() > 1 && response.compare(response.length() - 2, 2, "\n\n") != 0)) {
+		cerr << "The server did not answer the whole request" << endl;
+		cout << response;
+		return EXIT_FAILURE;
+	}
+
+	cout << response.substr(0, response.length() - 1);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,266 @@
+/*********************************************************************
+ *
+ * DesignServer.cpp:  Designs primers for requests arriving on a Unix
+ * domain socket, with the reference and settings loaded once.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <iostream>
+#include <set>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "DesignServer.h"
+#include "OutputWriter.h"
+
+using namespace std;
+
+int DesignServer::MAX_WORKERS = 4;
+const int DesignServer::LISTEN_BACKLOG = 64;
+
+//Set by SIGINT and SIGTERM.
+static volatile sig_atomic_t stopRequested = 0;
+
+static void requestStop(int) {
+	stopRequested = 1;
+}
+
+//Only there so that a finished worker interrupts accept.
+static void workerFinished(int) {
+}
+
+/*
+ * Reads the lines of a connection through a buffer.
+ */
+class ConnectionReader {
+
+public:
+
+	ConnectionReader(int fd) : fd(fd), start(0), end(0) {}
+
+	/**
+	 * Reads the next line without its line break. Returns false at the end
+	 * of the connection when no more text is left.
+	 */
+	bool readLine(string &line) {
+
+		line.clear();
+		for(;;) {
+			if(start == end) {
+				ssize_t count = read(fd, buffer, sizeof(buffer));
+				if(count < 0 && errno == EINTR) {
+					continue;
+				}
+				if(count <= 0) {
+					return !line.empty();
+				}
+				start = 0;
+				end = count;
+			}
+
+			char *newline = (char *) memchr(buffer + start, '\n', end - start);
+			size_t length = (newline != NULL ? newline - buffer : end) - start;
+			line.append(buffer + start, length);
+			start += length;
+			if(newline != NULL) {
+				start++;
+				if(!line.empty() && line[line.length() - 1] == '\r') {
+					line.erase(line.length() - 1);
+				}
+				return true;
+			}
+		}
+	}
+
+protected:
+
+	int fd;
+	char buffer[65536];
+	size_t start;
+	size_t end;
+};
+
+/*
+ * The terse writer with the lines of the protocol around its records.
+ */
+class ResponseWriter : public PrimersWriter {
+
+public:
+
+	void writeLine(const string &line) {
+		append(line);
+		append('\n');
+	}
+};
+
+DesignServer::DesignServer(DesignSession &designSession) : designSession(designSession) {
+}
+
+bool DesignServer::serveRequest(const vector<string> &lines, int fd) {
+
+	ResponseWriter response;
+	response.attach(fd, "the connection");
+
+	designSession.design(lines, [&response](const DesignResult &result) {
+		if(result.isError()) {
+			response.writeLine("ERROR: " + result.error);
+		}
+		else {
+			response.writeLine(">" + result.tier);
+			response.write(result.primerOutput);
+		}
+	});
+
+	response.writeLine("");
+	return response.close();
+}
+
+void DesignServer::serveConnection(int fd) {
+
+	ConnectionReader reader(fd);
+	vector<string> lines;
+	string line;
+
+	while(reader.readLine(line)) {
+		if(line.empty()) {
+			if(!serveRequest(lines, fd)) {
+				return;
+			}
+			lines.clear();
+		}
+		else if(line[0] != '#') {
+			lines.push_back(line);
+		}
+	}
+
+	//The last request may be ended by the end of the connection.
+	if(!lines.empty()) {
+		serveRequest(lines, fd);
+	}
+}
+
+void DesignServer::reapWorkers(bool block) {
+
+	int status;
+	pid_t pid;
+	while(!workers.empty() && (pid = waitpid(-1, &status, block ? 0 : WNOHANG)) != 0) {
+		if(pid < 0) {
+			if(errno == EINTR && block && !stopRequested) {
+				continue;
+			}
+			if(errno == ECHILD) {
+				workers.clear();
+			}
+			return;
+		}
+		workers.erase(pid);
+		block = false;
+	}
+}
+
+bool DesignServer::serve(const string &socketLoc) {
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(socketLoc.length() >= sizeof(address.sun_path)) {
+		cerr << "The socket path is too long: " << socketLoc << endl;
+		return false;
+	}
+	strcpy(address.sun_path, socketLoc.c_str());
+
+	int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listenFd < 0) {
+		cerr << "Could not create a socket: " << strerror(errno) << endl;
+		return false;
+	}
+
+	unlink(socketLoc.c_str());
+	if(bind(listenFd, (struct sockaddr *) &address, sizeof(address)) != 0 ||
+			listen(listenFd, LISTEN_BACKLOG) != 0) {
+		cerr << "Could not listen on " << socketLoc << ": " << strerror(errno) << endl;
+		close(listenFd);
+		return false;
+	}
+
+	//No SA_RESTART, so that accept and waitpid return when a signal arrives.
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	sigemptyset(&action.sa_mask);
+	action.sa_handler = requestStop;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	action.sa_handler = workerFinished;
+	sigaction(SIGCHLD, &action, NULL);
+
+	//A client that goes away is seen as a failed write instead.
+	signal(SIGPIPE, SIG_IGN);
+
+	cout << "Serving on " << socketLoc << " with up to " << MAX_WORKERS << " workers" << endl;
+
+	while(!stopRequested) {
+
+		reapWorkers(false);
+		if((int) workers.size() >= MAX_WORKERS) {
+			reapWorkers(true);
+			continue;
+		}
+
+		int clientFd = accept(listenFd, NULL, NULL);
+		if(clientFd < 0) {
+			if(errno != EINTR && errno != ECONNABORTED) {
+				cerr << "Could not accept a connection: " << strerror(errno) << endl;
+			}
+			continue;
+		}
+
+		pid_t pid = fork();
+		if(pid == 0) {
+			close(listenFd);
+			signal(SIGINT, SIG_DFL);
+			signal(SIGTERM, SIG_DFL);
+			signal(SIGCHLD, SIG_DFL);
+
+			if(designSession.reopen()) {
+				serveConnection(clientFd);
+			}
+			close(clientFd);
+			_exit(EXIT_SUCCESS);
+		}
+
+		if(pid < 0) {
+			cerr << "Could not start a worker: " << strerror(errno) << endl;
+		}
+		else {
+			workers.insert(pid);
+		}
+		close(clientFd);
+	}
+
+	close(listenFd);
+	unlink(socketLoc.c_str());
+
+	//Clients may keep a connection open for good, so the workers are stopped.
+	for(set<pid_t>::const_iterator iterator=workers.begin(); iterator!=workers.end(); ++iterator) {
+		kill(*iterator, SIGTERM);
+	}
+	while(!workers.empty()) {
+		reapWorkers(true);
+	}
+
+	cout << "Stopped serving on " << socketLoc << endl;
+	return true;
+}
@@ -0,0 +1,89 @@
+/*********************************************************************
+ *
+ * DesignServer.h:  Designs primers for requests arriving on a Unix
+ * domain socket, with the reference and settings loaded once.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#ifndef DESIGNSERVER_H_
+#define DESIGNSERVER_H_
+
+#include <string>
+#include <vector>
+#include <set>
+#include <sys/types.h>
+
+#include "DesignSession.h"
+
+/**
+ * A long running MedReseq which keeps an open design session, and designs
+ * primers for the requests of its clients.
+ *
+ * A request is a block of lines ended by an empty line (or the end of
+ * the connection). Every line is an input of the session (a region, a VCF
+ * line or a sequence); lines starting with # are skipped.
+ *
+ * The response holds, for every line in order, a line with > and the tier
+ * of the region (the name of the terse file it would be written to, such
+ * as tier1 or not_found) followed by its terse (.primers) record, or a
+ * line starting with ERROR: for a line that could not be read. The
+ * response is ended by an empty line. A connection may carry any number
+ * of requests.
+ *
+ * primer3 keeps its state in globals, so every connection is served by a
+ * process forked from the loaded server; up to MAX_WORKERS connections
+ * are served at once and the rest wait to be accepted.
+ */
+class DesignServer {
+
+public:
+
+	//The number of connections served at the same time.
+	static int MAX_WORKERS;
+
+	//The number of connections waiting to be accepted.
+	const static int LISTEN_BACKLOG;
+
+	DesignServer(DesignSession &designSession);
+
+	/**
+	 * Listens on the socket and serves connections until the server is
+	 * sent SIGINT or SIGTERM. A file left at the socket location by an
+	 * earlier server is replaced. Returns false if the socket could not
+	 * be set up.
+	 */
+	bool serve(const std::string &socketLoc);
+
+protected:
+
+	DesignSession &designSession;
+
+	//The forked workers still running.
+	std::set<pid_t> workers;
+
+	/**
+	 * Serves the requests of one connection; run in the forked worker.
+	 */
+	void serveConnection(int fd);
+
+	/**
+	 * Designs primers for the lines of one request and writes the response.
+	 * Returns false if the response could not be written.
+	 */
+	bool serveRequest(const std::vector<std::string> &lines, int fd);
+
+	/**
+	 * Waits for finished workers; blocks until one finishes if block is set.
+	 */
+	void reapWorkers(bool block);
+};
+
+#endif /* DESIGNSERVER_H_ */
@@ -0,0 +1,174 @@
+/*********************************************************************
+ *
+ * DesignSession.cpp:  Designs primers for batches of regions, VCF lines
+ * or sequences in process, with the reference and settings loaded once.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <iostream>
+#include <utility>
+
+#include "DesignSession.h"
+#include "ConfigurationLoader.h"
+#include "SequencesAdapter.h"
+#include "VCFAdapter.h"
+#include "Utility.h"
+
+using namespace std;
+
+const string DesignSession::DEFAULT_CONFIG_FILE = "essentials/medreseq.config";
+
+//The name of a sequence given without one, as for the -s option.
+const static string UNNAMED_SEQUENCE = "UNKNOWN";
+
+DesignSession::DesignSession() : opened(false), hasFasta(false) {
+}
+
+bool DesignSession::open(const string &fastaFileLoc, const string &configFileLoc) {
+
+	ConfigurationHolder configHolder = ConfigurationLoader::obtainConfigurationSettings(configFileLoc);
+	ConfigurationLoader::applyConfigurationSetting(configHolder);
+
+	//The defaults are used for what could not be read, as MedReseq does.
+	if(configHolder.isError()) {
+		cerr << configHolder.getErrorMsg() << endl;
+	}
+
+	return open(fastaFileLoc, configHolder.getSettingsFiles());
+}
+
+bool DesignSession::open(const string &fastaFileLoc) {
+	return open(fastaFileLoc, DEFAULT_CONFIG_FILE);
+}
+
+bool DesignSession::open(const string &fastaFileLoc, const vector<string> &settingsFiles) {
+
+	opened = false;
+
+	if(!fastaFileLoc.empty()) {
+		if(!samtoolsWrapper.loadFastaFile(fastaFileLoc)) {
+			cerr << "Error in loading the fasta index file" << fastaFileLoc << endl;
+			return false;
+		}
+		hasFasta = true;
+	}
+
+	if(!primer3Wrapper.loadSettings(settingsFiles)) {
+		return false;
+	}
+
+	this->settingsFiles = settingsFiles;
+	opened = true;
+	return true;
+}
+
+bool DesignSession::retrieveSequence(const string &input, SequenceRegionOutput &seqRegOut, DesignResult &result) {
+
+	//A sequence may be given a name before it.
+	size_t separator = input.find_first_of(" \t");
+	size_t sequenceStart = input.find_first_not_of(" \t", separator);
+	string sequenceName = UNNAMED_SEQUENCE;
+	string sequence = input;
+	if(separator != string::npos && sequenceStart != string::npos) {
+		sequenceName = input.substr(0, separator);
+		sequence = input.substr(sequenceStart);
+	}
+
+	string region;
+	if(Utility::regexMatch(input.c_str(), SamtoolsWrapper::REGION_INPUT_PATTERN.c_str())) {
+		region = input;
+	}
+	else if(Utility::regexMatch(sequence.c_str(), SequencesAdapter::FASTA_SEQUENCE_PATTERN.c_str())) {
+		SequencesAdapter sequenceAdapter;
+		seqRegOut = sequenceAdapter.retrieveSequenceObj(sequenceName, sequence);
+	}
+	else {
+		VCFAdapter vcfAdapter;
+		region = vcfAdapter.extractRegionFromLine(input);
+		if(region.empty()) {
+			result.error = "not a region, VCF line or sequence: " + input;
+			return false;
+		}
+	}
+
+	if(!region.empty()) {
+		if(!hasFasta) {
+			result.error = "no fasta loaded for the region: " + input;
+			return false;
+		}
+		seqRegOut = samtoolsWrapper.retrieveSequenceForRegion(region);
+	}
+
+	if(seqRegOut.getTargetSequence().empty()) {
+		result.error = "no sequence in the reference for: " + input;
+		return false;
+	}
+	return true;
+}
+
+bool DesignSession::design(const vector<string> &inputs, const DesignCallback &callback) {
+
+	if(!opened) {
+		cerr << "The design session is not open" << endl;
+		return false;
+	}
+
+	for(vector<string>::const_iterator iterator=inputs.begin(); iterator!=inputs.end(); ++iterator) {
+
+		DesignResult result;
+		result.input = *iterator;
+
+		SequenceRegionOutput seqRegOut;
+		if(retrieveSequence(result.input, seqRegOut, result)) {
+			result.primerOutput = primer3Wrapper.createPrimers(settingsFiles, std::move(seqRegOut), result.tier);
+		}
+		callback(result);
+	}
+	return true;
+}
+
+vector<DesignResult> DesignSession::design(const vector<string> &inputs) {
+
+	vector<DesignResult> results;
+	results.reserve(inputs.size());
+	design(inputs, [&results](const DesignResult &result) {
+		results.push_back(result);
+	});
+	return results;
+}
+
+DesignResult DesignSession::design(const string &input) {
+
+	vector<DesignResult> results = design(vector<string>(1, input));
+	if(results.empty()) {
+		DesignResult result;
+		result.input = input;
+		result.error = "the design session is not open";
+		return result;
+	}
+	return std::move(results[0]);
+}
+
+bool DesignSession::reopen() {
+	return !hasFasta || samtoolsWrapper.reopenFastaFile();
+}
+
+bool DesignSession::isOpen() const {
+	return opened;
+}
+
+const vector<string> &DesignSession::getSettingsFiles() const {
+	return settingsFiles;
+}
+
+SamtoolsWrapper &DesignSession::getSamtoolsWrapper() {
+	return samtoolsWrapper;
+}
@@ -0,0 +1,147 @@
+/*********************************************************************
+ *
+ * DesignSession.h:  Designs primers for batches of regions, VCF lines
+ * or sequences in process, with the reference and settings loaded once.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#ifndef DESIGNSESSION_H_
+#define DESIGNSESSION_H_
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "SamtoolsWrapper.h"
+#include "Primer3Wrapper.h"
+
+/**
+ * The result of designing primers for one input of a batch.
+ */
+struct DesignResult {
+
+	//The input line as it was submitted.
+	std::string input;
+
+	//The tier of the input, the name of the terse file it would be written
+	//to (such as tier1 or not_found); empty when there is an error.
+	std::string tier;
+
+	//Why the input could not be designed for; empty when it was.
+	std::string error;
+
+	//The primers, along with the sequence they were designed for.
+	PrimerOutput primerOutput;
+
+	bool isError() const {
+		return !error.empty();
+	}
+};
+
+/**
+ * The library entry point of MedReseq (libmedreseq.a). A session is opened
+ * once with the reference and the settings, after which any number of
+ * batches are designed for reading nothing but the reference and writing
+ * nothing at all: the fasta index, the packed reference, the settings read
+ * from the settings files, the mispriming libraries and the thermodynamic
+ * tables all stay loaded between batches.
+ *
+ * Every input of a batch is one of:
+ *   chrName:startIndex-endIndex      a region
+ *   a tab delimited VCF line         the region around the variant
+ *   [name ]prev[target]next          a sequence
+ *
+ *	DesignSession session;
+ *	if(session.open("hg19.fa")) {
+ *		session.design(regions, [](const DesignResult &result) { ... });
+ *	}
+ *
+ * primer3 keeps its state in globals, so there should be one session per
+ * process, used from one thread at a time.
+ */
+class DesignSession {
+
+public:
+
+	//Receives the result of every input of a batch, in order.
+	typedef std::function<void(const DesignResult &)> DesignCallback;
+
+	//The configuration file used by MedReseq, relative to its root directory.
+	const static std::string DEFAULT_CONFIG_FILE;
+
+	DesignSession();
+
+	/**
+	 * Opens the session with the configuration file (see
+	 * essentials/medreseq.config), which sets the length around the targets,
+	 * the thermodynamic parameters and the settings files. The fasta file may
+	 * be left empty when only sequences are designed for. Returns false, with
+	 * the reason on cerr, if the fasta or a settings file could not be loaded.
+	 */
+	bool open(const std::string &fastaFileLoc, const std::string &configFileLoc);
+
+	/**
+	 * Opens the session as above with the default configuration file.
+	 */
+	bool open(const std::string &fastaFileLoc);
+
+	/**
+	 * Opens the session with the settings files in the order of preference,
+	 * leaving the configuration as it was applied by the caller.
+	 */
+	bool open(const std::string &fastaFileLoc, const std::vector<std::string> &settingsFiles);
+
+	/**
+	 * Designs primers for the inputs, handing the result of each to the
+	 * callback as soon as it is done. Returns false if the session is not open.
+	 */
+	bool design(const std::vector<std::string> &inputs, const DesignCallback &callback);
+
+	/**
+	 * Designs primers for the inputs and returns the results in order.
+	 */
+	std::vector<DesignResult> design(const std::vector<std::string> &inputs);
+
+	/**
+	 * Designs primers for a single input.
+	 */
+	DesignResult design(const std::string &input);
+
+	/**
+	 * Opens the fasta again, which a forked process has to do before it
+	 * designs, since the file is shared with its parent otherwise.
+	 */
+	bool reopen();
+
+	bool isOpen() const;
+
+	const std::vector<std::string> &getSettingsFiles() const;
+
+	SamtoolsWrapper &getSamtoolsWrapper();
+
+protected:
+
+	SamtoolsWrapper samtoolsWrapper;
+	Primer3Wrapper primer3Wrapper;
+
+	//The settings files in the order of preference.
+	std::vector<std::string> settingsFiles;
+
+	bool opened;
+	bool hasFasta;
+
+	/**
+	 * Reads one input into its sequence, or sets the error of the result.
+	 */
+	bool retrieveSequence(const std::string &input, SequenceRegionOutput &, DesignResult &);
+};
+
+#endif /* DESIGNSESSION_H_ */
@@ -0,0 +1,231 @@
+/*********************************************************************
+ *
+ * Metrics.cpp:  Per-stage timers and counters of a run.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <time.h>
+
+#include "Metrics.h"
+
+using namespace std;
+
+//Initialize the static members
+bool Metrics::IS_ENABLED = false;
+Metrics::StageTimes Metrics::stages[Metrics::NUM_STAGES];
+long Metrics::counters[Metrics::NUM_COUNTERS];
+vector<uint64_t> Metrics::regionLatencies;
+uint64_t Metrics::startNanos = Metrics::now();
+
+thread_local Metrics::Timer *Metrics::Timer::current = NULL;
+
+Metrics::Timer::Timer(Stage stage) : stage(stage), isTiming(IS_ENABLED), start(0), elapsed(0), parent(NULL) {
+
+	if(!isTiming) {
+		return;
+	}
+
+	start = Metrics::now();
+
+	//The enclosing timer is paused while this one runs.
+	parent = current;
+	if(parent != NULL) {
+		parent->elapsed += start - parent->start;
+	}
+	current = this;
+}
+
+Metrics::Timer::~Timer() {
+
+	if(!isTiming) {
+		return;
+	}
+
+	uint64_t end = Metrics::now();
+	elapsed += end - start;
+	Metrics::addTime(stage, elapsed);
+
+	current = parent;
+	if(parent != NULL) {
+		parent->start = end;
+	}
+}
+
+void Metrics::Timer::exclude(uint64_t nanos) {
+
+	if(isTiming) {
+		uint64_t sofar = elapsed + (Metrics::now() - start);
+		elapsed -= (nanos < sofar) ? nanos : sofar;
+	}
+}
+
+uint64_t Metrics::now() {
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void Metrics::addTime(Stage stage, uint64_t nanos) {
+
+	if(!IS_ENABLED) {
+		return;
+	}
+
+	StageTimes &times = stages[stage];
+
+	int bucket = 0;
+	while(bucket < NUM_BUCKETS - 1 && (nanos >> bucket) > 0) {
+		bucket++;
+	}
+
+	__sync_fetch_and_add(&times.calls, 1);
+	__sync_fetch_and_add(&times.totalNanos, nanos);
+	__sync_fetch_and_add(&times.buckets[bucket], 1);
+
+	uint64_t max = times.maxNanos;
+	while(nanos > max) {
+		uint64_t seen = __sync_val_compare_and_swap(&times.maxNanos, max, nanos);
+		if(seen == max) {
+			break;
+		}
+		max = seen;
+	}
+}
+
+void Metrics::addCount(Counter counter, long count/*=1*/) {
+
+	if(IS_ENABLED) {
+		__sync_fetch_and_add(&counters[counter], count);
+	}
+}
+
+void Metrics::addRegionLatency(uint64_t nanos) {
+
+	if(IS_ENABLED) {
+		regionLatencies.push_back(nanos);
+	}
+}
+
+const char *Metrics::stageName(Stage stage) {
+
+	switch(stage) {
+	case STAGE_SETTINGS:		return "settings";
+	case STAGE_THERMO:			return "thermo_load";
+	case STAGE_FETCH:			return "fasta_fetch";
+	case STAGE_CHOOSE_PRIMERS:	return "choose_primers";
+	case STAGE_THAL:			return "thal";
+	case STAGE_DPAL:			return "dpal";
+	case STAGE_OUTPUT:			return "output";
+	default:					return "unknown";
+	}
+}
+
+const char *Metrics::counterName(Counter counter) {
+
+	switch(counter) {
+	case COUNTER_REGIONS:			return "regions";
+	case COUNTER_SETTINGS_TRIED:	return "settings_files_tried";
+	case COUNTER_BASES_DECODED:		return "bases_decoded";
+	case COUNTER_LEFT_CONSIDERED:	return "left_considered";
+	case COUNTER_LEFT_OK:			return "left_ok";
+	case COUNTER_RIGHT_CONSIDERED:	return "right_considered";
+	case COUNTER_RIGHT_OK:			return "right_ok";
+	case COUNTER_PAIRS_CONSIDERED:	return "pairs_considered";
+	case COUNTER_PAIRS_OK:			return "pairs_ok";
+	case COUNTER_PAIRS_RETURNED:	return "pairs_returned";
+	case COUNTER_THAL_CALLS:		return "thal_calls";
+	case COUNTER_DPAL_CALLS:		return "dpal_calls";
+	default:						return "unknown";
+	}
+}
+
+bool Metrics::writeReport(const string &fileLoc) {
+
+	ofstream report(fileLoc.c_str(), ios::out | ios::trunc);
+	if(!report.is_open()) {
+		cerr << "Could not open the metrics file " << fileLoc << endl;
+		return false;
+	}
+
+	report << fixed << setprecision(6);
+	report << "{" << endl;
+	report << "  \"wall_seconds\": " << (now() - startNanos) * 1e-9 << "," << endl;
+
+	//The stages, with the histogram given as [upper bound in us, count]
+	//for every non-empty bucket.
+	report << "  \"stages\": {" << endl;
+	for(int i = 0; i < NUM_STAGES; i++) {
+		const StageTimes &times = stages[i];
+		report << "    \"" << stageName((Stage) i) << "\": {"
+				<< "\"calls\": " << times.calls
+				<< ", \"total_seconds\": " << times.totalNanos * 1e-9
+				<< ", \"mean_us\": " << (times.calls > 0 ? times.totalNanos * 1e-3 / times.calls : 0.0)
+				<< ", \"max_us\": " << times.maxNanos * 1e-3
+				<< ", \"histogram_us\": [";
+		bool isFirst = true;
+		for(int bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+			if(times.buckets[bucket] > 0) {
+				report << (isFirst ? "" : ", ") << "[" << (1ULL << bucket) * 1e-3 << ", " << times.buckets[bucket] << "]";
+				isFirst = false;
+			}
+		}
+		report << "]}" << (i + 1 < NUM_STAGES ? "," : "") << endl;
+	}
+	report << "  }," << endl;
+
+	report << "  \"counters\": {" << endl;
+	for(int i = 0; i < NUM_COUNTERS; i++) {
+		report << "    \"" << counterName((Counter) i) << "\": " << counters[i]
+				<< (i + 1 < NUM_COUNTERS ? "," : "") << endl;
+	}
+	report << "  }," << endl;
+
+	//Nearest rank percentiles of the per-region primer design time.
+	vector<uint64_t> latencies = regionLatencies;
+	sort(latencies.begin(), latencies.end());
+
+	uint64_t total = 0;
+	for(vector<uint64_t>::const_iterator iterator=latencies.begin(); iterator!=latencies.end(); ++iterator) {
+		total += *iterator;
+	}
+
+	const double percentiles[] = {50, 90, 99};
+	const char *percentileNames[] = {"p50", "p90", "p99"};
+
+	report << "  \"region_latency_ms\": {\"count\": " << latencies.size()
+			<< ", \"mean\": " << (latencies.empty() ? 0.0 : total * 1e-6 / latencies.size());
+	for(int i = 0; i < 3; i++) {
+		double value = 0.0;
+		if(!latencies.empty()) {
+			size_t rank = (size_t) ceil(percentiles[i] / 100.0 * latencies.size());
+			value = latencies[rank > 0 ? rank - 1 : 0] * 1e-6;
+		}
+		report << ", \"" << percentileNames[i] << "\": " << value;
+	}
+	report << ", \"max\": " << (latencies.empty() ? 0.0 : latencies.back() * 1e-6) << "}" << endl;
+
+	report << "}" << endl;
+
+	report.close();
+	if(report.fail()) {
+		cerr << "Could not write the metrics file " << fileLoc << endl;
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,153 @@
+/*********************************************************************
+ *
+ * Metrics.h:  Per-stage timers and counters of a run.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * Collects where the wall time of a run goes. Every stage keeps the
+ * number of timed scopes, their total and maximum duration and a
+ * histogram of the durations in power of two buckets; counters keep
+ * plain totals, and the primer design time of each region is kept for
+ * percentiles. Nothing is measured unless IS_ENABLED is set, so the
+ * timers cost one test of a flag in a normal run.
+ *
+ * The stages do not overlap, so that their totals add up to at most the
+ * wall time: a timer started inside another one pauses it until it ends,
+ * and time given to a stage from inside a timer is taken out of it with
+ * exclude().
+ *
+ * Stages and counters may be updated from several threads. Region
+ * latencies are added by the main pipeline only.
+ */
+class Metrics {
+
+public:
+
+	//The timed stages.
+	enum Stage {
+		STAGE_SETTINGS,         //Reading a settings file, but for the thermo parameters.
+		STAGE_THERMO,           //Loading the thermodynamic parameters.
+		STAGE_FETCH,            //Fetching the sequence of a region and around it.
+		STAGE_CHOOSE_PRIMERS,   //primer3's choose_primers, but for the alignments.
+		STAGE_THAL,             //Thermodynamic alignments, per choose_primers call.
+		STAGE_DPAL,             //Dynamic programming alignments, per choose_primers call.
+		STAGE_OUTPUT,           //Formatting and writing the output files.
+		NUM_STAGES
+	};
+
+	//The counted events.
+	enum Counter {
+		COUNTER_REGIONS,
+		COUNTER_SETTINGS_TRIED,
+		COUNTER_BASES_DECODED,
+		COUNTER_LEFT_CONSIDERED,
+		COUNTER_LEFT_OK,
+		COUNTER_RIGHT_CONSIDERED,
+		COUNTER_RIGHT_OK,
+		COUNTER_PAIRS_CONSIDERED,
+		COUNTER_PAIRS_OK,
+		COUNTER_PAIRS_RETURNED,
+		COUNTER_THAL_CALLS,
+		COUNTER_DPAL_CALLS,
+		NUM_COUNTERS
+	};
+
+	//Turns the collection on; set from main with --metrics.
+	static bool IS_ENABLED;
+
+	/**
+	 * Times the scope it lives in and adds it to a stage, leaving out the
+	 * timers of the same thread nested in it.
+	 */
+	class Timer {
+	public:
+		Timer(Stage stage);
+		~Timer();
+
+		/**
+		 * Leaves the given time, added to another stage, out of this one.
+		 */
+		void exclude(uint64_t nanos);
+
+	private:
+		Stage stage;
+		bool isTiming;
+
+		//When the timer was last started or resumed, and the time
+		//counted before that.
+		uint64_t start;
+		uint64_t elapsed;
+
+		//The timer this one is nested in.
+		Timer *parent;
+
+		//The innermost timer of the thread.
+		static thread_local Timer *current;
+
+		Timer(const Timer &);
+		Timer &operator=(const Timer &);
+	};
+
+	/**
+	 * A monotonic clock in nanoseconds.
+	 */
+	static uint64_t now();
+
+	/**
+	 * Adds one timed scope of the given duration to a stage.
+	 */
+	static void addTime(Stage stage, uint64_t nanos);
+
+	static void addCount(Counter counter, long count = 1);
+
+	/**
+	 * Adds the time taken to design the primers for one region.
+	 */
+	static void addRegionLatency(uint64_t nanos);
+
+	/**
+	 * Writes the stage totals, histograms, counters and region latency
+	 * percentiles as JSON. Returns false if the file could not be written.
+	 */
+	static bool writeReport(const std::string &fileLoc);
+
+protected:
+
+	//The number of histogram buckets; bucket i holds durations below 2^i ns.
+	const static int NUM_BUCKETS = 48;
+
+	struct StageTimes {
+		uint64_t calls;
+		uint64_t totalNanos;
+		uint64_t maxNanos;
+		uint64_t buckets[NUM_BUCKETS];
+	};
+
+	static StageTimes stages[NUM_STAGES];
+	static long counters[NUM_COUNTERS];
+	static std::vector<uint64_t> regionLatencies;
+
+	//The time collection started, for the wall time of the run.
+	static uint64_t startNanos;
+
+	static const char *stageName(Stage);
+	static const char *counterName(Counter);
+};
+
+#endif /* METRICS_H_ */
@@ -0,0 +1,381 @@
+/*********************************************************************
+ *
+ * OutputWriter.cpp:  Buffered writers for the medreseq and primers files.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "OutputWriter.h"
+#include "Primer3Wrapper.h"
+#include "SequenceRegions.h"
+#include "Trace.h"
+
+using namespace std;
+
+//Initialize the static members
+const size_t OutputWriter::BUFFER_SIZE = 1 << 20;
+
+//=============================================================================================================
+//OutputWriter class methods.
+
+OutputWriter::OutputWriter() : fd(-1), ownsFd(false), offset(0), buffer(NULL), used(0), failed(false) {
+
+}
+
+OutputWriter::~OutputWriter() {
+
+	close();
+}
+
+bool OutputWriter::open(const string &fileLoc) {
+
+	close();
+
+	int newFd = ::open(fileLoc.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(newFd < 0) {
+		cerr << "Could not open the file " << fileLoc << " for writing" << endl;
+		attach(-1, fileLoc);
+		return false;
+	}
+
+	attach(newFd, fileLoc);
+	ownsFd = true;
+
+	return true;
+}
+
+bool OutputWriter::resume(const string &fileLoc, off_t length) {
+
+	close();
+
+	int newFd = ::open(fileLoc.c_str(), O_WRONLY);
+	struct stat fileStat;
+	if(newFd < 0 || fstat(newFd, &fileStat) != 0 || fileStat.st_size < length ||
+			ftruncate(newFd, length) != 0 || lseek(newFd, length, SEEK_SET) != length) {
+		cerr << "Could not resume writing the file " << fileLoc << " after " << length << " bytes" << endl;
+		if(newFd >= 0) {
+			::close(newFd);
+		}
+		attach(-1, fileLoc);
+		return false;
+	}
+
+	attach(newFd, fileLoc);
+	ownsFd = true;
+	offset = length;
+
+	return true;
+}
+
+bool OutputWriter::attach(int fd, const string &name) {
+
+	close();
+
+	if(buffer == NULL) {
+		buffer = new char[BUFFER_SIZE];
+	}
+
+	this->fd = fd;
+	this->ownsFd = false;
+	this->fileLoc = name;
+	this->used = 0;
+	this->offset = 0;
+	this->failed = false;
+
+	return fd >= 0;
+}
+
+bool OutputWriter::isOpen() const {
+	return fd >= 0;
+}
+
+bool OutputWriter::writeFully(const char *data, size_t len) {
+
+	while(len > 0) {
+		ssize_t written = ::write(fd, data, len);
+		if(written < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		data += written;
+		len -= written;
+		offset += written;
+	}
+
+	return true;
+}
+
+bool OutputWriter::flush() {
+
+	if(used > 0 && fd >= 0 && !failed) {
+		Trace::Span span("flush", "output");
+		if(Trace::IS_ENABLED) {
+			span.setDetail(fileLoc);
+		}
+
+		if(!writeFully(buffer, used)) {
+			cerr << "Could not write to the file " << fileLoc << ": " << strerror(errno) << endl;
+			failed = true;
+		}
+	}
+	used = 0;
+
+	return !failed;
+}
+
+bool OutputWriter::sync() {
+
+	if(flush() && fd >= 0 && ownsFd && fsync(fd) != 0) {
+		cerr << "Could not write to the file " << fileLoc << ": " << strerror(errno) << endl;
+		failed = true;
+	}
+
+	return !failed;
+}
+
+off_t OutputWriter::getOffset() const {
+	return offset;
+}
+
+bool OutputWriter::close() {
+
+	bool retVal = flush();
+
+	if(fd >= 0 && ownsFd) {
+		if(::close(fd) != 0 && !failed) {
+			cerr << "Could not write to the file " << fileLoc << ": " << strerror(errno) << endl;
+			retVal = false;
+		}
+	}
+	fd = -1;
+	ownsFd = false;
+
+	delete[] buffer;
+	buffer = NULL;
+
+	return retVal;
+}
+
+void OutputWriter::append(const char *data, size_t len) {
+
+	//A writer which was never opened, or has been closed, has no buffer;
+	//what is written to it is lost, and close() says so.
+	if(buffer == NULL) {
+		if(!failed) {
+			cerr << "Could not write to the file " << fileLoc << ": it is not open" << endl;
+			failed = true;
+		}
+		return;
+	}
+
+	if(used + len > BUFFER_SIZE) {
+		flush();
+
+		//Anything that would not fit in the buffer goes straight to the file.
+		if(len > BUFFER_SIZE) {
+			if(fd >= 0 && !failed && !writeFully(data, len)) {
+				cerr << "Could not write to the file " << fileLoc << ": " << strerror(errno) << endl;
+				failed = true;
+			}
+			return;
+		}
+	}
+
+	memcpy(buffer + used, data, len);
+	used += len;
+}
+
+void OutputWriter::appendInt(long value) {
+
+	//Digits are formed from the last one backwards.
+	char digits[24];
+	char *end = digits + sizeof(digits);
+	char *pos = end;
+
+	unsigned long magnitude = (value < 0) ? -(unsigned long) value : (unsigned long) value;
+	do {
+		*--pos = '0' + (char) (magnitude % 10);
+		magnitude /= 10;
+	} while(magnitude > 0);
+
+	if(value < 0) {
+		*--pos = '-';
+	}
+
+	append(pos, end - pos);
+}
+
+void OutputWriter::appendRegion(const SequenceRegionInput &region) {
+
+	append(region.getRegionName());
+	append(':');
+	appendInt(region.getStartIndex());
+	append('-');
+	appendInt(region.getEndIndex());
+}
+
+void OutputWriter::appendPrimerName(const SequenceRegionInput &region, bool isLeftPrimer) {
+
+	const char *chromosomeToMatch = "chr";
+	const string &regionName = region.getRegionName();
+
+	size_t pos = regionName.find(chromosomeToMatch);
+	if(pos != string::npos) {
+		pos += strlen(chromosomeToMatch);
+		append(regionName.data() + pos, regionName.length() - pos);
+	}
+	else {
+		append(regionName);
+	}
+
+	append('-');
+	appendInt(region.getStartIndex());
+	append(isLeftPrimer ? 'F' : 'R');
+}
+
+//=============================================================================================================
+//MedReseqWriter class methods.
+
+void MedReseqWriter::appendPrimer(const SequenceRegionInput &region, const SinglePrimer &primer, bool isLeftPrimer) {
+
+	appendPrimerName(region, isLeftPrimer);
+	append('=');
+	append(primer.getSequence());
+	append("| Start: ");
+	appendInt(primer.getStartIndex() + 1);
+	append(" | Length: ");
+	appendInt(primer.getLength());
+	append(" | Temperature: ");
+	appendInt((int) primer.getMeltingTemperature());
+	append(" | GC%: ");
+	appendInt(primer.getGcPercent());
+	append('\n');
+}
+
+void MedReseqWriter::write(const PrimerOutput &primerOut) {
+
+	const SequenceRegionOutput &seqOut = primerOut.getSeqOutput();
+	const SequenceRegionInput &region = seqOut.getSeqRegInput();
+
+	append('>');
+	appendRegion(region);
+	append('\n');
+
+	append(seqOut.getPrevSequence());
+	append('[');
+	append(seqOut.getTargetSequence());
+	append(']');
+	append(seqOut.getNextSequence());
+	append('\n');
+
+	append("Target: [");
+	appendInt(seqOut.getPrevSequence().length() + 1);
+	append(',');
+	appendInt(seqOut.getTargetSequence().length());
+	append("]\n");
+
+	append("Settings file : ");
+	append(primerOut.getSettingsFile());
+	append('\n');
+
+	if(!primerOut.getGlobalError().empty()) {
+		append("ERROR: ");
+		append(primerOut.getGlobalError());
+		append("\n\n");
+	}
+	else if(!primerOut.getSequenceError().empty()) {
+		append("ERROR: ");
+		append(primerOut.getSequenceError());
+		append("\n\n");
+	}
+	else {
+
+		if(!primerOut.getWarning().empty()) {
+			append("WARNING: ");
+			append(primerOut.getWarning());
+			append('\n');
+		}
+
+		const vector<PrimerPair> &primerPairs = primerOut.getPrimerPairs();
+		for(unsigned int i = 0; i < primerPairs.size(); i++) {
+
+			if(i >= 1) {
+				append("Alternative Primer ");
+				appendInt(i);
+				append(":\n");
+			}
+
+			appendPrimer(region, primerPairs[i].getLeftPrimer(), true);
+			appendPrimer(region, primerPairs[i].getRightPrimer(), false);
+
+			append("Overall Product size: ");
+			appendInt(primerPairs[i].getProductSize());
+			append('\n');
+		}
+		append('\n');
+	}
+}
+
+//=============================================================================================================
+//PrimersWriter class methods.
+
+void PrimersWriter::appendError(const SequenceRegionInput &region, const string &error) {
+
+	appendPrimerName(region, true);
+	append(", ERROR: ");
+	append(error);
+	append('\n');
+	appendPrimerName(region, false);
+	append(", ERROR: ");
+	append(error);
+	append('\n');
+}
+
+void PrimersWriter::write(const PrimerOutput &primerOut) {
+
+	const SequenceRegionInput &region = primerOut.getSeqOutput().getSeqRegInput();
+
+	if(!primerOut.getGlobalError().empty()) {
+		appendError(region, primerOut.getGlobalError());
+	}
+	else if(!primerOut.getSequenceError().empty()) {
+		appendError(region, primerOut.getSequenceError());
+	}
+	else {
+		if(!primerOut.getWarning().empty()) {
+			append("WARNING: ");
+			append(primerOut.getWarning());
+			append('\n');
+		}
+
+		if(!primerOut.getPrimerPairs().empty()) {
+			const PrimerPair &primerPair = primerOut.getPrimerPairs()[0];
+
+			appendPrimerName(region, true);
+			append(", ");
+			append(primerPair.getLeftPrimer().getSequence());
+			append('\n');
+			appendPrimerName(region, false);
+			append(", ");
+			append(primerPair.getRightPrimer().getSequence());
+			append('\n');
+		}
+	}
+}
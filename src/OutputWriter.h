@@ -0,0 +1,163 @@
+/*********************************************************************
+ *
+ * OutputWriter.h:  Buffered writers for the medreseq and primers files.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#ifndef OUTPUTWRITER_H_
+#define OUTPUTWRITER_H_
+
+#include <string>
+#include <cstddef>
+#include <sys/types.h>
+
+class PrimerOutput;
+class SinglePrimer;
+class SequenceRegionInput;
+
+/**
+ * A file writer which formats text into one large buffer that is reused
+ * for the life time of the writer, and hands it to the file only when
+ * the buffer is full or the writer is flushed or closed. Records are
+ * formatted straight from the primer model, so writing a record does
+ * not allocate.
+ */
+class OutputWriter {
+
+public:
+
+	//The number of bytes gathered before they are written to the file.
+	const static size_t BUFFER_SIZE;
+
+	OutputWriter();
+	virtual ~OutputWriter();
+
+	/**
+	 * Creates (or truncates) the file and opens it for writing.
+	 * Returns false if the file could not be created, in which case
+	 * whatever is written is dropped.
+	 */
+	bool open(const std::string &fileLoc);
+
+	/**
+	 * Opens the file written by an earlier run, cuts it back to the given
+	 * length and writes after it. Returns false if the file is shorter than
+	 * that or could not be opened.
+	 */
+	bool resume(const std::string &fileLoc, off_t length);
+
+	/**
+	 * Writes to an already open descriptor, such as the standard output,
+	 * which is not closed by the writer.
+	 */
+	bool attach(int fd, const std::string &name);
+
+	bool isOpen() const;
+
+	/**
+	 * Writes out the buffered text. Returns false if any write to the file
+	 * has failed so far.
+	 */
+	bool flush();
+
+	/**
+	 * Flushes and has the file written through to the disk, so that it
+	 * survives the machine going down. Returns false if any write has failed.
+	 */
+	bool sync();
+
+	/**
+	 * The length of the file up to what has been flushed.
+	 */
+	off_t getOffset() const;
+
+	/**
+	 * Flushes and closes the file. Returns false if any write has failed.
+	 */
+	bool close();
+
+protected:
+
+	//The file written to and a descriptive name used for errors.
+	int fd;
+	bool ownsFd;
+	std::string fileLoc;
+
+	//The bytes in the file, those written before it was resumed included.
+	off_t offset;
+
+	//The buffer and the number of bytes used in it.
+	char *buffer;
+	size_t used;
+
+	//Set once a write fails, so that the error is reported just once.
+	bool failed;
+
+	void append(const char *data, size_t len);
+	void append(const std::string &str) { append(str.data(), str.length()); }
+	template<size_t N> void append(const char (&literal)[N]) { append(literal, N - 1); }
+	void append(char c) {
+		if(used == BUFFER_SIZE || buffer == NULL) {
+			append(&c, 1);
+			return;
+		}
+		buffer[used++] = c;
+	}
+	void appendInt(long value);
+
+	/**
+	 * Appends the region in the format chrName:startIndex-endIndex.
+	 */
+	void appendRegion(const SequenceRegionInput &region);
+
+	/**
+	 * Appends the name of a primer, in the format ChromosomeNumber-startIndex(F|R).
+	 * The boolean parameter determines if it is a Forward or a Reverse primer.
+	 */
+	void appendPrimerName(const SequenceRegionInput &region, bool isLeftPrimer);
+
+private:
+	//Writes out len bytes, retrying short writes.
+	bool writeFully(const char *data, size_t len);
+
+	//The writer owns its buffer and file and is not copied.
+	OutputWriter(const OutputWriter &);
+	OutputWriter &operator=(const OutputWriter &);
+};
+
+/**
+ * Writes the comprehensive (.medreseq) record of a primer output: the
+ * region, its sequence with the target enclosed, and every primer pair
+ * with its properties.
+ */
+class MedReseqWriter : public OutputWriter {
+
+public:
+	void write(const PrimerOutput &primerOut);
+
+protected:
+	void appendPrimer(const SequenceRegionInput &region, const SinglePrimer &primer, bool isLeftPrimer);
+};
+
+/**
+ * Writes the terse (.primers) record of a primer output: the sequences of
+ * the best primer pair, or the error for the region.
+ */
+class PrimersWriter : public OutputWriter {
+
+public:
+	void write(const PrimerOutput &primerOut);
+
+protected:
+	void appendError(const SequenceRegionInput &region, const std::string &error);
+};
+
+#endif /* OUTPUTWRITER_H_ */
@@ -0,0 +1,350 @@
+/*********************************************************************
+ *
+ * PackedReference.cpp:  The 2-bit packed cache of the reference fasta.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+
+#include "PackedReference.h"
+#include "CacheFile.h"
+
+using namespace std;
+
+/*
+ * Layout of the cache file, in host byte order. All offsets are from the
+ * start of the file and every section starts on an 8 byte boundary.
+ *
+ *   Header
+ *   Contig[contigCount]       in fasta index order
+ *   per contig: packed bases  base i in bits 2*(i%4) of byte i/4, A=0 C=1 G=2 T=3
+ *               Run[]         bases that are not ACGT, one character per run
+ *               Run[]         lowercase intervals
+ *   contig names              NUL-terminated
+ */
+struct PackedReference::Header {
+	CacheFile::Stamp stamp;
+	uint64_t contigCount;
+	uint64_t fileSize;
+};
+
+struct PackedReference::Contig {
+	uint64_t length;
+	uint64_t nameOffset;
+	uint64_t packedOffset;
+	uint64_t otherOffset;
+	uint64_t otherCount;
+	uint64_t maskOffset;
+	uint64_t maskCount;
+};
+
+//Positions are 64-bit like the other offsets of the file.
+struct PackedReference::Run {
+	uint64_t start;
+	uint64_t length;
+	uint32_t base;
+	uint32_t unused;
+};
+
+const string PackedReference::PACKED_FILE_EXTENSION = ".2bc";
+
+static const char PACKED_MAGIC[8] = "MR2BIT2";
+
+//The number of bases read from the fasta at a time while building.
+static const int BUILD_CHUNK_SIZE = 1 << 20;
+
+//Four decoded bases for every possible packed byte.
+static char unpackTable[256][4];
+
+static void initUnpackTable() {
+
+	static bool initialized = false;
+	if(initialized) {
+		return;
+	}
+	for(int byte = 0; byte < 256; byte++) {
+		for(int k = 0; k < 4; k++) {
+			unpackTable[byte][k] = "ACGT"[(byte >> (2 * k)) & 3];
+		}
+	}
+	initialized = true;
+}
+
+static bool writeAll(FILE *file, const void *data, size_t size) {
+	return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+static bool padTo8(FILE *file, uint64_t &offset) {
+
+	static const char zeros[8] = {0};
+	size_t pad = (8 - offset % 8) % 8;
+	offset += pad;
+	return writeAll(file, zeros, pad);
+}
+
+PackedReference::PackedReference() : mapping(NULL), mappingSize(0), header(NULL), contigs(NULL) {
+	initUnpackTable();
+}
+
+PackedReference::~PackedReference() {
+	this->close();
+}
+
+bool PackedReference::isOpen() const {
+	return mapping != NULL;
+}
+
+void PackedReference::close() {
+
+	CacheFile::unmap(mapping, mappingSize);
+	mapping = NULL;
+	mappingSize = 0;
+	header = NULL;
+	contigs = NULL;
+}
+
+bool PackedReference::open(string fastaFileLoc, const faidx_t *fai) {
+
+	this->close();
+
+	string cacheFileLoc = fastaFileLoc + PACKED_FILE_EXTENSION;
+	if(this->map(fastaFileLoc, cacheFileLoc, fai)) {
+		return true;
+	}
+
+	if(!this->build(fastaFileLoc, cacheFileLoc, fai)) {
+		return false;
+	}
+	return this->map(fastaFileLoc, cacheFileLoc, fai);
+}
+
+bool PackedReference::map(string fastaFileLoc, string cacheFileLoc, const faidx_t *fai) {
+
+	mapping = CacheFile::map(cacheFileLoc, PACKED_MAGIC, fastaFileLoc, sizeof(Header), mappingSize);
+	if(mapping == NULL) {
+		return false;
+	}
+
+	header = (const Header *) mapping;
+	contigs = (const Contig *) (header + 1);
+
+	int contigCount = faidx_fetch_nseq(fai);
+	bool valid = header->fileSize == mappingSize &&
+			header->contigCount == (uint64_t) contigCount &&
+			sizeof(Header) + contigCount * sizeof(Contig) <= mappingSize;
+
+	//The contig ids must be those of the index.
+	for(int id = 0; valid && id < contigCount; id++) {
+		const Contig &contig = contigs[id];
+		valid = contig.length == (uint64_t) faidx_seq_len(fai, id) &&
+				contig.nameOffset < mappingSize &&
+				strncmp(mapping + contig.nameOffset, faidx_iseq(fai, id),
+						mappingSize - contig.nameOffset) == 0 &&
+				contig.packedOffset + (contig.length + 3) / 4 <= mappingSize &&
+				contig.otherOffset + contig.otherCount * sizeof(Run) <= mappingSize &&
+				contig.maskOffset + contig.maskCount * sizeof(Run) <= mappingSize;
+	}
+
+	if(!valid) {
+		this->close();
+	}
+	return valid;
+}
+
+bool PackedReference::build(string fastaFileLoc, string cacheFileLoc, const faidx_t *fai) {
+
+	Header head;
+	memset(&head, 0, sizeof(head));
+	if(!CacheFile::stamp(head.stamp, PACKED_MAGIC, fastaFileLoc)) {
+		return false;
+	}
+
+	//A contig too long for the int coordinates of faidx has no length, and
+	//is read from the fasta like every other contig.
+	int contigCount = faidx_fetch_nseq(fai);
+	for(int id = 0; id < contigCount; id++) {
+		if(faidx_seq_len(fai, id) < 0) {
+			return false;
+		}
+	}
+
+	string tempFileLoc = CacheFile::tempFileLoc(cacheFileLoc);
+	FILE *file = fopen(tempFileLoc.c_str(), "wb");
+	if(file == NULL) {
+		return false;
+	}
+
+	vector<Contig> contigTable(contigCount);
+
+	head.contigCount = contigCount;
+
+	//The header and the contig table are written again once the offsets are known.
+	uint64_t offset = sizeof(Header) + contigCount * sizeof(Contig);
+	bool ok = writeAll(file, &head, sizeof(head)) &&
+			writeAll(file, &contigTable[0], contigCount * sizeof(Contig));
+
+	vector<char> chunk(BUILD_CHUNK_SIZE + 1);
+	vector<unsigned char> packed;
+	vector<Run> others, masks;
+
+	for(int id = 0; ok && id < contigCount; id++) {
+		long length = faidx_seq_len(fai, id);
+		packed.assign((length + 3) / 4, 0);
+		others.clear();
+		masks.clear();
+
+		for(long chunkStart = 0; ok && chunkStart < length; chunkStart += BUILD_CHUNK_SIZE) {
+			long chunkEnd = min(length, chunkStart + BUILD_CHUNK_SIZE);
+			int read = faidx_fetch_id(fai, id, chunkStart, chunkEnd, &chunk[0]);
+			if(read != chunkEnd - chunkStart) {
+				ok = false;
+				break;
+			}
+
+			for(long i = chunkStart; i < chunkEnd; i++) {
+				char base = chunk[i - chunkStart];
+				int code = CacheFile::baseCode(base);
+
+				if(code >= 0) {
+					packed[i / 4] |= code << (2 * (i % 4));
+				}
+				else {
+					uint32_t upper = toupper((unsigned char) base);
+					if(!others.empty() && others.back().base == upper &&
+							others.back().start + others.back().length == (uint64_t) i) {
+						others.back().length++;
+					}
+					else {
+						Run run = {(uint64_t) i, 1, upper, 0};
+						others.push_back(run);
+					}
+				}
+
+				if(islower((unsigned char) base)) {
+					if(!masks.empty() && masks.back().start + masks.back().length == (uint64_t) i) {
+						masks.back().length++;
+					}
+					else {
+						Run run = {(uint64_t) i, 1, 0, 0};
+						masks.push_back(run);
+					}
+				}
+			}
+		}
+
+		Contig &contig = contigTable[id];
+		contig.length = length;
+		contig.packedOffset = offset;
+		ok = ok && writeAll(file, packed.empty() ? NULL : &packed[0], packed.size());
+		offset += packed.size();
+		ok = ok && padTo8(file, offset);
+
+		contig.otherOffset = offset;
+		contig.otherCount = others.size();
+		ok = ok && writeAll(file, others.empty() ? NULL : &others[0], others.size() * sizeof(Run));
+		offset += others.size() * sizeof(Run);
+
+		contig.maskOffset = offset;
+		contig.maskCount = masks.size();
+		ok = ok && writeAll(file, masks.empty() ? NULL : &masks[0], masks.size() * sizeof(Run));
+		offset += masks.size() * sizeof(Run);
+		ok = ok && padTo8(file, offset);
+	}
+
+	for(int id = 0; ok && id < contigCount; id++) {
+		const char *name = faidx_iseq(fai, id);
+		contigTable[id].nameOffset = offset;
+		ok = writeAll(file, name, strlen(name) + 1);
+		offset += strlen(name) + 1;
+	}
+
+	head.fileSize = offset;
+	ok = ok && fseek(file, 0, SEEK_SET) == 0 &&
+			writeAll(file, &head, sizeof(head)) &&
+			writeAll(file, &contigTable[0], contigCount * sizeof(Contig));
+
+	if(fclose(file) != 0) {
+		ok = false;
+	}
+
+	return CacheFile::commit(tempFileLoc, cacheFileLoc, ok);
+}
+
+bool PackedReference::endsAfter(uint64_t pos, const Run &run) {
+	return pos < run.start + run.length;
+}
+
+long PackedReference::getContigLength(int contigId) const {
+
+	if(mapping == NULL || contigId < 0 || (uint64_t) contigId >= header->contigCount) {
+		return -1;
+	}
+	return contigs[contigId].length;
+}
+
+int PackedReference::fetch(int contigId, long beg, long end, char *buf) const {
+
+	long length = getContigLength(contigId);
+	if(length < 0) {
+		return -1;
+	}
+
+	if(beg < 0) beg = 0;
+	if(beg >= length) beg = length;
+	if(end >= length) end = length;
+	if(beg > end) beg = end;
+
+	const Contig &contig = contigs[contigId];
+	const unsigned char *packed = (const unsigned char *) (mapping + contig.packedOffset);
+	char *out = buf;
+	long i = beg;
+
+	//Unpack a whole byte (four bases) at a time between the unaligned ends.
+	for(; i < end && (i & 3) != 0; i++) {
+		*out++ = unpackTable[packed[i >> 2]][i & 3];
+	}
+	for(; i + 4 <= end; i += 4, out += 4) {
+		memcpy(out, unpackTable[packed[i >> 2]], 4);
+	}
+	for(; i < end; i++) {
+		*out++ = unpackTable[packed[i >> 2]][i & 3];
+	}
+	*out = '\0';
+
+	//Put back the bases that are not ACGT, then the soft masking. The runs
+	//are sorted and disjoint, so they are found from the first ending after beg.
+	const Run *others = (const Run *) (mapping + contig.otherOffset);
+	const Run *othersEnd = others + contig.otherCount;
+	for(const Run *run = upper_bound(others, othersEnd, (uint64_t) beg, endsAfter);
+			run < othersEnd && run->start < (uint64_t) end; run++) {
+		long from = max<long>(beg, run->start);
+		long to = min<long>(end, run->start + run->length);
+		memset(buf + (from - beg), run->base, to - from);
+	}
+
+	const Run *masks = (const Run *) (mapping + contig.maskOffset);
+	const Run *masksEnd = masks + contig.maskCount;
+	for(const Run *run = upper_bound(masks, masksEnd, (uint64_t) beg, endsAfter);
+			run < masksEnd && run->start < (uint64_t) end; run++) {
+		long from = max<long>(beg, run->start);
+		long to = min<long>(end, run->start + run->length);
+		for(long k = from; k < to; k++) {
+			buf[k - beg] = tolower((unsigned char) buf[k - beg]);
+		}
+	}
+
+	return end - beg;
+}
@@ -0,0 +1,108 @@
+/*********************************************************************
+ *
+ * PackedReference.h:  The 2-bit packed cache of the reference fasta.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#ifndef PACKEDREFERENCE_H_
+#define PACKEDREFERENCE_H_
+
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "faidx.h"
+
+/**
+ * A read-only, memory mapped copy of the reference fasta with the bases
+ * packed four to a byte. Bases other than A, C, G and T (N-runs, IUPAC
+ * codes) are kept as runs of a single character and soft-masked
+ * (lowercase) stretches as a list of intervals, so that the decoded
+ * sequence is exactly what the fasta contains.
+ *
+ * The cache lives next to the fasta (fasta + PACKED_FILE_EXTENSION),
+ * is built once from the fasta index and is rebuilt whenever the
+ * fasta's size or modification time changes. Contig ids are those of
+ * the fasta index.
+ */
+class PackedReference {
+
+public:
+
+	//The extension appended to the fasta file name for the cache.
+	const static std::string PACKED_FILE_EXTENSION;
+
+	PackedReference();
+	~PackedReference();
+
+	/**
+	 * Maps the cache for the given fasta, building it first from the index
+	 * if it is missing or stale. Returns false if no usable cache could be
+	 * made (e.g. a read-only directory, or a contig longer than faidx can
+	 * fetch); the fasta index should then be used.
+	 */
+	bool open(std::string fastaFileLoc, const faidx_t *fai);
+
+	/**
+	 * Indicates if a cache is mapped.
+	 */
+	bool isOpen() const;
+
+	/**
+	 * Decodes the zero-based half open interval [beg, end) of a contig into
+	 * buf, which must hold end - beg + 1 bytes. Coordinates are clipped to
+	 * the contig like faidx_fetch_id(). Returns the number of bases written
+	 * (NUL-terminated), or -1 for an unknown contig id.
+	 */
+	int fetch(int contigId, long beg, long end, char *buf) const;
+
+	/**
+	 * The length of a contig, or -1 for an unknown contig id.
+	 */
+	long getContigLength(int contigId) const;
+
+protected:
+
+	//The on-disk layout; see PackedReference.cpp.
+	struct Header;
+	struct Contig;
+	struct Run;
+
+	//The mapped cache file.
+	const char *mapping;
+	size_t mappingSize;
+
+	const Header *header;
+	const Contig *contigs;
+
+	/**
+	 * Writes a new cache for the fasta from its index.
+	 */
+	bool build(std::string fastaFileLoc, std::string cacheFileLoc, const faidx_t *fai);
+
+	/**
+	 * Maps an existing cache and checks it against the fasta and its index.
+	 */
+	bool map(std::string fastaFileLoc, std::string cacheFileLoc, const faidx_t *fai);
+
+	/**
+	 * Unmaps the cache if one is mapped.
+	 */
+	void close();
+
+	/**
+	 * Orders a position before the runs that end after it, to find the
+	 * first run of a sorted list that reaches past the position.
+	 */
+	static bool endsAfter(uint64_t pos, const Run &run);
+};
+
+#endif /* PACKEDREFERENCE_H_ */
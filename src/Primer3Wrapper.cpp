@@ -22,13 +22,20 @@
 #include "SequenceRegions.h"
 #include "Utility.h"
 #include "ConfigurationLoader.h"
+#include "OutputWriter.h"
+#include "RunJournal.h"
+#include "SpecificityIndex.h"
+#include "Metrics.h"
+#include "Trace.h"
 
 #include <sstream>
-#include <fstream>
 #include <iostream>
+#include <iomanip>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
 
 using namespace std;
 
@@ -41,18 +48,21 @@ const std::string Primer3Wrapper::PRIMER_ERROR_FILE_NAME = "not_found";
 
 std::string Primer3Wrapper::PRIMER_THERMO_CONFIG_DEFAULT = "essentials/primer3_config/";
 bool Primer3Wrapper::IS_VERBOSE = false;
+std::string Primer3Wrapper::loadedThermoPath = "";
+bool Primer3Wrapper::isLoadedThermoBuiltIn = false;
+bool Primer3Wrapper::isReferenceKernels = false;
 int Primer3Wrapper::PRIMERS_PER_SEQUENCE = 1;
 int Primer3Wrapper::MAX_PRIMERS_PER_SEQUENCE = 5;
 
 //=============================================================================================================
 //PrimerPair class methods.
 
-SinglePrimer PrimerPair::getLeftPrimer() const {
+const SinglePrimer &PrimerPair::getLeftPrimer() const {
 	return leftPrimer;
 }
 
 void PrimerPair::setLeftPrimer(SinglePrimer leftPrimer) {
-	this->leftPrimer = SinglePrimer(leftPrimer);
+	this->leftPrimer = std::move(leftPrimer);
 }
 
 long PrimerPair::getPairAnyThCompl() const {
@@ -87,12 +97,12 @@ void PrimerPair::setProductSize(int productSize) {
 	this->productSize = productSize;
 }
 
-SinglePrimer PrimerPair::getRightPrimer() const {
+const SinglePrimer &PrimerPair::getRightPrimer() const {
 	return rightPrimer;
 }
 
 void PrimerPair::setRightPrimer(SinglePrimer rightPrimer) {
-	this->rightPrimer = SinglePrimer(rightPrimer);
+	this->rightPrimer = std::move(rightPrimer);
 }
 
 //=============================================================================================================
@@ -118,7 +128,7 @@ float SinglePrimer::getMeltingTemperature() const {
 	return meltingTemperature;
 }
 
-std::string SinglePrimer::getSequence() const {
+const std::string &SinglePrimer::getSequence() const {
 	return sequence;
 }
 
@@ -147,7 +157,7 @@ void SinglePrimer::setMeltingTemperature(float meltingTemperature) {
 }
 
 void SinglePrimer::setSequence(std::string sequence) {
-	this->sequence = sequence;
+	this->sequence = std::move(sequence);
 }
 
 void SinglePrimer::setStartIndex(int startIndex) {
@@ -169,13 +179,12 @@ PrimerOutput::PrimerOutput() {
 
 }
 
-PrimerOutput::PrimerOutput(SequenceRegionOutput &seqOut, const  p3retval *p3retVal, const seq_args *sargs, string settingsFile) {
+PrimerOutput::PrimerOutput(const p3retval *p3retVal, const seq_args *sargs, const string &settingsFile) {
 
 	//this->leftPrimers = vector<SinglePrimer>(Primer3Wrapper::PRIMERS_PER_SEQUENCE);
 	//this->rightPrimers = vector<SinglePrimer>(Primer3Wrapper::PRIMERS_PER_SEQUENCE);
 
 	//Fill in the default values for the pair
-	this->seqOutput = seqOut;
 	this->settingsFile = settingsFile;
 
 	if(p3retVal != NULL) {
@@ -195,6 +204,7 @@ PrimerOutput::PrimerOutput(SequenceRegionOutput &seqOut, const  p3retval *p3retV
 			//Atleast a single result needs to be returned
 			if(p3retVal->best_pairs.num_pairs >= 1) {
 
+				this->primerPairs.reserve(p3retVal->best_pairs.num_pairs);
 				for(int i=0; i < p3retVal->best_pairs.num_pairs; i++) {
 					// Pointers for the primer set just printing
 					primer_rec *fwd, *rev;
@@ -229,9 +239,9 @@ PrimerOutput::PrimerOutput(SequenceRegionOutput &seqOut, const  p3retval *p3retV
 					revPrimer.setThreeTh(rev->self_end);
 					revPrimer.setHairpin(rev->hairpin_th);
 
-					primerPair.setLeftPrimer(fwdPrimer);
-					primerPair.setRightPrimer(revPrimer);
-					this->primerPairs.push_back(primerPair);
+					primerPair.setLeftPrimer(std::move(fwdPrimer));
+					primerPair.setRightPrimer(std::move(revPrimer));
+					this->primerPairs.push_back(std::move(primerPair));
 				}
 			}
 			else {
@@ -260,52 +270,52 @@ PrimerOutput::PrimerOutput(SequenceRegionOutput &seqOut, const  p3retval *p3retV
 	}
 }
 
-SequenceRegionOutput PrimerOutput::getSeqOutput() {
+const SequenceRegionOutput &PrimerOutput::getSeqOutput() const {
 	return seqOutput;
 }
 
 void PrimerOutput::setSeqOutput(SequenceRegionOutput seqOutput) {
-	this->seqOutput = seqOutput;
+	this->seqOutput = std::move(seqOutput);
 }
 
-std::string PrimerOutput::getGlobalError() const {
+const std::string &PrimerOutput::getGlobalError() const {
 	return globalError;
 }
 
 void PrimerOutput::setGlobalError(std::string globalError) {
-	this->globalError = globalError;
+	this->globalError = std::move(globalError);
 }
 
-std::string PrimerOutput::getSequenceError() const {
+const std::string &PrimerOutput::getSequenceError() const {
 	return sequenceError;
 }
 
 void PrimerOutput::setSequenceError(std::string sequenceError) {
-	this->sequenceError = sequenceError;
+	this->sequenceError = std::move(sequenceError);
 }
 
-std::string PrimerOutput::getWarning() const {
+const std::string &PrimerOutput::getWarning() const {
 	return warning;
 }
 
 void PrimerOutput::setWarning(std::string warning) {
-	this->warning = warning;
+	this->warning = std::move(warning);
 }
 
-std::string PrimerOutput::getSettingsFile() const {
+const std::string &PrimerOutput::getSettingsFile() const {
 	return settingsFile;
 }
 
-std::vector<PrimerPair> PrimerOutput::getPrimerPairs() const {
+const std::vector<PrimerPair> &PrimerOutput::getPrimerPairs() const {
 	return primerPairs;
 }
 
 void PrimerOutput::setPrimerPairs(std::vector<PrimerPair> primerPairs) {
-	this->primerPairs = primerPairs;
+	this->primerPairs = std::move(primerPairs);
 }
 
 void PrimerOutput::setSettingsFile(std::string settingsFile) {
-	this->settingsFile = settingsFile;
+	this->settingsFile = std::move(settingsFile);
 }
 
 //=============================================================================================================
@@ -317,7 +327,7 @@ Primer3Settings::Primer3Settings(std::string settingsFile,
 									seq_args *seqSettings, string thermoSettingsLoc) {
 
 	this->settingsFile = settingsFile;
-	this->globalSetting = globalSetting;
+	this->globalSetting = globalSettings;
 	this->sequenceSetting = seqSettings;
 	this->thermoSettingsLoc = thermoSettingsLoc;
 }
@@ -327,10 +337,6 @@ Primer3Settings::~Primer3Settings() {
 	//Delete the global and sequence settings
 	if(globalSetting != NULL) {
 
-		if (globalSetting->thermodynamic_alignment == 1) {
-				destroy_thal_structures();
-		}
-
 		p3_destroy_global_settings(globalSetting);
 		globalSetting = NULL;
 	}
@@ -344,16 +350,90 @@ Primer3Settings::~Primer3Settings() {
 //=============================================================================================================
 //Primer3Wrapper class methods.
 
+//Records the phases of choose_primers on the trace.
+static void tracePrimer3Phase(const char *phase, int begin) {
+
+	if(begin) {
+		Trace::begin(phase, "primer3");
+	}
+	else {
+		Trace::end(phase, "primer3");
+	}
+}
+
+//Adds the counts of one thal bound check to a sum.
+static void addThalBoundStats(thal_bound_stats &sum, const thal_bound_stats &stats) {
+
+	sum.requested += stats.requested;
+	sum.skipped += stats.skipped;
+}
+
+//Prints the skipped and requested alignments of a thal bound check and the skip rate.
+static void printThalBoundStat(const string &name, const thal_bound_stats &stats) {
+
+	double rate = (stats.requested > 0) ? (100.0 * stats.skipped / stats.requested) : 0.0;
+	stringstream rateStr;
+	rateStr << fixed << setprecision(1) << rate;
+	cout << name << "=" << stats.skipped << "/" << stats.requested
+			<< " (" << rateStr.str() << "%)" << endl;
+}
+
+void Primer3Wrapper::setReferenceKernels(bool isOn) {
+
+	isReferenceKernels = isOn;
+	p3_set_reference_kernels(isOn ? 1 : 0);
+	seq_lib_use_snapshots(isOn ? 0 : 1);
+}
+
 Primer3Wrapper::Primer3Wrapper() {
 
+	//The mispriming libraries are read with the settings files in every
+	//run, so keep mappable snapshots of them rather than parsing them each time.
+	seq_lib_use_snapshots(isReferenceKernels ? 0 : 1);
+
+	if(Trace::IS_ENABLED) {
+		p3_set_phase_hook(tracePrimer3Phase);
+	}
 }
 
 Primer3Wrapper::~Primer3Wrapper() {
 
+	for(map<string, p3_global_settings *>::iterator iterator=globalSettingsCache.begin();
+			iterator!=globalSettingsCache.end(); ++iterator) {
+		if(iterator->second != NULL) {
+			p3_destroy_global_settings(iterator->second);
+		}
+	}
+}
+
+bool Primer3Wrapper::readGlobalSettings(const string &settingsFile) {
+
+	Primer3Settings primerSettings = Primer3Settings(settingsFile, NULL, NULL, PRIMER_THERMO_CONFIG_DEFAULT);
+	bool retVal = fillPrimerParameters(primerSettings);
+
+	//The global settings are kept, the sequence settings are made afresh
+	//for every region.
+	globalSettingsCache[settingsFile] = primerSettings.globalSetting;
+	primerSettings.globalSetting = NULL;
+
+	return retVal;
+}
+
+p3_global_settings *Primer3Wrapper::getGlobalSettings(const string &settingsFile) {
+
+	map<string, p3_global_settings *>::const_iterator iterator = globalSettingsCache.find(settingsFile);
+	if(iterator == globalSettingsCache.end()) {
+		readGlobalSettings(settingsFile);
+		iterator = globalSettingsCache.find(settingsFile);
+	}
+
+	return iterator->second;
 }
 
 bool Primer3Wrapper::fillPrimerParameters(Primer3Settings &primerSettings) {
 
+	Metrics::Timer timer(Metrics::STAGE_SETTINGS);
+
 	bool retVal = false;
 
 	string settingsFile = primerSettings.settingsFile;
@@ -388,6 +468,7 @@ bool Primer3Wrapper::fillPrimerParameters(Primer3Settings &primerSettings) {
 
 		cerr << "Sequence settings not created" << endl;
 		p3_destroy_global_settings(primerSettings.globalSetting);
+		primerSettings.globalSetting = NULL;
 		destroy_seq_args(primerSettings.sequenceSetting);
 		destroy_pr_append_str_data(&nonfatal_parse_err);
 		destroy_pr_append_str_data(&fatal_parse_err);
@@ -435,12 +516,21 @@ bool Primer3Wrapper::fillPrimerParameters(Primer3Settings &primerSettings) {
 
 bool Primer3Wrapper::fillThermoPrimerParameters(std::string themoSettingsPath) {
 
+	Metrics::Timer timer(Metrics::STAGE_THERMO);
+
 	bool retVal = false;
 
 	thal_results thalRes;
-	//if the path to the parameter files did not change, we don't need to read again
-	if (thermodynamic_path_changed == 0)
-		return retVal;
+	//The stock parameter set is compiled into thal, only a custom location
+	//or the reference kernels need the parameter files to be parsed.
+	bool isBuiltIn = !isReferenceKernels &&
+			themoSettingsPath == ConfigurationLoader::THERMO_CONFIG_LOCATION_DEFAULT;
+
+	//The thermodynamic tables are global to thal, so they are read once and
+	//kept until a different path, or way of reading them, is asked for.
+	if (!loadedThermoPath.empty() && loadedThermoPath == themoSettingsPath &&
+			isLoadedThermoBuiltIn == isBuiltIn)
+		return true;
 	//check that the path to the parameters folder was provided
 	if (themoSettingsPath.empty()) {
 		cerr << "Thermodynamic Alignment specified but path is empty. " <<
@@ -448,13 +538,22 @@ bool Primer3Wrapper::fillThermoPrimerParameters(std::string themoSettingsPath) {
 		return retVal;
 	}
 	else {
+		if (!loadedThermoPath.empty()) {
+			destroy_thal_structures();
+			loadedThermoPath.clear();
+		}
+
+		isBuiltIn = isBuiltIn && thal_load_default_parameters(&thalRes) == 0;
+
 		/* read in the thermodynamic parameters */
-		if (get_thermodynamic_values(themoSettingsPath.c_str(), &thalRes)) {
+		if (!isBuiltIn && get_thermodynamic_values(themoSettingsPath.c_str(), &thalRes)) {
 			cerr << thalRes.msg << endl;
 			return retVal;
 		}
 
 		retVal = true;
+		loadedThermoPath = themoSettingsPath;
+		isLoadedThermoBuiltIn = isBuiltIn;
 		// mark that the last given path was used for reading the parameters
 		thermodynamic_path_changed = 0;
 	}
@@ -462,27 +561,58 @@ bool Primer3Wrapper::fillThermoPrimerParameters(std::string themoSettingsPath) {
 	return retVal;
 }
 
-vector<PrimerOutput> Primer3Wrapper::createPrimers(vector<string> settingsFiles,
+vector<PrimerOutput> Primer3Wrapper::createPrimers(const vector<string> &settingsFiles,
 										map<string, SequenceRegionOutput> seqRegOuts) {
 
 	vector<PrimerOutput> primerOuts;
+	primerOuts.reserve(seqRegOuts.size());
 
-	//Iterate over all the region inputs
-	for(map<string, SequenceRegionOutput>::const_iterator iterator=seqRegOuts.begin();
+	//Iterate over all the region inputs, moving each into its primer output.
+	for(map<string, SequenceRegionOutput>::iterator iterator=seqRegOuts.begin();
 						iterator!=seqRegOuts.end(); ++iterator) {
 
+		primerOuts.push_back(createPrimers(settingsFiles, std::move(iterator->second)));
+	}
 
-		SequenceRegionOutput seqOut = (*iterator).second;
-		PrimerOutput primerOut = createPrimers(settingsFiles, seqOut);
+	return primerOuts;
+}
+
+/*
+ * Hands out the regions of a map in the order of their keys, moving each
+ * out of the map.
+ */
+class SequenceRegionMapSource : public SequenceRegionSource {
 
-		primerOuts.push_back(primerOut);
+public:
+	SequenceRegionMapSource(map<string, SequenceRegionOutput> &seqRegOuts) :
+			seqRegOuts(seqRegOuts), iterator(seqRegOuts.begin()) {
 	}
 
-	return primerOuts;
+	bool next(string &key, SequenceRegionOutput &seqRegOut) {
+
+		if(iterator == seqRegOuts.end()) {
+			return false;
+		}
+		key = iterator->first;
+		seqRegOut = std::move(iterator->second);
+		++iterator;
+		return true;
+	}
+
+protected:
+	map<string, SequenceRegionOutput> &seqRegOuts;
+	map<string, SequenceRegionOutput>::iterator iterator;
+};
+
+bool Primer3Wrapper::createPrimers(const vector<string> &settingsFiles,
+									map<string, SequenceRegionOutput> seqRegOuts, const string &outputFileLoc) {
+
+	SequenceRegionMapSource seqRegSource(seqRegOuts);
+	return createPrimers(settingsFiles, seqRegSource, outputFileLoc);
 }
 
-bool Primer3Wrapper::createPrimers(vector<string> settingsFiles,
-									map<string, SequenceRegionOutput> seqRegOuts, string outputFileLoc) {
+bool Primer3Wrapper::createPrimers(const vector<string> &settingsFiles,
+									SequenceRegionSource &seqRegSource, const string &outputFileLoc) {
 
 	bool retVal = false;
 
@@ -491,12 +621,11 @@ bool Primer3Wrapper::createPrimers(vector<string> settingsFiles,
 
 	//The names for the files and the file object itself.
 	string primerFileName[numOfSettingFiles + 1];
-	ofstream primersFile[numOfSettingFiles + 1]; //extra one for the errors
+	PrimersWriter primersFile[numOfSettingFiles + 1]; //extra one for the errors
 	bool isWrittenToFile[numOfSettingFiles + 1];
 
 	string medseqFileName = outputFileLoc + "." + PRIMER_COMPOSITE_FILE_EXTENSION;
-	ofstream medseqFile;
-	medseqFile.open(medseqFileName.c_str(), ios::out | ios::trunc);
+	MedReseqWriter medseqFile;
 
 	for (int i = 0; i < numOfSettingFiles; ++i) {
 		string extractedFileName = extractOutputFileName(string(settingsFiles[i]));
@@ -506,57 +635,147 @@ bool Primer3Wrapper::createPrimers(vector<string> settingsFiles,
 	primerFileName[numOfSettingFiles] = string(outputFileLoc + "-" + PRIMER_ERROR_FILE_NAME + "." + PRIMER_TERSE_FILE_EXTENSION);
 	isWrittenToFile[numOfSettingFiles] = false;
 
-	//Iterate over all the region inputs
-	for(map<string, SequenceRegionOutput>::const_iterator iterator=seqRegOuts.begin();
-						iterator!=seqRegOuts.end(); ++iterator) {
+	//The journal has the composite file first and then the terse files.
+	//A run which is not resumed goes on without one if it cannot be written.
+	RunJournal journal;
+	if(!journal.open(outputFileLoc, numOfSettingFiles + 2, settingsFiles) && RunJournal::RESUME) {
+		return false;
+	}
 
-		SequenceRegionOutput seqOut = (*iterator).second;
-		PrimerOutput primerOut = createPrimers(settingsFiles, seqOut);
+	if(journal.getDoneCount() > 0) {
+		cout << "Resuming with " << journal.getDoneCount() << " regions already done" << endl;
+		retVal = true;
+
+		bool isResumed = medseqFile.resume(medseqFileName, journal.getLength(0));
+		for (int i = 0; i <= numOfSettingFiles; ++i) {
+			if(journal.getLength(i + 1) >= 0) {
+				isResumed = primersFile[i].resume(primerFileName[i], journal.getLength(i + 1)) && isResumed;
+				isWrittenToFile[i] = true;
+			}
+		}
+
+		//The output done so far is missing or cut short, so going on would
+		//lose it; the journal is kept for another try.
+		if(!isResumed) {
+			cerr << "The output of the journal of " << outputFileLoc << " could not be resumed" << endl;
+			return false;
+		}
+	}
+	else {
+		medseqFile.open(medseqFileName);
+	}
+
+	//Iterate over all the region inputs, as the source hands them out.
+	string key;
+	SequenceRegionOutput seqRegOut;
+	while(seqRegSource.next(key, seqRegOut)) {
+
+		if(journal.isDone(key)) {
+			continue;
+		}
+
+		PrimerOutput primerOut = createPrimers(settingsFiles, std::move(seqRegOut));
 
 		int fileIndex = getIndexOfFileToWrite(primerOut, settingsFiles);
 
 		if(fileIndex >= 0 && fileIndex <= numOfSettingFiles) {
 
+			Metrics::Timer timer(Metrics::STAGE_OUTPUT);
+
 			//Lazy creation of file, only if needed.
 			if(!isWrittenToFile[fileIndex]) {
-				primersFile[fileIndex].open(primerFileName[fileIndex].c_str(), ios::out | ios::trunc);
+				primersFile[fileIndex].open(primerFileName[fileIndex]);
 				isWrittenToFile[fileIndex] = true;
 			}
 
-			medseqFile << printPrimer(primerOut);
-			primersFile[fileIndex] << printPrimer(primerOut, true);
+			medseqFile.write(primerOut);
+			primersFile[fileIndex].write(primerOut);
 
 			retVal = true;
 		}
-	}
 
-	//Close all the open files.
-	if(medseqFile.is_open()) {
-		medseqFile.close();
+		journal.addDone(key);
+
+		//The output is on the disk before the checkpoint which stands for it.
+		if(journal.isCheckpointDue()) {
+			Metrics::Timer timer(Metrics::STAGE_OUTPUT);
+
+			vector<off_t> fileLengths;
+			bool isSynced = medseqFile.sync();
+			fileLengths.push_back(medseqFile.getOffset());
+			for (int i = 0; i <= numOfSettingFiles; ++i) {
+				isSynced = (!isWrittenToFile[i] || primersFile[i].sync()) && isSynced;
+				fileLengths.push_back(isWrittenToFile[i] ? primersFile[i].getOffset() : -1);
+			}
+			if(isSynced) {
+				journal.checkpoint(fileLengths);
+			}
+		}
 	}
 
-	for (int i = 0; i < numOfSettingFiles; ++i) {
-		if(primersFile[i].is_open()) {
-			primersFile[i].close();
+	//Close all the open files, the error file included.
+	Metrics::Timer timer(Metrics::STAGE_OUTPUT);
+	bool isClosed = medseqFile.close();
+
+	for (int i = 0; i <= numOfSettingFiles; ++i) {
+		if(isWrittenToFile[i] && !primersFile[i].close()) {
+			isClosed = false;
 		}
 	}
 
-	//Also close the error file.
-	if(primersFile[numOfSettingFiles].is_open()) {
-		primersFile[numOfSettingFiles].close();
+	//The journal is kept for a run whose output could not be written.
+	if(isClosed) {
+		journal.finish();
+	}
+
+	return retVal && isClosed;
+}
+
+PrimerOutput Primer3Wrapper::createPrimers(const vector<string> &settingsFiles,
+											SequenceRegionOutput seqRegOut, string &tier) {
+
+	PrimerOutput primerOut = createPrimers(settingsFiles, std::move(seqRegOut));
+
+	int fileIndex = getIndexOfFileToWrite(primerOut, settingsFiles);
+	if(fileIndex >= 0 && fileIndex < (int) settingsFiles.size()) {
+		tier = extractOutputFileName(settingsFiles[fileIndex]);
+	}
+	else {
+		tier = PRIMER_ERROR_FILE_NAME;
+	}
+
+	return primerOut;
+}
+
+bool Primer3Wrapper::loadSettings(const vector<string> &settingsFiles) {
+
+	bool retVal = true;
+
+	for(vector<string>::const_iterator iterator=settingsFiles.begin(); iterator!=settingsFiles.end(); ++iterator) {
+		if(globalSettingsCache.find(*iterator) == globalSettingsCache.end() && !readGlobalSettings(*iterator)) {
+			cerr << "Could not read the settings file " << *iterator << endl;
+			retVal = false;
+		}
 	}
 
 	return retVal;
 }
 
-PrimerOutput Primer3Wrapper::createPrimers(vector<string> settingsFiles, SequenceRegionOutput &seqRegOut) {
+PrimerOutput Primer3Wrapper::createPrimers(const vector<string> &settingsFiles, SequenceRegionOutput seqRegOut) {
 
 	PrimerOutput primerOut;
+	uint64_t startNanos = Metrics::IS_ENABLED ? Metrics::now() : 0;
+
+	Trace::Span span("region", "design");
+	if(Trace::IS_ENABLED) {
+		span.setDetail(seqRegOut.getSeqRegInput().toString());
+	}
 
 	//Iterate through the list of settings files in order.
 	for(vector<string>::const_iterator settingsIterator=settingsFiles.begin();
 			settingsIterator!=settingsFiles.end(); ++settingsIterator) {
 
+		Metrics::addCount(Metrics::COUNTER_SETTINGS_TRIED);
 		primerOut = createPrimers(*settingsIterator, seqRegOut);
 
 		//If there were no error's then just break out of the inner loop
@@ -565,38 +784,50 @@ PrimerOutput Primer3Wrapper::createPrimers(vector<string> settingsFiles, Sequenc
 		}
 	}
 
+	primerOut.setSeqOutput(std::move(seqRegOut));
+
+	if(Metrics::IS_ENABLED) {
+		Metrics::addCount(Metrics::COUNTER_REGIONS);
+		Metrics::addRegionLatency(Metrics::now() - startNanos);
+	}
+
 	return primerOut;
 }
 
-PrimerOutput Primer3Wrapper::createPrimers(string settingsFile, SequenceRegionOutput &seqRegOut) {
+PrimerOutput Primer3Wrapper::createPrimers(const string &settingsFile, const SequenceRegionOutput &seqRegOut) {
 
-	PrimerOutput primerOut;
-	p3_global_settings *global_pa = NULL;
+	Trace::Span span("settings_attempt", "design");
+	if(Trace::IS_ENABLED) {
+		span.setDetail(settingsFile);
+	}
 
-	//TODO: We do not need to read the settings file everytime.
-	//Optimization required to read it just once.
-	//We could just keep a list of all the primer settings and pass them
-	//around each time rather than filling the parmeter each time
+	PrimerOutput primerOut;
 
-	Primer3Settings primerSettings = Primer3Settings(settingsFile, global_pa, NULL, PRIMER_THERMO_CONFIG_DEFAULT);
+	//The settings file is read only once; the region gets sequence
+	//settings of its own.
+	Primer3Settings primerSettings = Primer3Settings(settingsFile, getGlobalSettings(settingsFile),
+														create_seq_arg(), PRIMER_THERMO_CONFIG_DEFAULT);
 
-	//Make sure that the path change param is set to 1 now,
-	//because we would need to readjust this for each primer.
-	thermodynamic_path_changed = 1;
-	this->fillPrimerParameters(primerSettings);
+	if(primerSettings.globalSetting != NULL && primerSettings.sequenceSetting != NULL) {
+		p3retval *retVal = createPrimers(primerSettings, seqRegOut);
+		primerOut = PrimerOutput(retVal, primerSettings.sequenceSetting, primerSettings.settingsFile);
 
-	p3retval *retVal = createPrimers(primerSettings, seqRegOut);
-	primerOut = PrimerOutput(seqRegOut, retVal, primerSettings.sequenceSetting, primerSettings.settingsFile);
+		//Memory deallocation
+		destroy_p3retval(retVal);
+	}
+	else {
+		primerOut = PrimerOutput(NULL, NULL, settingsFile);
+	}
 
-	//Memory deallocation
-	destroy_p3retval(retVal);
+	//The global settings stay with the wrapper.
+	primerSettings.globalSetting = NULL;
 
 	return primerOut;
 }
 
 
 p3retval* Primer3Wrapper::createPrimers(Primer3Settings &primerSettings,
-										SequenceRegionOutput &seqRegOutput) {
+										const SequenceRegionOutput &seqRegOutput) {
 
 	/* Retval will point to the return value from choose_primers(). */
 	p3retval *retval = NULL;
@@ -606,7 +837,31 @@ p3retval* Primer3Wrapper::createPrimers(Primer3Settings &primerSettings,
 	p3_add_to_sa_tar2(primerSettings.sequenceSetting, (int)seqRegOutput.getPrevSequence().length() + 1, (int)seqRegOutput.getTargetSequence().length());
 
 	p3_set_gs_primer_file_flag(primerSettings.globalSetting, 0);
-    retval = choose_primers(primerSettings.globalSetting, primerSettings.sequenceSetting);
+
+	//The specificity checks tell the intended product by where the template
+	//lies in the reference, just before the target for region inputs.
+	if(SpecificityIndex::IS_ENABLED) {
+		const SequenceRegionInput &region = seqRegOutput.getSeqRegInput();
+		SpecificityIndex::placeTemplate(region.getContigId(),
+				region.getStartIndex() - 1 - (long) seqRegOutput.getPrevSequence().length());
+	}
+
+	p3_align_stats alignStats;
+	if(Metrics::IS_ENABLED) {
+		p3_get_align_stats(&alignStats);
+	}
+
+	{
+		Metrics::Timer timer(Metrics::STAGE_CHOOSE_PRIMERS);
+		Trace::Span span("choose_primers", "primer3");
+		retval = choose_primers(primerSettings.globalSetting, primerSettings.sequenceSetting);
+
+		//The alignments are stages of their own.
+		if(Metrics::IS_ENABLED) {
+			timer.exclude(addPrimerMetrics(alignStats, retval));
+		}
+	}
+
     if (NULL == retval) {
     	//Let us return a NULL, it is upto the calling method to handle it.
     	return retval;
@@ -614,35 +869,130 @@ p3retval* Primer3Wrapper::createPrimers(Primer3Settings &primerSettings,
 
     if(IS_VERBOSE) {
     	print_boulder(4, primerSettings.globalSetting, primerSettings.sequenceSetting, retval, 0);
+
+    	if(primerSettings.globalSetting->thermodynamic_alignment == 1) {
+    		printSecondaryStructures(primerSettings, retval);
+    		printThalBoundStats(retval);
+    	}
     }
 
 	return retval;
 
 }
 
-std::string Primer3Wrapper::outputPrintRegion(SequenceRegionInput region, bool isLeftPrimer) {
+void Primer3Wrapper::printSecondaryStructures(Primer3Settings &primerSettings, p3retval *retval) {
+
+	const args_for_one_oligo_or_primer &primerArgs = primerSettings.globalSetting->p_args;
+
+	//The same conditions which primer3 uses for the primer checks.
+	thal_args hairpinArgs, dimerArgs;
+	set_thal_default_args(&hairpinArgs);
+	hairpinArgs.type = thal_hairpin;
+	hairpinArgs.dimer = 0;
+	set_thal_default_args(&dimerArgs);
+	dimerArgs.type = thal_any;
+
+	thal_args *thalArgs[] = {&hairpinArgs, &dimerArgs};
+	for(int i = 0; i < 2; i++) {
+		thalArgs[i]->mv = primerArgs.salt_conc;
+		thalArgs[i]->dv = primerArgs.divalent_conc;
+		thalArgs[i]->dntp = primerArgs.dntp_conc;
+		thalArgs[i]->dna_conc = primerArgs.dna_conc;
+		thalArgs[i]->mode = THL_STRUCT;
+	}
+
+	for(int i = 0; i < retval->best_pairs.num_pairs; i++) {
+
+		//The sequences are returned in static buffers, so copy them.
+		string leftSeq = pr_oligo_sequence(primerSettings.sequenceSetting, retval->best_pairs.pairs[i].left);
+		string rightSeq = pr_oligo_rev_c_sequence(primerSettings.sequenceSetting, retval->best_pairs.pairs[i].right);
 
-	string chromosomeToMatch = "chr";
+		cout << "PRIMER_PAIR_" << i << "_STRUCTURES" << endl;
+		printSecondaryStructure("Left primer hairpin", leftSeq, leftSeq, hairpinArgs);
+		printSecondaryStructure("Right primer hairpin", rightSeq, rightSeq, hairpinArgs);
+		printSecondaryStructure("Primer dimer", leftSeq, rightSeq, dimerArgs);
+	}
+	cout << "=" << endl;
+}
+
+void Primer3Wrapper::printThalBoundStats(p3retval *retval) {
 
-	string regionPrintStr = region.getRegionName();
-	size_t pos = regionPrintStr.find(chromosomeToMatch);
-	if(pos != string::npos) {
-		regionPrintStr = regionPrintStr.substr(pos + chromosomeToMatch.length());
+	//The self checks of the left, right and internal oligos are added up per check.
+	thal_bound_stats selfAny = {0, 0}, selfEnd = {0, 0}, hairpin = {0, 0};
+	const oligo_stats *oligoStats[] = {&retval->fwd.expl, &retval->rev.expl, &retval->intl.expl};
+	for(int i = 0; i < 3; i++) {
+		addThalBoundStats(selfAny, oligoStats[i]->compl_any_th_bound);
+		addThalBoundStats(selfEnd, oligoStats[i]->compl_end_th_bound);
+		addThalBoundStats(hairpin, oligoStats[i]->hairpin_th_bound);
 	}
 
-	stringstream temp;
-	temp << region.getStartIndex();
-	string startIndexStr = temp.str();
-	string primerDirection = isLeftPrimer?"F":"R";
-	return string(regionPrintStr + "-" + startIndexStr  + primerDirection);
+	const char *names[] = {"SELF_ANY", "SELF_END", "HAIRPIN", "PAIR_ANY", "PAIR_END"};
+	const thal_bound_stats *checks[] = {&selfAny, &selfEnd, &hairpin,
+			&retval->best_pairs.expl.compl_any_th_bound, &retval->best_pairs.expl.compl_end_th_bound};
+
+	thal_bound_stats total = {0, 0};
+	for(int i = 0; i < 5; i++) {
+		printThalBoundStat(string("THAL_BOUND_SKIPPED_") + names[i], *checks[i]);
+		addThalBoundStats(total, *checks[i]);
+	}
+	printThalBoundStat("THAL_BOUND_SKIPPED", total);
 }
 
-void Primer3Wrapper::printPrimer(vector<PrimerOutput> primerOuts) {
+uint64_t Primer3Wrapper::addPrimerMetrics(const p3_align_stats &before, const p3retval *retval) {
+
+	//The alignment statistics of primer3 accumulate, so take the difference.
+	p3_align_stats after;
+	p3_get_align_stats(&after);
+
+	uint64_t thalNanos = (uint64_t) ((after.thal_seconds - before.thal_seconds) * 1e9);
+	uint64_t dpalNanos = (uint64_t) ((after.dpal_seconds - before.dpal_seconds) * 1e9);
+	Metrics::addTime(Metrics::STAGE_THAL, thalNanos);
+	Metrics::addTime(Metrics::STAGE_DPAL, dpalNanos);
+	Metrics::addCount(Metrics::COUNTER_THAL_CALLS, after.thal_calls - before.thal_calls);
+	Metrics::addCount(Metrics::COUNTER_DPAL_CALLS, after.dpal_calls - before.dpal_calls);
+
+	if(retval != NULL) {
+		Metrics::addCount(Metrics::COUNTER_LEFT_CONSIDERED, retval->fwd.expl.considered);
+		Metrics::addCount(Metrics::COUNTER_LEFT_OK, retval->fwd.expl.ok);
+		Metrics::addCount(Metrics::COUNTER_RIGHT_CONSIDERED, retval->rev.expl.considered);
+		Metrics::addCount(Metrics::COUNTER_RIGHT_OK, retval->rev.expl.ok);
+		Metrics::addCount(Metrics::COUNTER_PAIRS_CONSIDERED, retval->best_pairs.expl.considered);
+		Metrics::addCount(Metrics::COUNTER_PAIRS_OK, retval->best_pairs.expl.ok);
+		Metrics::addCount(Metrics::COUNTER_PAIRS_RETURNED, retval->best_pairs.num_pairs);
+	}
+
+	return thalNanos + dpalNanos;
+}
+
+void Primer3Wrapper::printSecondaryStructure(string title, string seq1, string seq2, thal_args &thalArgs) {
+
+	thal_results thalRes;
+	thal((const unsigned char *) seq1.c_str(), (const unsigned char *) seq2.c_str(), &thalArgs, &thalRes);
+
+	cout << title << ": Tm=" << thalRes.temp << endl;
+	if(thalRes.sec_struct != NULL) {
+		cout << thalRes.sec_struct;
+		free(thalRes.sec_struct);
+	}
+	else {
+		cout << "No secondary structure" << endl;
+	}
+}
+
+void Primer3Wrapper::printPrimer(const vector<PrimerOutput> &primerOuts) {
+
+	//Anything already written to cout goes out first.
+	cout.flush();
+
+	MedReseqWriter writer;
+	writer.attach(STDOUT_FILENO, "stdout");
 
 	for(vector<PrimerOutput>::const_iterator iterator=primerOuts.begin();
 		iterator!=primerOuts.end(); ++iterator) {
-		cout << printPrimer((PrimerOutput)(*iterator));
+		writer.write(*iterator);
 	}
+
+	writer.flush();
 }
 
 string Primer3Wrapper::extractOutputFileName(string fileName) {
@@ -661,12 +1011,12 @@ string Primer3Wrapper::extractOutputFileName(string fileName) {
 	return retVal;
 }
 
-int Primer3Wrapper::getIndexOfFileToWrite(PrimerOutput &primerOut, vector<string> &textVector) {
+int Primer3Wrapper::getIndexOfFileToWrite(const PrimerOutput &primerOut, const vector<string> &textVector) {
 
 	int retVal = -1;
 
 	if(primerOut.getGlobalError().empty() && primerOut.getSequenceError().empty()) {
-		string text = primerOut.getSettingsFile();
+		const string &text = primerOut.getSettingsFile();
 		for (unsigned int i = 0; i < textVector.size() ; ++i) {
 			if(text == textVector[i]) {
 				retVal = i;
@@ -682,84 +1032,5 @@ int Primer3Wrapper::getIndexOfFileToWrite(PrimerOutput &primerOut, vector<string
 	return retVal;
 }
 
-string Primer3Wrapper::printPrimer(PrimerOutput primerOut, bool isTerse/*=false*/) {
-
-	stringstream retVal("");
-
-	if(!isTerse) {
-		retVal << ">" << primerOut.getSeqOutput().getSeqRegInput().toString() << endl <<
-								primerOut.getSeqOutput().getCompleteSequence(true) << endl;
-		retVal << "Target: [" << primerOut.getSeqOutput().getPrevSequence().length() + 1 << "," <<
-				primerOut.getSeqOutput().getTargetSequence().length() << "]" << endl <<
-				"Settings file : " << primerOut.getSettingsFile() << endl;
-
-			if(!primerOut.getGlobalError().empty()) {
-				retVal << "ERROR: " << primerOut.getGlobalError() << endl << endl;
-			}
-			else if(!primerOut.getSequenceError().empty()) {
-				retVal << "ERROR: " << primerOut.getSequenceError() << endl << endl;
-			}
-			else {
-
-				if(!primerOut.getWarning().empty()) {
-					retVal << "WARNING: " << primerOut.getWarning() << endl;
-				}
-
-				vector<PrimerPair> primerPairs = primerOut.getPrimerPairs();
-				for(unsigned int i=0; i < primerPairs.size(); i++) {
-
-					PrimerPair primerPair = primerPairs[i];
-					SinglePrimer leftPrimer = primerPair.getLeftPrimer();
-					SinglePrimer rightPrimer = primerPair.getRightPrimer();
-
-					if(i >= 1) {
-						retVal << "Alternative Primer " << i << ":" << endl;
-					}
-					retVal << this->outputPrintRegion(primerOut.getSeqOutput().getSeqRegInput(), true) << "=" <<
-							leftPrimer.getSequence() <<
-							"| Start: " << leftPrimer.getStartIndex()  + 1 << " " <<
-							"| Length: " << leftPrimer.getLength() << " " <<
-							"| Temperature: " << (int)leftPrimer.getMeltingTemperature() << " " <<
-							"| GC%: " << leftPrimer.getGcPercent() << endl <<
-							this->outputPrintRegion(primerOut.getSeqOutput().getSeqRegInput(), false) << "=" <<
-							rightPrimer.getSequence() <<
-							"| Start: " << rightPrimer.getStartIndex() + 1 << " " <<
-							"| Length: " << rightPrimer.getLength() << " " <<
-							"| Temperature: " << (int)rightPrimer.getMeltingTemperature() << " " <<
-							"| GC%: " << rightPrimer.getGcPercent() << endl <<
-							"Overall Product size: " << primerPair.getProductSize() << endl;
-				}
-				retVal << endl;
-			}
-	}
-	else {
-
-		if(!primerOut.getGlobalError().empty()) {
-			retVal << this->outputPrintRegion(primerOut.getSeqOutput().getSeqRegInput(), true) << ", " <<
-								  "ERROR: " << primerOut.getGlobalError() << endl <<
-								  this->outputPrintRegion(primerOut.getSeqOutput().getSeqRegInput(), false) << ", " <<
-								  "ERROR: " << primerOut.getGlobalError() << endl;
-		}
-		else if(!primerOut.getSequenceError().empty()) {
-			retVal << this->outputPrintRegion(primerOut.getSeqOutput().getSeqRegInput(), true) << ", " <<
-					  "ERROR: " << primerOut.getSequenceError() << endl <<
-					  this->outputPrintRegion(primerOut.getSeqOutput().getSeqRegInput(), false) << ", " <<
-					  "ERROR: " <<	primerOut.getSequenceError() << endl;
-		}
-		else {
-			if(!primerOut.getWarning().empty()) {
-				retVal << "WARNING: " << primerOut.getWarning() << endl;
-			}
-
-			retVal << this->outputPrintRegion(primerOut.getSeqOutput().getSeqRegInput(), true) << ", " <<
-					(((PrimerPair)(primerOut.getPrimerPairs()[0])).getLeftPrimer()).getSequence() << endl <<
-					this->outputPrintRegion(primerOut.getSeqOutput().getSeqRegInput(), false) << ", " <<
-					(((PrimerPair)(primerOut.getPrimerPairs()[0])).getRightPrimer()).getSequence() << endl;
-		}
-
-	}
-
-	return retVal.str();
-}
 //=============================================================================================================
 
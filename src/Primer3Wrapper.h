@@ -18,9 +18,11 @@
 
 #include <string>
 #include <ostream>
+#include <map>
 
 #include "SamtoolsWrapper.h"
 #include "libprimer3.h"
+#include "thal.h"
 #include "SequenceRegions.h"
 #include "ConfigurationLoader.h"
 
@@ -72,7 +74,7 @@ public:
 	float getHairpin() const;
 	int getLength() const;
 	float getMeltingTemperature() const;
-	std::string getSequence() const;
+	const std::string &getSequence() const;
 	int getStartIndex() const;
 	float getThreeTh() const;
 
@@ -101,9 +103,9 @@ protected:
 
 public:
 	PrimerPair() {};
-	SinglePrimer getLeftPrimer() const;
+	const SinglePrimer &getLeftPrimer() const;
 	void setLeftPrimer(SinglePrimer leftPrimer);
-	SinglePrimer getRightPrimer() const;
+	const SinglePrimer &getRightPrimer() const;
 	void setRightPrimer(SinglePrimer rightPrimer);
 	long getPairAnyThCompl() const;
 	void setPairAnyThCompl(long pairAnyThCompl);
@@ -144,21 +146,23 @@ public:
 	PrimerOutput();
 
 	//The consturctor which takes in the necessary value from different primers and
-	//creates the overall primer output object.
-	PrimerOutput(SequenceRegionOutput &, const  p3retval*, const seq_args*, std::string);
+	//creates the overall primer output object. The sequence region is set
+	//separately, once the settings file which is used for it is known.
+	PrimerOutput(const p3retval*, const seq_args*, const std::string &);
 
-	//The setters and getters.
-	SequenceRegionOutput getSeqOutput();
+	//The setters and getters. The setters take their values by value, so
+	//that callers can move them in.
+	const SequenceRegionOutput &getSeqOutput() const;
 	void setSeqOutput(SequenceRegionOutput seqOutput);
-	std::string getGlobalError() const;
+	const std::string &getGlobalError() const;
 	void setGlobalError(std::string globalError);
-	std::string getSequenceError() const;
+	const std::string &getSequenceError() const;
 	void setSequenceError(std::string sequenceError);
-	std::string getWarning() const;
+	const std::string &getWarning() const;
 	void setWarning(std::string warning);
-	std::string getSettingsFile() const;
+	const std::string &getSettingsFile() const;
 	void setSettingsFile(std::string settingsFile);
-	std::vector<PrimerPair> getPrimerPairs() const;
+	const std::vector<PrimerPair> &getPrimerPairs() const;
 	void setPrimerPairs(std::vector<PrimerPair> primerPairs);
 };
 
@@ -218,6 +222,15 @@ public:
 	//Indicates the maximum number of primers allowed for a single sequence.
 	static int MAX_PRIMERS_PER_SEQUENCE;
 
+	/**
+	 * Switches every primer3 optimization to its plain reference version,
+	 * or back: the thal() kernels and alignment bounds, the mispriming
+	 * libraries parsed instead of mapped from snapshots, and the stock
+	 * thermodynamic parameters read from their files instead of the
+	 * compiled-in tables. The primers are the same either way.
+	 */
+	static void setReferenceKernels(bool);
+
 	//The default constructor and destructor
 	Primer3Wrapper();
 	~Primer3Wrapper();
@@ -227,58 +240,97 @@ public:
 	 * and generates a list of primer outputs.
 	 * The calling method has to be careful here because the entire output is in memory and could be
 	 * dangerous to call this for large number of regions.
+	 * The sequence outputs are moved into the primer outputs, so callers that
+	 * are done with the map should pass it with std::move.
 	 */
-	std::vector<PrimerOutput> createPrimers(std::vector<std::string>,
+	std::vector<PrimerOutput> createPrimers(const std::vector<std::string> &,
 												std::map<std::string, SequenceRegionOutput> seqRegOuts);
 
 	/**
 	 * The equivalent over-loaded method which accepts a list of settings files
 	 * and a map of Sequence outputs and dumps the output in files represented by
 	 * outputFile. This should be the method of choice for large input sizes.
+	 * The map is taken over in the same way as above.
+	 */
+	bool createPrimers(const std::vector<std::string> &settingsFiles,
+						std::map<std::string, SequenceRegionOutput> seqRegOuts, const std::string &outputFile);
+
+	/**
+	 * The same, for regions handed out one at a time by the source: each
+	 * region is designed and written as it comes, in the order of the
+	 * source, so that only one is held at a time.
 	 */
-	bool createPrimers(std::vector<std::string> settingsFiles,
-						std::map<std::string, SequenceRegionOutput> seqRegOuts, std::string outputFile);
+	bool createPrimers(const std::vector<std::string> &settingsFiles,
+						SequenceRegionSource &seqRegSource, const std::string &outputFile);
+
+	/**
+	 * Designs primers for a single region, trying the settings files in order.
+	 * The tier is set to the name the terse file of the output would be given
+	 * (such as tier1, or not_found).
+	 */
+	PrimerOutput createPrimers(const std::vector<std::string> &settingsFiles,
+								SequenceRegionOutput seqRegOut, std::string &tier);
+
+	/**
+	 * Reads every settings file, so that the settings, the thermodynamic
+	 * parameters and the mispriming libraries they name are loaded before
+	 * the first region. Returns false if a settings file could not be read.
+	 */
+	bool loadSettings(const std::vector<std::string> &settingsFiles);
 
 	/**
 	 * Prints the entire set of primers in a formatted way to stdout.
 	 */
-	void printPrimer(std::vector<PrimerOutput>);
+	void printPrimer(const std::vector<PrimerOutput> &);
 
 protected:
 
 	/*
 	 * This over-loaded method takes-in a list of settings files and sequence output
 	 * to create a primer output. It walks through the settings files in order of
-	 * preference.
+	 * preference. The sequence output ends up in the returned primer output.
 	 */
-	PrimerOutput createPrimers(std::vector<std::string>, SequenceRegionOutput &);
+	PrimerOutput createPrimers(const std::vector<std::string> &, SequenceRegionOutput);
 
 	/**
 	 * This over-loaded method creates a primer output for a given settings file
 	 * and sequence output. It is possible that the primers are not generated for
-	 * the given settings.
+	 * the given settings. The sequence output is not copied into the result.
 	 */
-	PrimerOutput createPrimers(std::string, SequenceRegionOutput &);
+	PrimerOutput createPrimers(const std::string &, const SequenceRegionOutput &);
 
 	/**
 	 * The over-loaded method takes the primer settings and sequence output
 	 * and creates returns a struct representation given by primer3 library.
 	 */
-	p3retval* createPrimers(Primer3Settings &, SequenceRegionOutput &);
+	p3retval* createPrimers(Primer3Settings &, const SequenceRegionOutput &);
+
+	/**
+	 * Prints the secondary structures (hairpins and the primer-dimer) of the
+	 * returned primer pairs. Primer3 itself only computes the melting temperatures
+	 * of these structures, so this is done separately for verbose output.
+	 */
+	void printSecondaryStructures(Primer3Settings &, p3retval *);
 
 	/**
-	 * This method creates the string representation of the primer-output
-	 * The terse parameter represents if the we need a short-hand output.
+	 * Prints how many of the thermodynamic alignments requested during pair
+	 * selection were skipped because their upper bound was below the limit,
+	 * for each check (self any, self end, hairpin, pair any, pair end) and in total.
 	 */
-	std::string printPrimer(PrimerOutput primerOut, bool isTerse=false);
+	void printThalBoundStats(p3retval *);
 
 	/**
-	 * The name construction of the output region to be printed.
-	 * The current format is ChromosomeNumber-startIndex(F|R)
-	 * The boolean parameter determines if it is a Forward or
-	 * a Reverse primer.
+	 * Adds the alignments run by choose_primers since the given statistics
+	 * were taken, and the oligos and pairs it considered, to the metrics.
+	 * Returns the time the alignments took.
 	 */
-	std::string outputPrintRegion(SequenceRegionInput, bool);
+	uint64_t addPrimerMetrics(const p3_align_stats &, const p3retval *);
+
+	/**
+	 * Runs the thermodynamic alignment of the two sequences with the structure
+	 * output turned on and prints it with the given title.
+	 */
+	void printSecondaryStructure(std::string, std::string, std::string, thal_args &);
 
 	/**
 	 * This method is used to fill in the necessary paramers to the
@@ -286,17 +338,44 @@ protected:
 	 */
 	bool fillPrimerParameters(Primer3Settings &);
 
+	/**
+	 * Provides the global settings of a settings file, along with the
+	 * mispriming libraries they name. The file is read the first time it
+	 * is asked for, and its settings are kept for the life of the wrapper.
+	 */
+	p3_global_settings *getGlobalSettings(const std::string &);
+
+	/**
+	 * Reads a settings file into the kept settings. Returns false if it
+	 * could not be read; the settings are kept and used all the same, as
+	 * primer3 reports what is wrong with them for every region.
+	 */
+	bool readGlobalSettings(const std::string &);
+
+	//The global settings read so far, by settings file.
+	std::map<std::string, p3_global_settings *> globalSettingsCache;
+
 	/**
 	 * This method is used to fill in the necessary thermodynamic parameters
 	 * to the primer settings which is going to be used for thermodynamic allignment.
 	 */
 	bool fillThermoPrimerParameters(std::string);
 
+	//The location the currently loaded thermodynamic parameters came from,
+	//empty if none are loaded.
+	static std::string loadedThermoPath;
+
+	//Whether the loaded thermodynamic parameters are the compiled-in ones.
+	static bool isLoadedThermoBuiltIn;
+
+	//Whether the reference versions of the optimizations are in use.
+	static bool isReferenceKernels;
+
 	/**
 	 * This method provides the index of the array for which the string match took place.
 	 * Returns a -1 on failure.
 	 */
-	int getIndexOfFileToWrite(PrimerOutput &, std::vector<std::string> &);
+	int getIndexOfFileToWrite(const PrimerOutput &, const std::vector<std::string> &);
 
 	/**
 	 * Provides the output name for the primers and medreseq files.
@@ -304,6 +383,10 @@ protected:
 	 */
 	std::string extractOutputFileName(std::string);
 
+	//The wrapper owns the settings it has read and is not copied.
+	Primer3Wrapper(const Primer3Wrapper &);
+	Primer3Wrapper &operator=(const Primer3Wrapper &);
+
 };
 
 #endif /* PRIMER3WRAPPER_H_ */
@@ -0,0 +1,109 @@
+/*********************************************************************
+ *
+ * ReferenceCache.cpp:  A memory budgeted cache of decoded reference windows.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <cstring>
+
+#include "ReferenceCache.h"
+
+using namespace std;
+
+//64 kb windows: a target with its padding usually falls in one or two.
+const long ReferenceCache::WINDOW_SIZE = 1 << 16;
+
+ReferenceCache::ReferenceCache(size_t budgetBytes) : budget(budgetBytes), used(0) {
+
+	memset(&stats, 0, sizeof(stats));
+	pthread_mutex_init(&lock, NULL);
+}
+
+ReferenceCache::~ReferenceCache() {
+
+	pthread_mutex_destroy(&lock);
+}
+
+bool ReferenceCache::isEnabled() const {
+	return budget >= (size_t) WINDOW_SIZE;
+}
+
+long ReferenceCache::read(int contigId, long window, long offset, long len, char *buf) {
+
+	long copied = -1;
+
+	pthread_mutex_lock(&lock);
+
+	map<WindowKey, WindowList::iterator>::iterator found = index.find(WindowKey(contigId, window));
+	if(found != index.end()) {
+		//Move the window to the front of the LRU list.
+		windows.splice(windows.begin(), windows, found->second);
+
+		const string &sequence = found->second->second;
+		copied = 0;
+		if(offset < (long) sequence.size()) {
+			copied = (long) sequence.size() - offset < len ? (long) sequence.size() - offset : len;
+			memcpy(buf, sequence.data() + offset, copied);
+		}
+		stats.hits++;
+	}
+	else {
+		stats.misses++;
+	}
+
+	pthread_mutex_unlock(&lock);
+
+	return copied;
+}
+
+void ReferenceCache::insert(int contigId, long window, string &sequence) {
+
+	if(!isEnabled()) {
+		return;
+	}
+
+	pthread_mutex_lock(&lock);
+
+	WindowKey key(contigId, window);
+
+	//Another thread may have decoded the same window in the meantime.
+	if(index.find(key) == index.end()) {
+		windows.push_front(make_pair(key, string()));
+		windows.front().second.swap(sequence);
+		index[key] = windows.begin();
+		used += windows.front().second.size();
+
+		while(used > budget && windows.size() > 1) {
+			used -= windows.back().second.size();
+			index.erase(windows.back().first);
+			windows.pop_back();
+			stats.evictions++;
+		}
+	}
+
+	pthread_mutex_unlock(&lock);
+}
+
+void ReferenceCache::addDecoded(unsigned long long bytes) {
+
+	pthread_mutex_lock(&lock);
+	stats.bytesDecoded += bytes;
+	pthread_mutex_unlock(&lock);
+}
+
+ReferenceCache::Stats ReferenceCache::getStats() {
+
+	pthread_mutex_lock(&lock);
+	Stats current = stats;
+	pthread_mutex_unlock(&lock);
+
+	return current;
+}
@@ -0,0 +1,103 @@
+/*********************************************************************
+ *
+ * ReferenceCache.h:  A memory budgeted cache of decoded reference windows.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#ifndef REFERENCECACHE_H_
+#define REFERENCECACHE_H_
+
+#include <string>
+#include <list>
+#include <map>
+#include <utility>
+
+#include <pthread.h>
+
+/**
+ * Keeps decoded stretches of the reference in memory so that targets
+ * which lie close together do not decode the same bases again. The
+ * reference is split into fixed, aligned windows of WINDOW_SIZE bases;
+ * windows are kept until the memory budget is reached and then evicted
+ * least recently used first.
+ *
+ * The cache may be shared by several threads.
+ */
+class ReferenceCache {
+
+public:
+
+	//The number of bases held in one cached window.
+	const static long WINDOW_SIZE;
+
+	//The statistics collected over the life time of the cache.
+	struct Stats {
+		unsigned long hits;
+		unsigned long misses;
+		unsigned long evictions;
+		unsigned long long bytesDecoded;
+	};
+
+	/**
+	 * A cache that holds at most budgetBytes of decoded sequence. A budget
+	 * smaller than one window disables the cache.
+	 */
+	ReferenceCache(size_t budgetBytes = 0);
+	~ReferenceCache();
+
+	/**
+	 * Indicates if windows are kept at all.
+	 */
+	bool isEnabled() const;
+
+	/**
+	 * Copies up to len bases, starting at offset within the window, into
+	 * buf. Returns the number of bases copied or -1 if the window is not
+	 * cached.
+	 */
+	long read(int contigId, long window, long offset, long len, char *buf);
+
+	/**
+	 * Adds a decoded window, evicting the least recently used windows to
+	 * stay within the budget. The sequence is taken over by the cache.
+	 */
+	void insert(int contigId, long window, std::string &sequence);
+
+	/**
+	 * Records bases that were decoded from the reference.
+	 */
+	void addDecoded(unsigned long long bytes);
+
+	Stats getStats();
+
+protected:
+
+	typedef std::pair<int, long> WindowKey;
+	typedef std::list<std::pair<WindowKey, std::string> > WindowList;
+
+	size_t budget;
+	size_t used;
+
+	//Most recently used window first.
+	WindowList windows;
+	std::map<WindowKey, WindowList::iterator> index;
+
+	Stats stats;
+
+	pthread_mutex_t lock;
+
+private:
+	//The cache owns a lock and is not copied.
+	ReferenceCache(const ReferenceCache &);
+	ReferenceCache &operator=(const ReferenceCache &);
+};
+
+#endif /* REFERENCECACHE_H_ */
@@ -0,0 +1,238 @@
+/*********************************************************************
+ *
+ * RunJournal.cpp:  Checkpoints of a run, so that a run which was stopped
+ * can be resumed where it left off.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "RunJournal.h"
+#include "Utility.h"
+
+using namespace std;
+
+bool RunJournal::RESUME = false;
+const int RunJournal::CHECKPOINT_INTERVAL = 100;
+const string RunJournal::JOURNAL_FILE_EXTENSION = "journal";
+vector<string> RunJournal::INPUTS;
+
+//The first line of a journal, followed by the number of output files.
+const static string JOURNAL_HEADER = "#medreseq-journal";
+
+RunJournal::RunJournal() : fd(-1), numOfFiles(0), pendingCount(0) {
+}
+
+RunJournal::~RunJournal() {
+
+	if(fd >= 0) {
+		close(fd);
+	}
+}
+
+off_t RunJournal::read() {
+
+	ifstream journalFile(journalFileLoc.c_str(), ios::binary);
+	stringstream contents;
+	contents << journalFile.rdbuf();
+	const string text = contents.str();
+
+	//The journal of another run, or another number of files, is not read.
+	if(text.compare(0, header.length(), header) != 0) {
+		return -1;
+	}
+
+	vector<string> pendingRegions;
+	off_t committed = header.length();
+	size_t start = header.length();
+	size_t end;
+
+	//A line without its line break was torn, and so is left out.
+	while((end = text.find('\n', start)) != string::npos) {
+
+		string line = text.substr(start, end - start);
+		start = end + 1;
+
+		if(line.compare(0, 2, "R\t") == 0) {
+			pendingRegions.push_back(line.substr(2));
+		}
+		else if(line.compare(0, 2, "C\t") == 0) {
+			stringstream checkpointLine(line.substr(2));
+			vector<off_t> checkpointLengths;
+			long long length;
+			while(checkpointLine >> length) {
+				checkpointLengths.push_back(length);
+			}
+			if((int) checkpointLengths.size() != numOfFiles) {
+				break;
+			}
+			done.insert(pendingRegions.begin(), pendingRegions.end());
+			pendingRegions.clear();
+			lengths = checkpointLengths;
+			committed = start;
+		}
+		else {
+			break;
+		}
+	}
+
+	return committed;
+}
+
+string RunJournal::describeInput(const string &input) {
+
+	stringstream line;
+	line << "I\t" << input;
+
+	struct stat inputStat;
+	if(stat(input.c_str(), &inputStat) == 0) {
+		line << "\t" << (long long) inputStat.st_size << "\t" << (long long) inputStat.st_mtime;
+	}
+	line << "\n";
+
+	return line.str();
+}
+
+bool RunJournal::open(const string &outputFileLoc, int numOfFiles, const vector<string> &settingsFiles) {
+
+	this->journalFileLoc = outputFileLoc + "." + JOURNAL_FILE_EXTENSION;
+	this->numOfFiles = numOfFiles;
+	this->lengths.assign(numOfFiles, -1);
+	this->done.clear();
+
+	stringstream headerLines;
+	headerLines << JOURNAL_HEADER << "\t" << numOfFiles << "\n";
+	for(vector<string>::const_iterator input=INPUTS.begin(); input!=INPUTS.end(); ++input) {
+		headerLines << describeInput(*input);
+	}
+	for(vector<string>::const_iterator settingsFile=settingsFiles.begin(); settingsFile!=settingsFiles.end(); ++settingsFile) {
+		headerLines << describeInput(*settingsFile);
+	}
+	this->header = headerLines.str();
+
+	off_t committed = -1;
+	if(RESUME && Utility::fileExists(journalFileLoc)) {
+		committed = read();
+		if(committed < 0) {
+			cerr << "The journal " << journalFileLoc << " is not one of a run with these inputs and settings" << endl;
+			return false;
+		}
+	}
+	else if(RESUME) {
+		cerr << "There is no journal " << journalFileLoc << ", so the run starts from the beginning" << endl;
+	}
+
+	//A new journal is started, or the one being resumed is cut back to its
+	//last checkpoint.
+	fd = ::open(journalFileLoc.c_str(), O_WRONLY | O_CREAT | (committed < 0 ? O_TRUNC : 0), 0644);
+	if(fd < 0 || (committed >= 0 && (ftruncate(fd, committed) != 0 || lseek(fd, committed, SEEK_SET) != committed))) {
+		cerr << "Could not write the journal " << journalFileLoc << ": " << strerror(errno) << endl;
+		return false;
+	}
+
+	if(committed < 0) {
+		return writeFully(header) && fsync(fd) == 0;
+	}
+	return true;
+}
+
+bool RunJournal::isDone(const string &region) const {
+	return done.find(region) != done.end();
+}
+
+size_t RunJournal::getDoneCount() const {
+	return done.size();
+}
+
+off_t RunJournal::getLength(int fileIndex) const {
+	return lengths[fileIndex];
+}
+
+void RunJournal::addDone(const string &region) {
+
+	pending += "R\t";
+	pending += region;
+	pending += '\n';
+	pendingCount++;
+}
+
+bool RunJournal::isCheckpointDue() const {
+	return pendingCount >= CHECKPOINT_INTERVAL;
+}
+
+bool RunJournal::writeFully(const string &text) {
+
+	const char *data = text.data();
+	size_t left = text.length();
+	while(left > 0) {
+		ssize_t written = ::write(fd, data, left);
+		if(written < 0 && errno == EINTR) {
+			continue;
+		}
+		if(written <= 0) {
+			return false;
+		}
+		data += written;
+		left -= written;
+	}
+	return true;
+}
+
+bool RunJournal::checkpoint(const vector<off_t> &fileLengths) {
+
+	if(fd < 0) {
+		return false;
+	}
+
+	stringstream checkpointLine;
+	checkpointLine << "C";
+	for(vector<off_t>::const_iterator iterator=fileLengths.begin(); iterator!=fileLengths.end(); ++iterator) {
+		checkpointLine << "\t" << (long long) *iterator;
+	}
+	checkpointLine << "\n";
+
+	pending += checkpointLine.str();
+	bool retVal = writeFully(pending) && fsync(fd) == 0;
+	if(!retVal) {
+		//What follows a torn checkpoint would not be read back, so the
+		//journal is given up.
+		cerr << "Could not write the journal " << journalFileLoc << ": " << strerror(errno) << endl;
+		close(fd);
+		fd = -1;
+	}
+
+	pending.clear();
+	pendingCount = 0;
+
+	return retVal;
+}
+
+void RunJournal::finish() {
+
+	if(fd >= 0) {
+		close(fd);
+		fd = -1;
+	}
+
+	//A journal given up on is removed as well, so that it is not resumed.
+	if(!journalFileLoc.empty()) {
+		remove(journalFileLoc.c_str());
+	}
+}
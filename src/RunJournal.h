@@ -0,0 +1,145 @@
+/*********************************************************************
+ *
+ * RunJournal.h:  Checkpoints of a run, so that a run which was stopped
+ * can be resumed where it left off.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#ifndef RUNJOURNAL_H_
+#define RUNJOURNAL_H_
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <sys/types.h>
+
+/**
+ * The journal of a run, kept next to its output files as <output>.journal
+ * and removed once the run has finished. Its header names the number of
+ * output files and the inputs of the run, each a path with its size and
+ * modification time if it is a file:
+ *   I<tab>input<tab>size<tab>mtime
+ * and a run is only resumed from a journal with the same header. After it
+ * come the regions done and the lengths of the output files, in
+ * checkpoints of CHECKPOINT_INTERVAL regions:
+ *   R<tab>region           a region done since the last checkpoint
+ *   C<tab>length ...       the checkpoint, one length per output file,
+ *                          -1 for a file not created yet
+ * The output files are written through to the disk before a checkpoint is
+ * appended to the journal in one write, so a checkpoint is only there once
+ * the output it stands for is. Regions after the last checkpoint, and a
+ * checkpoint torn by the run going down, are simply not done.
+ */
+class RunJournal {
+
+public:
+
+	//Continues the run of the journal, if there is one; set from main with --resume.
+	static bool RESUME;
+
+	//The number of regions designed between two checkpoints.
+	const static int CHECKPOINT_INTERVAL;
+
+	//The extension of the journal file.
+	const static std::string JOURNAL_FILE_EXTENSION;
+
+	//The fasta and region or sequence inputs of the run; set from main.
+	static std::vector<std::string> INPUTS;
+
+	RunJournal();
+	~RunJournal();
+
+	/**
+	 * Opens the journal of the output with the number of output files and
+	 * the settings files of the run. With RESUME the checkpoints of an
+	 * earlier run are read and kept, otherwise the journal is started
+	 * afresh. Returns false if the journal could not be written, or belongs
+	 * to a run with other output files, INPUTS or settings files.
+	 */
+	bool open(const std::string &outputFileLoc, int numOfFiles, const std::vector<std::string> &settingsFiles);
+
+	/**
+	 * Indicates if the region was done by the run being resumed.
+	 */
+	bool isDone(const std::string &region) const;
+
+	/**
+	 * The number of regions done by the run being resumed.
+	 */
+	size_t getDoneCount() const;
+
+	/**
+	 * The length of the output file at the last checkpoint, or -1 if the
+	 * file had not been created.
+	 */
+	off_t getLength(int fileIndex) const;
+
+	/**
+	 * Records a region as done; it is part of the next checkpoint.
+	 */
+	void addDone(const std::string &region);
+
+	/**
+	 * Indicates if CHECKPOINT_INTERVAL regions were done since the last checkpoint.
+	 */
+	bool isCheckpointDue() const;
+
+	/**
+	 * Appends a checkpoint with the lengths of the output files, which
+	 * must have been written through to the disk already.
+	 */
+	bool checkpoint(const std::vector<off_t> &fileLengths);
+
+	/**
+	 * Closes and removes the journal of a run which has finished.
+	 */
+	void finish();
+
+protected:
+
+	std::string journalFileLoc;
+	int fd;
+	int numOfFiles;
+
+	//The header of the journal of this run.
+	std::string header;
+
+	//The regions done by the run being resumed.
+	std::unordered_set<std::string> done;
+
+	//The lengths at the last checkpoint of the run being resumed.
+	std::vector<off_t> lengths;
+
+	//The records of the regions done since the last checkpoint.
+	std::string pending;
+	int pendingCount;
+
+	/**
+	 * Reads the checkpoints of the journal. Returns the length of the
+	 * journal up to its last whole checkpoint, or -1 if it is not a journal
+	 * of this run.
+	 */
+	off_t read();
+
+	/**
+	 * The header line of an input: the path, and its size and modification
+	 * time if it is a file.
+	 */
+	static std::string describeInput(const std::string &input);
+
+	bool writeFully(const std::string &text);
+
+	//The journal owns its file and is not copied.
+	RunJournal(const RunJournal &);
+	RunJournal &operator=(const RunJournal &);
+};
+
+#endif /* RUNJOURNAL_H_ */
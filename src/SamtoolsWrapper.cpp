@@ -15,22 +15,32 @@
 
 #include <iostream>
 #include <fstream>
+#include <utility>
+#include <cstdlib>
+#include <cstring>
+#include <set>
 
 #include "SamtoolsWrapper.h"
 #include "sam.h"
 #include "SequenceRegions.h"
 #include "Utility.h"
 #include "VCFAdapter.h"
+#include "BEDAdapter.h"
 #include "ConfigurationLoader.h"
+#include "Metrics.h"
 
 using namespace std;
 
 //The initialization of the static variables
-const string SamtoolsWrapper::REGION_INPUT_PATTERN = "^[A-za-z0-9]+:[0-9]+-[0-9]+$";
+//Contig names may hold any printable character, including ':' (e.g. HLA-A*01:01:01:01),
+//so only the last ':' separates the name from the interval.
+const string SamtoolsWrapper::REGION_INPUT_PATTERN = "^[!-~]+:[0-9]+-[0-9]+$";
 int SamtoolsWrapper::SEQUENCE_AROUND_LENGTH = ConfigurationLoader::SEQUENCE_AROUND_LENGTH_DEFAULT;
+int SamtoolsWrapper::REFERENCE_CACHE_MB = 0;
+bool SamtoolsWrapper::USE_REFERENCE_READS = false;
 
 //The empty consturctor
-SamtoolsWrapper::SamtoolsWrapper() {
+SamtoolsWrapper::SamtoolsWrapper() : fai(NULL), isReferenceReads(false), referenceCache(NULL) {
 
 }
 
@@ -42,10 +52,7 @@ SamtoolsWrapper::~SamtoolsWrapper() {
 		fai_destroy(fai);
 	}
 
-	//Delete the temporary regions file if it exists
-	if(Utility::fileExists(VCFAdapter::VCF_TEMP_REGIONS_FILE)) {
-		remove(VCFAdapter::VCF_TEMP_REGIONS_FILE.c_str());
-	}
+	delete referenceCache;
 }
 
 bool SamtoolsWrapper::loadFastaFile(string fastaFileLoc) {
@@ -57,9 +64,55 @@ bool SamtoolsWrapper::loadFastaFile(string fastaFileLoc) {
 	if(fai == NULL) {
 		return false;
 	}
-	else {
+	this->fastaFileLoc = fastaFileLoc;
+	this->isReferenceReads = USE_REFERENCE_READS;
+	fai_set_reference_reads(fai, isReferenceReads ? 1 : 0);
+
+	//The packed cache is built next to the fasta on first use. Without it
+	//the sequences are simply read from the fasta.
+	if(!isReferenceReads && !packedReference.open(fastaFileLoc, fai)) {
+		cerr << "Could not use a packed reference cache for " << fastaFileLoc << ", reading the fasta." << endl;
+	}
+
+	delete referenceCache;
+	referenceCache = new ReferenceCache((size_t) REFERENCE_CACHE_MB << 20);
+
+	//The index is built next to the fasta on first use, from the packed cache
+	//or, without one, from the fasta.
+	if(SpecificityIndex::IS_ENABLED) {
+		if(!specificityIndex.open(fastaFileLoc, fai, &packedReference)) {
+			cerr << "Could not use a specificity index for " << fastaFileLoc << endl;
+			return false;
+		}
+		SpecificityIndex::install(&specificityIndex);
+	}
+
+	return true;
+}
+
+bool SamtoolsWrapper::reopenFastaFile() {
+
+	if(fai == NULL) {
+		return false;
+	}
+	if(packedReference.isOpen()) {
 		return true;
 	}
+
+	fai_destroy(fai);
+	this->fai = fai_load(fastaFileLoc.c_str());
+	if(fai == NULL) {
+		return false;
+	}
+	fai_set_reference_reads(fai, isReferenceReads ? 1 : 0);
+
+	//The specificity index reads the fasta through the index it was opened with.
+	if(specificityIndex.isOpen() && !specificityIndex.open(fastaFileLoc, fai, &packedReference)) {
+		SpecificityIndex::install(NULL);
+		return false;
+	}
+
+	return true;
 }
 
 bool SamtoolsWrapper::isValidRegionsFile(string fileLoc) {
@@ -103,7 +156,7 @@ vector<string> SamtoolsWrapper::retrieveRegionsFromFile(string fileLoc) {
 	return regionsVector;
 }
 
-bool SamtoolsWrapper::validateRegionInput(SequenceRegionInput seqInput) {
+bool SamtoolsWrapper::validateRegionInput(const SequenceRegionInput &seqInput) {
 
 	bool retVal = true;
 
@@ -124,9 +177,16 @@ bool SamtoolsWrapper::validateRegionInput(SequenceRegionInput seqInput) {
 
 SequenceRegionOutput SamtoolsWrapper::retrieveSequencesAroundRegion(SequenceRegionInput &region) {
 
+	Metrics::Timer timer(Metrics::STAGE_FETCH);
+
 	SequenceRegionOutput seqRegOutput = SequenceRegionOutput(region, "", "", "");
 	string prev = "", target = "", next = "";
 
+	//Resolve the contig once, the padding regions below reuse the id.
+	if(region.getContigId() < 0) {
+		region.setContigId(faidx_name2id(fai, region.getRegionName().c_str()));
+	}
+
 	//Validate the input so that every thing is in order for the region.
 	if(validateRegionInput(region)) {
 		//Prev region.
@@ -144,6 +204,7 @@ SequenceRegionOutput SamtoolsWrapper::retrieveSequencesAroundRegion(SequenceRegi
 		SequenceRegionInput prevRegion = SequenceRegionInput(region.getRegionName(),
 									prevRegStartIndex,
 									prevRegEndIndex);
+		prevRegion.setContigId(region.getContigId());
 
 		prev = this->retrieveSequenceForRegion(prevRegion);
 
@@ -154,40 +215,133 @@ SequenceRegionOutput SamtoolsWrapper::retrieveSequencesAroundRegion(SequenceRegi
 		SequenceRegionInput nextRegion = SequenceRegionInput(region.getRegionName(),
 									region.getEndIndex() + 1,
 									region.getEndIndex() + SEQUENCE_AROUND_LENGTH);
+		nextRegion.setContigId(region.getContigId());
 
 		next = this->retrieveSequenceForRegion(nextRegion);
 
 		//Only create the required seq-out object if target has sequences in it.
 		if(!target.empty()) {
-			seqRegOutput = SequenceRegionOutput(region, prev, target, next);
+			seqRegOutput = SequenceRegionOutput(region, std::move(prev), std::move(target), std::move(next));
 		}
 	}
 
 	return seqRegOutput;
 }
 
-string SamtoolsWrapper::retrieveSequenceForRegion(SequenceRegionInput &region) {
+string SamtoolsWrapper::retrieveSequenceForRegion(const SequenceRegionInput &region) {
 
-	int readLength = 0;
+	string sequenceStr("");
 
-	//Calling the samtools api for fetching the sequences in the given region.
-	char *sequence = fai_fetch(fai, region.toString().c_str(), &readLength);
+	//The region is one-based and inclusive, while faidx takes a zero-based
+	//half open interval; a start of 0 is read like 1, as fai_fetch does.
+	long beg = region.getStartIndex() > 0 ? region.getStartIndex() - 1 : 0;
+	long end = region.getEndIndex();
+	long contigLength = faidx_seq_len(fai, region.getContigId());
+	if(end > contigLength) {
+		end = contigLength;
+	}
 
-	string sequenceStr("");
+	if(region.getContigId() < 0 || end <= beg) {
+		return sequenceStr;
+	}
+
+	sequenceStr.resize(end - beg + 1);
 
-	if(sequence != NULL) {
-		sequenceStr = sequence;
-		//The memory allocated by samtools needs to be deleted.
-		free(sequence);
+	if(!isReferenceCacheEnabled()) {
+		long readLength = fetchReference(region.getContigId(), beg, end, &sequenceStr[0]);
+		sequenceStr.resize(readLength > 0 ? readLength : 0);
+		return sequenceStr;
 	}
 
+	//Assemble the region from the aligned windows it overlaps, decoding
+	//only the windows that are not cached yet.
+	long readLength = 0;
+	for(long window = beg / ReferenceCache::WINDOW_SIZE; beg + readLength < end; window++) {
+		long windowStart = window * ReferenceCache::WINDOW_SIZE;
+		long offset = beg + readLength - windowStart;
+		long copied = referenceCache->read(region.getContigId(), window, offset,
+											end - beg - readLength, &sequenceStr[readLength]);
+		if(copied < 0) {
+			long windowEnd = windowStart + ReferenceCache::WINDOW_SIZE;
+			if(windowEnd > contigLength) {
+				windowEnd = contigLength;
+			}
+			string windowStr(windowEnd - windowStart + 1, '\0');
+			long decoded = fetchReference(region.getContigId(), windowStart, windowEnd, &windowStr[0]);
+			windowStr.resize(decoded > 0 ? decoded : 0);
+
+			copied = (long) windowStr.size() - offset < end - beg - readLength ?
+						(long) windowStr.size() - offset : end - beg - readLength;
+			if(copied > 0) {
+				windowStr.copy(&sequenceStr[readLength], copied, offset);
+			}
+			referenceCache->insert(region.getContigId(), window, windowStr);
+		}
+		if(copied <= 0) {
+			break;
+		}
+		readLength += copied;
+	}
+	sequenceStr.resize(readLength);
+
 	return sequenceStr;
 }
 
+long SamtoolsWrapper::fetchReference(int contigId, long beg, long end, char *buf) {
+
+	//Calling the samtools api for fetching the sequences in the given region.
+	long readLength = 0;
+	if(packedReference.isOpen()) {
+		readLength = packedReference.fetch(contigId, beg, end, buf);
+	}
+	else if(isReferenceReads) {
+		//The plain fetch takes an inclusive end and allocates the sequence.
+		int length = 0;
+		char *sequence = faidx_fetch_seq(fai, (char *) faidx_iseq(fai, contigId), beg, end - 1, &length);
+		if(sequence != NULL) {
+			memcpy(buf, sequence, length + 1);
+			readLength = length;
+			free(sequence);
+		}
+	}
+	else {
+		readLength = faidx_fetch_id(fai, contigId, beg, end, buf);
+	}
+
+	if(referenceCache != NULL && readLength > 0) {
+		referenceCache->addDecoded(readLength);
+	}
+
+	if(readLength > 0) {
+		Metrics::addCount(Metrics::COUNTER_BASES_DECODED, readLength);
+	}
+
+	return readLength > 0 ? readLength : 0;
+}
+
+bool SamtoolsWrapper::isReferenceCacheEnabled() const {
+	return referenceCache != NULL && referenceCache->isEnabled();
+}
+
+ReferenceCache::Stats SamtoolsWrapper::getReferenceCacheStats() const {
+
+	ReferenceCache::Stats stats = ReferenceCache::Stats();
+	if(referenceCache != NULL) {
+		stats = referenceCache->getStats();
+	}
+
+	return stats;
+}
+
 //Public methods.
 map<string, SequenceRegionOutput> SamtoolsWrapper::retrieveSequencesForRegions(string regionfileLoc) {
 	map<string, SequenceRegionOutput> regionMap;
 
+	//BED targets are walked from their interval index, see below.
+	if(BEDAdapter::isBEDFile(regionfileLoc)) {
+		return retrieveSequencesForBEDFile(regionfileLoc);
+	}
+
 	//Obtain the regions first
 	vector<string> regionsVector = this->retrieveRegionsFromFile(regionfileLoc);
 
@@ -201,6 +355,57 @@ map<string, SequenceRegionOutput> SamtoolsWrapper::retrieveSequencesForRegions(s
 	return regionMap;
 }
 
+map<string, SequenceRegionOutput> SamtoolsWrapper::retrieveSequencesForBEDFile(string bedFileLoc) {
+	map<string, SequenceRegionOutput> regionMap;
+
+	vector<SequenceRegionInput> regions = retrieveRegionsForBEDFile(bedFileLoc);
+	for(vector<SequenceRegionInput>::iterator iterator=regions.begin();
+				iterator!=regions.end(); ++iterator) {
+		regionMap.insert(pair<string, SequenceRegionOutput>(iterator->toString(), retrieveSequencesAroundRegion(*iterator)));
+	}
+
+	return regionMap;
+}
+
+vector<SequenceRegionInput> SamtoolsWrapper::retrieveRegionsForBEDFile(string bedFileLoc) {
+	vector<SequenceRegionInput> regions;
+
+	BEDAdapter bedAdapter;
+	if(!bedAdapter.load(bedFileLoc, BEDAdapter::MERGE_OVERLAPPING_TARGETS)) {
+		return regions;
+	}
+
+	//Walk the contigs in fasta order and their targets in start order, so
+	//that neighbouring targets are fetched one after the other.
+	int targetCount = 0;
+	for(int contigId = 0; contigId < faidx_fetch_nseq(fai); contigId++) {
+		targetCount += bedAdapter.extractRegions(faidx_iseq(fai, contigId), contigId, regions);
+	}
+
+	if(targetCount < bedAdapter.getTargetCount()) {
+		cerr << bedAdapter.getTargetCount() - targetCount << " targets in " << bedFileLoc
+				<< " are on contigs which are not in the fasta and were skipped." << endl;
+	}
+
+	return regions;
+}
+
+vector<SequenceRegionInput> SamtoolsWrapper::retrieveTargetsForRegions(string regionfileLoc) {
+
+	if(BEDAdapter::isBEDFile(regionfileLoc)) {
+		return retrieveRegionsForBEDFile(regionfileLoc);
+	}
+
+	vector<SequenceRegionInput> regions;
+	vector<string> regionsVector = this->retrieveRegionsFromFile(regionfileLoc);
+	for(vector<string>::const_iterator iterator=regionsVector.begin();
+				iterator!=regionsVector.end(); ++iterator) {
+		regions.push_back(SequenceRegionInput(*iterator));
+	}
+
+	return regions;
+}
+
 SequenceRegionOutput SamtoolsWrapper::retrieveSequenceForRegion(string region) {
 
 	SequenceRegionOutput regionSeqOut;
@@ -212,3 +417,40 @@ SequenceRegionOutput SamtoolsWrapper::retrieveSequenceForRegion(string region) {
 
 	return regionSeqOut;
 }
+
+SequenceRegionOutput SamtoolsWrapper::retrieveSequenceForTarget(SequenceRegionInput target) {
+	return this->retrieveSequencesAroundRegion(target);
+}
+
+//=============================================================================================================
+//SequenceRegionStream class methods.
+
+SequenceRegionStream::SequenceRegionStream(SamtoolsWrapper &samtoolsWrapper, vector<SequenceRegionInput> regions) :
+		samtoolsWrapper(samtoolsWrapper), nextIndex(0) {
+
+	//A region listed more than once is designed once, where it first appears.
+	set<string> keys;
+	for(vector<SequenceRegionInput>::iterator iterator=regions.begin();
+				iterator!=regions.end(); ++iterator) {
+		if(keys.insert(iterator->toString()).second) {
+			this->regions.push_back(std::move(*iterator));
+		}
+	}
+}
+
+bool SequenceRegionStream::next(string &key, SequenceRegionOutput &seqRegOut) {
+
+	if(nextIndex >= regions.size()) {
+		return false;
+	}
+
+	key = regions[nextIndex].toString();
+	seqRegOut = samtoolsWrapper.retrieveSequenceForTarget(regions[nextIndex]);
+	nextIndex++;
+
+	return true;
+}
+
+size_t SequenceRegionStream::size() const {
+	return regions.size();
+}
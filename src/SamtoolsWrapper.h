@@ -24,6 +24,9 @@
 #include "sam.h"
 #include "faidx.h"
 #include "SequenceRegions.h"
+#include "PackedReference.h"
+#include "ReferenceCache.h"
+#include "SpecificityIndex.h"
 
 /**
  * Samtools library is written in C, and this class acts as a wrapper around
@@ -37,6 +40,15 @@ public:
 	//to the left and the right of the target sequence.
 	static int SEQUENCE_AROUND_LENGTH;
 
+	//The memory budget in MB for decoded reference windows kept between
+	//regions; 0 turns the cache off.
+	static int REFERENCE_CACHE_MB;
+
+	//Whether sequences are read the plain way samtools did, with
+	//faidx_fetch_seq() and without the 2-bit packed cache of the fasta,
+	//to check the faster reads against.
+	static bool USE_REFERENCE_READS;
+
 	//The pattern which recognizes if a region is in the correct format.
 	//This acts as a regex match.
 	const static std::string REGION_INPUT_PATTERN;
@@ -57,22 +69,84 @@ public:
 	 */
 	bool loadFastaFile(std::string fastaFileLoc);
 
+	/*
+	 * Opens the loaded fasta file again, for a forked process, which would
+	 * otherwise share the position in the file with its parent. Nothing is
+	 * done when sequences come from the packed reference, which is mapped.
+	 *
+	 * Returns a false value on failure.
+	 */
+	bool reopenFastaFile();
+
 	/*
 	 * This method returns a key value pair of regions -> sequence
 	 * for a given file which contains information about the regions.
 	 */
 	std::map<std::string, SequenceRegionOutput> retrieveSequencesForRegions(std::string regionfileLoc);
 
+	/*
+	 * This method returns a key value pair of regions -> sequence for the
+	 * targets of a BED file, after de-duplication and optional merging.
+	 */
+	std::map<std::string, SequenceRegionOutput> retrieveSequencesForBEDFile(std::string bedFileLoc);
+
+	/*
+	 * This method returns the targets of a BED file, after de-duplication
+	 * and optional merging, in the order they are fetched: the contigs in
+	 * fasta order and the targets of each by start. No sequence is read.
+	 */
+	std::vector<SequenceRegionInput> retrieveRegionsForBEDFile(std::string bedFileLoc);
+
+	/*
+	 * This method returns the regions of a regions, VCF or BED file in the
+	 * order they are designed in: that of the file, or for a BED file the
+	 * order above. No sequence is read.
+	 */
+	std::vector<SequenceRegionInput> retrieveTargetsForRegions(std::string regionfileLoc);
+
+	/* This method provides the sequences for a region input whose contig
+	 * may already be resolved, as for the targets of a BED file.
+	 */
+	SequenceRegionOutput retrieveSequenceForTarget(SequenceRegionInput target);
+
 	/* This method provides a string containing the sequence for
 	 * regions which is passed as parameter.
 	 */
 	SequenceRegionOutput retrieveSequenceForRegion(std::string region);
 
+	/**
+	 * Indicates if decoded reference windows are cached.
+	 */
+	bool isReferenceCacheEnabled() const;
+
+	/**
+	 * The hit and decode counts of the reference cache.
+	 */
+	ReferenceCache::Stats getReferenceCacheStats() const;
+
 protected:
 
 	/* The structure that corresponds to a particular fasta index file */
 	faidx_t *fai;
 
+	/* The location of the loaded fasta file */
+	std::string fastaFileLoc;
+
+	/* Whether the fasta was loaded for reference reads, from USE_REFERENCE_READS. */
+	bool isReferenceReads;
+
+	/* The 2-bit packed cache of the same fasta, used instead of reading
+	 * the fasta whenever it is available. */
+	PackedReference packedReference;
+
+	/* Decoded windows of the reference, sized by REFERENCE_CACHE_MB when
+	 * the fasta is loaded. */
+	ReferenceCache *referenceCache;
+
+	/* The k-mer index of the same fasta, which primer3 checks every
+	 * primer and pair against when SpecificityIndex::IS_ENABLED is set. */
+	SpecificityIndex specificityIndex;
+
 	/**
 	 * This method walks through the entire regions file and infers if the file contents
 	 * are valid or not.
@@ -89,7 +163,7 @@ protected:
 	/**
 	 * This method recognizes if a given region input object is a valid region or not.
 	 */
-	bool validateRegionInput(SequenceRegionInput seqInput);
+	bool validateRegionInput(const SequenceRegionInput &seqInput);
 
 	/**
 	 * Retrieves the sequences around the target regions by padding the target with
@@ -99,9 +173,40 @@ protected:
 
 	/**
 	 * Retrieves the actual sequences for a given region input.
-	 * It uses the samtools faidx to do so.
+	 * It uses the samtools faidx to do so. Once the fasta is loaded
+	 * this may be called from several threads at a time.
 	 */
-	std::string retrieveSequenceForRegion(SequenceRegionInput &region);
+	std::string retrieveSequenceForRegion(const SequenceRegionInput &region);
+
+	/**
+	 * Decodes the zero-based half open interval [beg, end) of a contig into
+	 * buf from the packed cache or the fasta, bypassing the reference cache.
+	 * Returns the number of bases written.
+	 */
+	long fetchReference(int contigId, long beg, long end, char *buf);
+};
+
+/**
+ * Fetches the sequences of a list of regions one at a time, as primer3
+ * asks for them, so that a long target list is designed and written
+ * region by region in its own order instead of being held in memory.
+ */
+class SequenceRegionStream : public SequenceRegionSource {
+
+public:
+	SequenceRegionStream(SamtoolsWrapper &, std::vector<SequenceRegionInput>);
+
+	bool next(std::string &key, SequenceRegionOutput &seqRegOut);
+
+	//The number of regions in the stream.
+	size_t size() const;
+
+protected:
+	SamtoolsWrapper &samtoolsWrapper;
+	std::vector<SequenceRegionInput> regions;
+
+	//The index of the region handed out next.
+	size_t nextIndex;
 };
 
 #endif /* SAMTOOLSWRAPPER_H_ */
@@ -19,6 +19,7 @@
 #include <sstream>
 #include <vector>
 #include <cstdlib>
+#include <utility>
 
 #include "SequenceRegions.h"
 #include "Utility.h"
@@ -28,23 +29,22 @@ using namespace std;
 //=============================================================================================================
 //SequenceRegionInput class methods.
 
-SequenceRegionInput::SequenceRegionInput(string region) {
+SequenceRegionInput::SequenceRegionInput(const string &region) {
 
 	string regionName("");
 	string rightStr("");
 	long startIndex = 0;
 	long endIndex = 0;
 
-	//First split by : and then by -
-	vector<string> regionArr = Utility::split(region, ":");
-	if(!((string)regionArr[0]).empty() && !((string)regionArr[1]).empty()) {
+	//First split by the last : (contig names may contain : and -) and then by -
+	size_t colonPos = region.rfind(":");
+	if(colonPos != string::npos && colonPos > 0 && colonPos + 1 < region.length()) {
 
-		regionName = regionArr[0];
-		rightStr = regionArr[1];
+		regionName = region.substr(0, colonPos);
+		rightStr = region.substr(colonPos + 1);
 
-		//Reuse the same array.
-		regionArr = Utility::split(rightStr, "-");
-		if(!((string)regionArr[0]).empty() && !((string)regionArr[1]).empty()) {
+		vector<string> regionArr = Utility::split(rightStr, "-");
+		if(regionArr.size() >= 2 && !((string)regionArr[0]).empty() && !((string)regionArr[1]).empty()) {
 			startIndex = atol(((string)regionArr[0]).c_str());
 			endIndex = atol(((string)regionArr[1]).c_str());
 		}
@@ -53,17 +53,19 @@ SequenceRegionInput::SequenceRegionInput(string region) {
 	this->regionName = regionName;
 	this->startIndex = startIndex;
 	this->endIndex = endIndex;
+	this->contigId = -1;
 }
 
 //The implementations for the SequenceRegion class.
-SequenceRegionInput::SequenceRegionInput(string regionName, long startIndex, long endIndex) {
+SequenceRegionInput::SequenceRegionInput(const string &regionName, long startIndex, long endIndex) {
 
 	this->regionName = regionName;
 	this->startIndex = startIndex;
 	this->endIndex = endIndex;
+	this->contigId = -1;
 }
 
-string SequenceRegionInput::convertToRegionFormat(std::string regionName, long startIndex, long endIndex) {
+string SequenceRegionInput::convertToRegionFormat(const std::string &regionName, long startIndex, long endIndex) {
 
 	string retVal;
 
@@ -82,26 +84,35 @@ string SequenceRegionInput::convertToRegionFormat(std::string regionName, long s
 	return retVal;
 }
 
-string convertToRegionFormat(std::string regionName, std::string startIndex, std::string endIndex) {
+string SequenceRegionInput::convertToRegionFormat(const std::string &regionName,
+										const std::string &startIndex, const std::string &endIndex) {
 
 	string retVal = regionName + ":" + startIndex + "-" + endIndex;
 	return retVal;
 }
 
 
-string SequenceRegionInput::getRegionName() {
+const string &SequenceRegionInput::getRegionName() const {
 	return this->regionName;
 }
 
-long SequenceRegionInput::getStartIndex() {
+long SequenceRegionInput::getStartIndex() const {
 	return this->startIndex;
 }
 
-long SequenceRegionInput::getEndIndex() {
+long SequenceRegionInput::getEndIndex() const {
 	return this->endIndex;
 }
 
-string SequenceRegionInput::toString() {
+int SequenceRegionInput::getContigId() const {
+	return this->contigId;
+}
+
+void SequenceRegionInput::setContigId(int contigId) {
+	this->contigId = contigId;
+}
+
+string SequenceRegionInput::toString() const {
 
 	string regionStr = convertToRegionFormat(this->getRegionName(),
 												this->getStartIndex(), this->getEndIndex());
@@ -111,59 +122,59 @@ string SequenceRegionInput::toString() {
 //=============================================================================================================
 //SequenceRegionOutput class methods.
 
-SequenceRegionOutput::SequenceRegionOutput(SequenceRegionInput &seqInput, string completeSequence) {
-
-	string prev = "";
-	string target = "";
-	string next = "";
+SequenceRegionOutput::SequenceRegionOutput(const SequenceRegionInput &seqInput, const string &completeSequence) :
+		seqRegInput(seqInput) {
 
+	//The parts are taken straight out of the complete sequence.
 	size_t prevPos = completeSequence.find("[");
-	prev = completeSequence.substr(0, prevPos);
+	this->prevSequence.assign(completeSequence, 0, prevPos);
 
 	size_t nextPos = completeSequence.find("]");
-	next = completeSequence.substr(nextPos + 1);
+	this->nextSequence.assign(completeSequence, nextPos + 1, string::npos);
 
-	target = completeSequence.substr(prevPos + 1, nextPos - prevPos - 1);
-
-	this->prevSequence  = prev;
-	this->targetSequence = target;
-	this->nextSequence = next;
-	this->seqRegInput = seqInput;
+	this->targetSequence.assign(completeSequence, prevPos + 1, nextPos - prevPos - 1);
 }
 
 
-SequenceRegionOutput::SequenceRegionOutput(SequenceRegionInput &seqInput, string prev, string target, string next) {
+SequenceRegionOutput::SequenceRegionOutput(const SequenceRegionInput &seqInput, string prev, string target, string next) :
+		seqRegInput(seqInput), prevSequence(std::move(prev)),
+		targetSequence(std::move(target)), nextSequence(std::move(next)) {
 
-	this->seqRegInput = SequenceRegionInput(seqInput.toString());
-	this->prevSequence  = prev;
-	this->targetSequence = target;
-	this->nextSequence = next;
 }
 
-SequenceRegionInput SequenceRegionOutput::getSeqRegInput() {
+const SequenceRegionInput &SequenceRegionOutput::getSeqRegInput() const {
 	return seqRegInput;
 }
 
-std::string SequenceRegionOutput::getPrevSequence() {
+const std::string &SequenceRegionOutput::getPrevSequence() const {
 	return prevSequence;
 }
 
-std::string SequenceRegionOutput::getTargetSequence() {
+const std::string &SequenceRegionOutput::getTargetSequence() const {
 	return targetSequence;
 }
 
-std::string SequenceRegionOutput::getNextSequence() {
+const std::string &SequenceRegionOutput::getNextSequence() const {
 		return nextSequence;
 }
 
-std::string SequenceRegionOutput::getCompleteSequence(bool isTargetEnclosed/*=false*/) {
+std::string SequenceRegionOutput::getCompleteSequence(bool isTargetEnclosed/*=false*/) const {
+
+	//Build the sequence in one allocation.
+	string retVal;
+	retVal.reserve(prevSequence.length() + targetSequence.length() + nextSequence.length() + 2);
 
-	if(!isTargetEnclosed) {
-		return string(prevSequence + targetSequence + nextSequence);
+	retVal += prevSequence;
+	if(isTargetEnclosed) {
+		retVal += '[';
 	}
-	else {
-		return string(prevSequence + "[" + targetSequence + "]" + nextSequence);
+	retVal += targetSequence;
+	if(isTargetEnclosed) {
+		retVal += ']';
 	}
+	retVal += nextSequence;
+
+	return retVal;
 }
 
 //=============================================================================================================
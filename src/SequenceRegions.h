@@ -33,32 +33,36 @@ protected:
 	//The end index of the target region.
 	long endIndex;
 
+	//The id of the contig in the loaded fasta index, -1 until it is resolved.
+	int contigId;
 
 public:
 	//Constructor where each individual parameter is passed separately.
-	SequenceRegionInput(std::string, long, long);
+	SequenceRegionInput(const std::string &, long, long);
 
 	//Constructor where the entire region string is passed.
-	SequenceRegionInput(std::string);
+	SequenceRegionInput(const std::string &);
 
 	//Default constructor
-	SequenceRegionInput() {};
+	SequenceRegionInput() : startIndex(0), endIndex(0), contigId(-1) {};
 
 	/**
 	 * The static overloaded methods which provides the string format representaion
 	 * of the regions from a given input. The string representation would look like
 	 * chrName:startIndex-endIndex
 	 */
-	static std::string convertToRegionFormat(std::string, long, long);
-	static std::string convertToRegionFormat(std::string, std::string, std::string);
+	static std::string convertToRegionFormat(const std::string &, long, long);
+	static std::string convertToRegionFormat(const std::string &, const std::string &, const std::string &);
 
 	//The string representation of the region input object.
-	std::string toString();
+	std::string toString() const;
 
 	//The getters.
-	std::string getRegionName();
-	long getStartIndex();
-	long getEndIndex();
+	const std::string &getRegionName() const;
+	long getStartIndex() const;
+	long getEndIndex() const;
+	int getContigId() const;
+	void setContigId(int);
 };
 
 /**
@@ -80,21 +84,38 @@ protected:
 	std::string nextSequence;
 
 public:
-	//Constructors
+	//Constructors. The sequences are taken by value, so that callers which
+	//no longer need them can move them in rather than copy them.
 	SequenceRegionOutput() {};
-	SequenceRegionOutput(SequenceRegionInput &, std::string);
-	SequenceRegionOutput(SequenceRegionInput &, std::string, std::string, std::string);
+	SequenceRegionOutput(const SequenceRegionInput &, const std::string &);
+	SequenceRegionOutput(const SequenceRegionInput &, std::string, std::string, std::string);
 
 	//The getters and setters.
-	SequenceRegionInput getSeqRegInput();
-	std::string getPrevSequence();
-	std::string getTargetSequence();
-	std::string getNextSequence();
+	const SequenceRegionInput &getSeqRegInput() const;
+	const std::string &getPrevSequence() const;
+	const std::string &getTargetSequence() const;
+	const std::string &getNextSequence() const;
 
 	//The method returns a concatenation of the complete sequence which incudes the
 	//prev - target - next sequences. If the boolean target parameter is true, then
 	//the target region will be enclosed by a square brackets. prev-[target]-next.
-	std::string getCompleteSequence(bool isTargetEnclosed=false);
+	std::string getCompleteSequence(bool isTargetEnclosed=false) const;
+};
+
+/**
+ * Hands out the regions of an input one at a time, with the key the
+ * region is known by in the output and the journal, so that a region's
+ * sequences need only be held while its primers are designed.
+ */
+class SequenceRegionSource {
+
+public:
+	virtual ~SequenceRegionSource() {};
+
+	/**
+	 * Gives the next region and its key. Returns false once there are no more.
+	 */
+	virtual bool next(std::string &key, SequenceRegionOutput &seqRegOut) = 0;
 };
 #endif /* SEQUENCEREGIONS_H_ */
 
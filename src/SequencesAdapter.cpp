@@ -57,10 +57,10 @@ map<string, SequenceRegionOutput> SequencesAdapter::retrieveSequencesFromFile(st
 	return sequencesMap;
 }
 
-SequenceRegionOutput SequencesAdapter::retrieveSequenceObj(string sequenceName, string sequence) {
+SequenceRegionOutput SequencesAdapter::retrieveSequenceObj(const string &sequenceName, const string &sequence) {
 
 	SequenceRegionInput seqInput = SequenceRegionInput(sequenceName, 0, 0);
-	SequenceRegionOutput seqOut = SequenceRegionOutput(seqInput, string(sequence));
+	SequenceRegionOutput seqOut = SequenceRegionOutput(seqInput, sequence);
 
 	return seqOut;
 
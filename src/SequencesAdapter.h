@@ -42,7 +42,7 @@ public:
 	/**
 	 * This method create a sequences output object from a given string sequence.
 	 */
-	SequenceRegionOutput retrieveSequenceObj(std::string sequenceName, std::string sequence);
+	SequenceRegionOutput retrieveSequenceObj(const std::string &sequenceName, const std::string &sequence);
 
 };
 
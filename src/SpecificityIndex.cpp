@@ -0,0 +1,487 @@
+/*********************************************************************
+ *
+ * SpecificityIndex.cpp:  A k-mer index of the whole reference, used to
+ * reject primers and pairs which would bind or amplify elsewhere.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "SpecificityIndex.h"
+#include "CacheFile.h"
+#include "libprimer3.h"
+
+using namespace std;
+
+/*
+ * Layout of the index file, in host byte order:
+ *
+ *   Header
+ *   uint64_t contigStarts[contigCount + 1]   the position of every contig in
+ *                                            the reference laid end to end
+ *   uint32_t buckets[4^kmerLength + 1]       where the positions of every
+ *                                            k-mer start, A=0 C=1 G=2 T=3
+ *                                            with the first base highest
+ *   (padding to 8 bytes)
+ *   uint32_t positions[positionCount]        the positions of every k-mer,
+ *                                            ascending within a k-mer
+ */
+struct SpecificityIndex::Header {
+	CacheFile::Stamp stamp;
+	uint64_t contigCount;
+	uint64_t kmerLength;
+	uint64_t positionCount;
+	uint64_t fileSize;
+};
+
+bool SpecificityIndex::IS_ENABLED = false;
+const string SpecificityIndex::INDEX_FILE_EXTENSION = ".kmi";
+const int SpecificityIndex::KMER_LENGTH = 12;
+int SpecificityIndex::MAX_MISMATCHES = 3;
+int SpecificityIndex::MAX_BINDING_SITES = 100;
+int SpecificityIndex::MAX_PRODUCT_SIZE = 4000;
+
+static const char INDEX_MAGIC[8] = "MRKMER1";
+
+//The number of bases read from the reference at a time while building.
+static const int BUILD_CHUNK_SIZE = 1 << 20;
+
+//A k-mer seen more often than this (such as in a satellite) is not
+//checked site by site; the primer is taken as not specific.
+static const uint32_t MAX_KMER_POSITIONS = 1 << 16;
+
+//The number of primers whose sites are kept.
+static const size_t SITE_CACHE_SIZE = 1 << 16;
+
+//The index the primer3 hooks look in.
+static SpecificityIndex *installedIndex = NULL;
+
+//Where the template primer3 designs on lies in the reference; see placeTemplate().
+static int templateContigId = -1;
+static long templateStart = 0;
+
+static bool isSameSite(const SpecificityIndex::Site &site, const SpecificityIndex::Site &other) {
+	return site.contigId == other.contigId && site.start == other.start && site.isReverse == other.isReverse;
+}
+
+static uint64_t bucketsOffset(size_t headerSize, uint64_t contigCount) {
+	return headerSize + (contigCount + 1) * sizeof(uint64_t);
+}
+
+static uint64_t positionsOffset(size_t headerSize, uint64_t contigCount, int kmerLength) {
+	uint64_t end = bucketsOffset(headerSize, contigCount) + ((1UL << (2 * kmerLength)) + 1) * sizeof(uint32_t);
+	return (end + 7) / 8 * 8;
+}
+
+/*
+ * Calls visit(code, position) for every k-mer of ACGT bases of the
+ * reference, positions being those of the contigs laid end to end. The
+ * bases are read with fetch(contigId, beg, end, buf).
+ */
+template<typename Fetch, typename Visit>
+static bool forEachKmer(Fetch fetch, int contigCount, const vector<uint64_t> &contigStarts,
+						int kmerLength, Visit visit) {
+
+	const uint32_t mask = (1U << (2 * kmerLength)) - 1;
+	vector<char> chunk(BUILD_CHUNK_SIZE + 1);
+
+	for(int id = 0; id < contigCount; id++) {
+		long length = contigStarts[id + 1] - contigStarts[id];
+		uint32_t code = 0;
+		int valid = 0;
+
+		for(long chunkStart = 0; chunkStart < length; chunkStart += BUILD_CHUNK_SIZE) {
+			long chunkEnd = min(length, chunkStart + BUILD_CHUNK_SIZE);
+			if(fetch(id, chunkStart, chunkEnd, &chunk[0]) != chunkEnd - chunkStart) {
+				return false;
+			}
+
+			for(long i = chunkStart; i < chunkEnd; i++) {
+				int base = CacheFile::baseCode(chunk[i - chunkStart]);
+				if(base < 0) {
+					valid = 0;
+					continue;
+				}
+				code = ((code << 2) | base) & mask;
+				if(++valid >= kmerLength) {
+					visit(code, (uint32_t) (contigStarts[id] + i - kmerLength + 1));
+				}
+			}
+		}
+	}
+	return true;
+}
+
+SpecificityIndex::SpecificityIndex() : mapping(NULL), mappingSize(0), header(NULL),
+		contigStarts(NULL), buckets(NULL), positions(NULL), fai(NULL), reference(NULL) {
+}
+
+SpecificityIndex::~SpecificityIndex() {
+
+	if(installedIndex == this) {
+		install(NULL);
+	}
+	this->close();
+}
+
+bool SpecificityIndex::isOpen() const {
+	return mapping != NULL;
+}
+
+void SpecificityIndex::close() {
+
+	CacheFile::unmap(mapping, mappingSize);
+	mapping = NULL;
+	mappingSize = 0;
+	header = NULL;
+	contigStarts = NULL;
+	buckets = NULL;
+	positions = NULL;
+	siteCache.clear();
+}
+
+bool SpecificityIndex::open(string fastaFileLoc, const faidx_t *fai, const PackedReference *reference) {
+
+	this->close();
+
+	if(fai == NULL) {
+		return false;
+	}
+	this->fai = fai;
+	this->reference = reference;
+
+	string indexFileLoc = fastaFileLoc + INDEX_FILE_EXTENSION;
+	if(this->map(fastaFileLoc, indexFileLoc, fai)) {
+		return true;
+	}
+
+	cout << "Building the specificity index " << indexFileLoc << endl;
+	if(!this->build(fastaFileLoc, indexFileLoc, fai)) {
+		return false;
+	}
+	return this->map(fastaFileLoc, indexFileLoc, fai);
+}
+
+long SpecificityIndex::fetch(int contigId, long beg, long end, char *buf) const {
+
+	if(reference != NULL && reference->isOpen()) {
+		return reference->fetch(contigId, beg, end, buf);
+	}
+
+	//The fasta itself; the plain fetch takes an inclusive end and allocates the sequence.
+	int length = 0;
+	char *sequence = faidx_fetch_seq(fai, (char *) faidx_iseq(fai, contigId), beg, end - 1, &length);
+	if(sequence == NULL) {
+		return -1;
+	}
+	memcpy(buf, sequence, length + 1);
+	free(sequence);
+	return length;
+}
+
+bool SpecificityIndex::map(string fastaFileLoc, string indexFileLoc, const faidx_t *fai) {
+
+	mapping = CacheFile::map(indexFileLoc, INDEX_MAGIC, fastaFileLoc, sizeof(Header), mappingSize);
+	if(mapping == NULL) {
+		return false;
+	}
+
+	header = (const Header *) mapping;
+
+	int contigCount = faidx_fetch_nseq(fai);
+	bool valid = header->fileSize == mappingSize &&
+			header->contigCount == (uint64_t) contigCount &&
+			header->kmerLength == (uint64_t) KMER_LENGTH &&
+			positionsOffset(sizeof(Header), contigCount, KMER_LENGTH) +
+					header->positionCount * sizeof(uint32_t) == mappingSize;
+
+	if(valid) {
+		contigStarts = (const uint64_t *) (mapping + sizeof(Header));
+		buckets = (const uint32_t *) (mapping + bucketsOffset(sizeof(Header), contigCount));
+		positions = (const uint32_t *) (mapping + positionsOffset(sizeof(Header), contigCount, KMER_LENGTH));
+		valid = buckets[1UL << (2 * KMER_LENGTH)] == header->positionCount;
+	}
+
+	//The contigs must be those of the index.
+	for(int id = 0; valid && id < contigCount; id++) {
+		valid = contigStarts[id + 1] - contigStarts[id] == (uint64_t) faidx_seq_len(fai, id);
+	}
+
+	if(!valid) {
+		this->close();
+	}
+	return valid;
+}
+
+bool SpecificityIndex::build(string fastaFileLoc, string indexFileLoc, const faidx_t *fai) {
+
+	Header head;
+	memset(&head, 0, sizeof(head));
+	if(!CacheFile::stamp(head.stamp, INDEX_MAGIC, fastaFileLoc)) {
+		return false;
+	}
+
+	int contigCount = faidx_fetch_nseq(fai);
+	vector<uint64_t> starts(contigCount + 1, 0);
+	bool isTooLong = false;
+	for(int id = 0; id < contigCount; id++) {
+		isTooLong = isTooLong || faidx_seq_len(fai, id) < 0;
+		starts[id + 1] = starts[id] + max(faidx_seq_len(fai, id), 0);
+	}
+
+	//Positions are kept in 32 bits.
+	if(isTooLong || starts[contigCount] > UINT32_MAX) {
+		cerr << "The reference is too long for a specificity index" << endl;
+		return false;
+	}
+
+	//The first pass counts every k-mer, so that the positions can be
+	//written straight to their place in the second.
+	const uint64_t kmerCount = 1UL << (2 * KMER_LENGTH);
+	vector<uint32_t> counts(kmerCount + 1, 0);
+	auto fetch = [this](int contigId, long beg, long end, char *buf) {
+		return this->fetch(contigId, beg, end, buf);
+	};
+	if(!forEachKmer(fetch, contigCount, starts, KMER_LENGTH,
+			[&counts](uint32_t code, uint32_t) { counts[code + 1]++; })) {
+		return false;
+	}
+	for(uint64_t code = 0; code < kmerCount; code++) {
+		counts[code + 1] += counts[code];
+	}
+
+	head.contigCount = contigCount;
+	head.kmerLength = KMER_LENGTH;
+	head.positionCount = counts[kmerCount];
+	head.fileSize = positionsOffset(sizeof(Header), contigCount, KMER_LENGTH) + head.positionCount * sizeof(uint32_t);
+
+	string tempFileLoc = CacheFile::tempFileLoc(indexFileLoc);
+
+	//The file is filled through a mapping, so that the positions of a whole
+	//genome need not fit in memory.
+	int fd = ::open(tempFileLoc.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) {
+		return false;
+	}
+	void *data = MAP_FAILED;
+	if(ftruncate(fd, head.fileSize) == 0) {
+		data = mmap(NULL, head.fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	if(data == MAP_FAILED) {
+		::close(fd);
+		return CacheFile::commit(tempFileLoc, indexFileLoc, false);
+	}
+
+	char *file = (char *) data;
+	memcpy(file, &head, sizeof(head));
+	memcpy(file + sizeof(Header), &starts[0], starts.size() * sizeof(uint64_t));
+	memcpy(file + bucketsOffset(sizeof(Header), contigCount), &counts[0], counts.size() * sizeof(uint32_t));
+
+	uint32_t *filePositions = (uint32_t *) (file + positionsOffset(sizeof(Header), contigCount, KMER_LENGTH));
+	bool ok = forEachKmer(fetch, contigCount, starts, KMER_LENGTH,
+			[&counts, filePositions](uint32_t code, uint32_t position) {
+				filePositions[counts[code]++] = position;
+			});
+
+	ok = msync(data, head.fileSize, MS_SYNC) == 0 && ok;
+	munmap(data, head.fileSize);
+	if(::close(fd) != 0) {
+		ok = false;
+	}
+
+	return CacheFile::commit(tempFileLoc, indexFileLoc, ok);
+}
+
+bool SpecificityIndex::addSites(const string &sequence, bool isReverse, vector<Site> &sites) const {
+
+	const int length = sequence.length();
+	const int anchorStart = isReverse ? 0 : length - KMER_LENGTH;
+
+	uint32_t code = 0;
+	for(int i = anchorStart; i < anchorStart + KMER_LENGTH; i++) {
+		int base = CacheFile::baseCode(sequence[i]);
+		if(base < 0) {
+			return true;
+		}
+		code = (code << 2) | base;
+	}
+
+	uint32_t first = buckets[code], last = buckets[code + 1];
+	if(last - first > MAX_KMER_POSITIONS) {
+		return false;
+	}
+
+	const uint64_t *contigEnd = contigStarts + header->contigCount + 1;
+	char window[length + 1];
+
+	for(uint32_t p = first; p < last; p++) {
+
+		int contigId = upper_bound(contigStarts, contigEnd, (uint64_t) positions[p]) - contigStarts - 1;
+		long start = positions[p] - contigStarts[contigId] - anchorStart;
+		if(start < 0 || start + length > (long) (contigStarts[contigId + 1] - contigStarts[contigId])) {
+			continue;
+		}
+
+		//Only the bases outside the anchor can differ.
+		if(fetch(contigId, start, start + length, window) != length) {
+			continue;
+		}
+		int mismatches = 0;
+		for(int i = 0; i < length && mismatches <= MAX_MISMATCHES; i++) {
+			if(i == anchorStart) {
+				i += KMER_LENGTH - 1;
+				continue;
+			}
+			int base = CacheFile::baseCode(window[i]);
+			if(base < 0 || base != CacheFile::baseCode(sequence[i])) {
+				mismatches++;
+			}
+		}
+		if(mismatches > MAX_MISMATCHES) {
+			continue;
+		}
+
+		Site site = {contigId, start, isReverse};
+		sites.push_back(site);
+		if((int) sites.size() > MAX_BINDING_SITES) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SpecificityIndex::findSites(const string &primer, vector<Site> &sites) const {
+
+	sites.clear();
+	if(!isOpen() || (int) primer.length() < KMER_LENGTH) {
+		return true;
+	}
+
+	//On the reverse strand the primer reads as its reverse complement.
+	string reverse(primer.rbegin(), primer.rend());
+	for(string::iterator base = reverse.begin(); base != reverse.end(); ++base) {
+		switch(*base) {
+		case 'A': case 'a': *base = 'T'; break;
+		case 'C': case 'c': *base = 'G'; break;
+		case 'G': case 'g': *base = 'C'; break;
+		case 'T': case 't': *base = 'A'; break;
+		default: *base = 'N';
+		}
+	}
+
+	return addSites(primer, false, sites) && addSites(reverse, true, sites);
+}
+
+const SpecificityIndex::SiteList &SpecificityIndex::lookup(const string &primer) {
+
+	unordered_map<string, SiteList>::iterator cached = siteCache.find(primer);
+	if(cached != siteCache.end()) {
+		return cached->second;
+	}
+
+	SiteList &siteList = siteCache[primer];
+	siteList.isSpecific = findSites(primer, siteList.sites);
+	return siteList;
+}
+
+void SpecificityIndex::limitCache() {
+
+	if(siteCache.size() >= SITE_CACHE_SIZE) {
+		siteCache.clear();
+	}
+}
+
+int SpecificityIndex::countProducts(const string &left, const string &right, int limit,
+									const Site *leftSite, const Site *rightSite) {
+
+	limitCache();
+	const SiteList &leftSites = lookup(left);
+	const SiteList &rightSites = lookup(right);
+	if(!leftSites.isSpecific || !rightSites.isSpecific) {
+		return limit;
+	}
+
+	//A product runs from a forward site of either primer to the end of a
+	//reverse site of either primer on the same contig.
+	const SiteList *lists[2] = {&leftSites, &rightSites};
+	const long lengths[2] = {(long) left.length(), (long) right.length()};
+	int products = 0;
+
+	for(int f = 0; f < 2; f++) {
+		for(vector<Site>::const_iterator forward = lists[f]->sites.begin();
+				forward != lists[f]->sites.end(); ++forward) {
+			if(forward->isReverse) {
+				continue;
+			}
+			for(int r = 0; r < 2; r++) {
+				for(vector<Site>::const_iterator reverse = lists[r]->sites.begin();
+						reverse != lists[r]->sites.end(); ++reverse) {
+					if(!reverse->isReverse || reverse->contigId != forward->contigId) {
+						continue;
+					}
+					if(f == 0 && r == 1 && leftSite != NULL && rightSite != NULL &&
+							isSameSite(*forward, *leftSite) && isSameSite(*reverse, *rightSite)) {
+						continue;
+					}
+					long productSize = reverse->start + lengths[r] - forward->start;
+					if(productSize >= lengths[f] && productSize <= MAX_PRODUCT_SIZE && ++products >= limit) {
+						return products;
+					}
+				}
+			}
+		}
+	}
+	return products;
+}
+
+int SpecificityIndex::isOligoSpecific(const char *oligo) {
+
+	installedIndex->limitCache();
+	return installedIndex->lookup(oligo).isSpecific;
+}
+
+int SpecificityIndex::isPairSpecific(const char *left, int leftStart, const char *right, int rightStart) {
+
+	//Without the place of the template, the intended product is taken to
+	//be one of those found.
+	if(templateContigId < 0) {
+		return installedIndex->countProducts(left, right, 2) < 2;
+	}
+
+	Site leftSite = {templateContigId, templateStart + leftStart, false};
+	Site rightSite = {templateContigId, templateStart + rightStart, true};
+	return installedIndex->countProducts(left, right, 1, &leftSite, &rightSite) == 0;
+}
+
+void SpecificityIndex::placeTemplate(int contigId, long start) {
+
+	templateContigId = contigId;
+	templateStart = start;
+}
+
+void SpecificityIndex::install(SpecificityIndex *index) {
+
+	installedIndex = index;
+	if(index != NULL) {
+		p3_set_specificity_hooks(isOligoSpecific, isPairSpecific);
+	}
+	else {
+		p3_set_specificity_hooks(NULL, NULL);
+	}
+}
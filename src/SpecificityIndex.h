@@ -0,0 +1,201 @@
+/*********************************************************************
+ *
+ * SpecificityIndex.h:  A k-mer index of the whole reference, used to
+ * reject primers and pairs which would bind or amplify elsewhere.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#ifndef SPECIFICITYINDEX_H_
+#define SPECIFICITYINDEX_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "faidx.h"
+#include "PackedReference.h"
+
+/**
+ * A read-only, memory mapped index of the position of every k-mer of the
+ * reference (forward strand, KMER_LENGTH bases, ACGT only), kept next to
+ * the fasta (fasta + INDEX_FILE_EXTENSION). Like the packed reference it is
+ * built once and rebuilt whenever the fasta's size or modification time
+ * changes; it takes 4 bytes for every base, plus 64MB for the k-mer table.
+ *
+ * A binding site of a primer is a place on either strand where the 3'-most
+ * KMER_LENGTH bases of the primer match exactly and the rest of it has at
+ * most MAX_MISMATCHES mismatches. Sites are found by looking up the 3'
+ * k-mer (or the 5' k-mer of the reverse complement) and comparing the
+ * rest against the packed reference, or against the fasta when there is
+ * no packed reference.
+ *
+ * Once installed, primer3 drops every primer with more than
+ * MAX_BINDING_SITES sites, and every pair which, from the sites of its two
+ * primers, would amplify a product of up to MAX_PRODUCT_SIZE bases other
+ * than the intended one on the template (see placeTemplate()); only
+ * specific primers take part in the pair search.
+ */
+class SpecificityIndex {
+
+public:
+
+	//Checks every primer and pair against the index; set from main with --specificity.
+	static bool IS_ENABLED;
+
+	//The extension appended to the fasta file name for the index.
+	const static std::string INDEX_FILE_EXTENSION;
+
+	//The number of bases at the 3' end of a primer that must match exactly.
+	const static int KMER_LENGTH;
+
+	//The mismatches allowed in the rest of a primer at a binding site.
+	static int MAX_MISMATCHES;
+
+	//The most binding sites a primer may have.
+	static int MAX_BINDING_SITES;
+
+	//The longest product which counts as one, in bases.
+	static int MAX_PRODUCT_SIZE;
+
+	/**
+	 * A binding site, given by the first base it covers on the forward strand.
+	 */
+	struct Site {
+		int contigId;
+		long start;
+		bool isReverse;
+	};
+
+	SpecificityIndex();
+	~SpecificityIndex();
+
+	/**
+	 * Maps the index for the fasta, building it first if it is missing or
+	 * stale. The bases are read from the packed reference if it is open,
+	 * otherwise from the fasta with faidx_fetch_seq(); both must stay open
+	 * while the index is used. Returns false if no usable index could be
+	 * made.
+	 */
+	bool open(std::string fastaFileLoc, const faidx_t *fai, const PackedReference *reference);
+
+	/**
+	 * Indicates if an index is mapped.
+	 */
+	bool isOpen() const;
+
+	/**
+	 * Finds the binding sites of a primer, given 5'->3'. Returns false, with
+	 * the sites found so far, if there are more than MAX_BINDING_SITES.
+	 */
+	bool findSites(const std::string &primer, std::vector<Site> &sites) const;
+
+	/**
+	 * Counts the products the two primers (both 5'->3') would amplify
+	 * together or on their own, stopping at limit. A pair designed on the
+	 * reference has its intended product among them, unless the sites of
+	 * the left and the right primer it runs between are given.
+	 */
+	int countProducts(const std::string &left, const std::string &right, int limit,
+						const Site *leftSite = NULL, const Site *rightSite = NULL);
+
+	/**
+	 * Has primer3 check every primer and pair against the index, or stops
+	 * it for NULL. The index must stay open while it is installed.
+	 */
+	static void install(SpecificityIndex *index);
+
+	/**
+	 * Tells the installed checks where the next template primer3 designs on
+	 * starts in the reference (zero-based), so that the intended product of
+	 * a pair is told from the others by its place. A contig id of -1 marks
+	 * a template from outside the reference, for which one product is
+	 * taken to be the intended one.
+	 */
+	static void placeTemplate(int contigId, long start);
+
+protected:
+
+	//The on-disk layout; see SpecificityIndex.cpp.
+	struct Header;
+
+	//The sites of a primer, and whether there were too many.
+	struct SiteList {
+		bool isSpecific;
+		std::vector<Site> sites;
+	};
+
+	//The mapped index file.
+	const char *mapping;
+	size_t mappingSize;
+
+	const Header *header;
+	const uint64_t *contigStarts;
+	const uint32_t *buckets;
+	const uint32_t *positions;
+
+	//Where the bases are read from; the packed reference when it is open.
+	const faidx_t *fai;
+	const PackedReference *reference;
+
+	//The sites of the primers looked at so far; primer3 forms many pairs
+	//from the same primers.
+	std::unordered_map<std::string, SiteList> siteCache;
+
+	/**
+	 * The sites of a primer, from the cache if it has been looked at.
+	 */
+	const SiteList &lookup(const std::string &primer);
+
+	/**
+	 * Empties the cache once it has grown large.
+	 */
+	void limitCache();
+
+	/**
+	 * Adds the sites on one strand; sequence is the primer as it reads on the
+	 * forward strand at such a site, so the primer itself for the forward
+	 * strand and its reverse complement for the reverse strand. Returns false
+	 * past MAX_BINDING_SITES.
+	 */
+	bool addSites(const std::string &sequence, bool isReverse, std::vector<Site> &sites) const;
+
+	/**
+	 * Reads the bases in [beg, end) of a contig, like PackedReference::fetch().
+	 */
+	long fetch(int contigId, long beg, long end, char *buf) const;
+
+	/**
+	 * Writes a new index for the fasta from its packed reference or itself.
+	 */
+	bool build(std::string fastaFileLoc, std::string indexFileLoc, const faidx_t *fai);
+
+	/**
+	 * Maps an existing index and checks it against the fasta and its index.
+	 */
+	bool map(std::string fastaFileLoc, std::string indexFileLoc, const faidx_t *fai);
+
+	/**
+	 * Unmaps the index if one is mapped.
+	 */
+	void close();
+
+	//The primer3 hooks of the installed index.
+	static int isOligoSpecific(const char *oligo);
+	static int isPairSpecific(const char *left, int leftStart, const char *right, int rightStart);
+
+	//The index owns its mapping and is not copied.
+	SpecificityIndex(const SpecificityIndex &);
+	SpecificityIndex &operator=(const SpecificityIndex &);
+};
+
+#endif /* SPECIFICITYINDEX_H_ */
@@ -0,0 +1,173 @@
+/*********************************************************************
+ *
+ * Trace.cpp:  A timeline of the spans of a run in trace-event format.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <time.h>
+
+#include "Trace.h"
+
+using namespace std;
+
+//The number of events a thread buffer has room for before it grows.
+#define TRACE_EVENTS_RESERVED 4096
+
+//Initialize the static members
+bool Trace::IS_ENABLED = false;
+vector<Trace::ThreadBuffer *> Trace::buffers;
+pthread_mutex_t Trace::lock = PTHREAD_MUTEX_INITIALIZER;
+__thread Trace::ThreadBuffer *Trace::threadBuffer = NULL;
+uint64_t Trace::startNanos = Trace::now();
+
+uint64_t Trace::now() {
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+Trace::ThreadBuffer *Trace::getThreadBuffer() {
+
+	if(threadBuffer == NULL) {
+		ThreadBuffer *buffer = new ThreadBuffer();
+		buffer->events.reserve(TRACE_EVENTS_RESERVED);
+
+		pthread_mutex_lock(&lock);
+		buffer->threadId = buffers.size() + 1;
+		buffers.push_back(buffer);
+		pthread_mutex_unlock(&lock);
+
+		threadBuffer = buffer;
+	}
+
+	return threadBuffer;
+}
+
+void Trace::addSpan(const char *name, const char *category,
+					uint64_t start, uint64_t duration, const string &detail) {
+
+	ThreadBuffer *buffer = getThreadBuffer();
+
+	buffer->events.push_back(Event());
+	Event &event = buffer->events.back();
+	event.name = name;
+	event.category = category;
+	event.phase = 'X';
+	event.startNanos = start;
+	event.durationNanos = duration;
+	event.detail = detail;
+}
+
+void Trace::addEvent(const char *name, const char *category, char phase) {
+
+	ThreadBuffer *buffer = getThreadBuffer();
+
+	buffer->events.push_back(Event());
+	Event &event = buffer->events.back();
+	event.name = name;
+	event.category = category;
+	event.phase = phase;
+	event.startNanos = now();
+	event.durationNanos = 0;
+}
+
+void Trace::begin(const char *name, const char *category) {
+
+	if(IS_ENABLED) {
+		addEvent(name, category, 'B');
+	}
+}
+
+void Trace::end(const char *name, const char *category) {
+
+	if(IS_ENABLED) {
+		addEvent(name, category, 'E');
+	}
+}
+
+//Writes text as a JSON string.
+static void writeJSONString(ostream &out, const string &text) {
+
+	out << '"';
+	for(string::const_iterator iterator=text.begin(); iterator!=text.end(); ++iterator) {
+		unsigned char c = *iterator;
+		if(c == '"' || c == '\\') {
+			out << '\\' << c;
+		}
+		else if(c < 0x20) {
+			out << "\\u" << hex << setw(4) << setfill('0') << (int) c << dec << setfill(' ');
+		}
+		else {
+			out << c;
+		}
+	}
+	out << '"';
+}
+
+bool Trace::writeTrace(const string &fileLoc) {
+
+	ofstream trace(fileLoc.c_str(), ios::out | ios::trunc);
+	if(!trace.is_open()) {
+		cerr << "Could not open the trace file " << fileLoc << endl;
+		return false;
+	}
+
+	//Time stamps are in microseconds.
+	trace << fixed << setprecision(3);
+	trace << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << endl;
+
+	bool isFirst = true;
+	pthread_mutex_lock(&lock);
+	for(vector<ThreadBuffer *>::const_iterator bufferIterator=buffers.begin();
+				bufferIterator!=buffers.end(); ++bufferIterator) {
+
+		const ThreadBuffer *buffer = *bufferIterator;
+
+		//Name the thread so the viewer shows which one is the main one.
+		trace << (isFirst ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+				<< buffer->threadId << ", \"args\": {\"name\": \""
+				<< (buffer->threadId == 1 ? "main" : "worker") << " " << buffer->threadId << "\"}}";
+		isFirst = false;
+
+		for(vector<Event>::const_iterator iterator=buffer->events.begin();
+					iterator!=buffer->events.end(); ++iterator) {
+
+			trace << ",\n{\"name\": \"" << iterator->name << "\", \"cat\": \"" << iterator->category
+					<< "\", \"ph\": \"" << iterator->phase << "\", \"pid\": 1, \"tid\": " << buffer->threadId
+					<< ", \"ts\": " << (iterator->startNanos - startNanos) * 1e-3;
+			if(iterator->phase == 'X') {
+				trace << ", \"dur\": " << iterator->durationNanos * 1e-3;
+			}
+			if(!iterator->detail.empty()) {
+				trace << ", \"args\": {\"detail\": ";
+				writeJSONString(trace, iterator->detail);
+				trace << "}";
+			}
+			trace << "}";
+		}
+	}
+	pthread_mutex_unlock(&lock);
+
+	trace << "\n]}" << endl;
+
+	trace.close();
+	if(trace.fail()) {
+		cerr << "Could not write the trace file " << fileLoc << endl;
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,112 @@
+/*********************************************************************
+ *
+ * Trace.h:  A timeline of the spans of a run in trace-event format.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <pthread.h>
+
+/**
+ * Records spans (a region, a settings file attempt, a phase of primer3,
+ * an output flush) with their thread, so that a single slow region can
+ * be found on a timeline. The file is written in the Chrome trace-event
+ * format and can be opened in chrome://tracing or Perfetto.
+ *
+ * Every thread appends to a buffer of its own, so recording takes no
+ * lock; a lock is taken only the first time a thread records. Nothing
+ * is recorded unless IS_ENABLED is set.
+ */
+class Trace {
+
+public:
+
+	//Turns the recording on; set from main with --trace.
+	static bool IS_ENABLED;
+
+	/**
+	 * Records the scope it lives in as one span. The name and category
+	 * must be string literals, they are not copied.
+	 */
+	class Span {
+	public:
+		Span(const char *name, const char *category) :
+			name(name), category(category), start(IS_ENABLED ? now() : 0) {}
+		~Span() {
+			if(start != 0) {
+				Trace::addSpan(name, category, start, now() - start, detail);
+			}
+		}
+
+		/**
+		 * Attaches a description, such as the region, to the span.
+		 */
+		void setDetail(const std::string &detail) { this->detail = detail; }
+
+	private:
+		const char *name;
+		const char *category;
+		uint64_t start;
+		std::string detail;
+	};
+
+	/**
+	 * Opens and closes a span which does not follow a scope, such as
+	 * a phase reported by primer3. Begin and end must pair up on a thread.
+	 */
+	static void begin(const char *name, const char *category);
+	static void end(const char *name, const char *category);
+
+	/**
+	 * Writes every recorded event. Threads must have stopped recording.
+	 * Returns false if the file could not be written.
+	 */
+	static bool writeTrace(const std::string &fileLoc);
+
+protected:
+
+	//'X' for a complete span, 'B' and 'E' for begin and end.
+	struct Event {
+		const char *name;
+		const char *category;
+		char phase;
+		uint64_t startNanos;
+		uint64_t durationNanos;
+		std::string detail;
+	};
+
+	struct ThreadBuffer {
+		int threadId;
+		std::vector<Event> events;
+	};
+
+	//All the buffers, guarded by lock, and the buffer of this thread.
+	static std::vector<ThreadBuffer *> buffers;
+	static pthread_mutex_t lock;
+	static __thread ThreadBuffer *threadBuffer;
+
+	//The start of the run, so that time stamps are small.
+	static uint64_t startNanos;
+
+	static uint64_t now();
+	static ThreadBuffer *getThreadBuffer();
+	static void addSpan(const char *name, const char *category,
+						uint64_t start, uint64_t duration, const std::string &detail);
+	static void addEvent(const char *name, const char *category, char phase);
+};
+
+#endif /* TRACE_H_ */
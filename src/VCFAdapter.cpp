@@ -18,11 +18,14 @@
 #include <iostream>
 #include <vector>
 #include <cstdlib>
+#include <cstring>
 
 #include "VCFAdapter.h"
 #include "Utility.h"
 #include "SequenceRegions.h"
 #include "SamtoolsWrapper.h"
+#include "bgzf.h"
+#include "tbx.h"
 
 
 using namespace std;
@@ -33,7 +36,11 @@ const int VCFAdapter::REGION_INDEX_PADDING = 5;
 const std::string VCFAdapter::VCF_FILE_EXTENTION = ".vcf";
 const std::string VCFAdapter::VCF_LINE_COMMENT_PATTERN = "\\s*#.*";
 const std::string VCFAdapter::VCF_LINE_TARGET_PATTERN = "^[A-Za-z0-9]+.+[0-9]+";
-const std::string VCFAdapter::VCF_TEMP_REGIONS_FILE = "temp-vcf.regions";
+std::string VCFAdapter::RESTRICT_TO = "";
+
+VCFAdapter::VCFAdapter() : isRestricted(false) {
+
+}
 
 bool VCFAdapter::isVCFFile(string fileLoc) {
 
@@ -112,8 +119,6 @@ string VCFAdapter::extractRegion(std::string &vcfLine) {
 
 vector<string> VCFAdapter::extractRegions(string vcfFileLoc) {
 
-	//TODO: Avoid duplicate code between this and file function.
-
 	//Read the VCF file and extract the region info.
 	vector<string> regionsVector;
 
@@ -122,22 +127,29 @@ vector<string> VCFAdapter::extractRegions(string vcfFileLoc) {
 		return regionsVector;
 	}
 
+	if(!loadRestriction()) {
+		cerr << "The restriction could not be loaded, so no variants are used - " << RESTRICT_TO << "\n";
+		return regionsVector;
+	}
+
+	//A bgzip compressed VCF is read through BGZF, and only the parts
+	//holding the restricted regions are read if it is restricted.
+	if(bgzf_check_bgzf(vcfFileLoc.c_str()) == 1) {
+		if(isRestricted && extractIndexedRegions(vcfFileLoc, regionsVector)) {
+			return regionsVector;
+		}
+		extractCompressedRegions(vcfFileLoc, regionsVector);
+		return regionsVector;
+	}
+
 	string line = "";
 	ifstream vcfFile (vcfFileLoc.c_str(), ifstream::in);
 	if(vcfFile.is_open())
 	{
 		while(vcfFile.good()) {
 			getline(vcfFile,line);
-			if(!line.empty() && !Utility::regexMatch(line.c_str(), VCF_LINE_COMMENT_PATTERN.c_str()) &&
-						Utility::regexMatch(line.c_str(), VCF_LINE_TARGET_PATTERN.c_str())) {
-
-				//Now extract the information for each line and add it to the vector
-				string regionStr = extractRegion(line);
-
-				if(Utility::regexMatch(regionStr.c_str(), SamtoolsWrapper::REGION_INPUT_PATTERN.c_str())) {
-					regionsVector.push_back(regionStr);
-					//cout << line << endl << regionStr << endl << endl;
-				}
+			if(!isOutsideRestriction(line)) {
+				addRegion(line, regionsVector);
 			}
 		}
 		vcfFile.close();
@@ -149,44 +161,157 @@ vector<string> VCFAdapter::extractRegions(string vcfFileLoc) {
 	return regionsVector;
 }
 
-bool VCFAdapter::extractRegionsToFile(string vcfFileLoc, string regionsFileLoc) {
+void VCFAdapter::addRegion(string &line, vector<string> &regionsVector) {
 
-	bool retVal = false;
+	if(!line.empty() && !Utility::regexMatch(line.c_str(), VCF_LINE_COMMENT_PATTERN.c_str()) &&
+				Utility::regexMatch(line.c_str(), VCF_LINE_TARGET_PATTERN.c_str())) {
 
-	if(!isValidVCFFile(vcfFileLoc)) {
-		cerr << "The vcf-file is not the intended format." << vcfFileLoc << "\n";
-		return retVal;
+		//Now extract the information for each line and add it to the vector
+		string regionStr = extractRegion(line);
+
+		if(Utility::regexMatch(regionStr.c_str(), SamtoolsWrapper::REGION_INPUT_PATTERN.c_str())) {
+			regionsVector.push_back(regionStr);
+		}
 	}
+}
 
-	string line = "";
-	ifstream vcfFile (vcfFileLoc.c_str(), ifstream::in);
+string VCFAdapter::extractRegionFromLine(string vcfLine) {
 
-	ofstream regionOutFile;
-	regionOutFile.open(regionsFileLoc.c_str(), ios::out | ios::trunc);
+	//A line that is not from a file may be short of the fields used.
+	vector<string> regionsVector;
+	if(Utility::split(vcfLine, " \t").size() > ALT) {
+		addRegion(vcfLine, regionsVector);
+	}
 
-	if(vcfFile.is_open() && regionOutFile.is_open()) {
-		while(vcfFile.good()) {
-			getline(vcfFile,line);
-			if(!line.empty() && !Utility::regexMatch(line.c_str(), VCF_LINE_COMMENT_PATTERN.c_str()) &&
-					Utility::regexMatch(line.c_str(), VCF_LINE_TARGET_PATTERN.c_str())) {
+	return regionsVector.empty() ? "" : regionsVector[0];
+}
+
+bool VCFAdapter::loadRestriction() {
+
+	isRestricted = !RESTRICT_TO.empty();
+	if(!isRestricted) {
+		return true;
+	}
+
+	//The restriction is merged, so that the intervals of a chromosome are disjoint.
+	if(BEDAdapter::isBEDFile(RESTRICT_TO) || Utility::fileExists(RESTRICT_TO)) {
+		return restriction.load(RESTRICT_TO, true);
+	}
+
+	vector<SequenceRegionInput> regions;
+	vector<string> regionArr = Utility::split(RESTRICT_TO, ",");
+	for(vector<string>::iterator iterator=regionArr.begin(); iterator!=regionArr.end(); ++iterator) {
+		if(!Utility::regexMatch(iterator->c_str(), SamtoolsWrapper::REGION_INPUT_PATTERN.c_str())) {
+			cerr << "The restriction " << *iterator << " is not in format regionName:startIndex-endIndex." << endl;
+			return false;
+		}
+		regions.push_back(SequenceRegionInput(*iterator));
+	}
+	restriction.loadRegions(regions, true);
 
-				//Now extract the information for each line.
-				string regionStr = extractRegion(line);
+	return true;
+}
+
+bool VCFAdapter::isOutsideRestriction(string &line) {
+
+	if(!isRestricted || line.empty() || Utility::regexMatch(line.c_str(), VCF_LINE_COMMENT_PATTERN.c_str())) {
+		return false;
+	}
+
+	vector<string> regionArr = Utility::split(line, " \t");
+	if(regionArr.size() <= REF) {
+		return true;
+	}
+
+	//The variant covers its reference allele, or up to END= for symbolic
+	//alleles, as in the tabix index. Restrictions may name the chromosome
+	//with or without the prefix the regions get.
+	long beg = atol(regionArr[POSITION].c_str()) - 1;
+	long end = beg + (regionArr[REF].length() > 0 ? regionArr[REF].length() : 1);
+	if(regionArr.size() > INFO) {
+		string info = ";" + regionArr[INFO];
+		size_t endPos = info.find(";END=");
+		if(endPos != string::npos && atol(info.c_str() + endPos + 5) > beg) {
+			end = atol(info.c_str() + endPos + 5);
+		}
+	}
+	string &chromosome = regionArr[CHROMOSOMES];
+
+	return !restriction.overlaps(chromosome, beg, end) &&
+			(chromosome.find(REGION_CHROMOSOME_PREFIX) != string::npos ||
+				!restriction.overlaps(REGION_CHROMOSOME_PREFIX + chromosome, beg, end));
+}
+
+bool VCFAdapter::extractIndexedRegions(string vcfFileLoc, vector<string> &regionsVector) {
+
+	tbx_t *index = Utility::fileExists(vcfFileLoc + ".tbi") ? tbx_index_load(vcfFileLoc.c_str()) : NULL;
+	if(index == NULL) {
+		cerr << "Indexing " << vcfFileLoc << ", this is done only once." << endl;
+		if(tbx_index_build(vcfFileLoc.c_str()) != 0 ||
+				(index = tbx_index_load(vcfFileLoc.c_str())) == NULL) {
+			cerr << "Could not index " << vcfFileLoc << ", reading all of it." << endl;
+			return false;
+		}
+	}
+
+	BGZF *vcfFile = bgzf_open(vcfFileLoc.c_str(), "r");
+	if(vcfFile == NULL) {
+		tbx_index_destroy(index);
+		return false;
+	}
 
-				if(Utility::regexMatch(regionStr.c_str(), SamtoolsWrapper::REGION_INPUT_PATTERN.c_str())) {
-					regionOutFile << regionStr << endl;
-					//cout << line << endl << regionStr << endl << endl;
-					retVal = true;
+	//Query the restricted intervals of every chromosome in the VCF. The intervals
+	//are sorted and disjoint, so a variant that was found for the previous
+	//interval starts before its end; it is only added once.
+	kstring_t str = {0, 0, 0};
+	vector<SequenceRegionInput> intervals;
+	for(int tid = 0; tid < tbx_n_seqs(index); tid++) {
+		string chromosome = tbx_seq_name(index, tid);
+		intervals.clear();
+		if(restriction.extractRegions(chromosome, tid, intervals) == 0 &&
+				chromosome.find(REGION_CHROMOSOME_PREFIX) == string::npos) {
+			restriction.extractRegions(REGION_CHROMOSOME_PREFIX + chromosome, tid, intervals);
+		}
+
+		long previousEnd = 0;
+		for(vector<SequenceRegionInput>::iterator iterator=intervals.begin(); iterator!=intervals.end(); ++iterator) {
+			tbx_iter_t iter = tbx_iter_query(index, tid, iterator->getStartIndex() - 1, iterator->getEndIndex());
+			while(tbx_iter_read(vcfFile, iter, &str) >= 0) {
+				const char *position = strchr(str.s, '\t');
+				if(position != NULL && atol(position + 1) - 1 >= previousEnd) {
+					string line(str.s, str.l);
+					addRegion(line, regionsVector);
 				}
 			}
+			tbx_iter_destroy(iter);
+			previousEnd = iterator->getEndIndex();
 		}
-		vcfFile.close();
-		regionOutFile.close();
-	}
-	else {
-		return retVal;
 	}
 
-	return retVal;
+	free(str.s);
+	bgzf_close(vcfFile);
+	tbx_index_destroy(index);
+
+	return true;
 }
 
+bool VCFAdapter::extractCompressedRegions(string vcfFileLoc, vector<string> &regionsVector) {
+
+	BGZF *vcfFile = bgzf_open(vcfFileLoc.c_str(), "r");
+	if(vcfFile == NULL) {
+		return false;
+	}
+
+	kstring_t str = {0, 0, 0};
+	while(tbx_getline(vcfFile, &str) >= 0) {
+		string line(str.s, str.l);
+		if(!isOutsideRestriction(line)) {
+			addRegion(line, regionsVector);
+		}
+	}
+
+	free(str.s);
+	bgzf_close(vcfFile);
+
+	return true;
+}
@@ -16,6 +16,8 @@
 #ifndef VCFEXTRACTOR_H_
 #define VCFEXTRACTOR_H_
 
+#include "BEDAdapter.h"
+
 /**
  * The enumerator elements which corresponds to the index of the named parameter.
  * in the tab delimited VCF file.
@@ -24,7 +26,8 @@ enum VCFLineParameters {
 	CHROMOSOMES = 0,
 	POSITION = 1,
 	REF = 3,
-	ALT = 4
+	ALT = 4,
+	INFO = 7
 };
 
 /**
@@ -53,10 +56,43 @@ protected:
 
 public:
 
-	//The temporary regions file created for VCF inputs.
-	const static std::string VCF_TEMP_REGIONS_FILE;
+	//A bed-file or comma separated regions; when set only the variants
+	//overlapping them are used.
+	static std::string RESTRICT_TO;
 
 protected:
+
+	//The intervals of RESTRICT_TO, loaded when the VCF is read.
+	BEDAdapter restriction;
+	bool isRestricted;
+
+	/**
+	 * Loads RESTRICT_TO into the restriction, if it is set.
+	 */
+	bool loadRestriction();
+
+	/**
+	 * Indicates if a VCF line lies outside the restriction.
+	 */
+	bool isOutsideRestriction(std::string &);
+
+	/**
+	 * Extracts the regions of the variants overlapping the restriction from a
+	 * bgzip compressed VCF through its tabix index, which is built if it does
+	 * not exist yet.
+	 */
+	bool extractIndexedRegions(std::string, std::vector<std::string> &);
+
+	/**
+	 * Extracts the regions from a bgzip compressed VCF, reading all of it.
+	 */
+	bool extractCompressedRegions(std::string, std::vector<std::string> &);
+
+	/**
+	 * Adds the region of a VCF line to the vector if the line is a variant.
+	 */
+	void addRegion(std::string &, std::vector<std::string> &);
+
 	/*
 	 * The validator which tells us if a given file is in the required
 	 * VCF format of tab delimited parameters file.
@@ -81,6 +117,8 @@ protected:
 
 public:
 
+	VCFAdapter();
+
 	/*
 	 * This static method tells if a given file is VCF file or not based on
 	 * the extension of the file.
@@ -94,10 +132,10 @@ public:
 	std::vector<std::string> extractRegions(std::string);
 
 	/**
-	 * This method is used to extract the regions from a given VCF file
-	 * to given output file.
+	 * Provides the region of a single VCF line, or an empty string if the
+	 * line is not a variant. RESTRICT_TO does not apply to it.
 	 */
-	bool extractRegionsToFile(std::string vcfFileLoc, std::string regionsFileLoc);
+	std::string extractRegionFromLine(std::string vcfLine);
 };
 
 
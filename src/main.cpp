@@ -15,6 +15,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <utility>
 #include <regex.h>
 
 #include "SamtoolsWrapper.h"
@@ -25,17 +26,35 @@
 #include "ConfigurationLoader.h"
 #include "VCFAdapter.h"
 #include "SequencesAdapter.h"
+#include "BEDAdapter.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "RunJournal.h"
+#include "SpecificityIndex.h"
+#include "DesignSession.h"
+#include "DesignServer.h"
 
 using namespace std;
 
-const static string MEDRESEQ_CMD_USAGE_STR_DEFAULT = "Usage: ./MedReseq [OPTION] -f FILE -r region-input\n";
+const static string MEDRESEQ_CMD_USAGE_STR_DEFAULT = "Usage: ./MedReseq [OPTION] -f FILE -r region-input\n"
+								"   or: ./MedReseq [OPTION] -f FILE --serve socket-file\n";
 const static string MEDRESEQ_CMD_USAGE_STR_FULL = "Generate primers for the given input\n"
 								"Example: ./MedReseq --fasta ucsc.hg19.fasta --region chr4:148375054-148375079 -o compOutput\n"
 								"\t-f, --fasta \tfasta-file\n "
-								"\t-r, --region\tregion OR regions-file OR vcf-file(.vcf)\n "
+								"\t-r, --region\tregion OR regions-file OR vcf-file(.vcf) OR bed-file(.bed, .bed.gz)\n "
 								"\t-s, --sequence\tsequence OR sequences-file(instead of -r)\n"
 								"\t-o, --output\toptional output-file name(defaults to output, and .medreseq will be appended)\n"
-								"\t-v, --verbose\toptional flag for verbose output";
+								"\t-v, --verbose\toptional flag for verbose output\n"
+								"\t--merge-targets\toptional flag to merge overlapping bed-file targets\n"
+								"\t--restrict\toptional bed-file OR regions(comma separated) to which vcf-file variants are limited\n"
+								"\t--ref-cache-mb\toptional memory in MB for caching decoded reference between regions(defaults to 0, off)\n"
+								"\t--metrics\toptional json-file to which per-stage timings and counters of the run are written\n"
+								"\t--trace\toptional json-file to which a timeline of every region is written(chrome trace-event format)\n"
+								"\t--reference-kernels\toptional flag to use the plain reference version of every optimized kernel(same output, slower)\n"
+								"\t--resume\toptional flag to continue a run that was stopped, from the output-file.journal it left behind\n"
+								"\t--specificity\toptional flag to reject primers and pairs that would bind or amplify elsewhere in the fasta(builds fasta.kmi)\n"
+								"\t--serve\tunix socket on which requests are served with everything loaded once, instead of -r or -s(see MedReseqClient)\n"
+								"\t--serve-workers\toptional number of connections served at the same time(defaults to 4)";
 
 const static string MAIN_CONFIG_FILE = "essentials/medreseq.config";
 const static string OUTPUT_FILE_NAME_DEFAULT = "output";
@@ -66,9 +85,12 @@ int main(int argc, char **argv) {
 	string fastaFile = "";
 	string sequenceOrRegionInput = "";
 	string outputName = OUTPUT_FILE_NAME_DEFAULT;
+	string metricsFile = "";
+	string traceFile = "";
+	string serveSocket = "";
 
 	//Validate the command line arguments
-	if(!(argc == 5 || argc == 7 || argc == 6 || argc == 8) ||
+	if(argc < 5 ||
 		argc <= 2 || (argc == 2 && (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")))) {
 		cerr << MEDRESEQ_CMD_USAGE_STR_DEFAULT;
 		cerr << MEDRESEQ_CMD_USAGE_STR_FULL << endl;
@@ -77,7 +99,31 @@ int main(int argc, char **argv) {
 
 	//Parse the command line parameters and exit if format is not correct.
 	 for (int i = 1; i < argc; i++) {
-		if (i + 1 != argc) {
+		//The flags take no value, so they may also come last.
+		if (!strcmp(argv[i], "-v") || !strcmp(argv[i], "--verbose")) {
+			Primer3Wrapper::IS_VERBOSE = true;
+		}
+		else if (!strcmp(argv[i], "--merge-targets")) {
+			BEDAdapter::MERGE_OVERLAPPING_TARGETS = true;
+		}
+		else if (!strcmp(argv[i], "--reference-kernels")) {
+			SamtoolsWrapper::USE_REFERENCE_READS = true;
+			Primer3Wrapper::setReferenceKernels(true);
+		}
+		else if (!strcmp(argv[i], "--resume")) {
+			RunJournal::RESUME = true;
+		}
+		else if (!strcmp(argv[i], "--specificity")) {
+			SpecificityIndex::IS_ENABLED = true;
+		}
+		//Every other option is followed by its value.
+		else if (i + 1 == argc) {
+			cerr << "Not enough or Invalid arguments." << endl;
+			cerr << MEDRESEQ_CMD_USAGE_STR_DEFAULT;
+			cerr << MEDRESEQ_CMD_USAGE_STR_FULL << endl;
+			return EXIT_FAILURE;
+		}
+		else {
 			if (!strcmp(argv[i], "-f") || !strcmp(argv[i], "--fasta")) {
 				fastaFile = argv[++i];
 				if(!Utility::fileExists(fastaFile)) {
@@ -121,20 +167,54 @@ int main(int argc, char **argv) {
 			else if (!strcmp(argv[i], "-o") || !strcmp(argv[i], "--output")) {
 				outputName = argv[++i];
 			}
-			else {
-				if (!strcmp(argv[i], "-v") || !strcmp(argv[i], "--verbose")) {
-					Primer3Wrapper::IS_VERBOSE = true;
+			else if (!strcmp(argv[i], "--metrics")) {
+				metricsFile = argv[++i];
+				Metrics::IS_ENABLED = true;
+				p3_set_align_timing(1);
+			}
+			else if (!strcmp(argv[i], "--trace")) {
+				traceFile = argv[++i];
+				Trace::IS_ENABLED = true;
+			}
+			else if (!strcmp(argv[i], "--serve")) {
+				serveSocket = argv[++i];
+			}
+			else if (!strcmp(argv[i], "--serve-workers")) {
+				string workers = argv[++i];
+				if(!Utility::regexMatch(workers.c_str(), "^[1-9][0-9]*$")) {
+					cerr << "The number of workers should be a positive number. Aborting." << endl;
+					return EXIT_FAILURE;
 				}
-				else {
-					cerr << "Not enough or Invalid arguments." << endl;
-					cerr << MEDRESEQ_CMD_USAGE_STR_DEFAULT;
-					cerr << MEDRESEQ_CMD_USAGE_STR_FULL << endl;
+				DesignServer::MAX_WORKERS = Utility::digitFromString(workers);
+			}
+			else if (!strcmp(argv[i], "--restrict")) {
+				VCFAdapter::RESTRICT_TO = argv[++i];
+			}
+			else if (!strcmp(argv[i], "--ref-cache-mb")) {
+				string cacheMb = argv[++i];
+				if(!Utility::regexMatch(cacheMb.c_str(), "^[0-9]+$")) {
+					cerr << "The reference cache size should be a number of MB. Aborting." << endl;
 					return EXIT_FAILURE;
 				}
+				SamtoolsWrapper::REFERENCE_CACHE_MB = Utility::digitFromString(cacheMb);
+			}
+			else {
+				cerr << "Not enough or Invalid arguments." << endl;
+				cerr << MEDRESEQ_CMD_USAGE_STR_DEFAULT;
+				cerr << MEDRESEQ_CMD_USAGE_STR_FULL << endl;
+				return EXIT_FAILURE;
 			}
 		}
 	 }
 
+	//Only the variants of a vcf-file are restricted.
+	if(!VCFAdapter::RESTRICT_TO.empty() &&
+			!(isRegionInputVal && cmdParamIsFile && VCFAdapter::isVCFFile(sequenceOrRegionInput))) {
+		cerr << "--restrict applies only to a vcf-file given with -r. Aborting." << endl;
+		cerr << MEDRESEQ_CMD_USAGE_STR_DEFAULT;
+		return EXIT_FAILURE;
+	}
+
 	//Obtain all the configurations and apply them.
 	ConfigurationHolder configHolder = ConfigurationLoader::obtainConfigurationSettings(MAIN_CONFIG_FILE);
 	ConfigurationLoader::applyConfigurationSetting(configHolder);
@@ -147,7 +227,21 @@ int main(int argc, char **argv) {
 	//The start of the actual processing.
 	cout << "Welcome to Medical Re-sequencing!" << endl;
 
-	//The map of sequencename->sequence object.
+	//A run is only resumed with the inputs it was started with.
+	RunJournal::INPUTS.push_back(fastaFile);
+	RunJournal::INPUTS.push_back(sequenceOrRegionInput);
+
+	//The server opens a design session once and then designs for its clients.
+	if(!serveSocket.empty()) {
+		DesignSession designSession;
+		if(!designSession.open(fastaFile, configHolder.getSettingsFiles())) {
+			return EXIT_FAILURE;
+		}
+		DesignServer designServer(designSession);
+		return designServer.serve(serveSocket) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//The map of sequencename->sequence object, for a single region or sequences.
 	map<string, SequenceRegionOutput> sequencesMap;
 
 	//The wrapper objects for both primer3 and samtools.
@@ -160,17 +254,20 @@ int main(int argc, char **argv) {
 		return EXIT_FAILURE;
 	}
 
+	vector<string> settingsFiles = configHolder.getSettingsFiles();
+
+	//A file of regions is streamed: each region is fetched, designed and
+	//written in the order of the file before the next one is read.
+	bool isStreamed = isRegionInputVal && cmdParamIsFile;
+	SequenceRegionStream sequenceStream(samtoolsWrapper, isStreamed ?
+			samtoolsWrapper.retrieveTargetsForRegions(sequenceOrRegionInput) : vector<SequenceRegionInput>());
+
 	//Now, based on the second input call the appropriate method.
-	if(isRegionInputVal) {
-		if(!cmdParamIsFile) {
-			sequencesMap.insert(pair<string, SequenceRegionOutput>
-									(sequenceOrRegionInput, samtoolsWrapper.retrieveSequenceForRegion(sequenceOrRegionInput)));
-		}
-		else {
-			sequencesMap = samtoolsWrapper.retrieveSequencesForRegions(sequenceOrRegionInput);
-		}
+	if(isRegionInputVal && !cmdParamIsFile) {
+		sequencesMap.insert(pair<string, SequenceRegionOutput>
+								(sequenceOrRegionInput, samtoolsWrapper.retrieveSequenceForRegion(sequenceOrRegionInput)));
 	}
-	else {
+	else if(!isRegionInputVal) {
 		SequencesAdapter sequenceAdapter;
 		if(!cmdParamIsFile) {
 			sequencesMap.insert(pair<string, SequenceRegionOutput>
@@ -181,17 +278,39 @@ int main(int argc, char **argv) {
 		}
 	}
 
-	cout << "Creating primers for " << sequencesMap.size() << " regions" << endl;
+	cout << "Creating primers for " << (isStreamed ? sequenceStream.size() : sequencesMap.size()) << " regions" << endl;
 
 	//Now that we have the sequences, we can get the primers generated.
-	vector<string> settingsFiles = configHolder.getSettingsFiles();
-	primer3Wrapper.createPrimers(settingsFiles, sequencesMap, outputName);
+	//The sequences are not needed any more, so they are handed over.
+	//A resumed run which could not be continued has not written anything.
+	bool isCreated = isStreamed ? primer3Wrapper.createPrimers(settingsFiles, sequenceStream, outputName) :
+					primer3Wrapper.createPrimers(settingsFiles, std::move(sequencesMap), outputName);
+	if(!isCreated && RunJournal::RESUME) {
+		return EXIT_FAILURE;
+	}
+
+	//The streamed regions were fetched while the primers were created.
+	if(samtoolsWrapper.isReferenceCacheEnabled()) {
+		ReferenceCache::Stats cacheStats = samtoolsWrapper.getReferenceCacheStats();
+		unsigned long lookups = cacheStats.hits + cacheStats.misses;
+		cout << "Reference cache: " << cacheStats.hits << " hits, " << cacheStats.misses << " misses ("
+				<< (lookups > 0 ? 100 * cacheStats.hits / lookups : 0) << "% hit rate), "
+				<< cacheStats.evictions << " evictions, " << cacheStats.bytesDecoded << " bases decoded" << endl;
+	}
 
 	cout << "The comprehensive output file is: " <<
 				outputName  << "." << Primer3Wrapper::PRIMER_COMPOSITE_FILE_EXTENSION << endl;
 	cout << "The concise primers output files are: " <<
 					outputName << "-*"  << "." << Primer3Wrapper::PRIMER_TERSE_FILE_EXTENSION << endl;
 
+	if(Metrics::IS_ENABLED && Metrics::writeReport(metricsFile)) {
+		cout << "The metrics file is: " << metricsFile << endl;
+	}
+
+	if(Trace::IS_ENABLED && Trace::writeTrace(traceFile)) {
+		cout << "The trace file is: " << traceFile << endl;
+	}
+
 	return EXIT_SUCCESS;
 }
 
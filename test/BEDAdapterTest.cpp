@@ -0,0 +1,56 @@
+/*********************************************************************
+ *
+ * BEDAdapterTest.cpp:  Checks the overlap queries of the interval
+ * index, in particular past the last bin of a contig with more
+ * intervals than bins.
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#include "BEDAdapter.h"
+#include "SequenceRegions.h"
+
+using namespace std;
+
+static bool check(bool condition, const string &what) {
+
+	cout << (condition ? "PASSED " : "FAILED ") << what << endl;
+	return condition;
+}
+
+int main(int argc, char *argv[]) {
+
+	//Ten short intervals, all in the first bin of chr1.
+	vector<SequenceRegionInput> regions;
+	for(long start = 1; start < 1000; start += 100) {
+		regions.push_back(SequenceRegionInput("chr1", start, start + 49));
+	}
+	regions.push_back(SequenceRegionInput("chr2", 100001, 100100));
+
+	BEDAdapter restriction;
+	restriction.loadRegions(regions, true);
+
+	bool retVal = check(restriction.getTargetCount() == 11, "the intervals are indexed");
+	retVal = check(restriction.overlaps("chr1", 120, 121), "a position in an interval overlaps it") && retVal;
+	retVal = check(restriction.overlaps("chr1", 940, 960), "a position in the last interval overlaps it") && retVal;
+	retVal = check(!restriction.overlaps("chr1", 60, 90), "a position between intervals overlaps none") && retVal;
+
+	//Past the last bin of chr1; this read beyond the bins when looked up by the interval count.
+	retVal = check(!restriction.overlaps("chr1", 39999, 40000), "a position past the last bin overlaps none") && retVal;
+	retVal = check(!restriction.overlaps("chr1", 10000000, 10000001), "a position far past the last bin overlaps none") && retVal;
+
+	retVal = check(restriction.overlaps("chr2", 100050, 100051), "a position on another contig overlaps its interval") && retVal;
+	retVal = check(!restriction.overlaps("chr3", 120, 121), "a position on a contig without intervals overlaps none") && retVal;
+
+	return retVal ? EXIT_SUCCESS : EXIT_FAILURE;
+}
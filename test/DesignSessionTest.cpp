@@ -0,0 +1,162 @@
+/*********************************************************************
+ *
+ * DesignSessionTest.cpp:  Checks that a DesignSession designs batches
+ * from what it loaded when it was opened, without the settings files.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "DesignSession.h"
+#include "Utility.h"
+#include "WorkloadGenerator.h"
+
+using namespace std;
+
+//The settings files copied into the test directory, with the
+//mispriming library they name.
+const static char *SETTINGS_FILES[] = {"essentials/tier1.settings", "essentials/tier2.settings"};
+const static string MISPRIMING_LIBRARY = "essentials/humrep_and_simple.txt";
+const static string MISPRIMING_LIBRARY_TAG = "PRIMER_MISPRIMING_LIBRARY=";
+
+static bool copyFile(const string &from, const string &to, const string &libraryLoc) {
+
+	ifstream in(from.c_str());
+	ofstream out(to.c_str());
+	string line;
+	while(getline(in, line)) {
+		if(!libraryLoc.empty() && line.compare(0, MISPRIMING_LIBRARY_TAG.length(), MISPRIMING_LIBRARY_TAG) == 0) {
+			line = MISPRIMING_LIBRARY_TAG + libraryLoc;
+		}
+		out << line << "\n";
+	}
+	return in.eof() && out.good();
+}
+
+static void removeDirectory(const string &dirLoc) {
+
+	DIR *dir = opendir(dirLoc.c_str());
+	if(dir == NULL) {
+		return;
+	}
+	struct dirent *entry;
+	while((entry = readdir(dir)) != NULL) {
+		if(strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..")) {
+			unlink((dirLoc + "/" + entry->d_name).c_str());
+		}
+	}
+	closedir(dir);
+	rmdir(dirLoc.c_str());
+}
+
+/*
+ * Describes a result by everything that is written out for it.
+ */
+static string describe(const DesignResult &result) {
+
+	string text = result.input + " " + result.tier + " " + result.error + " " +
+			result.primerOutput.getGlobalError() + " " + result.primerOutput.getSequenceError();
+
+	const vector<PrimerPair> &pairs = result.primerOutput.getPrimerPairs();
+	for(vector<PrimerPair>::const_iterator pair=pairs.begin(); pair!=pairs.end(); ++pair) {
+		text += " " + pair->getLeftPrimer().getSequence() + "/" + pair->getRightPrimer().getSequence();
+	}
+	return text;
+}
+
+static bool check(bool condition, const string &what) {
+
+	cout << (condition ? "PASSED " : "FAILED ") << what << endl;
+	return condition;
+}
+
+int main(int argc, char *argv[]) {
+
+	if(!Utility::fileExists(MISPRIMING_LIBRARY)) {
+		cerr << "Run from the MedReseq root directory" << endl;
+		return EXIT_FAILURE;
+	}
+
+	char tempDir[] = "/tmp/medreseq-session-test-XXXXXX";
+	if(mkdtemp(tempDir) == NULL) {
+		cerr << "Could not create a temporary directory" << endl;
+		return EXIT_FAILURE;
+	}
+	string dirLoc = tempDir;
+
+	WorkloadSpec spec;
+	WorkloadSpec::preset("small", spec);
+	spec.contigs = 1;
+	spec.contigLength = 100000;
+	spec.regions = 12;
+	WorkloadGenerator generator(spec);
+
+	string libraryLoc = dirLoc + "/library.txt";
+	vector<string> settingsFiles;
+	bool retVal = generator.generate(dirLoc + "/session") &&
+			copyFile(MISPRIMING_LIBRARY, libraryLoc, "");
+	for(size_t i = 0; retVal && i < sizeof(SETTINGS_FILES) / sizeof(SETTINGS_FILES[0]); i++) {
+		string settingsLoc = dirLoc + "/" + Utility::split(SETTINGS_FILES[i], "/")[1];
+		retVal = copyFile(SETTINGS_FILES[i], settingsLoc, libraryLoc);
+		settingsFiles.push_back(settingsLoc);
+	}
+	if(!retVal) {
+		cerr << "Could not write the test files in " << dirLoc << endl;
+		removeDirectory(dirLoc);
+		return EXIT_FAILURE;
+	}
+
+	vector<string> inputs;
+	ifstream regions((dirLoc + "/session" + WorkloadGenerator::REGIONS_EXTENSION).c_str());
+	string line;
+	while(getline(regions, line)) {
+		inputs.push_back(line);
+	}
+
+	DesignSession session;
+	retVal = check(session.open(dirLoc + "/session" + WorkloadGenerator::FASTA_EXTENSION, settingsFiles),
+			"the session opens");
+
+	vector<DesignResult> before = session.design(inputs);
+	int designed = 0;
+	for(vector<DesignResult>::const_iterator result=before.begin(); result!=before.end(); ++result) {
+		designed += result->primerOutput.getPrimerPairs().empty() ? 0 : 1;
+	}
+	retVal = check(before.size() == inputs.size() && designed > 0, "a batch is designed") && retVal;
+
+	//Everything the designs need was loaded when the session was opened.
+	unlink(libraryLoc.c_str());
+	unlink((libraryLoc + ".p3sl").c_str());
+	for(vector<string>::const_iterator settingsFile=settingsFiles.begin(); settingsFile!=settingsFiles.end(); ++settingsFile) {
+		unlink(settingsFile->c_str());
+	}
+
+	vector<DesignResult> after = session.design(inputs);
+	bool isSame = before.size() == after.size();
+	for(size_t i = 0; isSame && i < before.size(); i++) {
+		isSame = describe(before[i]) == describe(after[i]);
+		if(!isSame) {
+			cout << "  before: " << describe(before[i]) << "\n  after:  " << describe(after[i]) << endl;
+		}
+	}
+	retVal = check(isSame, "a batch after the settings files and library are removed is the same") && retVal;
+
+	removeDirectory(dirLoc);
+
+	return retVal ? EXIT_SUCCESS : EXIT_FAILURE;
+}
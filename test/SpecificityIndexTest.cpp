@@ -0,0 +1,181 @@
+/*********************************************************************
+ *
+ * SpecificityIndexTest.cpp:  Checks that the specificity index finds
+ * both copies of a duplicated segment, and tells the intended product
+ * of a pair from the one the copy would give.
+ *
+ * Last modified: 19 October 2026
+ *
+ *********************************************************************
+ *
+ * This file is released under the Virginia Tech Non-Commercial
+ * Purpose License. A copy of this license has been provided in
+ * the Medical Re-sequencing root directory.
+ *
+ *********************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "faidx.h"
+#include "PackedReference.h"
+#include "SpecificityIndex.h"
+
+using namespace std;
+
+//The duplicated segment: where it is taken from on chr1 and put on chr2.
+const static long SEGMENT_START = 10000;
+const static long SEGMENT_LENGTH = 2000;
+const static long COPY_START = 5000;
+
+const static int LINE_LENGTH = 60;
+const static int PRIMER_LENGTH = 20;
+
+static void removeDirectory(const string &dirLoc) {
+
+	DIR *dir = opendir(dirLoc.c_str());
+	if(dir == NULL) {
+		return;
+	}
+	struct dirent *entry;
+	while((entry = readdir(dir)) != NULL) {
+		if(strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..")) {
+			unlink((dirLoc + "/" + entry->d_name).c_str());
+		}
+	}
+	closedir(dir);
+	rmdir(dirLoc.c_str());
+}
+
+static string randomBases(long length) {
+
+	static const char BASES[] = "ACGT";
+	string bases(length, 'A');
+	for(long i = 0; i < length; i++) {
+		bases[i] = BASES[rand() % 4];
+	}
+	return bases;
+}
+
+static string reverseComplement(const string &sequence) {
+
+	string reverse(sequence.rbegin(), sequence.rend());
+	for(string::iterator base = reverse.begin(); base != reverse.end(); ++base) {
+		*base = *base == 'A' ? 'T' : *base == 'C' ? 'G' : *base == 'G' ? 'C' : 'A';
+	}
+	return reverse;
+}
+
+static bool writeFasta(const string &fileLoc, const vector<string> &names, const vector<string> &contigs) {
+
+	ofstream out(fileLoc.c_str());
+	for(size_t i = 0; i < contigs.size(); i++) {
+		out << ">" << names[i] << "\n";
+		for(size_t j = 0; j < contigs[i].length(); j += LINE_LENGTH) {
+			out << contigs[i].substr(j, LINE_LENGTH) << "\n";
+		}
+	}
+	return out.good();
+}
+
+static string readFile(const string &fileLoc) {
+
+	ifstream in(fileLoc.c_str(), ios::binary);
+	stringstream content;
+	content << in.rdbuf();
+	return content.str();
+}
+
+static bool check(bool condition, const string &what) {
+
+	cout << (condition ? "PASSED " : "FAILED ") << what << endl;
+	return condition;
+}
+
+int main(int argc, char *argv[]) {
+
+	char tempDir[] = "/tmp/medreseq-specificity-test-XXXXXX";
+	if(mkdtemp(tempDir) == NULL) {
+		cerr << "Could not create a temporary directory" << endl;
+		return EXIT_FAILURE;
+	}
+	string dirLoc = tempDir;
+
+	//chr2 holds a copy of a segment of chr1, the rest is random.
+	srand(50);
+	vector<string> names, contigs;
+	names.push_back("chr1");
+	contigs.push_back(randomBases(30000));
+	names.push_back("chr2");
+	contigs.push_back(randomBases(20000));
+	contigs[1].replace(COPY_START, SEGMENT_LENGTH, contigs[0], SEGMENT_START, SEGMENT_LENGTH);
+
+	string fastaLoc = dirLoc + "/dup.fa";
+	faidx_t *fai = NULL;
+	if(!writeFasta(fastaLoc, names, contigs) || (fai = fai_load(fastaLoc.c_str())) == NULL) {
+		cerr << "Could not write the test fasta in " << dirLoc << endl;
+		removeDirectory(dirLoc);
+		return EXIT_FAILURE;
+	}
+
+	//The index built from the fasta must be the one built from the packed reference.
+	PackedReference noReference;
+	SpecificityIndex fastaIndex;
+	bool retVal = check(fastaIndex.open(fastaLoc, fai, &noReference), "the index is built from the fasta");
+	string fastaBuilt = readFile(fastaLoc + SpecificityIndex::INDEX_FILE_EXTENSION);
+	unlink((fastaLoc + SpecificityIndex::INDEX_FILE_EXTENSION).c_str());
+
+	PackedReference reference;
+	SpecificityIndex index;
+	retVal = check(reference.open(fastaLoc, fai) && index.open(fastaLoc, fai, &reference),
+			"the index is built from the packed reference") && retVal;
+	retVal = check(!fastaBuilt.empty() && fastaBuilt == readFile(fastaLoc + SpecificityIndex::INDEX_FILE_EXTENSION),
+			"both indexes are the same") && retVal;
+
+	SpecificityIndex *indexes[] = {&fastaIndex, &index};
+	const char *readFrom[] = {"fasta", "packed reference"};
+	for(int i = 0; i < 2; i++) {
+		string from = string(" (") + readFrom[i] + ")";
+
+		//A pair outside the segment has its intended product only.
+		string left = contigs[0].substr(2000, PRIMER_LENGTH);
+		string right = reverseComplement(contigs[0].substr(2300, PRIMER_LENGTH));
+		SpecificityIndex::Site leftSite = {0, 2000, false};
+		SpecificityIndex::Site rightSite = {0, 2300, true};
+		vector<SpecificityIndex::Site> sites;
+		retVal = check(indexes[i]->findSites(left, sites) && sites.size() == 1, "a unique primer has one site" + from) && retVal;
+		retVal = check(indexes[i]->countProducts(left, right, 2) == 1, "a unique pair has one product" + from) && retVal;
+		retVal = check(indexes[i]->countProducts(left, right, 2, &leftSite, &rightSite) == 0,
+				"a unique pair has no product besides the intended one" + from) && retVal;
+
+		//Inside the segment, both primers bind on both contigs.
+		left = contigs[0].substr(SEGMENT_START + 200, PRIMER_LENGTH);
+		right = reverseComplement(contigs[0].substr(SEGMENT_START + 500, PRIMER_LENGTH));
+		leftSite.start = SEGMENT_START + 200;
+		rightSite.start = SEGMENT_START + 500;
+		retVal = check(indexes[i]->findSites(left, sites) && sites.size() == 2 &&
+				sites[0].contigId != sites[1].contigId, "a primer in the segment has a site in each copy" + from) && retVal;
+		retVal = check(indexes[i]->countProducts(left, right, 3) == 2, "a pair in the segment has two products" + from) && retVal;
+		retVal = check(indexes[i]->countProducts(left, right, 2, &leftSite, &rightSite) == 1,
+				"a pair in the segment has the product of the copy besides the intended one" + from) && retVal;
+
+		//The same pair designed on the copy has the product of chr1 besides its own.
+		leftSite.contigId = rightSite.contigId = 1;
+		leftSite.start = COPY_START + 200;
+		rightSite.start = COPY_START + 500;
+		retVal = check(indexes[i]->countProducts(left, right, 2, &leftSite, &rightSite) == 1,
+				"a pair in the copy has the product of the segment besides the intended one" + from) && retVal;
+	}
+
+	fai_destroy(fai);
+	removeDirectory(dirLoc);
+
+	return retVal ? EXIT_SUCCESS : EXIT_FAILURE;
+}